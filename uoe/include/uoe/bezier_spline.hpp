@@ -64,18 +64,22 @@ class BezierSpline {
     auto get_spline_points() -> vector<Vector3f>;
     auto get_length() -> float;
     auto get_closest_point(Vector3f point) -> Vector3f;
-    auto f(float t) -> Vector3f;  // spline polynomial function
+    auto f(float t) -> Vector3f;   // spline polynomial function
+    auto df(float t) -> Vector3f;  // derivative of the spline polynomial function
+    auto evaluate(const vector<float>& ts) -> vector<Vector3f>;  // f at every t in `ts`
 
    private:
     auto generate_distance_lut() -> void;
     auto generate_offset_points() -> void;
+    auto generate_weighted_points() -> void;
+    auto evaluate_polynomial(const vector<Vector3f>& coefficients, float t) -> Vector3f;
 
     vector<Vector3f> input_points;         // idx: input point number, element: 3D input point
     vector<Vector3f> offset_input_points;  // idx: offset point number
+    // idx: term of the polynomial, element: offset point times its binomial weight
+    vector<Vector3f> weighted_points;
+    vector<Vector3f> derivative_points;  // idx: term of the derivative of the polynomial
     vector<Vector3f> spline_points;        // idx: output point number, element: 3D output point
-    // static vector<int> binomial_lut;       // idx: input point number, element: binomial
-    // coeffient
-    static constexpr std::array<int, binomial_lut_size> binomial_lut = generate_binomial_lut();
     vector<float> distance_lut;  // idx: time, element: distance - arc length at last idx
     Vector3f offset;             // translation from origin
     int resolution;              // output size
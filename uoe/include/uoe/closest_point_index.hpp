@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <eigen3/Eigen/Dense>
+#include <eigen3/Eigen/Geometry>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace uoe::trajectory {
+
+/**
+ * @brief closest point queries on a polyline, e.g. a trajectory sampled at a fixed distance.
+ * The segments of the polyline are kept in a bounding volume hierarchy over runs of consecutive
+ * segments, which are spatially coherent, so no sorting is needed to build it. A query starts
+ * from the segment found by the previous query, and its neighbours, which bounds the distance
+ * before the hierarchy is traversed. For a query point moving along the polyline, only the
+ * nodes on the path to that segment survive the bound. The result is projected onto the closest
+ * segment, rather than snapped to a sample. Queries do not allocate.
+ */
+class ClosestPointIndex final {
+   public:
+    ClosestPointIndex() {}
+    explicit ClosestPointIndex(std::vector<Eigen::Vector3f> polyline)
+        : points_(std::move(polyline)) {
+        if (points_.size() >= 2) {
+            nodes_.reserve(2 * (n_segments_() / LEAF_SIZE + 1));
+            build_(0, n_segments_());
+        }
+    }
+
+    /**
+     * @brief the point on the polyline closest to `query`, or `query` if the polyline is empty.
+     */
+    auto closest_point(const Eigen::Vector3f& query) -> Eigen::Vector3f {
+        if (points_.size() < 2) {
+            return points_.empty() ? query : points_.front();
+        }
+        // warm start from the segment of the previous query
+        auto best_segment = last_segment_;
+        auto best = squared_distance_to_segment_(query, best_segment);
+        const auto first = last_segment_ > 0 ? last_segment_ - 1 : 0;
+        const auto last = std::min(last_segment_ + 2, n_segments_());
+        for (auto s = first; s < last; ++s) {
+            const auto d = squared_distance_to_segment_(query, s);
+            if (d < best) {
+                best = d;
+                best_segment = s;
+            }
+        }
+
+        auto stack = std::array<std::uint32_t, MAX_DEPTH>{};
+        auto top = std::size_t{0};
+        stack[top++] = 0;
+        while (top > 0) {
+            const auto& node = nodes_[stack[--top]];
+            if (node.box.squaredExteriorDistance(query) >= best) {
+                continue;
+            }
+            if (node.left == NO_CHILD) {
+                for (auto s = node.first; s < node.last; ++s) {
+                    const auto d = squared_distance_to_segment_(query, s);
+                    if (d < best) {
+                        best = d;
+                        best_segment = s;
+                    }
+                }
+                continue;
+            }
+            // visit the nearer child first, so it tightens the bound for the other one
+            auto near = node.left;
+            auto far = node.right;
+            if (nodes_[far].box.squaredExteriorDistance(query) <
+                nodes_[near].box.squaredExteriorDistance(query)) {
+                std::swap(near, far);
+            }
+            stack[top++] = far;
+            stack[top++] = near;
+        }
+        last_segment_ = best_segment;
+        return project_onto_segment_(query, best_segment);
+    }
+
+    [[nodiscard]] auto points() const -> const std::vector<Eigen::Vector3f>& { return points_; }
+
+   private:
+    static constexpr std::uint32_t LEAF_SIZE = 8;
+    static constexpr std::uint32_t NO_CHILD = std::numeric_limits<std::uint32_t>::max();
+    // the ranges of the children differ by at most one segment, so the depth is logarithmic
+    static constexpr std::size_t MAX_DEPTH = 64;
+
+    struct Node {
+        Eigen::AlignedBox3f box;
+        std::uint32_t first, last;  // range of segments
+        std::uint32_t left = NO_CHILD, right = NO_CHILD;
+    };
+
+    std::vector<Eigen::Vector3f> points_{};
+    std::vector<Node> nodes_{};
+    std::uint32_t last_segment_ = 0;
+
+    [[nodiscard]] auto n_segments_() const -> std::uint32_t {
+        return static_cast<std::uint32_t>(points_.size() - 1);
+    }
+
+    auto build_(std::uint32_t first, std::uint32_t last) -> std::uint32_t {
+        const auto idx = static_cast<std::uint32_t>(nodes_.size());
+        nodes_.push_back(Node{Eigen::AlignedBox3f{}, first, last});
+        // segment s spans points s and s + 1
+        for (auto p = first; p <= last; ++p) {
+            nodes_[idx].box.extend(points_[p]);
+        }
+        if (last - first > LEAF_SIZE) {
+            const auto middle = first + (last - first) / 2;
+            const auto left = build_(first, middle);
+            const auto right = build_(middle, last);
+            nodes_[idx].left = left;
+            nodes_[idx].right = right;
+        }
+        return idx;
+    }
+
+    [[nodiscard]] auto project_onto_segment_(const Eigen::Vector3f& query, std::uint32_t s) const
+        -> Eigen::Vector3f {
+        const auto& a = points_[s];
+        const Eigen::Vector3f ab = points_[s + 1] - a;
+        const auto length2 = ab.squaredNorm();
+        const auto t = length2 > 0 ? std::clamp((query - a).dot(ab) / length2, 0.f, 1.f) : 0.f;
+        return a + t * ab;
+    }
+
+    [[nodiscard]] auto squared_distance_to_segment_(const Eigen::Vector3f& query,
+                                                    std::uint32_t s) const -> float {
+        return (project_onto_segment_(query, s) - query).squaredNorm();
+    }
+};
+
+}  // namespace uoe::trajectory
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "uoe/common_types.hpp"
+#include "uoe/octomap.hpp"
+
+namespace uoe {
+
+/**
+ * @brief the cells of a uoe::Octomap, at a coarser depth than its leaves, that are known to be
+ * free in their entirety, so a collision check through open space can accept it a cell at a time,
+ * instead of stepping through every voxel of it, see RRT::assign_coarse_free_space().
+ *
+ * The occupancy of an inner node of the octree is the maximum of its children, which is
+ * conservative for obstacles, but not for unknown space: a free inner node can still have unknown
+ * children. So a cell only counts as free if it is covered by a free leaf, looked up in the tree,
+ * or if the free leaves below it fill it entirely, which is counted once, when the cells are
+ * built, in a single pass over the leaves. A cell that is not free may still be mostly free, so a
+ * check that fails here has to be refined at the resolution of the map.
+ *
+ * The map is referenced, not copied, so it has to outlive the cells, and not change meanwhile.
+ */
+class CoarseFreeSpace final {
+   public:
+    using vec3 = types::vec3;
+
+    /**
+     * @param levels the number of levels above the leaves the cells are at, so the edge of a cell
+     * is the resolution of the map times 2^levels.
+     * @throws std::invalid_argument if levels is 0, or not less than the depth of the octree.
+     */
+    CoarseFreeSpace(const Octomap& map, unsigned int levels)
+        : map_{map}, levels_{levels}, depth_{depth_of_(map, levels)} {
+        const auto& octree = map.octree();
+        const auto tree_depth = octree.getTreeDepth();
+        cell_size_ = octree.getNodeSize(depth_);
+        // keys are offset by half the extent of the tree, so that the origin is at its center
+        key_offset_ = octree.getNodeSize(0) / 2;
+
+        // the free volume, in voxels, below each cell. Leaves at or above the depth of the cells
+        // are found by the lookup in the tree instead.
+        auto volumes = std::unordered_map<std::uint64_t, std::uint64_t>();
+        for (auto it = octree.begin_leafs(), end = octree.end_leafs(); it != end; ++it) {
+            if (it.getDepth() <= depth_ || octree.isNodeOccupied(*it)) {
+                continue;
+            }
+            const auto key = it.getKey();
+            const auto cell = cell_{key[0] >> levels_, key[1] >> levels_, key[2] >> levels_};
+            volumes[pack_(cell)] += std::uint64_t{1} << (3 * (tree_depth - it.getDepth()));
+        }
+        const auto full = std::uint64_t{1} << (3 * levels_);
+        for (const auto& [cell, volume] : volumes) {
+            if (volume == full) {
+                filled_cells_.insert(cell);
+            }
+        }
+    }
+
+    [[nodiscard]] auto levels() const -> unsigned int { return levels_; }
+    [[nodiscard]] auto cell_size() const -> double { return cell_size_; }
+    /**
+     * @brief the cells that are free because the leaves below them fill them, not counting the
+     * cells covered by a single free leaf
+     */
+    [[nodiscard]] auto n_filled_cells() const -> std::size_t { return filled_cells_.size(); }
+
+    /**
+     * @brief if every cell within clearance of the segment from a to b is free. False does not
+     * mean the segment is in collision, only that it comes near space not known to be free.
+     *
+     * The cells the segment passes through are traversed with a 3D-DDA, and together with them
+     * the cells within clearance of them, so a cell grown by the clearance is only looked up
+     * once, when the traversal first reaches it.
+     */
+    [[nodiscard]] auto segment_is_free(const vec3& a, const vec3& b, float clearance) const
+        -> bool {
+        const auto reach = static_cast<std::int64_t>(std::ceil(std::max(0.0f, clearance) /
+                                                               static_cast<float>(cell_size_)));
+        const auto to_cell = [&](const vec3& p) {
+            auto c = std::array<double, 3>{};
+            for (int i = 0; i < 3; ++i) {
+                c[i] = (static_cast<double>(p[i]) + key_offset_) / cell_size_;
+            }
+            return c;
+        };
+        const auto start = to_cell(a);
+        const auto stop = to_cell(b);
+
+        auto cell = std::array<std::int64_t, 3>{};
+        auto remaining = std::array<std::int64_t, 3>{};
+        auto step = std::array<std::int64_t, 3>{};
+        auto t_delta = std::array<double, 3>{};
+        auto t_max = std::array<double, 3>{};
+        constexpr auto inf = std::numeric_limits<double>::max();
+        for (int i = 0; i < 3; ++i) {
+            cell[i] = static_cast<std::int64_t>(std::floor(start[i]));
+            const auto last = static_cast<std::int64_t>(std::floor(stop[i]));
+            const auto d = stop[i] - start[i];
+            step[i] = last > cell[i] ? 1 : (last < cell[i] ? -1 : 0);
+            remaining[i] = std::abs(last - cell[i]);
+            t_delta[i] = step[i] != 0 ? 1.0 / std::abs(d) : inf;
+            t_max[i] = step[i] > 0   ? (static_cast<double>(cell[i] + 1) - start[i]) / d
+                       : step[i] < 0 ? (static_cast<double>(cell[i]) - start[i]) / d
+                                     : inf;
+        }
+
+        // the first cell, grown by reach in every direction
+        for (auto x = cell[0] - reach; x <= cell[0] + reach; ++x) {
+            for (auto y = cell[1] - reach; y <= cell[1] + reach; ++y) {
+                for (auto z = cell[2] - reach; z <= cell[2] + reach; ++z) {
+                    if (! free_({x, y, z})) {
+                        return false;
+                    }
+                }
+            }
+        }
+        // every step along an axis grows the region by the slab of cells at its leading face
+        while (remaining[0] + remaining[1] + remaining[2] > 0) {
+            auto axis = 0;
+            for (int i = 1; i < 3; ++i) {
+                if (remaining[i] > 0 && (remaining[axis] == 0 || t_max[i] < t_max[axis])) {
+                    axis = i;
+                }
+            }
+            cell[axis] += step[axis];
+            t_max[axis] += t_delta[axis];
+            --remaining[axis];
+
+            const auto u = (axis + 1) % 3;
+            const auto v = (axis + 2) % 3;
+            auto c = cell;
+            c[axis] = cell[axis] + step[axis] * reach;
+            for (c[u] = cell[u] - reach; c[u] <= cell[u] + reach; ++c[u]) {
+                for (c[v] = cell[v] - reach; c[v] <= cell[v] + reach; ++c[v]) {
+                    if (! free_(c)) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+   private:
+    using cell_ = std::array<std::int64_t, 3>;
+
+    const Octomap& map_;
+    unsigned int levels_;
+    unsigned int depth_;
+    double cell_size_ = 0.0;
+    double key_offset_ = 0.0;
+    // free cells with leaves below them, see the constructor
+    std::unordered_set<std::uint64_t> filled_cells_{};
+
+    [[nodiscard]] static auto depth_of_(const Octomap& map, unsigned int levels) -> unsigned int {
+        const auto tree_depth = map.octree().getTreeDepth();
+        if (levels == 0 || levels >= tree_depth) {
+            throw std::invalid_argument("levels must be in [1, depth of the octree)");
+        }
+        return tree_depth - levels;
+    }
+
+    // a cell index has at most 16 bits per axis, as many as a key
+    [[nodiscard]] static auto pack_(const cell_& c) -> std::uint64_t {
+        return static_cast<std::uint64_t>(c[0]) | static_cast<std::uint64_t>(c[1]) << 16 |
+               static_cast<std::uint64_t>(c[2]) << 32;
+    }
+
+    [[nodiscard]] auto free_(const cell_& c) const -> bool {
+        const auto n_cells = std::int64_t{1} << depth_;
+        auto key = octomap::OcTreeKey{};
+        for (unsigned int i = 0; i < 3; ++i) {
+            if (c[i] < 0 || c[i] >= n_cells) {
+                return false;
+            }
+            // the key of the center of the cell, as OcTree::search() expects at a depth
+            key[i] = static_cast<octomap::key_type>((c[i] << levels_) | (1 << (levels_ - 1)));
+        }
+        const auto& octree = map_.octree();
+        const auto* node = octree.search(key, depth_);
+        if (node == nullptr) {
+            return false;
+        }
+        if (! octree.nodeHasChildren(node)) {
+            // a leaf at the depth of the cell, or a pruned one above it, covers the whole cell
+            return ! octree.isNodeOccupied(node);
+        }
+        return filled_cells_.count(pack_(c)) != 0;
+    }
+};
+
+}  // namespace uoe
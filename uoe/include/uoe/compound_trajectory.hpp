@@ -12,30 +12,37 @@
 #include <vector>
 
 #include "uoe/bezier_spline.hpp"
+#include "uoe/closest_point_index.hpp"
+#include "uoe/cubic_spline.hpp"
 #include "uoe/linear_trajectory.hpp"
 #include "uoe/utils/utils.hpp"
 
 namespace uoe::trajectory {
 constexpr auto MARKER_SCALE = 0.1f;
 
-using Trajectory = std::variant<BezierSpline, LinearTrajectory>;
+using Trajectory = std::variant<BezierSpline, CubicSpline, LinearTrajectory>;
 
 class CompoundTrajectory {
    public:
     CompoundTrajectory(ros::NodeHandle& nh, ros::Rate& rate, std::vector<Eigen::Vector3f> path,
                        bool visualise = false, float marker_scale = MARKER_SCALE);
+    /**
+     * @brief the same trajectory, without publishing it to be visualised, so it needs no node,
+     * e.g. to fly it offline, see test/pid_tuning.cpp.
+     */
+    explicit CompoundTrajectory(std::vector<Eigen::Vector3f> path);
     auto get_point_at_distance(float distance) -> Eigen::Vector3f;
     auto get_length() -> float;
     auto get_closest_point(Eigen::Vector3f point) -> Eigen::Vector3f;
 
    private:
     auto visualise(float scale) -> void;
+    auto get_trajectory_idx(float distance) -> std::size_t;
     std::vector<float> distance_lut;
+    std::size_t cursor = 0;  // index of the trajectory found by the last distance query
     std::vector<std::vector<Eigen::Vector3f>> sections;
     std::vector<Trajectory> trajectories;
-    std::vector<Eigen::Vector3f> points;
-    ros::NodeHandle nh;
-    ros::Rate rate;
+    ClosestPointIndex closest_point_index;
     ros::Publisher pub_visualisation;
     int seq_marker;
 };
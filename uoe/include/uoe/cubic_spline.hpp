@@ -0,0 +1,41 @@
+#pragma once
+
+#include <eigen3/Eigen/Dense>
+#include <vector>
+
+namespace uoe::trajectory {
+
+//--------------------------------------------------------------------------------------------------
+// Piecewise cubic spline interpolating every input point, with natural end conditions.
+// The spline is C2 continuous, parameterised by the accumulated chord length, and each segment
+// is a cubic polynomial in the local parameter, so evaluating it, or its first and second
+// derivative, costs a binary search for the segment and a constant amount of work.
+// Unlike BezierSpline there is no limit on the number of input points.
+class CubicSpline {
+   public:
+    CubicSpline() {}
+    CubicSpline(std::vector<Eigen::Vector3f> points, int samples_per_segment = 8);
+    auto get_point_at_time(float time) const -> Eigen::Vector3f;
+    auto get_velocity_at_time(float time) const -> Eigen::Vector3f;  // d/dt
+    auto get_acceleration_at_time(float time) const -> Eigen::Vector3f;  // d^2/dt^2
+    auto get_time_at_distance(float distance) const -> float;
+    auto get_point_at_distance(float distance) const -> Eigen::Vector3f;
+    auto get_length() const -> float;
+    auto get_duration() const -> float;  // parameter value at the last input point
+    auto get_closest_point(Eigen::Vector3f point) const -> Eigen::Vector3f;
+
+   private:
+    // p(t) = a + b * u + c * u^2 + d * u^3, with u = t - knot of the segment
+    struct Segment {
+        Eigen::Vector3f a, b, c, d;
+    };
+    auto generate_segments(const std::vector<Eigen::Vector3f>& points) -> void;
+    auto generate_distance_lut(int samples_per_segment) -> void;
+    auto get_segment_idx(float time) const -> int;
+
+    std::vector<float> knots;       // idx: input point number, element: parameter value
+    std::vector<Segment> segments;  // idx: segment number, between knots idx and idx + 1
+    std::vector<float> time_lut;    // idx: sample number, element: parameter value
+    std::vector<float> distance_lut;  // idx: sample number, element: arc length at the sample
+};
+}  // namespace uoe::trajectory
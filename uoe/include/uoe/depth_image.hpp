@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "uoe/common_types.hpp"
+
+namespace uoe {
+
+/**
+ * @brief intrinsics of a pinhole depth camera, in its optical frame, with z forward, x right and
+ * y down. Depths outside [depth_min, depth_max] are not measurements.
+ */
+struct PinholeCamera {
+    float fx = 1, fy = 1, cx = 0, cy = 0;
+    unsigned int width = 0, height = 0;
+    float depth_min = 0, depth_max = std::numeric_limits<float>::max();
+
+    /**
+     * @brief the camera of an image of width x height pixels, with the field of view of
+     * rosparam/camera.yaml, in degrees, and its principal point at the center of the image.
+     */
+    static auto from_fov(unsigned int width, unsigned int height, float horizontal_fov,
+                         float vertical_fov, float depth_min, float depth_max) -> PinholeCamera {
+        const auto focal_length = [](unsigned int size, float fov) {
+            return static_cast<float>(size) / 2 /
+                   std::tan(static_cast<float>(uoe::types::deg2rad(fov)) / 2);
+        };
+        return {focal_length(width, horizontal_fov),
+                focal_length(height, vertical_fov),
+                static_cast<float>(width) / 2,
+                static_cast<float>(height) / 2,
+                width,
+                height,
+                depth_min,
+                depth_max};
+    }
+
+    [[nodiscard]] auto measures(float depth) const -> bool {
+        return std::isfinite(depth) && depth_min <= depth && depth <= depth_max;
+    }
+};
+
+/**
+ * @brief a depth image, not owned, in meters along the optical axis, with a mask selecting the
+ * pixels to integrate. Pixel (u, v) is depth[v * stride + u].
+ */
+struct DepthImageView {
+    const float* depth = nullptr;
+    unsigned int width = 0, height = 0;
+    std::size_t stride = 0;  // in pixels
+    // a byte per pixel, row major without padding, nonzero for the pixels to integrate. Every
+    // pixel is integrated if it is nullptr.
+    const std::uint8_t* mask = nullptr;
+
+    [[nodiscard]] auto at(unsigned int u, unsigned int v) const -> float {
+        return depth[v * stride + u];
+    }
+    [[nodiscard]] auto selected(unsigned int u, unsigned int v) const -> bool {
+        return mask == nullptr || mask[std::size_t{v} * width + u] != 0;
+    }
+};
+
+}  // namespace uoe
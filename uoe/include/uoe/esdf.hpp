@@ -0,0 +1,397 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "uoe/bbx.hpp"
+#include "uoe/common_types.hpp"
+#include "uoe/octomap.hpp"
+
+namespace uoe {
+
+/**
+ * @brief euclidean signed distance field over a fixed volume, built from a uoe::Octomap.
+ *
+ * The field is a dense grid of voxels. Each voxel holds the distance from its center to the
+ * center of the nearest voxel that is not free. For voxels that are not free it is the negative
+ * distance to the nearest free voxel. Unknown space counts as not free, as it does for the
+ * raycasts in RRT, and so does the space outside of the bounds, so the distances of free voxels
+ * are at most the distance to the nearest voxel past the bounds. Distances are truncated to
+ * [-max_distance, max_distance].
+ *
+ * The distances are computed with the exact euclidean distance transform of Felzenszwalb and
+ * Huttenlocher, one pass per axis, so building the field is linear in the number of voxels.
+ * An update of a region only recomputes the voxels within max_distance of it, which is what
+ * keeps the field in sync with a growing octomap cheaply.
+ *
+ * A collision check of a segment is then a few trilinear lookups. Starting at one end, the
+ * segment is known to be free for as far as the distance at the current point exceeds the
+ * clearance, so the lookups skip ahead by that amount (sphere tracing). In open space a segment
+ * takes a handful of lookups regardless of the clearance, where raycasting a wide cross section
+ * needs more rays the wider it is.
+ */
+class Esdf final {
+   public:
+    using vec3 = types::vec3;
+    using index_type = std::int32_t;
+
+    /**
+     * @param bounds the volume covered by the field. Queries outside of it see unknown space.
+     * @param voxel_size edge length of the voxels, usually the octomap resolution.
+     * @param max_distance distances are only exact up to this value.
+     * @throws std::invalid_argument if voxel_size or max_distance is not greater than 0.
+     */
+    Esdf(const types::BBX& bounds, double voxel_size, double max_distance)
+        : voxel_size_{static_cast<float>(voxel_size)},
+          max_distance_{static_cast<float>(max_distance)} {
+        if (! (voxel_size > 0)) {
+            throw std::invalid_argument("voxel_size must be greater than 0");
+        }
+        if (! (max_distance > 0)) {
+            throw std::invalid_argument("max_distance must be greater than 0");
+        }
+        origin_ = bounds.min();
+        const vec3 extent = bounds.max() - origin_;
+        for (int axis = 0; axis < 3; ++axis) {
+            // at least two voxels along each axis, so there is always something to interpolate
+            dimensions_[axis] =
+                std::max(2, static_cast<index_type>(std::ceil(extent[axis] / voxel_size_)));
+        }
+        // everything is unknown until the first integration
+        distances_.assign(n_voxels_(), -max_distance_);
+    }
+
+    // PUBLIC INTERFACE
+    // ---------------------------------------------------------------------------------------------
+
+    /**
+     * @brief recompute the whole field from map.
+     */
+    auto integrate(const Octomap& map) -> void { integrate(map, bounds()); }
+
+    /**
+     * @brief recompute the field where it can have changed, when the occupancy of map has
+     * changed inside region, e.g. the result of Octomap::changed_region().
+     */
+    auto integrate(const Octomap& map, const types::BBX& region) -> void {
+        // voxels within max_distance of the region can change, and their distances depend on the
+        // voxels within max_distance of them.
+        const auto margin = static_cast<index_type>(std::ceil(max_distance_ / voxel_size_)) + 1;
+        auto [write_lo, write_hi] = voxel_range_(region);
+        for (int axis = 0; axis < 3; ++axis) {
+            write_lo[axis] = std::max(write_lo[axis] - margin, 0);
+            write_hi[axis] = std::min(write_hi[axis] + margin, dimensions_[axis] - 1);
+            if (write_hi[axis] < write_lo[axis]) {
+                return;  // the region is outside of the field
+            }
+        }
+        auto read_lo = write_lo;
+        auto read_hi = write_hi;
+        for (int axis = 0; axis < 3; ++axis) {
+            read_lo[axis] = std::max(read_lo[axis] - margin, 0);
+            read_hi[axis] = std::min(read_hi[axis] + margin, dimensions_[axis] - 1);
+        }
+
+        auto block = block_t{};
+        block.lo = read_lo;
+        for (int axis = 0; axis < 3; ++axis) {
+            block.dimensions[axis] = read_hi[axis] - read_lo[axis] + 1;
+        }
+        rasterize_(map, block);
+        compute_(block);
+
+        for (index_type z = write_lo[2]; z <= write_hi[2]; ++z) {
+            for (index_type y = write_lo[1]; y <= write_hi[1]; ++y) {
+                for (index_type x = write_lo[0]; x <= write_hi[0]; ++x) {
+                    const auto d = block.distances[block.index(x - read_lo[0], y - read_lo[1],
+                                                               z - read_lo[2])];
+                    // the block is clipped to the field, so nothing past it was a source
+                    distances_[index_(x, y, z)] = std::min(d, distance_to_border_(x, y, z));
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief the distance at pt, trilinearly interpolated between the voxel centers.
+     * @return -max_distance() outside of the bounds, where space is unknown.
+     */
+    [[nodiscard]] auto distance(const vec3& pt) const -> float {
+        const vec3 g = (pt - origin_) / voxel_size_;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (! (0 <= g[axis] && g[axis] <= static_cast<float>(dimensions_[axis]))) {
+                return -max_distance_;
+            }
+        }
+        // coordinates relative to the voxel centers
+        auto i = std::array<index_type, 3>{};
+        auto t = std::array<float, 3>{};
+        for (int axis = 0; axis < 3; ++axis) {
+            const auto c = g[axis] - 0.5f;
+            i[axis] = std::clamp(static_cast<index_type>(std::floor(c)), 0, dimensions_[axis] - 2);
+            t[axis] = std::clamp(c - static_cast<float>(i[axis]), 0.0f, 1.0f);
+        }
+        const auto at = [&](index_type dx, index_type dy, index_type dz) {
+            return distances_[index_(i[0] + dx, i[1] + dy, i[2] + dz)];
+        };
+        const auto lerp = [](float a, float b, float s) { return a + (b - a) * s; };
+        const auto x00 = lerp(at(0, 0, 0), at(1, 0, 0), t[0]);
+        const auto x10 = lerp(at(0, 1, 0), at(1, 1, 0), t[0]);
+        const auto x01 = lerp(at(0, 0, 1), at(1, 0, 1), t[0]);
+        const auto x11 = lerp(at(0, 1, 1), at(1, 1, 1), t[0]);
+        return lerp(lerp(x00, x10, t[1]), lerp(x01, x11, t[1]), t[2]);
+    }
+
+    /**
+     * @brief true if every point of the segment from a to b is at least clearance away from
+     * space that is not free.
+     * @note the distances are between voxel centers, so half a voxel diagonal is added to
+     * clearance, to stay conservative. A clearance above max_distance() can never be satisfied.
+     */
+    [[nodiscard]] auto segment_is_free(const vec3& a, const vec3& b, float clearance) const
+        -> bool {
+        const auto margin = clearance + voxel_size_ * std::sqrt(3.0f) / 2;
+        const vec3 d = b - a;
+        const auto length = d.norm();
+        const vec3 direction = length > 0 ? vec3{d / length} : vec3::Zero();
+        const auto min_step = voxel_size_ / 2;
+
+        for (auto s = 0.0f;;) {
+            const auto dist = distance(a + direction * std::min(s, length));
+            if (dist < margin) {
+                return false;
+            }
+            if (s >= length) {
+                return true;
+            }
+            // nothing is closer than dist to the current point, so the segment is free until
+            // it gets within margin of that sphere's boundary.
+            s += std::max(dist - margin, min_step);
+        }
+    }
+
+    [[nodiscard]] auto bounds() const -> types::BBX {
+        const vec3 extent = vec3{static_cast<float>(dimensions_[0]),
+                                 static_cast<float>(dimensions_[1]),
+                                 static_cast<float>(dimensions_[2])} *
+                            voxel_size_;
+        return {origin_, origin_ + extent};
+    }
+    [[nodiscard]] auto voxel_size() const -> float { return voxel_size_; }
+    [[nodiscard]] auto max_distance() const -> float { return max_distance_; }
+    [[nodiscard]] auto dimensions() const -> const std::array<index_type, 3>& {
+        return dimensions_;
+    }
+
+   private:
+    vec3 origin_{};
+    float voxel_size_;
+    float max_distance_;
+    std::array<index_type, 3> dimensions_{};
+    std::vector<float> distances_{};
+
+    /**
+     * @brief a box of voxels the distance transform is computed over.
+     */
+    struct block_t {
+        std::array<index_type, 3> lo{};
+        std::array<index_type, 3> dimensions{};
+        std::vector<std::uint8_t> free{};
+        std::vector<float> distances{};
+
+        [[nodiscard]] auto size() const -> std::size_t {
+            return static_cast<std::size_t>(dimensions[0]) * dimensions[1] * dimensions[2];
+        }
+        [[nodiscard]] auto index(index_type x, index_type y, index_type z) const -> std::size_t {
+            return (static_cast<std::size_t>(z) * dimensions[1] + y) * dimensions[0] + x;
+        }
+    };
+
+    [[nodiscard]] auto n_voxels_() const -> std::size_t {
+        return static_cast<std::size_t>(dimensions_[0]) * dimensions_[1] * dimensions_[2];
+    }
+    [[nodiscard]] auto index_(index_type x, index_type y, index_type z) const -> std::size_t {
+        return (static_cast<std::size_t>(z) * dimensions_[1] + y) * dimensions_[0] + x;
+    }
+
+    /**
+     * @brief the distance from the center of the voxel to the center of the nearest voxel
+     * outside of the field, one past it along an axis, which is unknown space.
+     */
+    [[nodiscard]] auto distance_to_border_(index_type x, index_type y, index_type z) const
+        -> float {
+        const auto voxels = std::min({x + 1, y + 1, z + 1, dimensions_[0] - x,
+                                      dimensions_[1] - y, dimensions_[2] - z});
+        return static_cast<float>(voxels) * voxel_size_;
+    }
+
+    /**
+     * @return the first and last voxel, per axis, whose center is inside bbx. Not clipped to the
+     * field, and empty along an axis if last < first.
+     */
+    [[nodiscard]] auto voxel_range_(const types::BBX& bbx) const
+        -> std::pair<std::array<index_type, 3>, std::array<index_type, 3>> {
+        auto lo = std::array<index_type, 3>{};
+        auto hi = std::array<index_type, 3>{};
+        const vec3 min = (bbx.min() - origin_) / voxel_size_;
+        const vec3 max = (bbx.max() - origin_) / voxel_size_;
+        for (int axis = 0; axis < 3; ++axis) {
+            lo[axis] = static_cast<index_type>(std::ceil(min[axis] - 0.5f));
+            hi[axis] = static_cast<index_type>(std::floor(max[axis] - 0.5f));
+        }
+        return {lo, hi};
+    }
+
+    /**
+     * @brief mark the voxels of block whose center lies inside a free leaf of map.
+     */
+    auto rasterize_(const Octomap& map, block_t& block) const -> void {
+        block.free.assign(block.size(), 0);
+        const auto& lo = block.lo;
+        const vec3 min = origin_ + vec3{static_cast<float>(lo[0]), static_cast<float>(lo[1]),
+                                        static_cast<float>(lo[2])} *
+                                       voxel_size_;
+        const vec3 max = min + vec3{static_cast<float>(block.dimensions[0]),
+                                    static_cast<float>(block.dimensions[1]),
+                                    static_cast<float>(block.dimensions[2])} *
+                                   voxel_size_;
+
+        map.iterate_over_known_leaves_in_bbx(
+            types::BBX{min, max},
+            [&](const Octomap::point_type& center, double size, bool occupied) {
+                if (occupied) {
+                    return;  // voxels are not free until a free leaf says otherwise
+                }
+                const auto half = static_cast<float>(size / 2);
+                const vec3 c = vec3{center.x(), center.y(), center.z()};
+                auto [leaf_lo, leaf_hi] =
+                    voxel_range_(types::BBX{c - vec3::Constant(half), c + vec3::Constant(half)});
+                for (int axis = 0; axis < 3; ++axis) {
+                    leaf_lo[axis] = std::max(leaf_lo[axis] - lo[axis], 0);
+                    leaf_hi[axis] = std::min(leaf_hi[axis] - lo[axis], block.dimensions[axis] - 1);
+                }
+                for (index_type z = leaf_lo[2]; z <= leaf_hi[2]; ++z) {
+                    for (index_type y = leaf_lo[1]; y <= leaf_hi[1]; ++y) {
+                        for (index_type x = leaf_lo[0]; x <= leaf_hi[0]; ++x) {
+                            block.free[block.index(x, y, z)] = 1;
+                        }
+                    }
+                }
+            });
+    }
+
+    /**
+     * @brief signed distances of every voxel of block, from its free voxels.
+     */
+    auto compute_(block_t& block) const -> void {
+        const auto n = block.size();
+        // squared distances in voxels, from every voxel to the nearest voxel that is not free,
+        // and to the nearest free voxel.
+        auto to_occupied = std::vector<double>(n);
+        auto to_free = std::vector<double>(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            to_occupied[i] = block.free[i] ? infinity : 0.0;
+            to_free[i] = block.free[i] ? 0.0 : infinity;
+        }
+        distance_transform_(to_occupied, block.dimensions);
+        distance_transform_(to_free, block.dimensions);
+
+        block.distances.resize(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            const auto d = block.free[i] ? std::sqrt(to_occupied[i]) : -std::sqrt(to_free[i]);
+            block.distances[i] =
+                std::clamp(static_cast<float>(d) * voxel_size_, -max_distance_, max_distance_);
+        }
+    }
+
+    static constexpr double infinity = std::numeric_limits<double>::infinity();
+
+    /**
+     * @brief squared euclidean distance transform of f in place, one axis at a time.
+     */
+    static auto distance_transform_(std::vector<double>& f,
+                                    const std::array<index_type, 3>& dimensions) -> void {
+        const auto [nx, ny, nz] = dimensions;
+        const auto longest = static_cast<std::size_t>(std::max({nx, ny, nz}));
+        auto line = std::vector<double>(longest);
+        auto parabolas = std::vector<index_type>(longest);
+        auto boundaries = std::vector<double>(longest + 1);
+
+        const auto transform_lines = [&](index_type n, std::size_t stride, index_type n_a,
+                                         std::size_t stride_a, index_type n_b,
+                                         std::size_t stride_b) {
+            for (index_type b = 0; b < n_b; ++b) {
+                for (index_type a = 0; a < n_a; ++a) {
+                    double* first = f.data() + a * stride_a + b * stride_b;
+                    distance_transform_1d_(first, stride, n, line, parabolas, boundaries);
+                }
+            }
+        };
+        const auto sx = std::size_t{1};
+        const auto sy = static_cast<std::size_t>(nx);
+        const auto sz = static_cast<std::size_t>(nx) * ny;
+        transform_lines(nx, sx, ny, sy, nz, sz);
+        transform_lines(ny, sy, nx, sx, nz, sz);
+        transform_lines(nz, sz, nx, sx, ny, sy);
+    }
+
+    /**
+     * @brief Felzenszwalb and Huttenlocher. The lower envelope of the parabolas rooted at every
+     * q with a finite f(q), evaluated at every q.
+     */
+    static auto distance_transform_1d_(double* f, std::size_t stride, index_type n,
+                                       std::vector<double>& line,
+                                       std::vector<index_type>& parabolas,
+                                       std::vector<double>& boundaries) -> void {
+        for (index_type q = 0; q < n; ++q) {
+            line[q] = f[q * stride];
+        }
+        const auto intersection = [&](index_type p, index_type q) {
+            return ((line[q] + static_cast<double>(q) * q) - (line[p] + static_cast<double>(p) * p)) /
+                   (2.0 * (q - p));
+        };
+
+        index_type k = -1;
+        for (index_type q = 0; q < n; ++q) {
+            if (line[q] == infinity) {
+                continue;
+            }
+            if (k < 0) {
+                k = 0;
+                parabolas[0] = q;
+                boundaries[0] = -infinity;
+                boundaries[1] = infinity;
+                continue;
+            }
+            auto s = intersection(parabolas[k], q);
+            while (s <= boundaries[k]) {
+                --k;
+                s = intersection(parabolas[k], q);
+            }
+            ++k;
+            parabolas[k] = q;
+            boundaries[k] = s;
+            boundaries[k + 1] = infinity;
+        }
+        if (k < 0) {
+            return;  // no sources, everything stays at infinity
+        }
+
+        k = 0;
+        for (index_type q = 0; q < n; ++q) {
+            while (boundaries[k + 1] < q) {
+                ++k;
+            }
+            const auto p = parabolas[k];
+            f[q * stride] = static_cast<double>(q - p) * (q - p) + line[p];
+        }
+    }
+};
+
+}  // namespace uoe
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 
 // #include "Eigen/src/Geometry/Quaternion.h"
 #include "uoe/common_types.hpp"
@@ -29,7 +34,15 @@ struct Plane3D {
     };
 };
 
+/**
+ * @brief how a volume relates to a region, e.g. an octree node to a FoV.
+ */
+enum class Overlap { Outside, Partial, Inside };
+
 class FoV {
+   public:
+    static constexpr std::size_t BATCH_SIZE = 16;
+
    private:
     Pose pose_;
     FoVAngle horizontal_, vertical_;
@@ -44,8 +57,9 @@ class FoV {
 
     // Plane3D right_, left_, above_, below_;
 
-    // std::array<Plane3D, 4> planes_{};
-    std::vector<Plane3D> planes_{};
+    // the four side planes, as a structure of arrays, so a batch of points can be tested against
+    // all of them with the same instructions. A point is inside, when it is below every plane.
+    std::array<float, 4> plane_nx_{}, plane_ny_{}, plane_nz_{}, plane_d_{};
 
    public:
     FoV(Pose p, const FoVAngle& h, const FoVAngle& v, const DepthRange& d, Position target)
@@ -132,10 +146,14 @@ class FoV {
             lower_left_ = m * direction_towards_target_;
         }
 
-        planes_.emplace_back(upper_right_.cross(lower_right_), pose().position);
-        planes_.emplace_back(lower_right_.cross(lower_left_), pose().position);
-        planes_.emplace_back(lower_left_.cross(upper_left_), pose().position);
-        planes_.emplace_back(upper_left_.cross(upper_right_), pose().position);
+        const auto normals = plane_normals();
+        for (std::size_t i = 0; i < normals.size(); ++i) {
+            const auto plane = Plane3D(normals[i], pose().position);
+            plane_nx_[i] = plane.normal.x();
+            plane_ny_[i] = plane.normal.y();
+            plane_nz_[i] = plane.normal.z();
+            plane_d_[i] = static_cast<float>(plane.d);
+        }
     }
 
     [[nodiscard]] auto pose() const -> const Pose& { return pose_; }
@@ -234,10 +252,89 @@ class FoV {
     }
 
     auto inside_fov(const vec3& pt) const -> bool {
-        const double dist_from_fov_to_pt = (pt - pose_.position).norm();
-        return depth_range_.min <= dist_from_fov_to_pt && dist_from_fov_to_pt <= depth_range_.max &&
-               std::all_of(planes_.begin(), planes_.end(),
-                           [&](const Plane3D& plane) { return plane.below(pt); });
+        auto inside = std::uint8_t{0};
+        inside_fov(&pt, 1, &inside);
+        return inside != 0;
+    }
+
+    /**
+     * @brief inside[i] = inside_fov(pts[i]), for i in [0, n).
+     *
+     * The points are tested in blocks of BATCH_SIZE. Each block is transposed into a structure of
+     * arrays, and then tested with straight line code, without branches, comparing squared
+     * distances to the depth range, so the compiler can map one lane to each point.
+     */
+    auto inside_fov(const vec3* pts, std::size_t n, std::uint8_t* inside) const -> void {
+        const auto& o = pose_.position;
+        const auto min2 = depth_range_.min * depth_range_.min;
+        const auto max2 = depth_range_.max * depth_range_.max;
+        for (std::size_t first = 0; first < n; first += BATCH_SIZE) {
+            const auto count = std::min(BATCH_SIZE, n - first);
+            alignas(32) std::array<float, BATCH_SIZE> x{}, y{}, z{};
+            for (std::size_t i = 0; i < count; ++i) {
+                x[i] = pts[first + i].x();
+                y[i] = pts[first + i].y();
+                z[i] = pts[first + i].z();
+            }
+            alignas(32) std::array<std::uint8_t, BATCH_SIZE> mask{};
+            for (std::size_t i = 0; i < BATCH_SIZE; ++i) {
+                const auto dx = x[i] - o.x();
+                const auto dy = y[i] - o.y();
+                const auto dz = z[i] - o.z();
+                const auto distance2 = dx * dx + dy * dy + dz * dz;
+                auto below = (min2 <= distance2) & (distance2 <= max2);
+                for (std::size_t p = 0; p < plane_d_.size(); ++p) {
+                    below &= x[i] * plane_nx_[p] + y[i] * plane_ny_[p] + z[i] * plane_nz_[p] +
+                                 plane_d_[p] <
+                             0.0f;
+                }
+                mask[i] = static_cast<std::uint8_t>(below);
+            }
+            std::copy_n(mask.begin(), count, inside + first);
+        }
+    }
+
+    auto inside_fov(const std::vector<vec3>& pts, std::vector<std::uint8_t>& inside) const
+        -> void {
+        inside.resize(pts.size());
+        inside_fov(pts.data(), pts.size(), inside.data());
+    }
+
+    /**
+     * @brief how the axis aligned cube at center relates to the line of sight volume of the FoV,
+     * i.e. the pyramid between the origin and the far plane. This also covers the space in
+     * front of the near plane, where occluders can still block the view.
+     *
+     * A cube that crosses the near plane is Partial, so inside_fov() has the same result for
+     * every point of a cube classified as Inside. The test is conservative: a cube is only
+     * Outside if it is entirely outside one of the side planes, or beyond the far plane, so
+     * some cubes near the edges are reported Partial, while being outside.
+     */
+    [[nodiscard]] auto overlap(const vec3& center, float half_size) const -> Overlap {
+        auto inside = true;
+        for (std::size_t p = 0; p < plane_d_.size(); ++p) {
+            const auto s = center.x() * plane_nx_[p] + center.y() * plane_ny_[p] +
+                           center.z() * plane_nz_[p] + plane_d_[p];
+            // the largest change of s over the cube
+            const auto r = half_size * (std::abs(plane_nx_[p]) + std::abs(plane_ny_[p]) +
+                                        std::abs(plane_nz_[p]));
+            if (s - r >= 0.0f) {
+                return Overlap::Outside;
+            }
+            inside = inside && s + r < 0.0f;
+        }
+
+        const vec3 offset = (center - pose_.position).cwiseAbs();
+        const auto nearest2 = (offset.array() - half_size).max(0.0f).matrix().squaredNorm();
+        const auto farthest2 = (offset.array() + half_size).matrix().squaredNorm();
+        const auto max2 = depth_range_.max * depth_range_.max;
+        const auto min2 = depth_range_.min * depth_range_.min;
+        if (nearest2 > max2) {
+            return Overlap::Outside;
+        }
+        const auto crosses_near_plane = nearest2 < min2 && min2 < farthest2;
+        return inside && farthest2 <= max2 && ! crosses_near_plane ? Overlap::Inside
+                                                                   : Overlap::Partial;
     }
 
     // auto normal_plane() const -> mat3x3 {}
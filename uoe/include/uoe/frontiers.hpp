@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "uoe/bbx.hpp"
+#include "uoe/common_types.hpp"
+#include "uoe/octomap.hpp"
+#include "uoe/voxelstatus.hpp"
+
+namespace uoe {
+
+/**
+ * @brief the frontier of the explored space of a uoe::Octomap, i.e. the free voxels with an
+ * unknown neighbour, which is where a viewpoint can still see something new.
+ *
+ * Every frontier voxel remembers which of its faces border unknown space, so the frontiers facing
+ * a point, e.g. the interest point of a NBV request, can be told apart from those looking away
+ * from it: from a frontier facing the point, the view towards it passes through unknown space.
+ *
+ * Only the free leaves of the octree are visited, and of those only the voxels on their faces, so
+ * the cost of an update scales with the surface of the free space in it, not its volume. An update
+ * of a region only revisits that region, which keeps the frontier in sync with a growing map.
+ */
+class Frontiers final {
+   public:
+    using vec3 = types::vec3;
+
+    /**
+     * @brief one bit per face of a voxel, set if the neighbour across it is unknown, in the order
+     * -x, +x, -y, +y, -z, +z.
+     */
+    using face_mask = std::uint8_t;
+
+    struct frontier {
+        vec3 center;
+        face_mask unknown_faces;
+    };
+
+    /**
+     * @param resolution edge length of the voxels, the resolution of the maps that are integrated
+     * @throws std::invalid_argument if resolution is not greater than 0.
+     */
+    explicit Frontiers(double resolution) : resolution_{resolution} {
+        if (! (resolution > 0)) {
+            throw std::invalid_argument("resolution must be greater than 0");
+        }
+    }
+
+    /**
+     * @brief recompute the whole frontier from map.
+     */
+    auto update(const Octomap& map) -> void {
+        voxels_.clear();
+        update(map, map.metric_bounds());
+    }
+
+    /**
+     * @brief recompute the frontier where it can have changed, when the occupancy of map has
+     * changed inside region, e.g. the result of Octomap::changed_region(). The voxels next to the
+     * region are revisited too, as their neighbours inside it may no longer be unknown.
+     */
+    auto update(const Octomap& map, const types::BBX& region) -> void {
+        const auto [lo, hi] = index_range_(region);
+        for (auto it = voxels_.begin(); it != voxels_.end();) {
+            it = inside_(unpack_(it->first), lo, hi) ? voxels_.erase(it) : std::next(it);
+        }
+
+        const auto r = static_cast<float>(resolution_);
+        const auto scan_region =
+            types::BBX{vec3((lo[0] + 0.5f) * r, (lo[1] + 0.5f) * r, (lo[2] + 0.5f) * r),
+                       vec3((hi[0] + 0.5f) * r, (hi[1] + 0.5f) * r, (hi[2] + 0.5f) * r)};
+        map.iterate_over_known_leaves_in_bbx(
+            scan_region, [&](const Octomap::point_type& center, double size, bool occupied) {
+                if (! occupied) {
+                    scan_leaf_(map, center, size, lo, hi);
+                }
+            });
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t { return voxels_.size(); }
+    [[nodiscard]] auto empty() const -> bool { return voxels_.empty(); }
+    [[nodiscard]] auto resolution() const -> double { return resolution_; }
+
+    [[nodiscard]] auto all() const -> std::vector<frontier> {
+        auto out = std::vector<frontier>();
+        out.reserve(voxels_.size());
+        for (const auto& [key, faces] : voxels_) {
+            out.push_back({center_(unpack_(key)), faces});
+        }
+        return out;
+    }
+
+    /**
+     * @brief the centers of the frontier voxels within max_distance of point, with an unknown
+     * neighbour on the side facing it.
+     */
+    [[nodiscard]] auto facing(const vec3& point, float max_distance) const -> std::vector<vec3> {
+        auto out = std::vector<vec3>();
+        for (const auto& [key, faces] : voxels_) {
+            const auto center = center_(unpack_(key));
+            const vec3 to_point = point - center;
+            if (to_point.squaredNorm() > max_distance * max_distance) {
+                continue;
+            }
+            for (int face = 0; face < 6; ++face) {
+                const auto axis = face / 2;
+                const auto sign = face % 2 == 0 ? -1.0f : 1.0f;
+                if ((faces >> face) & 1u && sign * to_point[axis] > 0) {
+                    out.push_back(center);
+                    break;
+                }
+            }
+        }
+        return out;
+    }
+
+   private:
+    using index_ = std::array<std::int32_t, 3>;
+
+    // 21 bits per axis is ±2^20 voxels, more than the 2^16 an octree has along an axis
+    static constexpr std::int32_t OFFSET = 1 << 20;
+
+    double resolution_;
+    std::unordered_map<std::uint64_t, face_mask> voxels_{};
+
+    [[nodiscard]] static auto pack_(const index_& i) -> std::uint64_t {
+        const auto bits = [](std::int32_t v) { return static_cast<std::uint64_t>(v + OFFSET); };
+        return bits(i[0]) | bits(i[1]) << 21 | bits(i[2]) << 42;
+    }
+
+    [[nodiscard]] static auto unpack_(std::uint64_t key) -> index_ {
+        constexpr auto MASK = (std::uint64_t{1} << 21) - 1;
+        const auto axis = [&](int shift) {
+            return static_cast<std::int32_t>((key >> shift) & MASK) - OFFSET;
+        };
+        return {axis(0), axis(21), axis(42)};
+    }
+
+    [[nodiscard]] static auto inside_(const index_& i, const index_& lo, const index_& hi)
+        -> bool {
+        return lo[0] <= i[0] && i[0] <= hi[0] && lo[1] <= i[1] && i[1] <= hi[1] &&
+               lo[2] <= i[2] && i[2] <= hi[2];
+    }
+
+    [[nodiscard]] auto center_(const index_& i) const -> vec3 {
+        const auto r = static_cast<float>(resolution_);
+        return {(i[0] + 0.5f) * r, (i[1] + 0.5f) * r, (i[2] + 0.5f) * r};
+    }
+
+    /**
+     * @brief the voxels overlapping region, grown by a voxel in every direction
+     */
+    [[nodiscard]] auto index_range_(const types::BBX& region) const -> std::pair<index_, index_> {
+        const auto min = region.min();
+        const auto max = region.max();
+        auto lo = index_{};
+        auto hi = index_{};
+        for (int axis = 0; axis < 3; ++axis) {
+            lo[axis] = static_cast<std::int32_t>(std::floor(min[axis] / resolution_)) - 1;
+            hi[axis] = static_cast<std::int32_t>(std::floor(max[axis] / resolution_)) + 1;
+        }
+        return {lo, hi};
+    }
+
+    /**
+     * @brief adds the voxels on the faces of a free leaf, clipped to [lo, hi], whose neighbour
+     * across the face is unknown. Neighbours inside the leaf are free, so only the faces can
+     * border unknown space.
+     */
+    auto scan_leaf_(const Octomap& map, const Octomap::point_type& center, double size,
+                    const index_& lo, const index_& hi) -> void {
+        const auto n = std::max(1, static_cast<std::int32_t>(std::lround(size / resolution_)));
+        auto leaf_lo = index_{};
+        for (int axis = 0; axis < 3; ++axis) {
+            leaf_lo[axis] =
+                static_cast<std::int32_t>(std::lround((center(axis) - size / 2) / resolution_));
+        }
+
+        const auto r = static_cast<float>(resolution_);
+        for (int face = 0; face < 6; ++face) {
+            const auto axis = face / 2;
+            const auto sign = face % 2 == 0 ? -1 : 1;
+            const auto u = (axis + 1) % 3;
+            const auto v = (axis + 2) % 3;
+            auto i = index_{};
+            i[axis] = sign < 0 ? leaf_lo[axis] : leaf_lo[axis] + n - 1;
+            if (i[axis] < lo[axis] || i[axis] > hi[axis]) {
+                continue;
+            }
+            for (i[u] = std::max(leaf_lo[u], lo[u]); i[u] <= std::min(leaf_lo[u] + n - 1, hi[u]);
+                 ++i[u]) {
+                for (i[v] = std::max(leaf_lo[v], lo[v]);
+                     i[v] <= std::min(leaf_lo[v] + n - 1, hi[v]); ++i[v]) {
+                    auto neighbour = center_(i);
+                    neighbour[axis] += sign * r;
+                    const auto status = map.get_voxel_status_at_point(
+                        {neighbour.x(), neighbour.y(), neighbour.z()});
+                    if (status == VoxelStatus::Unknown) {
+                        voxels_[pack_(i)] |= static_cast<face_mask>(1u << face);
+                    }
+                }
+            }
+        }
+    }
+};
+
+}  // namespace uoe
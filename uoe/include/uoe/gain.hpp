@@ -2,13 +2,18 @@
 
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <limits>
 #include <variant>
+#include <vector>
 
 #include "uoe/bbx.hpp"
 #include "uoe/common_types.hpp"
 #include "uoe/fov.hpp"
 #include "uoe/octomap.hpp"
+#include "uoe/utils/trace.hpp"
+#include "uoe/visibility.hpp"
 #include "uoe/voxelstatus.hpp"
 #include "uoe_msgs/FoVGainMetric.h"
 
@@ -24,8 +29,28 @@ struct FoVGainMetric {
     double v_occupied_voxels;
     double v_unknown_voxels;
     double v_total;
+    // terms of gain_distance, so it can be recomputed for another root with with_distance_total()
+    double n_unknown_visible;
+    double sum_squared_distance_unknown_visible;
+    // work done to compute the metric. gain_of_fovs() traverses the octree once for the whole
+    // batch, so every metric of a batch has the node visits of the shared traversal.
+    std::size_t n_octree_nodes_visited;
+    std::size_t n_voxels_visited;  // voxels inside the FoV, each a lookup in the depth buffer
 };  // FoVGainMetric
 
+/**
+ * @brief the metric gain_of_fov() would have returned for the same FoV and octomap, if the
+ * distance between the target and the root had been distance_total. Only gain_distance, and
+ * therefore gain_total, depend on the root.
+ */
+auto with_distance_total(FoVGainMetric m, double weight_distance_to_target, double distance_total)
+    -> FoVGainMetric {
+    m.gain_distance = weight_distance_to_target *
+                      (m.n_unknown_visible - m.sum_squared_distance_unknown_visible / distance_total);
+    m.gain_total = m.gain_distance / m.gain_unknown;
+    return m;
+}
+
 auto yaml(const FoVGainMetric metric, int indentation = 0, int tabsize = 2) -> std::string {
     const auto tab = std::string(tabsize, ' ');
     const auto tab2 = tab + tab;
@@ -64,96 +89,129 @@ auto to_ros_msg(const FoVGainMetric& m) -> uoe_msgs::FoVGainMetric {
     msg.voxels.free = m.v_free_voxels;
     msg.voxels.occupied = m.v_occupied_voxels;
     msg.voxels.unknown = m.v_unknown_voxels;
+    msg.octree_nodes_visited = m.n_octree_nodes_visited;
+    msg.voxels_visited = m.n_voxels_visited;
 
     return msg;
 }
 
-auto gain_of_fov(
-    const types::FoV& fov, const uoe::Octomap& octomap, const double weight_free,
-    const double weight_occupied, const double weight_unknown,
-    const double weight_distance_to_target, const double weight_not_visible, types::vec3 root,
-    std::function<double(double)> distance_tf,
-    std::function<void(const types::vec3&, const types::vec3&, float, const bool, uoe::VoxelStatus)>
-        visit_cb) -> FoVGainMetric {
-    using namespace uoe::types;
-    using uoe::VoxelStatus;
-    using point = uoe::Octomap::point_type;
+namespace detail {
 
-    const auto bbx = uoe::compute_bbx(fov);
+/**
+ * @brief the voxels of an octree traversal that are inside a FoV. The voxels are tested against
+ * the FoV in batches, and every voxel that blocks line of sight is added to the depth buffer, so
+ * visibility can be looked up afterwards instead of raycasting from the origin to each voxel.
+ */
+class VoxelsInsideFoV final {
+   public:
+    struct voxel {
+        types::vec3 center;
+        double size;
+        VoxelStatus status;
+    };
 
-    const point origin = [&] {
-        const auto pos = fov.pose().position;
-        return point{pos.x(), pos.y(), pos.z()};
-    }();
+    VoxelsInsideFoV(const types::FoV& fov, double resolution)
+        : fov_{&fov}, visibility_{fov, resolution} {}
 
-    const auto visible = [&](const vec3& v) -> bool {
-        auto voxel = octomap.raycast(origin, point{v.x(), v.y(), v.z()}, false);
+    auto add(const types::vec3& v, double size, VoxelStatus vs) -> void {
+        if (vs != VoxelStatus::Free) {
+            visibility_.insert_occluder(v, size, vs);
+        }
+        batch_.push_back({v, size, vs});
+        batch_centers_.push_back(v);
+        if (batch_.size() == 16 * types::FoV::BATCH_SIZE) {
+            flush();
+        }
+    }
 
-        VoxelStatus status;
-        const auto match = [&](auto&& x) {
-            auto visitor = Overload{
-                [&](Free) {
-                    status = VoxelStatus::Free;
-                    return true;
-                },
-                [&](Unknown) {
-                    status = VoxelStatus::Unknown;
-                    return false;
-                },
-                [&](Occupied) {
-                    status = VoxelStatus::Occupied;
-
-                    return false;
-                },
-            };
-
-            return std::visit(visitor, x);
-        };
-
-        const bool is_visible = match(voxel);
-        const auto dir = (v - fov.pose().position);
-        visit_cb(v, dir.normalized(), dir.norm(), is_visible, status);
-        return is_visible;
-    };
+    auto flush() -> void {
+        fov_->inside_fov(batch_centers_, batch_inside_);
+        for (std::size_t i = 0; i < batch_.size(); ++i) {
+            if (batch_inside_[i] != 0) {
+                voxels_.push_back(batch_[i]);
+            }
+        }
+        batch_.clear();
+        batch_centers_.clear();
+    }
+
+    [[nodiscard]] auto fov() const -> const types::FoV& { return *fov_; }
+    [[nodiscard]] auto voxels() const -> const std::vector<voxel>& { return voxels_; }
+    [[nodiscard]] auto visibility() const -> const VisibilityMap& { return visibility_; }
 
+   private:
+    const types::FoV* fov_;
+    VisibilityMap visibility_;
+    std::vector<voxel> voxels_{};
+    std::vector<voxel> batch_{};
+    std::vector<types::vec3> batch_centers_{};
+    std::vector<std::uint8_t> batch_inside_{};
+};
+
+/**
+ * @brief the second pass of gain_of_fov(), once every voxel of the traversal has been added and
+ * flushed.
+ */
+auto gain_of_voxels_inside_fov(
+    const VoxelsInsideFoV& inside, const double resolution, const double weight_free,
+    const double weight_occupied, const double weight_unknown,
+    const double weight_distance_to_target, const double weight_not_visible,
+    const types::vec3& root, const std::function<double(double)>& distance_tf,
+    const std::function<void(const types::vec3&, const types::vec3&, float, const bool,
+                             uoe::VoxelStatus)>& visit_cb) -> FoVGainMetric {
+    using namespace uoe::types;
+    using uoe::VoxelStatus;
+
+    const auto& fov = inside.fov();
     auto m = FoVGainMetric{};
 
     const double distance_total = distance_tf((fov.target() - root).norm());
 
-    octomap.iterate_over_bbx(bbx, [&](const auto& pt, const double size, VoxelStatus vs) {
-        const vec3 v = vec3{pt.x(), pt.y(), pt.z()};
+    for (const auto& [v, size, vs] : inside.voxels()) {
         const double distance_to_target = distance_tf((fov.target() - v).norm());
 
         // m.v_total += volume_scale_factor;
 
-        if (fov.inside_fov(v)) {
-            const double voxel_volume = std::pow(size, 3.0);
-            m.v_inside_fov += voxel_volume;
-
-            if (visible(v)) {
-                m.v_visible += voxel_volume;
-                switch (vs) {
-                    case VoxelStatus::Free:
-                        m.gain_free += weight_free * voxel_volume;
-                        m.v_free_voxels += voxel_volume;
-                        break;
-                    case VoxelStatus::Occupied:
-                        m.gain_occupied += weight_occupied * voxel_volume;
-                        m.v_occupied_voxels += voxel_volume;
-                        break;
-                    case VoxelStatus::Unknown:
-                        m.gain_unknown += weight_unknown * voxel_volume;
-                        m.gain_distance += weight_distance_to_target *
-                                           (1 - (std::pow(distance_to_target, 2) / distance_total));
-                        m.v_unknown_voxels += voxel_volume;
-                        break;
-                }
-            } else {
-                m.v_not_visible += voxel_volume;
-                m.gain_not_visible += weight_not_visible * voxel_volume;
+        const double voxel_volume = std::pow(size, 3.0);
+        // the number of voxels at the map resolution, as a block of unknown space counts as
+        // every voxel in it.
+        const double n_voxels = std::pow(size / resolution, 3.0);
+        m.v_inside_fov += voxel_volume;
+
+        const auto first_hit = inside.visibility().first_hit(v, size);
+        const bool is_visible = first_hit == VoxelStatus::Free;
+        if (visit_cb) {
+            const vec3 dir = (v - fov.pose().position);
+            visit_cb(v, dir.normalized(), dir.norm(), is_visible, first_hit);
+        }
+
+        if (is_visible) {
+            m.v_visible += voxel_volume;
+            switch (vs) {
+                case VoxelStatus::Free:
+                    m.gain_free += weight_free * voxel_volume;
+                    m.v_free_voxels += voxel_volume;
+                    break;
+                case VoxelStatus::Occupied:
+                    m.gain_occupied += weight_occupied * voxel_volume;
+                    m.v_occupied_voxels += voxel_volume;
+                    break;
+                case VoxelStatus::Unknown:
+                    m.gain_unknown += weight_unknown * voxel_volume;
+                    m.gain_distance +=
+                        n_voxels * weight_distance_to_target *
+                        (1 - (std::pow(distance_to_target, 2) / distance_total));
+                    m.n_unknown_visible += n_voxels;
+                    m.sum_squared_distance_unknown_visible +=
+                        n_voxels * std::pow(distance_to_target, 2);
+                    m.v_unknown_voxels += voxel_volume;
+                    break;
             }
+        } else {
+            m.v_not_visible += voxel_volume;
+            m.gain_not_visible += weight_not_visible * voxel_volume;
         }
-    });
+    }
 
     // scale with volume
     // m.gain_free *= resolution_scale_factor;
@@ -163,9 +221,138 @@ auto gain_of_fov(
     // m.gain_not_visible *= resolution_scale_factor;
 
     m.gain_total = m.gain_distance / m.gain_unknown;
+    m.n_voxels_visited = inside.voxels().size();
     // (m.gain_free + m.gain_occupied + m.gain_unknown + m.gain_not_visible) / m.v_inside_fov;
 
     return m;
 }
 
+}  // namespace detail
+
+auto gain_of_fov(
+    const types::FoV& fov, const uoe::Octomap& octomap, const double weight_free,
+    const double weight_occupied, const double weight_unknown,
+    const double weight_distance_to_target, const double weight_not_visible, types::vec3 root,
+    std::function<double(double)> distance_tf,
+    std::function<void(const types::vec3&, const types::vec3&, float, const bool, uoe::VoxelStatus)>
+        visit_cb) -> FoVGainMetric {
+    using namespace uoe::types;
+    const auto timer = utils::trace::scoped_timer(utils::trace::stage::gain_of_fov);
+    utils::trace::count(utils::trace::stage::gain_of_fov);
+
+    // only the octree nodes overlapping the line of sight volume of the fov are visited, and
+    // unknown space fully inside it is visited as a whole, rather than voxel by voxel.
+    auto inside = detail::VoxelsInsideFoV(fov, octomap.resolution());
+    const auto overlap = [&](const auto& center, const double size) {
+        return fov.overlap(vec3{center.x(), center.y(), center.z()}, static_cast<float>(size / 2));
+    };
+    const auto n_visited = octomap.iterate_over_region(
+        overlap, [&](const auto& pt, const double size, VoxelStatus vs) {
+            inside.add(vec3{pt.x(), pt.y(), pt.z()}, size, vs);
+        });
+    inside.flush();
+
+    auto m = detail::gain_of_voxels_inside_fov(inside, octomap.resolution(), weight_free,
+                                               weight_occupied, weight_unknown,
+                                               weight_distance_to_target, weight_not_visible, root,
+                                               distance_tf, visit_cb);
+    m.n_octree_nodes_visited = n_visited;
+    return m;
+}
+
+/**
+ * @brief an upper bound of the gain_total of gain_of_fov(), with the same arguments, for far less
+ * than computing it: no visibility, and only the octree nodes nearer to the target of fov than
+ * the nearest unknown space overlapping it are visited.
+ *
+ * gain_total is gain_distance / gain_unknown, i.e. weight_distance_to_target / (weight_unknown *
+ * resolution^3) times the average of 1 - d^2 / D over the visible unknown voxels, where d is the
+ * distance of a voxel to the target, and D that of the root. No voxel has a larger term than the
+ * unknown space nearest to the target, whether it is visible or not.
+ * @return -infinity if no unknown space overlaps fov, as gain_unknown is then 0, so the FoV is
+ * never chosen. infinity if the weights, or distance_tf, leave the gain unbounded.
+ * @note distance_tf has to be non negative and non decreasing, as the identity is.
+ */
+auto gain_upper_bound(const types::FoV& fov, const uoe::Octomap& octomap,
+                      const double weight_unknown, const double weight_distance_to_target,
+                      const types::vec3& root, const std::function<double(double)>& distance_tf)
+    -> double {
+    using namespace uoe::types;
+    constexpr auto inf = std::numeric_limits<double>::infinity();
+    const double distance_total = distance_tf((fov.target() - root).norm());
+    if (! (weight_unknown > 0) || weight_distance_to_target < 0 || ! (distance_total > 0)) {
+        return inf;
+    }
+
+    const auto overlap = [&](const auto& center, const double size) {
+        return fov.overlap(vec3{center.x(), center.y(), center.z()}, static_cast<float>(size / 2));
+    };
+    const auto& t = fov.target();
+    const auto nearest = octomap.distance_to_nearest_unknown({t.x(), t.y(), t.z()}, overlap);
+    if (! nearest) {
+        return -inf;
+    }
+    const auto d = distance_tf(*nearest);
+    return weight_distance_to_target / (weight_unknown * std::pow(octomap.resolution(), 3.0)) *
+           (1 - d * d / distance_total);
+}
+
+/**
+ * @brief gain_of_fov() of every FoV in fovs, with a single traversal of the octree for the whole
+ * batch. A node is descended into while it overlaps any of the FoVs, and each voxel reached is
+ * handed to the FoVs it overlaps, so FoVs looking at the same region, like the NBV candidates,
+ * share the cost of walking the octree. Unknown space is only visited as a whole when it is inside
+ * every FoV of the batch, so a metric may differ from gain_of_fov() by the discretization of the
+ * distance gain.
+ */
+auto gain_of_fovs(const std::vector<types::FoV>& fovs, const uoe::Octomap& octomap,
+                  const double weight_free, const double weight_occupied,
+                  const double weight_unknown, const double weight_distance_to_target,
+                  const double weight_not_visible, types::vec3 root,
+                  std::function<double(double)> distance_tf) -> std::vector<FoVGainMetric> {
+    using namespace uoe::types;
+    using uoe::types::Overlap;
+    const auto timer = utils::trace::scoped_timer(utils::trace::stage::gain_of_fov);
+    utils::trace::count(utils::trace::stage::gain_of_fov, fovs.size());
+
+    auto inside = std::vector<detail::VoxelsInsideFoV>{};
+    inside.reserve(fovs.size());
+    for (const auto& fov : fovs) {
+        inside.emplace_back(fov, octomap.resolution());
+    }
+
+    const auto overlap = [&](const auto& center, const double size) {
+        const auto c = vec3{center.x(), center.y(), center.z()};
+        auto any = false;
+        auto all = true;
+        for (const auto& fov : fovs) {
+            const auto o = fov.overlap(c, static_cast<float>(size / 2));
+            any = any || o != Overlap::Outside;
+            all = all && o == Overlap::Inside;
+        }
+        return ! any ? Overlap::Outside : all ? Overlap::Inside : Overlap::Partial;
+    };
+    const auto n_visited = octomap.iterate_over_region(
+        overlap, [&](const auto& pt, const double size, VoxelStatus vs) {
+            const auto v = vec3{pt.x(), pt.y(), pt.z()};
+            for (auto& fov_inside : inside) {
+                if (fov_inside.fov().overlap(v, static_cast<float>(size / 2)) !=
+                    Overlap::Outside) {
+                    fov_inside.add(v, size, vs);
+                }
+            }
+        });
+
+    auto metrics = std::vector<FoVGainMetric>{};
+    metrics.reserve(fovs.size());
+    for (auto& fov_inside : inside) {
+        fov_inside.flush();
+        metrics.push_back(detail::gain_of_voxels_inside_fov(
+            fov_inside, octomap.resolution(), weight_free, weight_occupied, weight_unknown,
+            weight_distance_to_target, weight_not_visible, root, distance_tf, {}));
+        metrics.back().n_octree_nodes_visited = n_visited;
+    }
+    return metrics;
+}
+
 }  // namespace uoe
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "uoe/common_types.hpp"
+
+namespace uoe {
+
+/**
+ * @brief memoizes a value computed for a viewpoint, e.g. the gain of its FoV, by the position of
+ * the viewpoint, quantized to a grid with a spacing of quantum.
+ *
+ * Viewpoints in the same cell share a value. This is only sound when the orientation of a
+ * viewpoint follows from its position, as for the NBV candidates, which all look towards the
+ * same target, and when the value changes slowly with the position, i.e. quantum should be
+ * around the map resolution. The values are only valid for the map and parameters they were
+ * computed with, so the cache has to be cleared when either changes.
+ *
+ * Safe to use from several threads.
+ */
+template <typename T>
+class GainCache final {
+   public:
+    explicit GainCache(float quantum) {
+        if (! (quantum > 0.0f)) {
+            throw std::invalid_argument("quantum must be greater than 0");
+        }
+        quantum_ = quantum;
+    }
+
+    [[nodiscard]] auto find(const types::vec3& position) -> std::optional<T> {
+        auto lock = std::scoped_lock{mutex_};
+        const auto it = values_.find(key_(position));
+        if (it == values_.end()) {
+            ++misses_;
+            return std::nullopt;
+        }
+        ++hits_;
+        return it->second;
+    }
+
+    auto insert(const types::vec3& position, const T& value) -> void {
+        auto lock = std::scoped_lock{mutex_};
+        values_.insert_or_assign(key_(position), value);
+    }
+
+    auto clear() -> void {
+        auto lock = std::scoped_lock{mutex_};
+        values_.clear();
+    }
+
+    [[nodiscard]] auto quantum() const -> float { return quantum_; }
+    [[nodiscard]] auto size() const -> std::size_t {
+        auto lock = std::scoped_lock{mutex_};
+        return values_.size();
+    }
+    [[nodiscard]] auto hits() const -> std::size_t {
+        auto lock = std::scoped_lock{mutex_};
+        return hits_;
+    }
+    [[nodiscard]] auto misses() const -> std::size_t {
+        auto lock = std::scoped_lock{mutex_};
+        return misses_;
+    }
+
+   private:
+    using key_type = std::array<std::int32_t, 3>;
+
+    struct key_hash {
+        auto operator()(const key_type& key) const -> std::size_t {
+            // boost::hash_combine
+            auto seed = std::size_t{0};
+            for (const auto k : key) {
+                seed ^= std::hash<std::int32_t>{}(k) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            }
+            return seed;
+        }
+    };
+
+    float quantum_{};
+    mutable std::mutex mutex_{};
+    std::unordered_map<key_type, T, key_hash> values_{};
+    std::size_t hits_ = 0;
+    std::size_t misses_ = 0;
+
+    [[nodiscard]] auto key_(const types::vec3& position) const -> key_type {
+        const auto q = [this](float x) {
+            return static_cast<std::int32_t>(std::floor(x / quantum_));
+        };
+        return {q(position.x()), q(position.y()), q(position.z())};
+    }
+};
+
+}  // namespace uoe
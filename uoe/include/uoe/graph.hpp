@@ -1,63 +1,123 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <numeric>
 #include <ostream>
+#include <queue>
+#include <utility>
 #include <vector>
 
 namespace uoe::types::graph {
 
 struct Edge {
     std::size_t from, to;
+    double weight = 1.0;
 };
 
-// first index is vertex id (a), second is vertex id (b) of a vertex that it forms
-// an edge with (a,b)
-using Graph = std::vector<std::vector<std::size_t>>;
-
-auto visited(const Graph& g, const Edge& e) -> bool {
-    const auto [u, v] = e;
-
-    assert(u != v);
-    assert(0 <= u && u < g.size());
+/**
+ * @brief directed graph in compressed sparse row form. The edges leaving a vertex are stored
+ * contiguously, in the order they were given, so iterating over the neighbors of a vertex is a
+ * linear scan, and an edge costs two words and a weight, rather than an allocation per vertex.
+ * The graph is immutable once built.
+ */
+class CsrGraph final {
+   public:
+    CsrGraph(std::size_t n_vertices, const std::vector<Edge>& edges)
+        : offsets_(n_vertices + 1, 0), targets_(edges.size()), weights_(edges.size()) {
+        for (const auto& e : edges) {
+            assert(e.from < n_vertices && e.to < n_vertices);
+            ++offsets_[e.from + 1];
+        }
+        std::partial_sum(offsets_.begin(), offsets_.end(), offsets_.begin());
+        // counting sort by source vertex, which keeps the relative order of the edges
+        auto next = std::vector<std::size_t>(offsets_.begin(), offsets_.end() - 1);
+        for (const auto& e : edges) {
+            const auto i = next[e.from]++;
+            targets_[i] = e.to;
+            weights_[i] = e.weight;
+        }
+    }
 
-    const auto& edges = g[u];
+    [[nodiscard]] auto n_vertices() const -> std::size_t { return offsets_.size() - 1; }
+    [[nodiscard]] auto n_edges() const -> std::size_t { return targets_.size(); }
+    [[nodiscard]] auto degree(std::size_t u) const -> std::size_t {
+        return offsets_[u + 1] - offsets_[u];
+    }
 
-    for (const auto connected_vertex : edges) {
-        if (v == connected_vertex) {
-            return true;
+    /**
+     * @brief call f(v, weight) for every edge (u, v).
+     */
+    template <typename F>
+    auto for_each_neighbor(std::size_t u, F&& f) const -> void {
+        assert(u < n_vertices());
+        for (auto i = offsets_[u]; i < offsets_[u + 1]; ++i) {
+            f(targets_[i], weights_[i]);
         }
     }
-    return false;
-};
 
-// returns true if the edge does not exist, it then marks the edge as visited.
-auto mark_as_visited(Graph& g, const Edge& e) -> bool {
-    const auto [u, v] = e;
-
-    assert(u != v);
-    assert(0 <= u && u < g.size());
+   private:
+    std::vector<std::size_t> offsets_;
+    std::vector<std::size_t> targets_;
+    std::vector<double> weights_;
+};
 
-    auto& edges = g[u];
+/**
+ * @brief Dijkstra's algorithm. The weights must be non negative.
+ * @return the vertices on a shortest path from source to target, both included, or an empty
+ * vector if target can not be reached.
+ */
+inline auto shortest_path(const CsrGraph& g, std::size_t source, std::size_t target)
+    -> std::vector<std::size_t> {
+    assert(source < g.n_vertices() && target < g.n_vertices());
+    constexpr auto none = std::numeric_limits<std::size_t>::max();
+    auto distance = std::vector<double>(g.n_vertices(), std::numeric_limits<double>::infinity());
+    auto previous = std::vector<std::size_t>(g.n_vertices(), none);
 
-    for (const auto connected_vertex : edges) {
-        if (v == connected_vertex) {
-            return false;
+    using entry = std::pair<double, std::size_t>;
+    auto frontier = std::priority_queue<entry, std::vector<entry>, std::greater<>>{};
+    distance[source] = 0.0;
+    frontier.emplace(0.0, source);
+    while (! frontier.empty()) {
+        const auto [d, u] = frontier.top();
+        frontier.pop();
+        if (u == target) {
+            break;
         }
+        if (d > distance[u]) {
+            continue;  // stale entry
+        }
+        g.for_each_neighbor(u, [&, d = d, u = u](std::size_t v, double w) {
+            if (d + w < distance[v]) {
+                distance[v] = d + w;
+                previous[v] = u;
+                frontier.emplace(distance[v], v);
+            }
+        });
     }
-    edges.push_back(v);
-    return true;
-};
-auto print_graph(const Graph& g, std::ostream& os = std::cout) {
-    for (std::size_t u = 0; u < g.size(); ++u) {
+
+    auto path = std::vector<std::size_t>{};
+    if (source != target && previous[target] == none) {
+        return path;
+    }
+    for (auto v = target; v != none; v = previous[v]) {
+        path.push_back(v);
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+inline auto print_graph(const CsrGraph& g, std::ostream& os = std::cout) -> void {
+    for (std::size_t u = 0; u < g.n_vertices(); ++u) {
         os << "[ ";
-        for (std::size_t v = 0; v < g[u].size(); ++v) {
-            os << "(" << u << ", " << v << "), ";
-        }
+        g.for_each_neighbor(u, [&](std::size_t v, double) { os << "(" << u << ", " << v << "), "; });
         os << " ]" << std::endl;
     }
     os << "\n\n";
-};
+}
 
 }  // namespace uoe::types::graph
@@ -0,0 +1,351 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "uoe/bbx.hpp"
+#include "uoe/common_types.hpp"
+#include "uoe/octomap.hpp"
+
+namespace uoe {
+
+/**
+ * @brief the space that is not free in a uoe::Octomap, grown by the clearance of a drone, over a
+ * fixed volume, so the drone fits wherever its center is outside of it.
+ *
+ * The layer is a dense grid of voxels, a byte each, that are blocked if they are within clearance
+ * of a voxel that is not free, i.e. the Minkowski sum of the space that is not free and a sphere.
+ * Unknown space counts as not free, as it does for the raycasts in RRT, and so does the space
+ * outside of the bounds, so the voxels within clearance of the bounds are blocked, and segments
+ * leaving the bounds are not free.
+ *
+ * A collision check of a segment is then a walk over the voxels its centerline passes through,
+ * with a lookup of a byte per voxel, rather than a bundle of raycasts spanning the cross section
+ * of the drone, which misses obstacles thinner than the spacing between the rays. An update of a
+ * region only recomputes the voxels within clearance of it, and only the voxels not free on the
+ * boundary to free space are grown, as the inside of an obstacle is covered by its boundary.
+ */
+class InflatedOccupancy final {
+   public:
+    using vec3 = types::vec3;
+    using index_type = std::int32_t;
+
+    /**
+     * @param bounds the volume covered by the layer, usually the bounds of the map. Segments
+     * leaving it are not free.
+     * @param voxel_size edge length of the voxels, usually the octomap resolution.
+     * @param clearance the distance kept to the space that is not free, e.g. the radius of the
+     * cross section of the drone.
+     * @throws std::invalid_argument if voxel_size is not greater than 0, or clearance is negative.
+     */
+    InflatedOccupancy(const types::BBX& bounds, double voxel_size, double clearance)
+        : voxel_size_{static_cast<float>(voxel_size)}, clearance_{static_cast<float>(clearance)} {
+        if (! (voxel_size > 0)) {
+            throw std::invalid_argument("voxel_size must be greater than 0");
+        }
+        if (! (clearance >= 0)) {
+            throw std::invalid_argument("clearance must not be negative");
+        }
+        origin_ = bounds.min();
+        const vec3 extent = bounds.max() - origin_;
+        for (int axis = 0; axis < 3; ++axis) {
+            dimensions_[axis] =
+                std::max(1, static_cast<index_type>(std::ceil(extent[axis] / voxel_size_)));
+        }
+        // a centerline point is anywhere in its voxel, and an obstacle anywhere in its own, so
+        // the voxel centers have to be a voxel diagonal further apart than the clearance
+        const auto radius = clearance_ / voxel_size_ + std::sqrt(3.0f);
+        radius_ = static_cast<index_type>(std::ceil(radius));
+        border_ = static_cast<index_type>(std::floor(radius));
+        for (index_type z = -radius_; z <= radius_; ++z) {
+            for (index_type y = -radius_; y <= radius_; ++y) {
+                for (index_type x = -radius_; x <= radius_; ++x) {
+                    if (static_cast<float>(x * x + y * y + z * z) <= radius * radius) {
+                        sphere_.push_back({x, y, z});
+                    }
+                }
+            }
+        }
+        // everything is unknown until the first integration
+        not_free_.assign(n_voxels_(), 1);
+        blocked_.assign(n_voxels_(), 1);
+    }
+
+    // PUBLIC INTERFACE
+    // ---------------------------------------------------------------------------------------------
+
+    /**
+     * @brief recompute the whole layer from map.
+     */
+    auto integrate(const Octomap& map) -> void { integrate(map, bounds()); }
+
+    /**
+     * @brief recompute the layer where it can have changed, when the occupancy of map has changed
+     * inside region, e.g. the result of Octomap::changed_region().
+     */
+    auto integrate(const Octomap& map, const types::BBX& region) -> void {
+        auto [lo, hi] = voxel_range_(region);
+        for (int axis = 0; axis < 3; ++axis) {
+            lo[axis] = std::max(lo[axis], 0);
+            hi[axis] = std::min(hi[axis], dimensions_[axis] - 1);
+            if (hi[axis] < lo[axis]) {
+                return;  // the region is outside of the layer
+            }
+        }
+        rasterize_(map, lo, hi);
+
+        // the voxels within the radius of the region can change, and whether they are blocked
+        // depends on the voxels within the radius of them
+        const auto [write_lo, write_hi] = grown_(lo, hi, radius_);
+        const auto [read_lo, read_hi] = grown_(write_lo, write_hi, radius_);
+        for (index_type z = write_lo[2]; z <= write_hi[2]; ++z) {
+            for (index_type y = write_lo[1]; y <= write_hi[1]; ++y) {
+                for (index_type x = write_lo[0]; x <= write_hi[0]; ++x) {
+                    blocked_[index_(x, y, z)] = not_free_[index_(x, y, z)] || near_border_(x, y, z);
+                }
+            }
+        }
+        for (index_type z = read_lo[2]; z <= read_hi[2]; ++z) {
+            for (index_type y = read_lo[1]; y <= read_hi[1]; ++y) {
+                for (index_type x = read_lo[0]; x <= read_hi[0]; ++x) {
+                    if (on_boundary_(x, y, z)) {
+                        grow_(x, y, z, write_lo, write_hi);
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief true if the drone fits at pt, i.e. it is inside the bounds, and not blocked.
+     */
+    [[nodiscard]] auto is_free(const vec3& pt) const -> bool {
+        const auto voxel = voxel_of_(pt);
+        return in_bounds_(voxel) && ! blocked_[index_(voxel[0], voxel[1], voxel[2])];
+    }
+
+    /**
+     * @brief true if the drone fits along the whole segment from a to b, i.e. none of the voxels
+     * the segment passes through is blocked, found by a 3D DDA walk over them.
+     */
+    [[nodiscard]] auto segment_is_free(const vec3& a, const vec3& b) const -> bool {
+        auto voxel = voxel_of_(a);
+        const auto last = voxel_of_(b);
+        if (! in_bounds_(voxel) || ! in_bounds_(last)) {
+            return false;
+        }
+        const vec3 ga = (a - origin_) / voxel_size_;
+        const vec3 d = (b - a) / voxel_size_;
+        constexpr auto inf = std::numeric_limits<float>::infinity();
+        auto step = std::array<index_type, 3>{};
+        auto t_max = std::array<float, 3>{};
+        auto t_delta = std::array<float, 3>{};
+        for (int axis = 0; axis < 3; ++axis) {
+            step[axis] = d[axis] > 0 ? 1 : (d[axis] < 0 ? -1 : 0);
+            if (step[axis] == 0) {
+                t_max[axis] = inf;
+                t_delta[axis] = inf;
+                continue;
+            }
+            const auto boundary = static_cast<float>(voxel[axis] + (step[axis] > 0 ? 1 : 0));
+            t_max[axis] = (boundary - ga[axis]) / d[axis];
+            t_delta[axis] = static_cast<float>(step[axis]) / d[axis];
+        }
+
+        // the walk ends at the voxel of b, and can not take more steps than it is away
+        auto n_steps = 0;
+        for (int axis = 0; axis < 3; ++axis) {
+            n_steps += std::abs(last[axis] - voxel[axis]);
+        }
+        for (auto i = 0;; ++i) {
+            if (blocked_[index_(voxel[0], voxel[1], voxel[2])]) {
+                return false;
+            }
+            if (voxel == last || i == n_steps) {
+                return true;
+            }
+            const auto axis = static_cast<int>(
+                std::min_element(t_max.begin(), t_max.end()) - t_max.begin());
+            voxel[axis] += step[axis];
+            t_max[axis] += t_delta[axis];
+            if (! in_bounds_(voxel)) {
+                return false;
+            }
+        }
+    }
+
+    [[nodiscard]] auto bounds() const -> types::BBX {
+        const vec3 extent = vec3{static_cast<float>(dimensions_[0]),
+                                 static_cast<float>(dimensions_[1]),
+                                 static_cast<float>(dimensions_[2])} *
+                            voxel_size_;
+        return {origin_, origin_ + extent};
+    }
+    [[nodiscard]] auto voxel_size() const -> float { return voxel_size_; }
+    [[nodiscard]] auto clearance() const -> float { return clearance_; }
+    [[nodiscard]] auto dimensions() const -> const std::array<index_type, 3>& {
+        return dimensions_;
+    }
+
+   private:
+    using voxel_t = std::array<index_type, 3>;
+
+    vec3 origin_{};
+    float voxel_size_;
+    float clearance_;
+    std::array<index_type, 3> dimensions_{};
+    // the offsets of the voxels within the radius, in voxels, of the one at the center
+    index_type radius_ = 0;
+    // the voxels up to this many voxels from outside of the layer are within the radius of it
+    index_type border_ = 0;
+    std::vector<voxel_t> sphere_{};
+    std::vector<std::uint8_t> not_free_{};
+    std::vector<std::uint8_t> blocked_{};
+
+    [[nodiscard]] auto n_voxels_() const -> std::size_t {
+        return static_cast<std::size_t>(dimensions_[0]) * dimensions_[1] * dimensions_[2];
+    }
+    [[nodiscard]] auto index_(index_type x, index_type y, index_type z) const -> std::size_t {
+        return (static_cast<std::size_t>(z) * dimensions_[1] + y) * dimensions_[0] + x;
+    }
+    [[nodiscard]] auto in_bounds_(const voxel_t& voxel) const -> bool {
+        for (int axis = 0; axis < 3; ++axis) {
+            if (voxel[axis] < 0 || voxel[axis] >= dimensions_[axis]) {
+                return false;
+            }
+        }
+        return true;
+    }
+    [[nodiscard]] auto voxel_of_(const vec3& pt) const -> voxel_t {
+        const vec3 g = (pt - origin_) / voxel_size_;
+        // clamped, so points far outside do not overflow, but still fail in_bounds_()
+        const auto to_index = [](float c) {
+            return static_cast<index_type>(std::clamp(std::floor(c), -1.0f, 1e9f));
+        };
+        return {to_index(g.x()), to_index(g.y()), to_index(g.z())};
+    }
+
+    /**
+     * @return the first and last voxel, per axis, whose center is inside bbx. Not clipped to the
+     * layer, and empty along an axis if last < first.
+     */
+    [[nodiscard]] auto voxel_range_(const types::BBX& bbx) const -> std::pair<voxel_t, voxel_t> {
+        auto lo = voxel_t{};
+        auto hi = voxel_t{};
+        const vec3 min = (bbx.min() - origin_) / voxel_size_;
+        const vec3 max = (bbx.max() - origin_) / voxel_size_;
+        for (int axis = 0; axis < 3; ++axis) {
+            lo[axis] = static_cast<index_type>(std::ceil(min[axis] - 0.5f));
+            hi[axis] = static_cast<index_type>(std::floor(max[axis] - 0.5f));
+        }
+        return {lo, hi};
+    }
+
+    /**
+     * @brief the range lo to hi grown by margin voxels, clipped to the layer.
+     */
+    [[nodiscard]] auto grown_(const voxel_t& lo, const voxel_t& hi, index_type margin) const
+        -> std::pair<voxel_t, voxel_t> {
+        auto grown_lo = voxel_t{};
+        auto grown_hi = voxel_t{};
+        for (int axis = 0; axis < 3; ++axis) {
+            grown_lo[axis] = std::max(lo[axis] - margin, 0);
+            grown_hi[axis] = std::min(hi[axis] + margin, dimensions_[axis] - 1);
+        }
+        return {grown_lo, grown_hi};
+    }
+
+    /**
+     * @brief mark the voxels from lo to hi whose center lies inside a free leaf of map as free,
+     * and the others as not free.
+     */
+    auto rasterize_(const Octomap& map, const voxel_t& lo, const voxel_t& hi) -> void {
+        for (index_type z = lo[2]; z <= hi[2]; ++z) {
+            for (index_type y = lo[1]; y <= hi[1]; ++y) {
+                for (index_type x = lo[0]; x <= hi[0]; ++x) {
+                    not_free_[index_(x, y, z)] = 1;
+                }
+            }
+        }
+        const auto corner = [&](const voxel_t& voxel, index_type offset) {
+            return vec3{origin_ + vec3{static_cast<float>(voxel[0] + offset),
+                                       static_cast<float>(voxel[1] + offset),
+                                       static_cast<float>(voxel[2] + offset)} *
+                                      voxel_size_};
+        };
+        map.iterate_over_known_leaves_in_bbx(
+            types::BBX{corner(lo, 0), corner(hi, 1)},
+            [&](const Octomap::point_type& center, double size, bool occupied) {
+                if (occupied) {
+                    return;  // voxels are not free until a free leaf says otherwise
+                }
+                const auto half = static_cast<float>(size / 2);
+                const vec3 c = vec3{center.x(), center.y(), center.z()};
+                auto [leaf_lo, leaf_hi] =
+                    voxel_range_(types::BBX{c - vec3::Constant(half), c + vec3::Constant(half)});
+                for (int axis = 0; axis < 3; ++axis) {
+                    leaf_lo[axis] = std::max(leaf_lo[axis], lo[axis]);
+                    leaf_hi[axis] = std::min(leaf_hi[axis], hi[axis]);
+                }
+                for (index_type z = leaf_lo[2]; z <= leaf_hi[2]; ++z) {
+                    for (index_type y = leaf_lo[1]; y <= leaf_hi[1]; ++y) {
+                        for (index_type x = leaf_lo[0]; x <= leaf_hi[0]; ++x) {
+                            not_free_[index_(x, y, z)] = 0;
+                        }
+                    }
+                }
+            });
+    }
+
+    /**
+     * @brief true if the voxel is within the radius of the space outside of the layer, which is
+     * unknown, i.e. the nearest voxel outside, one past the layer along an axis, is.
+     */
+    [[nodiscard]] auto near_border_(index_type x, index_type y, index_type z) const -> bool {
+        return std::min({x + 1, y + 1, z + 1, dimensions_[0] - x, dimensions_[1] - y,
+                         dimensions_[2] - z}) <= border_;
+    }
+
+    /**
+     * @brief true if the voxel is not free, and next to a free voxel. The space outside of the
+     * layer is not free, but is blocked by near_border_() instead of grown from.
+     */
+    [[nodiscard]] auto on_boundary_(index_type x, index_type y, index_type z) const -> bool {
+        if (! not_free_[index_(x, y, z)]) {
+            return false;
+        }
+        const auto free = [&](index_type nx, index_type ny, index_type nz) {
+            return in_bounds_({nx, ny, nz}) && ! not_free_[index_(nx, ny, nz)];
+        };
+        return free(x - 1, y, z) || free(x + 1, y, z) || free(x, y - 1, z) || free(x, y + 1, z) ||
+               free(x, y, z - 1) || free(x, y, z + 1);
+    }
+
+    /**
+     * @brief block the voxels within the radius of the voxel, that are between lo and hi.
+     */
+    auto grow_(index_type x, index_type y, index_type z, const voxel_t& lo, const voxel_t& hi)
+        -> void {
+        // the whole sphere is outside of the range
+        if (x + radius_ < lo[0] || x - radius_ > hi[0] || y + radius_ < lo[1] ||
+            y - radius_ > hi[1] || z + radius_ < lo[2] || z - radius_ > hi[2]) {
+            return;
+        }
+        for (const auto& [dx, dy, dz] : sphere_) {
+            const auto v = voxel_t{x + dx, y + dy, z + dz};
+            if (lo[0] <= v[0] && v[0] <= hi[0] && lo[1] <= v[1] && v[1] <= hi[1] &&
+                lo[2] <= v[2] && v[2] <= hi[2]) {
+                blocked_[index_(v[0], v[1], v[2])] = 1;
+            }
+        }
+    }
+};
+
+}  // namespace uoe
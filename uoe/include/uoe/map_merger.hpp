@@ -0,0 +1,258 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "uoe/octomap.hpp"
+#include "uoe/utils/concurrency.hpp"
+
+namespace uoe {
+
+/**
+ * @brief one global uoe::Octomap fused from the maps of several sources, e.g. the object maps of
+ * the drones of a fleet, kept up to date from the voxels each source reports as changed, rather
+ * than from copies of the whole maps.
+ *
+ * The log-odds of a voxel in the global map is the sum of its log-odds in the map of every source
+ * that knows it, clamped like any other voxel, i.e. the sources are fused as independent
+ * measurements of the same space. A source reports the current log-odds of its changed voxels,
+ * and the merger keeps the last value reported by each source, so a report replaces what that
+ * source contributed before, rather than adding to it. Reporting a voxel twice is then harmless,
+ * and a report that is lost is made up for by the next one to include the voxel.
+ *
+ * The contributions are split by key into shards, that are merged by a thread each, so the cost of
+ * fusing the reports of the fleet is spread over the cores. Only the voxels whose fused log-odds
+ * changed are written to the octree, by the calling thread, as the octree is not thread safe.
+ */
+class MapMerger final {
+   public:
+    using key_type = octomap::OcTreeKey;
+
+    /**
+     * @brief the changed voxels of the map of a source, not owned. keys holds the x, y and z of
+     * the key of a voxel, size times, and log_odds the current log-odds of each voxel.
+     */
+    struct Delta {
+        std::string_view source;
+        const std::uint16_t* keys = nullptr;
+        const float* log_odds = nullptr;
+        std::size_t size = 0;
+
+        [[nodiscard]] auto key(std::size_t i) const -> key_type {
+            return {keys[3 * i], keys[3 * i + 1], keys[3 * i + 2]};
+        }
+    };
+
+    /**
+     * @param resolution of the global map, which every source has to share, as keys of maps of
+     * different resolutions address different voxels.
+     * @param n_shards number of parts the contributions are split into, and of threads merging
+     * them. With 1 the calling thread merges everything.
+     * @throws std::invalid_argument if resolution is not greater than 0.
+     */
+    explicit MapMerger(double resolution,
+                       unsigned int n_shards = utils::concurrency::default_number_of_workers())
+        : map_{resolution}, shards_(std::max(n_shards, 1u)) {
+        if (! (resolution > 0)) {
+            throw std::invalid_argument("resolution must be greater than 0");
+        }
+    }
+    MapMerger(const MapMerger&) = delete;
+    auto operator=(const MapMerger&) -> MapMerger& = delete;
+
+    /**
+     * @brief fuses the changed voxels of several sources into the global map at once. The inner
+     * nodes of the octree are updated once all of them are written.
+     * @return the number of voxels of the global map whose log-odds changed
+     */
+    auto merge(const std::vector<Delta>& deltas) -> std::size_t {
+        for (auto& shard : shards_) {
+            shard.pending.clear();
+            shard.merged.clear();
+        }
+        auto sources = std::vector<std::uint32_t>(deltas.size());
+        for (std::size_t d = 0; d < deltas.size(); ++d) {
+            sources[d] = source_index_(deltas[d].source);
+            for (std::size_t i = 0; i < deltas[d].size; ++i) {
+                shards_[shard_of_(deltas[d].key(i))].pending.emplace_back(d, i);
+            }
+        }
+        if (source_indices_.size() > stride_) {
+            restride_(std::max(2 * stride_, source_indices_.size()));
+        }
+
+        const auto& octree = map_.octree();
+        const auto min_log_odds = octree.getClampingThresMinLog();
+        const auto max_log_odds = octree.getClampingThresMaxLog();
+        const auto merge_shard = [&](std::size_t s) {
+            auto& shard = shards_[s];
+            auto slots = std::vector<std::uint32_t>{};
+            slots.reserve(shard.pending.size());
+            for (const auto& [d, i] : shard.pending) {
+                const auto& delta = deltas[d];
+                const auto key = delta.key(i);
+                const auto [it, inserted] =
+                    shard.slots.try_emplace(key, static_cast<std::uint32_t>(shard.keys.size()));
+                if (inserted) {
+                    shard.keys.push_back(key);
+                    shard.log_odds.resize(shard.log_odds.size() + stride_, UNKNOWN_);
+                }
+                shard.log_odds[it->second * stride_ + sources[d]] = delta.log_odds[i];
+                slots.push_back(it->second);
+            }
+            // a voxel reported by several sources is only fused once, with every report applied
+            std::sort(slots.begin(), slots.end());
+            slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+            for (const auto slot : slots) {
+                const auto fused = fuse_(&shard.log_odds[slot * stride_], stride_);
+                shard.merged.emplace_back(shard.keys[slot],
+                                          std::clamp(fused, min_log_odds, max_log_odds));
+            }
+        };
+        if (shards_.size() < 2) {
+            merge_shard(0);
+        } else {
+            auto pool = utils::concurrency::WorkerPool<std::size_t>(
+                static_cast<unsigned int>(shards_.size()), shards_.size(),
+                [&](std::size_t s) { merge_shard(s); });
+            for (std::size_t s = 0; s < shards_.size(); ++s) {
+                pool.submit(s);
+            }
+        }
+
+        auto& writable = map_.octree();
+        auto n_changed = std::size_t{0};
+        for (const auto& shard : shards_) {
+            for (const auto& [key, log_odds] : shard.merged) {
+                const auto* node = writable.search(key);
+                if (node == nullptr || node->getLogOdds() != log_odds) {
+                    writable.setNodeValue(key, log_odds, true);
+                    ++n_changed;
+                }
+            }
+        }
+        if (n_changed > 0) {
+            map_.update_inner_occupancy();
+        }
+        return n_changed;
+    }
+
+    /**
+     * @brief the global map. Modifying it directly is undone by the next report of the voxels
+     * modified, but e.g. tracking its changes is fine.
+     */
+    [[nodiscard]] auto map() const -> const Octomap& { return map_; }
+    auto map() -> Octomap& { return map_; }
+
+    [[nodiscard]] auto resolution() const -> double { return map_.resolution(); }
+    /**
+     * @brief the sources that have reported so far, in the order they first did
+     */
+    [[nodiscard]] auto sources() const -> std::vector<std::string> {
+        auto names = std::vector<std::string>(source_indices_.size());
+        for (const auto& [name, index] : source_indices_) {
+            names[index] = name;
+        }
+        return names;
+    }
+    /**
+     * @brief number of voxels known to any source
+     */
+    [[nodiscard]] auto n_voxels() const -> std::size_t {
+        return std::accumulate(
+            shards_.begin(), shards_.end(), std::size_t{0},
+            [](std::size_t n, const shard_& shard) { return n + shard.keys.size(); });
+    }
+
+   private:
+    // the log-odds of a voxel in the map of a source that does not know it yet. Not a log-odds an
+    // octree can hold, as they are clamped.
+    static constexpr float UNKNOWN_ = std::numeric_limits<float>::lowest();
+
+    [[nodiscard]] static auto pack_(const key_type& key) -> std::uint64_t {
+        return (std::uint64_t{key[0]} << 32) | (std::uint64_t{key[1]} << 16) | key[2];
+    }
+    // fibonacci hashing of the packed key, so the neighbouring voxels a source reports together
+    // are spread over the shards
+    [[nodiscard]] static auto hash_(const key_type& key) -> std::uint64_t {
+        return pack_(key) * 0x9e3779b97f4a7c15ull;
+    }
+    struct key_hash_ {
+        auto operator()(const key_type& key) const -> std::size_t {
+            return static_cast<std::size_t>(hash_(key));
+        }
+    };
+    struct key_equal_ {
+        auto operator()(const key_type& a, const key_type& b) const -> bool {
+            return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+        }
+    };
+
+    struct shard_ {
+        // the slot of each voxel, the index of its key in keys, and of its log-odds in the map of
+        // every source in log_odds, which holds stride_ of them per slot, by the index of the source
+        std::unordered_map<key_type, std::uint32_t, key_hash_, key_equal_> slots;
+        std::vector<key_type> keys;
+        std::vector<float> log_odds;
+        // scratch space of merge(): the voxels of the deltas the shard is responsible for, as
+        // pairs of the index of the delta and of the voxel in it, and the fused log-odds
+        std::vector<std::pair<std::size_t, std::size_t>> pending;
+        std::vector<std::pair<key_type, float>> merged;
+    };
+
+    [[nodiscard]] auto shard_of_(const key_type& key) const -> std::size_t {
+        // the high bits, as the hash maps of the shards pick their buckets with the low bits
+        return (hash_(key) >> 40) % shards_.size();
+    }
+
+    auto source_index_(std::string_view source) -> std::uint32_t {
+        const auto it = source_indices_.find(source);
+        if (it != source_indices_.end()) {
+            return it->second;
+        }
+        const auto index = static_cast<std::uint32_t>(source_indices_.size());
+        source_indices_.emplace(std::string{source}, index);
+        return index;
+    }
+    /**
+     * @brief makes room for the log-odds of stride sources per voxel
+     */
+    auto restride_(std::size_t stride) -> void {
+        for (auto& shard : shards_) {
+            auto log_odds = std::vector<float>(shard.keys.size() * stride, UNKNOWN_);
+            for (std::size_t slot = 0; slot < shard.keys.size(); ++slot) {
+                std::copy_n(&shard.log_odds[slot * stride_], stride_, &log_odds[slot * stride]);
+            }
+            shard.log_odds = std::move(log_odds);
+        }
+        stride_ = stride;
+    }
+
+    [[nodiscard]] static auto fuse_(const float* log_odds, std::size_t n) -> float {
+        auto sum = 0.0f;
+        for (std::size_t i = 0; i < n; ++i) {
+            if (log_odds[i] != UNKNOWN_) {
+                sum += log_odds[i];
+            }
+        }
+        return sum;
+    }
+
+    Octomap map_;
+    std::vector<shard_> shards_;
+    // the log-odds per voxel, see shard_, at least one per source
+    std::size_t stride_ = 4;
+    std::map<std::string, std::uint32_t, std::less<>> source_indices_;
+};
+
+}  // namespace uoe
@@ -10,8 +10,11 @@
 #include <tf2/LinearMath/Quaternion.h>
 #include <visualization_msgs/Marker.h>
 
+#include <chrono>
 #include <eigen3/Eigen/Dense>
+#include <future>
 #include <limits>
+#include <memory>
 #include <optional>
 #include <unordered_map>
 #include <utility>
@@ -20,6 +23,7 @@
 #include "uoe/compound_trajectory.hpp"
 #include "uoe/rrt/rrt.hpp"
 #include "uoe/rrt/rrt_builder.hpp"
+#include "uoe/sampled_trajectory.hpp"
 #include "uoe/utils/rviz.hpp"
 #include "uoe/utils/transform.hpp"
 #include "uoe/utils/utils.hpp"
@@ -34,6 +38,7 @@
 namespace uoe {
 constexpr auto INITIAL_ALTITUDE = 5;
 constexpr auto DEFAULT_TIMEOUT = 120;
+constexpr auto VISUALISATION_RATE = 10.0;  // Hz, at most
 class Mission {
    public:
     Mission(ros::NodeHandle& nh, ros::Rate& rate, types::vec3 target,
@@ -53,7 +58,11 @@ class Mission {
    private:
     auto find_path_(Eigen::Vector3f start, Eigen::Vector3f end)
         -> std::optional<std::vector<Eigen::Vector3f>>;
-    auto find_nbv_path_(Eigen::Vector3f start) -> std::optional<std::vector<Eigen::Vector3f>>;
+    auto load_planner_config_() -> void;
+    auto make_nbv_request_(Eigen::Vector3f start) -> uoe_msgs::NBV;
+    auto request_nbv_path_(Eigen::Vector3f start) -> void;
+    auto nbv_path_from_response_(const std::optional<uoe_msgs::NBV>& nbv_srv)
+        -> std::optional<std::vector<Eigen::Vector3f>>;
     auto fit_trajectory_(std::vector<Eigen::Vector3f> path)
         -> std::optional<trajectory::CompoundTrajectory>;
     auto drone_set_mode_(std::string mode = "OFFBOARD") -> bool;
@@ -63,9 +72,10 @@ class Mission {
     auto drone_land() -> bool;
     auto drone_arm() -> bool;
 
+    auto set_trajectory_(trajectory::CompoundTrajectory trajectory) -> void;
     auto set_home_trajectory_() -> bool;
     auto set_takeoff_trajectory_() -> void;
-    auto set_nbv_trajectory_() -> void;
+    auto set_nbv_trajectory_() -> bool;
     auto set_test_trajectory_() -> void;
 
     auto trajectory_step_(float vel, bool look_forwards = true) -> bool;
@@ -89,6 +99,9 @@ class Mission {
     // publishers
     ros::Publisher pub_mission_state_;
     ros::Publisher pub_visualise_;
+    // the markers of visualise_() are published from here, at most VISUALISATION_RATE times a
+    // second, instead of every tick. Shared, as a Mission is movable.
+    std::shared_ptr<utils::rviz::marker_aggregator> visualisation_;
     ros::Publisher pub_setpoint_;
 
     // subscribers
@@ -104,6 +117,16 @@ class Mission {
     ros::ServiceClient client_land_;
     ros::ServiceClient client_nbv_;
     ros::ServiceClient client_rrt_;
+    std::future<std::optional<uoe_msgs::NBV>> nbv_request_;  // in flight on another thread
+
+    // planning requests, loaded once from the parameter server
+    uoe_msgs::DroneConfig drone_config_;
+    uoe_msgs::RrtConfig rrt_config_;
+    uoe_msgs::RrtConfig nbv_rrt_config_;
+    uoe_msgs::NbvConfig nbv_config_;
+    uoe_msgs::FoV fov_;
+    // interest points the nbv service already holds as excluded points
+    std::size_t nbv_excluded_points_sent_ = 0;
 
     // msg instances
     mavros_msgs::State drone_state_;
@@ -131,6 +154,7 @@ class Mission {
 
     // path
     trajectory::CompoundTrajectory trajectory_;
+    trajectory::SampledTrajectory trajectory_samples_;  // trajectory_ at the rate of the loop
     int waypoint_idx_;
 
     float velocity_target_;
@@ -146,6 +170,7 @@ class Mission {
     bool exploration_complete_;
     bool takeoff_initiated_;
     bool home_trajectory_found_;
+    bool nbv_look_ahead_ = true;  // plan the next view while flying to the current one
 
     // visualisation
     float marker_scale_;
@@ -7,11 +7,20 @@
 #include <octomap_msgs/conversions.h>
 #include <octomap_ros/conversions.h>
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <functional>
+#include <limits>
+#include <optional>
 #include <utility>
+#include <vector>
 
 #include "uoe/bbx.hpp"
 #include "uoe/common_headers.hpp"
+#include "uoe/depth_image.hpp"
+#include "uoe/utils/concurrency.hpp"
+#include "uoe/utils/trace.hpp"
 #include "uoe/voxelstatus.hpp"
 #include "octomap/OcTreeKey.h"
 // #include <pcl-1.12/pcl/impl/point_types.hpp>
@@ -23,6 +32,8 @@ namespace uoe {
 constexpr auto DEFAULT_MIN_THRESH_PROB = 0.1;
 constexpr auto DEFAULT_MAX_THRESH_PROB = 0.5;
 
+class OctomapSnapshot;
+
 class Octomap final {
    public:
     // PUBLIC TYPES
@@ -31,6 +42,29 @@ class Octomap final {
     using octree_type = octomap::OcTree;
     using node_type = octree_type::NodeType;
 
+    /**
+     * @brief result of raycast_bundle(). Bit i of hits is set if ray i hit an occupied voxel
+     * (or an unknown voxel, if unknown voxels are not ignored), and hit_centers[i] is then the
+     * center of that voxel.
+     */
+    template <std::size_t N>
+    struct RaycastBundle {
+        std::uint32_t hits = 0;
+        std::array<point_type, N> hit_centers{};
+
+        [[nodiscard]] auto any() const -> bool { return hits != 0; }
+        [[nodiscard]] auto hit(std::size_t i) const -> bool { return (hits >> i) & 1u; }
+    };
+
+    /**
+     * @brief result of raycast_status(). status is Free if nothing was hit, center is then
+     * undefined.
+     */
+    struct RaycastHit {
+        VoxelStatus status = VoxelStatus::Free;
+        point_type center{};
+    };
+
     // struct BBX {
     //     point_type center;
     //     float width, height, depth;
@@ -69,8 +103,9 @@ class Octomap final {
             throw std::invalid_argument("the msg has no data");
         }
 
-        auto data_stream = std::stringstream{};
-        data_stream.write((const char*)&data[0], data.size());
+        // read the message in place, rather than through a copy of it
+        auto buffer = byte_view_buffer_(data);
+        auto data_stream = std::istream(&buffer);
         octree_.readBinaryData(data_stream);
         std::cout << "read binary data into octree" << std::endl;
     }
@@ -102,6 +137,241 @@ class Octomap final {
         return raycast_(origin, direction, max_range, ignore_unknown_voxels);
     }
 
+    /**
+     * @brief casts N parallel rays, all sharing the same direction and max range, through the
+     * octree in lockstep. The rays are traversed with a 3D-DDA in key space, so the step
+     * directions and increments are computed once for the whole bundle. Each ray remembers the
+     * leaf it is currently inside, and crosses it in a single step, see skip_leaf_(), so large
+     * pruned free (or unknown) regions cost one node lookup rather than one per voxel.
+     * A ray hits if it enters an occupied voxel, or an unknown voxel when ignore_unknown_voxels
+     * is false, before max_range.
+     * @param stop_at_first_hit stop traversing all rays as soon as any ray hits. The mask will
+     * then only contain the ray(s) that hit in the same step.
+     * @return RaycastBundle<N> where bit i of hits is set if origins[i] hit something
+     */
+    template <std::size_t N>
+    auto raycast_bundle(const std::array<point_type, N>& origins, const point_type& direction,
+                        double max_range, bool ignore_unknown_voxels = false,
+                        bool stop_at_first_hit = false) const -> RaycastBundle<N> {
+        static_assert(0 < N && N <= 32, "the hit mask has room for at most 32 rays");
+        const auto timer = utils::trace::scoped_timer(utils::trace::stage::raycast);
+        utils::trace::count(utils::trace::stage::raycast, N);
+
+        auto bundle = RaycastBundle<N>{};
+        const auto dir = direction.normalized();
+        const auto res = resolution();
+        constexpr auto inf = std::numeric_limits<double>::max();
+        // like castRay, a non-positive max_range means the rays are unbounded
+        const auto range = max_range > 0.0 ? max_range : inf;
+
+        // shared by all rays in the bundle
+        auto step = std::array<int, 3>{};
+        auto t_delta = std::array<double, 3>{};
+        for (unsigned int i = 0; i < 3; ++i) {
+            step[i] = dir(i) > 0.0f ? 1 : (dir(i) < 0.0f ? -1 : 0);
+            t_delta[i] = step[i] != 0 ? res / std::abs(dir(i)) : inf;
+        }
+
+        struct ray_state {
+            octomap::OcTreeKey key;
+            std::array<double, 3> t_max;
+            leaf_ leaf;
+            bool alive;
+        };
+
+        auto rays = std::array<ray_state, N>{};
+        auto n_alive = std::size_t{0};
+
+        const auto classify = [&](ray_state& ray, std::size_t idx) {
+            if (! contains_(ray.leaf, ray.key)) {
+                ray.leaf = find_leaf_(ray.key);
+            }
+            const auto status = ray.leaf.node == nullptr ? VoxelStatus::Unknown
+                                : octree_.isNodeOccupied(ray.leaf.node) ? VoxelStatus::Occupied
+                                                                         : VoxelStatus::Free;
+            const bool hit = status == VoxelStatus::Occupied ||
+                             (status == VoxelStatus::Unknown && ! ignore_unknown_voxels);
+            if (hit) {
+                bundle.hits |= 1u << idx;
+                bundle.hit_centers[idx] = octree_.keyToCoord(ray.key);
+                ray.alive = false;
+                --n_alive;
+            }
+            return hit;
+        };
+
+        for (std::size_t r = 0; r < N; ++r) {
+            auto& ray = rays[r];
+            // rays starting outside the octree bounds are treated as not hitting, like castRay
+            ray.alive = octree_.coordToKeyChecked(origins[r], ray.key);
+            if (! ray.alive) {
+                continue;
+            }
+            ++n_alive;
+            ray.leaf = find_leaf_(ray.key);
+            for (unsigned int i = 0; i < 3; ++i) {
+                if (step[i] != 0) {
+                    const double voxel_border =
+                        octree_.keyToCoord(ray.key[i]) + static_cast<double>(step[i]) * res * 0.5;
+                    ray.t_max[i] = (voxel_border - origins[r](i)) / dir(i);
+                } else {
+                    ray.t_max[i] = inf;
+                }
+            }
+            if (classify(ray, r) && stop_at_first_hit) {
+                return bundle;
+            }
+        }
+
+        while (n_alive > 0) {
+            auto any_hit = false;
+            for (std::size_t r = 0; r < N; ++r) {
+                auto& ray = rays[r];
+                if (! ray.alive) {
+                    continue;
+                }
+
+                if (! skip_leaf_(ray.leaf, ray.key, ray.t_max, step, t_delta, range)) {
+                    ray.alive = false;
+                    --n_alive;
+                    continue;
+                }
+                any_hit |= classify(ray, r);
+            }
+
+            if (any_hit && stop_at_first_hit) {
+                break;
+            }
+        }
+
+        return bundle;
+    }
+
+    /**
+     * @brief the first voxel along the ray from origin in direction that is occupied, or unknown
+     * if ignore_unknown_voxels is false, within max_range. Same traversal as raycast_bundle(), so
+     * voxels are classified as they are stepped through, and a leaf is crossed in one step.
+     * @param max_range a non-positive value means the ray is unbounded.
+     */
+    auto raycast_status(const point_type& origin, const point_type& direction, double max_range,
+                        bool ignore_unknown_voxels = false) const -> RaycastHit {
+        const auto timer = utils::trace::scoped_timer(utils::trace::stage::raycast);
+        utils::trace::count(utils::trace::stage::raycast);
+        const auto dir = direction.normalized();
+        const auto res = resolution();
+        constexpr auto inf = std::numeric_limits<double>::max();
+        const auto range = max_range > 0.0 ? max_range : inf;
+
+        auto key = octomap::OcTreeKey{};
+        if (! octree_.coordToKeyChecked(origin, key)) {
+            return {};
+        }
+        auto step = std::array<int, 3>{};
+        auto t_delta = std::array<double, 3>{};
+        auto t_max = std::array<double, 3>{};
+        for (unsigned int i = 0; i < 3; ++i) {
+            step[i] = dir(i) > 0.0f ? 1 : (dir(i) < 0.0f ? -1 : 0);
+            t_delta[i] = step[i] != 0 ? res / std::abs(dir(i)) : inf;
+            t_max[i] = step[i] != 0 ? (octree_.keyToCoord(key[i]) +
+                                       static_cast<double>(step[i]) * res * 0.5 - origin(i)) /
+                                          dir(i)
+                                    : inf;
+        }
+
+        while (true) {
+            const auto leaf = find_leaf_(key);
+            const auto status = leaf.node == nullptr           ? VoxelStatus::Unknown
+                                : octree_.isNodeOccupied(leaf.node) ? VoxelStatus::Occupied
+                                                                     : VoxelStatus::Free;
+            if (status == VoxelStatus::Occupied ||
+                (status == VoxelStatus::Unknown && ! ignore_unknown_voxels)) {
+                return {status, octree_.keyToCoord(key)};
+            }
+            if (! skip_leaf_(leaf, key, t_max, step, t_delta, range)) {
+                return {};
+            }
+        }
+    }
+
+    /**
+     * @brief raycast_status() through the nodes at depth instead of the leaves, for coarse
+     * queries, e.g. over long distances, where a step crosses a whole node. Every node has the
+     * status get_voxel_status_at_point(point, depth) gives it, so a ray stops at a node with any
+     * occupied voxel in it, and the hit center is the center of that node. A depth of 0, or of
+     * the tree, is the same as raycast_status().
+     */
+    auto raycast_status(const point_type& origin, const point_type& direction, double max_range,
+                        bool ignore_unknown_voxels, unsigned int depth) const -> RaycastHit {
+        const auto tree_depth = octree_.getTreeDepth();
+        if (depth == 0 || depth >= tree_depth) {
+            return raycast_status(origin, direction, max_range, ignore_unknown_voxels);
+        }
+        const auto timer = utils::trace::scoped_timer(utils::trace::stage::raycast);
+        utils::trace::count(utils::trace::stage::raycast);
+        const auto dir = direction.normalized();
+        const auto size = octree_.getNodeSize(depth);
+        const auto span = 1u << (tree_depth - depth);
+        constexpr auto inf = std::numeric_limits<double>::max();
+        constexpr auto max_key = std::numeric_limits<octomap::key_type>::max();
+        const auto range = max_range > 0.0 ? max_range : inf;
+
+        // the key of the center of the node at depth containing origin
+        auto key = octomap::OcTreeKey{};
+        if (! octree_.coordToKeyChecked(origin, depth, key)) {
+            return {};
+        }
+        const auto center = octree_.keyToCoord(key, depth);
+        auto step = std::array<int, 3>{};
+        auto t_delta = std::array<double, 3>{};
+        auto t_max = std::array<double, 3>{};
+        for (unsigned int i = 0; i < 3; ++i) {
+            step[i] = dir(i) > 0.0f ? 1 : (dir(i) < 0.0f ? -1 : 0);
+            t_delta[i] = step[i] != 0 ? size / std::abs(dir(i)) : inf;
+            t_max[i] = step[i] != 0
+                           ? (center(i) + static_cast<double>(step[i]) * size * 0.5 - origin(i)) /
+                                 dir(i)
+                           : inf;
+        }
+
+        while (true) {
+            const auto* node = octree_.search(key, depth);
+            const auto status = node == nullptr                ? VoxelStatus::Unknown
+                                : octree_.isNodeOccupied(node) ? VoxelStatus::Occupied
+                                                               : VoxelStatus::Free;
+            if (status == VoxelStatus::Occupied ||
+                (status == VoxelStatus::Unknown && ! ignore_unknown_voxels)) {
+                return {status, octree_.keyToCoord(key, depth)};
+            }
+            const auto axis = static_cast<unsigned int>(
+                std::distance(t_max.begin(), std::min_element(t_max.begin(), t_max.end())));
+            if (t_max[axis] > range) {
+                return {};
+            }
+            const auto out_of_tree = step[axis] > 0 ? key[axis] > max_key - span : key[axis] < span;
+            if (out_of_tree) {
+                return {};
+            }
+            key[axis] = static_cast<octomap::key_type>(static_cast<int>(key[axis]) +
+                                                       step[axis] * static_cast<int>(span));
+            t_max[axis] += t_delta[axis];
+        }
+    }
+
+    /**
+     * @brief the status of the node at depth containing point, or of the leaf above it, if the
+     * leaf has been pruned. Depths count from the root, and 0 is the depth of the leaves, as in
+     * octomap. The occupancy of an inner node is the maximum of its children, so Occupied means
+     * some voxel in the node is occupied, but Free only means none is known to be: part of a free
+     * inner node can still be unknown.
+     */
+    auto get_voxel_status_at_point(const point_type& point, unsigned int depth) const
+        -> VoxelStatus {
+        if (const auto opt = search_for_node_(point, depth)) {
+            return octree_.isNodeOccupied(opt.value()) ? VoxelStatus::Occupied : VoxelStatus::Free;
+        }
+        return VoxelStatus::Unknown;
+    }
+
     auto get_voxel_status_at_point(const point_type& point) const -> VoxelStatus {
         if (const auto opt = search_for_node_(point)) {
             const auto node_ptr = opt.value();
@@ -111,23 +381,164 @@ class Octomap final {
         return VoxelStatus::Unknown;
     }
 
-    auto compute_total_volume_voxels_with_status(VoxelStatus status) -> double {
-        // calculate the total volume of the received object map
-        auto volume_total = 0.0;
-        for (auto it = octree().begin_leafs(), end = octree().end_leafs(); it != end; ++it) {
-            const auto key = it.getKey();
-            const auto vs = get_voxelstatus_at_node_using_key_(key);
-            if (vs == status) {
-                const auto size = it.getSize();
-                const auto volume = std::pow(size, 3);
-                volume_total += volume;
+    /**
+     * @brief bounding box of every leaf whose status differs from the status of the same region
+     * in other, e.g. an older version of the same map. Leaves only other knows about are
+     * included too.
+     * @return std::nullopt if both maps agree everywhere.
+     */
+    [[nodiscard]] auto changed_region(const Octomap& other) const -> std::optional<types::BBX> {
+        auto min = types::vec3::Constant(std::numeric_limits<float>::max()).eval();
+        auto max = types::vec3::Constant(std::numeric_limits<float>::lowest()).eval();
+        auto changed = false;
+        const auto expand = [&](const point_type& center, double size) {
+            const auto half = static_cast<float>(size / 2);
+            const auto c = types::vec3{center.x(), center.y(), center.z()};
+            min = min.cwiseMin(c - types::vec3::Constant(half));
+            max = max.cwiseMax(c + types::vec3::Constant(half));
+            changed = true;
+        };
+
+        for (auto it = octree_.begin_leafs(), end = octree_.end_leafs(); it != end; ++it) {
+            const auto vs = octree_.isNodeOccupied(*it) ? VoxelStatus::Occupied : VoxelStatus::Free;
+            const auto center = it.getCoordinate();
+            if (other.get_voxel_status_at_point(center) != vs) {
+                expand(center, it.getSize());
+            }
+        }
+        // leaves that other knows about, but are unknown in this map
+        const auto& other_octree = other.octree();
+        for (auto it = other_octree.begin_leafs(), end = other_octree.end_leafs(); it != end;
+             ++it) {
+            const auto center = it.getCoordinate();
+            if (get_voxel_status_at_point(center) == VoxelStatus::Unknown) {
+                expand(center, it.getSize());
             }
         }
 
-        return volume_total;
+        if (! changed) {
+            return std::nullopt;
+        }
+        return types::BBX{min, max};
     }
 
-    auto compute_total_volume_of_occupied_voxels() -> double {
+    /**
+     * @brief transform(center, size, occupied) of every leaf, reduced with reduce, starting from
+     * init, like std::transform_reduce(). With a bbx, only the leaves overlapping it are visited.
+     *
+     * The octree is split into independent subtrees, at the first depth with enough of them to
+     * keep n_workers threads busy, and every thread reduces the subtrees it takes on its own, so
+     * no leaves are collected on the way. As the subtrees are reduced in any order, reduce has to
+     * be associative and commutative, and transform safe to call from several threads at once.
+     * With fewer than 2 workers the calling thread visits every leaf itself.
+     */
+    template <typename T, typename Reduce, typename Transform>
+    auto transform_reduce_leaves(
+        T init, Reduce reduce, Transform transform,
+        unsigned int n_workers = utils::concurrency::default_number_of_workers(),
+        const std::optional<types::BBX>& bbx = std::nullopt) const -> T {
+        const auto* root = octree_.getRoot();
+        if (root == nullptr) {
+            return init;
+        }
+        const auto reduce_subtree = [&](const subtree_& st) {
+            auto acc = std::optional<T>{};
+            transform_reduce_subtree_(st, bbx, acc, reduce, transform);
+            return acc;
+        };
+        const auto subtrees = n_workers < 2 ? std::vector<subtree_>{{root, {0, 0, 0}, 0}}
+                                            : split_(root, bbx, SUBTREES_PER_WORKER * n_workers);
+        auto partials = std::vector<std::optional<T>>(subtrees.size());
+        if (n_workers < 2 || subtrees.size() < 2) {
+            std::transform(subtrees.begin(), subtrees.end(), partials.begin(), reduce_subtree);
+        } else {
+            auto pool = utils::concurrency::WorkerPool<std::size_t>(
+                std::min<unsigned int>(n_workers, static_cast<unsigned int>(subtrees.size())),
+                subtrees.size(), [&](std::size_t i) { partials[i] = reduce_subtree(subtrees[i]); });
+            for (std::size_t i = 0; i < subtrees.size(); ++i) {
+                pool.submit(i);
+            }
+        }
+        for (auto& partial : partials) {
+            if (partial) {
+                init = reduce(std::move(init), std::move(*partial));
+            }
+        }
+        return init;
+    }
+
+    /**
+     * @brief track the voxels whose status changes from now on, i.e. that become known, or change
+     * between free and occupied, see dirty_region(). For a map updated in place this is cheaper
+     * than comparing it to an older copy of itself with changed_region().
+     */
+    auto enable_change_tracking(bool enabled = true) -> void {
+        octree_.enableChangeDetection(enabled);
+    }
+    [[nodiscard]] auto tracks_changes() const -> bool {
+        return octree_.isChangeDetectionEnabled();
+    }
+    /**
+     * @brief number of voxels changed since change tracking was enabled, or last reset
+     */
+    [[nodiscard]] auto n_changed_voxels() const -> std::size_t {
+        return octree_.numChangesDetected();
+    }
+    /**
+     * @brief keys of the voxels changed since change tracking was enabled, or last reset
+     */
+    [[nodiscard]] auto changed_keys() const -> std::vector<octomap::OcTreeKey> {
+        auto keys = std::vector<octomap::OcTreeKey>();
+        keys.reserve(octree_.numChangesDetected());
+        for (auto it = octree_.changedKeysBegin(), end = octree_.changedKeysEnd(); it != end;
+             ++it) {
+            keys.push_back(it->first);
+        }
+        return keys;
+    }
+    /**
+     * @brief bounding box of the voxels changed since change tracking was enabled, or last reset,
+     * or std::nullopt if none has, in the same form as changed_region().
+     */
+    [[nodiscard]] auto dirty_region() const -> std::optional<types::BBX> {
+        if (octree_.numChangesDetected() == 0) {
+            return std::nullopt;
+        }
+        constexpr auto max_key = std::numeric_limits<octomap::key_type>::max();
+        auto lo = octomap::OcTreeKey{max_key, max_key, max_key};
+        auto hi = octomap::OcTreeKey{0, 0, 0};
+        for (auto it = octree_.changedKeysBegin(), end = octree_.changedKeysEnd(); it != end;
+             ++it) {
+            for (unsigned int i = 0; i < 3; ++i) {
+                lo[i] = std::min(lo[i], it->first[i]);
+                hi[i] = std::max(hi[i], it->first[i]);
+            }
+        }
+        const auto half = static_cast<float>(resolution() / 2);
+        const auto corner = [&](const octomap::OcTreeKey& key, float offset) {
+            const auto c = octree_.keyToCoord(key);
+            return types::vec3{c.x() + offset, c.y() + offset, c.z() + offset};
+        };
+        return types::BBX{corner(lo, -half), corner(hi, half)};
+    }
+    /**
+     * @brief forget the changes tracked so far, e.g. once they have been published
+     */
+    auto reset_changes() -> void { octree_.resetChangeDetection(); }
+
+    auto compute_total_volume_voxels_with_status(VoxelStatus status) const -> double {
+        // leaves are never unknown
+        if (status == VoxelStatus::Unknown) {
+            return 0.0;
+        }
+        const auto occupied = status == VoxelStatus::Occupied;
+        return transform_reduce_leaves(
+            0.0, std::plus<>(), [occupied](const point_type&, double size, bool leaf_occupied) {
+                return leaf_occupied == occupied ? size * size * size : 0.0;
+            });
+    }
+
+    auto compute_total_volume_of_occupied_voxels() const -> double {
         return compute_total_volume_voxels_with_status(VoxelStatus::Occupied);
     }
 
@@ -153,6 +564,116 @@ class Octomap final {
     // }
 
     auto resolution() const -> double { return octree_.getResolution(); }
+
+    /**
+     * @brief integrate a scan, with the same sensor model as octomap_server. Every point marks
+     * the voxel it is in as occupied, and the voxels on the ray to it from sensor_origin as free.
+     * Points further away than max_range only clear space up to max_range.
+     * @param lazy_eval leave the occupancy of the inner nodes out of date, so several scans can be
+     * inserted before updating them once with update_inner_occupancy(). Queries are wrong until
+     * then.
+     */
+    auto insert_point_cloud(const octomap::Pointcloud& scan, const point_type& sensor_origin,
+                            double max_range = -1.0, bool lazy_eval = false) -> void {
+        octree_.insertPointCloud(scan, sensor_origin, max_range, lazy_eval);
+    }
+
+    /**
+     * @brief bring the inner nodes up to date after scans were inserted with lazy_eval.
+     */
+    auto update_inner_occupancy() -> void { octree_.updateInnerOccupancy(); }
+
+    /**
+     * @brief integrate a depth image projectively, instead of as a point cloud. Every voxel in the
+     * part of the camera frustum the selected pixels see is projected into the image, and compared
+     * against the depth of the pixel it lands on: it is occupied if it is within half a voxel of
+     * the measured surface, free if it is in front of it, and left as it is if it is behind it. The
+     * cost is bound by the volume seen, rather than by the number of points times the length of
+     * their rays, as with insert_point_cloud().
+     * @param camera_to_map the pose of the optical frame of the camera in the map
+     * @param lazy_eval as for insert_point_cloud()
+     * @return the number of voxels updated
+     */
+    auto integrate_depth_image(const DepthImageView& image, const PinholeCamera& camera,
+                               const Eigen::Isometry3f& camera_to_map, bool lazy_eval = false)
+        -> std::size_t {
+        // the bounds of the selected pixels with a measurement, in the image and in depth
+        auto u_min = image.width, v_min = image.height, u_max = 0u, v_max = 0u;
+        auto depth_max = 0.0f;
+        for (unsigned int v = 0; v < image.height; ++v) {
+            for (unsigned int u = 0; u < image.width; ++u) {
+                if (image.selected(u, v) && camera.measures(image.at(u, v))) {
+                    u_min = std::min(u_min, u);
+                    u_max = std::max(u_max, u);
+                    v_min = std::min(v_min, v);
+                    v_max = std::max(v_max, v);
+                    depth_max = std::max(depth_max, image.at(u, v));
+                }
+            }
+        }
+        if (u_min > u_max) {
+            return 0;
+        }
+
+        // the voxels of the bounding box of the frustum of those pixels
+        const auto res = static_cast<float>(resolution());
+        const auto far = depth_max + res;
+        auto lo = Eigen::Vector3f{camera_to_map.translation()};
+        auto hi = lo;
+        for (const auto u : {static_cast<float>(u_min), static_cast<float>(u_max + 1)}) {
+            for (const auto v : {static_cast<float>(v_min), static_cast<float>(v_max + 1)}) {
+                const Eigen::Vector3f corner =
+                    camera_to_map *
+                    Eigen::Vector3f{(u - camera.cx) / camera.fx * far,
+                                    (v - camera.cy) / camera.fy * far, far};
+                lo = lo.cwiseMin(corner);
+                hi = hi.cwiseMax(corner);
+            }
+        }
+        auto key_lo = octomap::OcTreeKey{};
+        auto key_hi = octomap::OcTreeKey{};
+        if (! octree_.coordToKeyChecked(point_type{lo.x(), lo.y(), lo.z()}, key_lo) ||
+            ! octree_.coordToKeyChecked(point_type{hi.x(), hi.y(), hi.z()}, key_hi)) {
+            return 0;
+        }
+
+        const Eigen::Isometry3f map_to_camera = camera_to_map.inverse();
+        auto n_updated = std::size_t{0};
+        // the counters are wider than a key, so the loops end at the edge of the map too
+        for (unsigned int x = key_lo[0]; x <= key_hi[0]; ++x) {
+            for (unsigned int y = key_lo[1]; y <= key_hi[1]; ++y) {
+                for (unsigned int z = key_lo[2]; z <= key_hi[2]; ++z) {
+                    const auto key = octomap::OcTreeKey{static_cast<octomap::key_type>(x),
+                                                        static_cast<octomap::key_type>(y),
+                                                        static_cast<octomap::key_type>(z)};
+                    const auto center = octree_.keyToCoord(key);
+                    const Eigen::Vector3f p =
+                        map_to_camera * Eigen::Vector3f{center.x(), center.y(), center.z()};
+                    if (p.z() <= 0) {
+                        continue;
+                    }
+                    const auto u = std::floor(camera.fx * p.x() / p.z() + camera.cx);
+                    const auto v = std::floor(camera.fy * p.y() / p.z() + camera.cy);
+                    if (u < u_min || u > u_max || v < v_min || v > v_max) {
+                        continue;
+                    }
+                    const auto pixel_u = static_cast<unsigned int>(u);
+                    const auto pixel_v = static_cast<unsigned int>(v);
+                    const auto depth = image.at(pixel_u, pixel_v);
+                    if (! image.selected(pixel_u, pixel_v) || ! camera.measures(depth)) {
+                        continue;
+                    }
+                    const auto distance_to_surface = depth - p.z();
+                    if (distance_to_surface < -res / 2) {
+                        continue;  // occluded
+                    }
+                    octree_.updateNode(key, distance_to_surface <= res / 2, lazy_eval);
+                    ++n_updated;
+                }
+            }
+        }
+        return n_updated;
+    }
     // TODO:
     auto write(const std::filesystem::path& path, bool overwrite = false) const -> bool {
         if (! overwrite && std::filesystem::is_regular_file(path)) {
@@ -160,53 +681,156 @@ class Octomap final {
             return false;
         }
 
-        auto s = std::ofstream(path);
-        octree_.writeBinaryConst(s);
+        auto s = std::ofstream(path, std::ios_base::binary);
+        return octree_.writeBinaryConst(s);
     }
 
     using bbx_iterator_cb =
         std::function<void(const point_type& pt, const double size, const VoxelStatus vs)>;
 
+    /**
+     * @brief call cb for every known leaf overlapping the bbx, and for every unknown voxel, at the
+     * resolution of the map, with its center inside it. Both are found in the same top down
+     * traversal, so unknown space is passed to cb as it is reached, instead of collecting it first.
+     */
     auto iterate_over_bbx(const uoe::types::BBX& bbx, bbx_iterator_cb cb) const -> void {
-        const auto [min, max] = [&] {
-            const auto min = bbx.min();
-            const auto max = bbx.max();
-            const point_type start = {min.x(), min.y(), min.z()};
-            const point_type stop = {max.x(), max.y(), max.z()};
-            return std::make_pair(start, stop);
-        }();
-
-        for (auto it = octree_.begin_leafs_bbx(min, max), end = octree_.end_leafs_bbx(); it != end;
-             ++it) {
-            const auto voxel_center = it.getCoordinate();
-            const auto size = it.getSize();
-            // ROS_INFO_STREAM("getSize() -> " << size);
-            const auto key = it.getKey();
+        const auto min = bbx.min();
+        const auto max = bbx.max();
+        const auto res = resolution();
+        iterate_over_region(
+            [&](const point_type& center, double size) { return overlap_(bbx, center, size); },
+            [&](const point_type& center, double size, VoxelStatus vs) {
+                if (vs != VoxelStatus::Unknown) {
+                    cb(center, size, vs);
+                    return;
+                }
+                // the voxels of a block of unknown space, clipped to the bbx
+                const auto n = std::max(1L, std::lround(size / res));
+                auto lo = std::array<long, 3>{};
+                auto hi = std::array<long, 3>{};
+                for (unsigned int i = 0; i < 3; ++i) {
+                    const auto corner = center(i) - size / 2;
+                    lo[i] = std::max(0L, std::lround(std::ceil((min[i] - corner) / res - 0.5)));
+                    hi[i] = std::min(n - 1, std::lround(std::floor((max[i] - corner) / res - 0.5)));
+                }
+                const auto voxel = [&](unsigned int i, long k) {
+                    return static_cast<float>(center(i) - size / 2 + (k + 0.5) * res);
+                };
+                for (auto x = lo[0]; x <= hi[0]; ++x) {
+                    for (auto y = lo[1]; y <= hi[1]; ++y) {
+                        for (auto z = lo[2]; z <= hi[2]; ++z) {
+                            cb({voxel(0, x), voxel(1, y), voxel(2, z)}, res, VoxelStatus::Unknown);
+                        }
+                    }
+                }
+            });
+    }
 
-            cb(voxel_center, size, get_voxelstatus_at_node_using_key_(key));
-        }
+    using overlap_fn =
+        std::function<uoe::types::Overlap(const point_type& center, const double size)>;
 
-        octomap::point3d_list voxel_centers{};
+    /**
+     * @brief call cb for every leaf that overlaps a region, e.g. the FoV, in a top down
+     * traversal. overlap tells how a node relates to the region. Subtrees Outside of it are
+     * skipped, and the nodes below one Inside of it are not tested any further.
+     *
+     * Unknown space has no nodes, so it is passed to cb in blocks as large as possible: an
+     * unknown subtree Inside the region is a single call, with the size of the subtree, and only
+     * unknown space crossing the boundary of the region is split down to the resolution. Leaves
+     * crossing the boundary are passed to cb as well, so cb has to test them, if it needs to
+     * know which are inside.
+     * @return the number of nodes visited, counting every block of unknown space as a node
+     */
+    auto iterate_over_region(const overlap_fn& overlap, const bbx_iterator_cb& cb) const
+        -> std::size_t {
+        return iterate_over_region_(octree_.getRoot(), point_type{0, 0, 0}, 0, false, overlap, cb);
+    }
+
+    /**
+     * @brief the distance from point to the nearest unknown space overlapping a region, e.g. a
+     * FoV, or std::nullopt if no unknown space overlaps it. overlap is the same as for
+     * iterate_over_region(). A lower bound, as a block of unknown space counts from its nearest
+     * corner even if only part of it overlaps the region.
+     *
+     * The children of a node are descended into nearest first, and nodes further away than the
+     * nearest unknown space found so far are skipped, so unknown space near point is found in a
+     * handful of node visits.
+     */
+    [[nodiscard]] auto distance_to_nearest_unknown(const point_type& point,
+                                                   const overlap_fn& overlap) const
+        -> std::optional<double> {
+        auto nearest = std::numeric_limits<double>::infinity();
+        nearest_unknown_(octree_.getRoot(), point_type{0, 0, 0}, 0, point, overlap, nearest);
+        if (nearest == std::numeric_limits<double>::infinity()) {
+            return std::nullopt;
+        }
+        return nearest;
+    }
 
-        octree_.getUnknownLeafCenters(voxel_centers, min, max);
-        for (auto voxel_center : voxel_centers) {
-            // TODO: check if resolution() is correct here
-            // ROS_INFO_STREAM("unknown so using DEFAULT resolution: " << resolution());
+    using known_leaf_cb =
+        std::function<void(const point_type& center, const double size, const bool occupied)>;
 
-            cb(voxel_center, resolution(), VoxelStatus::Unknown);
+    /**
+     * @brief call cb for every leaf inside the bbx, that is either free or occupied. Unlike
+     * iterate_over_bbx(), unknown space is not enumerated, which is expensive for large volumes.
+     * With a depth, the nodes at depth are passed as leaves, with the status
+     * get_voxel_status_at_point(point, depth) gives them, for a coarse look at a large region.
+     */
+    auto iterate_over_known_leaves_in_bbx(const uoe::types::BBX& bbx, const known_leaf_cb& cb,
+                                          unsigned int depth = 0) const -> void {
+        const auto min = point_type{bbx.min().x(), bbx.min().y(), bbx.min().z()};
+        const auto max = point_type{bbx.max().x(), bbx.max().y(), bbx.max().z()};
+        for (auto it = octree_.begin_leafs_bbx(min, max, static_cast<unsigned char>(depth)),
+                  end = octree_.end_leafs_bbx();
+             it != end; ++it) {
+            cb(it.getCoordinate(), it.getSize(), octree_.isNodeOccupied(*it));
         }
     }
 
+    /**
+     * @brief the axis aligned bounds of the known space of the map.
+     */
+    [[nodiscard]] auto metric_bounds() const -> uoe::types::BBX {
+        double x_min{}, y_min{}, z_min{}, x_max{}, y_max{}, z_max{};
+        octree_.getMetricMin(x_min, y_min, z_min);
+        octree_.getMetricMax(x_max, y_max, z_max);
+        const auto vec = [](double x, double y, double z) {
+            return uoe::types::vec3{static_cast<float>(x), static_cast<float>(y),
+                                    static_cast<float>(z)};
+        };
+        return {vec(x_min, y_min, z_min), vec(x_max, y_max, z_max)};
+    }
+
+    /**
+     * @brief a flat copy of the map for read heavy queries, see uoe::OctomapSnapshot. Defined in
+     * uoe/octomap_snapshot.hpp.
+     * @param region if given, only the voxels inside it are copied.
+     */
+    [[nodiscard]] auto snapshot(const std::optional<types::BBX>& region = {}) const
+        -> OctomapSnapshot;
+
     /**
      * @brief returns a mutable reference to the underlying OcTree
      * @return const OcTree&
      */
     auto octree() -> octree_type& { return octree_; }
+    [[nodiscard]] auto octree() const -> const octree_type& { return octree_; }
 
    private:
     // ---------------------------------------------------------------------------------------------
     octree_type octree_;
 
+    /**
+     * @brief read only stream buffer over bytes owned by someone else, e.g. a message
+     */
+    struct byte_view_buffer_ : std::streambuf {
+        explicit byte_view_buffer_(const std::vector<std::int8_t>& bytes) {
+            // std::streambuf only reads through the get area, so the const_cast is safe
+            auto* begin = const_cast<char*>(reinterpret_cast<const char*>(bytes.data()));
+            setg(begin, begin, begin + bytes.size());
+        }
+    };
+
     // PRIVATE METHODS
     // ---------------------------------------------------------------------------------------------
     // Octomap(const octomap_msgs::Octomap& map) : octree_{map.resolution} {
@@ -218,20 +842,306 @@ class Octomap final {
 
     auto raycast_(const point_type& origin, const point_type& direction, double max_range = -1,
                   bool ignore_unknown_voxels = false) const -> Voxel {
-        auto end = point_type{std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
-                              std::numeric_limits<float>::max()};
-        const auto intersected_occupied_voxel =
-            octree_.castRay(origin, direction, end, ignore_unknown_voxels, max_range);
-        if (intersected_occupied_voxel) {
-            return Occupied{end};
-        }
-        if ((end - origin).norm() < max_range) {
-            return Unknown{end};
+        const auto hit = raycast_status(origin, direction, max_range, ignore_unknown_voxels);
+        switch (hit.status) {
+            case VoxelStatus::Occupied:
+                return Occupied{hit.center};
+            case VoxelStatus::Unknown:
+                return Unknown{hit.center};
+            case VoxelStatus::Free:
+                break;
         }
 
         return Free{};
     }
 
+    /**
+     * @brief the leaf node containing a key, and the depth it was found at. node is nullptr if
+     * the region is unknown, in which case depth is the depth of the missing child.
+     */
+    struct leaf_ {
+        const node_type* node = nullptr;
+        octomap::OcTreeKey key;
+        unsigned int depth = 0;
+        bool valid = false;
+    };
+
+    /**
+     * @brief same descent as OcTree::search(key), but also remembers at which depth it stopped,
+     * so that contains_() can tell if a neighbouring key is inside the same leaf.
+     */
+    auto find_leaf_(const octomap::OcTreeKey& key) const -> leaf_ {
+        const auto tree_depth = octree_.getTreeDepth();
+        const node_type* node = octree_.getRoot();
+        if (node == nullptr) {
+            // empty tree, everything is unknown
+            return {nullptr, key, 0, true};
+        }
+
+        for (unsigned int depth = 0; depth < tree_depth; ++depth) {
+            const auto pos = octomap::computeChildIdx(key, static_cast<int>(tree_depth - 1 - depth));
+            if (! octree_.nodeChildExists(node, pos)) {
+                // a pruned node covers all its children, otherwise the child is unknown
+                return octree_.nodeHasChildren(node) ? leaf_{nullptr, key, depth + 1, true}
+                                                     : leaf_{node, key, depth, true};
+            }
+            node = octree_.getNodeChild(node, pos);
+        }
+
+        return {node, key, tree_depth, true};
+    }
+
+    auto contains_(const leaf_& leaf, const octomap::OcTreeKey& key) const -> bool {
+        if (! leaf.valid) {
+            return false;
+        }
+        const auto shift = octree_.getTreeDepth() - leaf.depth;
+        return (key[0] >> shift) == (leaf.key[0] >> shift) &&
+               (key[1] >> shift) == (leaf.key[1] >> shift) &&
+               (key[2] >> shift) == (leaf.key[2] >> shift);
+    }
+
+    /**
+     * @brief moves a ray, traversed with a 3D-DDA in key space, from its voxel in leaf to the
+     * first voxel past the leaf, with the same key and t_max as if it had stepped there voxel by
+     * voxel. Inside a leaf at the finest depth this is a single step.
+     * @return false if the ray leaves the octree, or goes past range, before leaving the leaf.
+     */
+    auto skip_leaf_(const leaf_& leaf, octomap::OcTreeKey& key, std::array<double, 3>& t_max,
+                    const std::array<int, 3>& step, const std::array<double, 3>& t_delta,
+                    double range) const -> bool {
+        constexpr auto inf = std::numeric_limits<double>::max();
+        constexpr auto max_key = std::numeric_limits<octomap::key_type>::max();
+        const auto shift = octree_.getTreeDepth() - leaf.depth;
+
+        // the number of steps along each axis until the ray is in the last voxel of the leaf,
+        // and the distance along the ray at which it then leaves the leaf through that face.
+        auto n = std::array<unsigned int, 3>{};
+        auto t_face = std::array<double, 3>{inf, inf, inf};
+        auto at_border = std::array<bool, 3>{};
+        for (unsigned int i = 0; i < 3; ++i) {
+            if (step[i] == 0) {
+                continue;
+            }
+            const unsigned int lo = (static_cast<unsigned int>(leaf.key[i]) >> shift) << shift;
+            const unsigned int hi = lo + (1u << shift) - 1;
+            n[i] = step[i] > 0 ? hi - key[i] : key[i] - lo;
+            t_face[i] = t_max[i] + n[i] * t_delta[i];
+            at_border[i] = step[i] > 0 ? hi == max_key : lo == 0;
+        }
+        const unsigned int dim = t_face[0] < t_face[1] ? (t_face[0] < t_face[2] ? 0 : 2)
+                                                       : (t_face[1] < t_face[2] ? 1 : 2);
+        if (t_face[dim] > range || at_border[dim]) {
+            return false;
+        }
+
+        for (unsigned int i = 0; i < 3; ++i) {
+            if (i == dim || step[i] == 0 || t_max[i] >= t_face[dim]) {
+                continue;
+            }
+            // the faces crossed along the other axes before leaving the leaf
+            const auto k = std::min(
+                n[i], static_cast<unsigned int>(std::ceil((t_face[dim] - t_max[i]) / t_delta[i])));
+            key[i] = static_cast<octomap::key_type>(static_cast<int>(key[i]) +
+                                                    step[i] * static_cast<int>(k));
+            t_max[i] += k * t_delta[i];
+        }
+        key[dim] = static_cast<octomap::key_type>(static_cast<int>(key[dim]) +
+                                                  step[dim] * static_cast<int>(n[dim] + 1));
+        t_max[dim] += (n[dim] + 1) * t_delta[dim];
+        return true;
+    }
+
+    /**
+     * @brief a node of the octree with the center and depth of its cube, which is not stored in it
+     */
+    struct subtree_ {
+        const node_type* node;
+        point_type center;
+        unsigned int depth;
+    };
+
+    // enough subtrees per worker that a few large ones do not leave the other workers idle
+    static constexpr std::size_t SUBTREES_PER_WORKER = 8;
+
+    static auto overlap_(const types::BBX& bbx, const point_type& center, double size)
+        -> types::Overlap {
+        const auto min = bbx.min();
+        const auto max = bbx.max();
+        auto inside = true;
+        for (unsigned int i = 0; i < 3; ++i) {
+            const auto lo = center(i) - size / 2;
+            const auto hi = center(i) + size / 2;
+            if (hi < min[i] || lo > max[i]) {
+                return types::Overlap::Outside;
+            }
+            inside = inside && min[i] <= lo && hi <= max[i];
+        }
+        return inside ? types::Overlap::Inside : types::Overlap::Partial;
+    }
+
+    auto child_of_(const subtree_& st, unsigned int i) const -> subtree_ {
+        // bit 0, 1 and 2 of the child index select the upper half along x, y and z.
+        const auto quarter = static_cast<float>(octree_.getNodeSize(st.depth) / 4);
+        return {octree_.getNodeChild(st.node, i),
+                st.center + point_type{i & 1u ? quarter : -quarter, i & 2u ? quarter : -quarter,
+                                       i & 4u ? quarter : -quarter},
+                st.depth + 1};
+    }
+
+    /**
+     * @brief the subtrees overlapping bbx at the first depth with at least n of them, or with no
+     * inner nodes left to split. Leaves above that depth are subtrees of their own.
+     */
+    auto split_(const node_type* root, const std::optional<types::BBX>& bbx, std::size_t n) const
+        -> std::vector<subtree_> {
+        auto subtrees = std::vector<subtree_>{{root, {0, 0, 0}, 0}};
+        auto next = std::vector<subtree_>();
+        auto any_inner = octree_.nodeHasChildren(root);
+        while (subtrees.size() < n && any_inner) {
+            next.clear();
+            any_inner = false;
+            for (const auto& st : subtrees) {
+                if (! octree_.nodeHasChildren(st.node)) {
+                    next.push_back(st);
+                    continue;
+                }
+                for (unsigned int i = 0; i < 8; ++i) {
+                    if (! octree_.nodeChildExists(st.node, i)) {
+                        continue;
+                    }
+                    const auto child = child_of_(st, i);
+                    if (bbx && overlap_(*bbx, child.center, octree_.getNodeSize(child.depth)) ==
+                                   types::Overlap::Outside) {
+                        continue;
+                    }
+                    any_inner = any_inner || octree_.nodeHasChildren(child.node);
+                    next.push_back(child);
+                }
+            }
+            std::swap(subtrees, next);
+        }
+        return subtrees;
+    }
+
+    template <typename T, typename Reduce, typename Transform>
+    auto transform_reduce_subtree_(const subtree_& st, const std::optional<types::BBX>& bbx,
+                                   std::optional<T>& acc, Reduce& reduce,
+                                   Transform& transform) const -> void {
+        const auto size = octree_.getNodeSize(st.depth);
+        if (bbx && overlap_(*bbx, st.center, size) == types::Overlap::Outside) {
+            return;
+        }
+        if (! octree_.nodeHasChildren(st.node)) {
+            auto value = transform(st.center, size, octree_.isNodeOccupied(st.node));
+            acc = acc ? reduce(std::move(*acc), std::move(value)) : std::move(value);
+            return;
+        }
+        for (unsigned int i = 0; i < 8; ++i) {
+            if (octree_.nodeChildExists(st.node, i)) {
+                transform_reduce_subtree_(child_of_(st, i), bbx, acc, reduce, transform);
+            }
+        }
+    }
+
+    /**
+     * @param node nullptr for unknown space.
+     * @param center the center of the node, the root is centered at the origin.
+     * @param inside whether an ancestor is inside the region.
+     * @return the number of nodes visited in the subtree of node
+     */
+    auto iterate_over_region_(const node_type* node, const point_type& center, unsigned depth,
+                              bool inside, const overlap_fn& overlap,
+                              const bbx_iterator_cb& cb) const -> std::size_t {
+        const auto size = octree_.getNodeSize(depth);
+        if (! inside) {
+            const auto o = overlap(center, size);
+            if (o == uoe::types::Overlap::Outside) {
+                return 1;
+            }
+            inside = o == uoe::types::Overlap::Inside;
+        }
+
+        if (node == nullptr) {
+            if (inside || depth == octree_.getTreeDepth()) {
+                cb(center, size, VoxelStatus::Unknown);
+                return 1;
+            }
+        } else if (! octree_.nodeHasChildren(node)) {
+            const auto status =
+                octree_.isNodeOccupied(node) ? VoxelStatus::Occupied : VoxelStatus::Free;
+            cb(center, size, status);
+            return 1;
+        }
+
+        // bit 0, 1 and 2 of the child index select the upper half along x, y and z.
+        const auto quarter = static_cast<float>(size / 4);
+        auto n_visited = std::size_t{1};
+        for (unsigned int i = 0; i < 8; ++i) {
+            const auto child_center =
+                center + point_type{i & 1u ? quarter : -quarter, i & 2u ? quarter : -quarter,
+                                    i & 4u ? quarter : -quarter};
+            const node_type* child = node != nullptr && octree_.nodeChildExists(node, i)
+                                         ? octree_.getNodeChild(node, i)
+                                         : nullptr;
+            n_visited += iterate_over_region_(child, child_center, depth + 1, inside, overlap, cb);
+        }
+        return n_visited;
+    }
+
+    /**
+     * @brief the distance from point to the nearest point of the cube at center with edge size
+     */
+    static auto distance_to_cube_(const point_type& point, const point_type& center, double size)
+        -> double {
+        auto squared = 0.0;
+        for (unsigned int i = 0; i < 3; ++i) {
+            const auto d = std::max(std::abs(point(i) - center(i)) - size / 2, 0.0);
+            squared += d * d;
+        }
+        return std::sqrt(squared);
+    }
+
+    /**
+     * @param node nullptr for unknown space.
+     * @param nearest the distance to the nearest unknown space found so far.
+     */
+    auto nearest_unknown_(const node_type* node, const point_type& center, unsigned depth,
+                          const point_type& point, const overlap_fn& overlap,
+                          double& nearest) const -> void {
+        const auto size = octree_.getNodeSize(depth);
+        const auto distance = distance_to_cube_(point, center, size);
+        if (distance >= nearest || overlap(center, size) == uoe::types::Overlap::Outside) {
+            return;
+        }
+        if (node == nullptr) {
+            nearest = distance;
+            return;
+        }
+        if (! octree_.nodeHasChildren(node)) {
+            return;
+        }
+
+        const auto quarter = static_cast<float>(size / 4);
+        auto children = std::array<std::pair<double, unsigned int>, 8>{};
+        auto centers = std::array<point_type, 8>{};
+        for (unsigned int i = 0; i < 8; ++i) {
+            centers[i] = center + point_type{i & 1u ? quarter : -quarter,
+                                             i & 2u ? quarter : -quarter,
+                                             i & 4u ? quarter : -quarter};
+            children[i] = {distance_to_cube_(point, centers[i], size / 2), i};
+        }
+        std::sort(children.begin(), children.end());
+        for (const auto& [d, i] : children) {
+            if (d >= nearest) {
+                break;
+            }
+            const node_type* child =
+                octree_.nodeChildExists(node, i) ? octree_.getNodeChild(node, i) : nullptr;
+            nearest_unknown_(child, centers[i], depth + 1, point, overlap, nearest);
+        }
+    }
+
     auto get_voxelstatus_at_node_using_key_(const octomap::OcTreeKey key) const -> VoxelStatus {
         if (const auto opt = search_for_node_using_key_(key)) {
             const auto node_ptr = opt.value();
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <octomap_msgs/Octomap.h>
+#include <ros/time.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "uoe/octomap.hpp"
+#include "uoe/shared_octomap.hpp"
+
+namespace uoe {
+
+/**
+ * @brief keeps the most recent octomap message around, and only deserializes it into a
+ * uoe::Octomap when a consumer asks for it and the map has changed since the last time.
+ * The deserialized octree is shared between all consumers through a std::shared_ptr, so a
+ * consumer can keep using its copy even if a newer map arrives while it is planning.
+ *
+ * Consumers asking for a map that has already been deserialized take a snapshot of it without
+ * locking, so planner threads only ever wait for each other when a new map has to be decoded, and
+ * never on update().
+ */
+class OctomapCache final {
+   public:
+    // PUBLIC TYPES
+    // ---------------------------------------------------------------------------------------------
+    using msg_type = octomap_msgs::Octomap;
+    using msg_ptr = octomap_msgs::Octomap::ConstPtr;
+    using octomap_ptr = std::shared_ptr<const uoe::Octomap>;
+    using version_type = SharedOctomap::version_type;
+
+    // CONSTRUCTORS
+    // ---------------------------------------------------------------------------------------------
+    OctomapCache() = default;
+    OctomapCache(const OctomapCache&) = delete;
+    auto operator=(const OctomapCache&) -> OctomapCache& = delete;
+
+    // PUBLIC INTERFACE
+    // ---------------------------------------------------------------------------------------------
+
+    /**
+     * @brief store a new octomap message. This is cheap, as the message is not deserialized
+     * until get() is called. Intended to be used directly as a ros::Subscriber callback.
+     */
+    auto update(const msg_ptr& msg) -> void {
+        if (msg == nullptr || msg->data.empty()) {
+            return;
+        }
+        auto lock = std::scoped_lock{mutex_};
+        // messages published with the same stamp contain the same map
+        if (latest_msg_ != nullptr && latest_msg_->header.stamp == msg->header.stamp &&
+            latest_msg_->data.size() == msg->data.size()) {
+            return;
+        }
+        latest_msg_ = msg;
+        version_.fetch_add(1);
+    }
+
+    /**
+     * @brief store a new octomap message that is not owned by a shared pointer,
+     * e.g. the response of a octomap_msgs::GetOctomap service call.
+     */
+    auto update(msg_type&& msg) -> void {
+        update(boost::make_shared<const msg_type>(std::move(msg)));
+    }
+
+    /**
+     * @brief returns the deserialized octomap of the most recent message, or nullptr if no
+     * message has been received yet. Deserialization only happens when the map has changed
+     * since the last call.
+     */
+    [[nodiscard]] auto get() -> octomap_ptr {
+        if (auto snapshot = octomap_.snapshot(); snapshot.version == version_.load()) {
+            return snapshot.map;
+        }
+        // one consumer decodes the new map, while the others wait for it
+        auto decode_lock = std::scoped_lock{decode_mutex_};
+        auto [msg, version] = [this] {
+            auto lock = std::scoped_lock{mutex_};
+            return std::pair{latest_msg_, version_.load()};
+        }();
+        if (auto snapshot = octomap_.snapshot(); snapshot.version >= version) {
+            return snapshot.map;
+        }
+        auto octomap = std::make_shared<const uoe::Octomap>(*msg);
+        octomap_.publish(octomap, version);
+        return octomap;
+    }
+
+    /**
+     * @brief monotonically increasing counter, incremented every time a new map is stored.
+     */
+    [[nodiscard]] auto version() const -> version_type { return version_.load(); }
+
+    /**
+     * @brief the stamp of the most recent message, or ros::Time{0} if none has been received.
+     */
+    [[nodiscard]] auto stamp() const -> ros::Time {
+        auto lock = std::scoped_lock{mutex_};
+        return latest_msg_ != nullptr ? latest_msg_->header.stamp : ros::Time{0};
+    }
+
+    /**
+     * @brief true if a message has been received within max_age, measured against ros::Time::now()
+     */
+    [[nodiscard]] auto is_fresh(const ros::Duration& max_age) const -> bool {
+        const auto s = stamp();
+        return ! s.isZero() && (ros::Time::now() - s) <= max_age;
+    }
+
+   private:
+    mutable std::mutex mutex_;  // guards latest_msg_
+    msg_ptr latest_msg_ = nullptr;
+    std::atomic<version_type> version_{0};
+    std::mutex decode_mutex_;
+    SharedOctomap octomap_;
+};
+
+}  // namespace uoe
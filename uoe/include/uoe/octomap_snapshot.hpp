@@ -0,0 +1,349 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+
+#include "uoe/bbx.hpp"
+#include "uoe/common_types.hpp"
+#include "uoe/octomap.hpp"
+#include "uoe/utils/trace.hpp"
+#include "uoe/voxelstatus.hpp"
+
+namespace uoe {
+
+/**
+ * @brief read only copy of a uoe::Octomap, flattened for the many lookups of a single planning
+ * request, during which the map does not change.
+ *
+ * The known space of the map is stored at the finest resolution, in blocks of 8x8x8 voxels with 2
+ * bits of VoxelStatus per voxel, hashed by the key of the block. Missing blocks are unknown. A
+ * status lookup is a hash of the block key and a shift, instead of a descent of the octree, and
+ * consecutive lookups in the same block, as along a ray, skip the hash too.
+ *
+ * Pruned regions of the octree are expanded, so the snapshot costs 2 bits per known voxel. For
+ * large maps at fine resolutions it should be restricted to the region the request plans in.
+ *
+ * Keys are the same as the OcTreeKeys of the map at the finest depth.
+ */
+class OctomapSnapshot final {
+   public:
+    using point_type = Octomap::point_type;
+    using key_type = octomap::OcTreeKey;
+
+    template <std::size_t N>
+    using RaycastBundle = Octomap::RaycastBundle<N>;
+
+    static constexpr unsigned int BLOCK_BITS = 3;
+    static constexpr unsigned int BLOCK_SIZE = 1u << BLOCK_BITS;
+    static constexpr std::size_t VOXELS_PER_BLOCK = BLOCK_SIZE * BLOCK_SIZE * BLOCK_SIZE;
+
+    /**
+     * @param region if given, only the voxels inside it are copied, everything else is unknown.
+     */
+    explicit OctomapSnapshot(const Octomap& map, const std::optional<types::BBX>& region = {})
+        : resolution_{map.resolution()} {
+        const auto& octree = map.octree();
+        const auto tree_depth = octree.getTreeDepth();
+        max_key_value_ = static_cast<octomap::key_type>(1u << (tree_depth - 1));
+        resolution_factor_ = 1.0 / resolution_;
+
+        auto min_key = key_type{0, 0, 0};
+        auto max_key = key_type{key_max_, key_max_, key_max_};
+        if (region) {
+            const auto pt = [](const types::vec3& v) { return point_type{v.x(), v.y(), v.z()}; };
+            octree.coordToKeyClamped(pt(region->min()), min_key);
+            octree.coordToKeyClamped(pt(region->max()), max_key);
+        }
+
+        for (auto it = octree.begin_leafs(), end = octree.end_leafs(); it != end; ++it) {
+            const auto span = 1u << (tree_depth - it.getDepth());
+            const auto key = it.getKey();
+            // the keys a leaf covers are aligned to its size
+            auto lo = std::array<unsigned int, 3>{};
+            auto hi = std::array<unsigned int, 3>{};
+            auto empty = false;
+            for (unsigned int i = 0; i < 3; ++i) {
+                const auto first = key[i] & ~(span - 1);
+                lo[i] = std::max<unsigned int>(first, min_key[i]);
+                hi[i] = std::min<unsigned int>(first + span - 1, max_key[i]);
+                empty = empty || lo[i] > hi[i];
+            }
+            if (! empty) {
+                fill_(lo, hi,
+                      octree.isNodeOccupied(*it) ? VoxelStatus::Occupied : VoxelStatus::Free);
+            }
+        }
+    }
+
+    [[nodiscard]] auto resolution() const -> double { return resolution_; }
+    [[nodiscard]] auto n_blocks() const -> std::size_t { return blocks_.size(); }
+
+    /**
+     * @brief writes the snapshot in a flat format, which uoe::MappedOctomapSnapshot opens with
+     * mmap. Defined in uoe/octomap_snapshot_file.hpp.
+     * @return false if the file exists and overwrite is false, or it could not be written
+     */
+    auto write(const std::filesystem::path& path, bool overwrite = false) const -> bool;
+
+    [[nodiscard]] auto status(const key_type& key) const -> VoxelStatus {
+        const auto it = blocks_.find(block_key_(key));
+        return it == blocks_.end() ? VoxelStatus::Unknown : it->second.get(voxel_index_(key));
+    }
+
+    [[nodiscard]] auto get_voxel_status_at_point(const point_type& point) const -> VoxelStatus {
+        auto key = key_type{};
+        return coord_to_key_checked_(point, key) ? status(key) : VoxelStatus::Unknown;
+    }
+
+    /**
+     * @brief same as Octomap::raycast_bundle(), and gives the same result for the same map.
+     * Every voxel along the rays is looked up, rather than skipping over large leaves, but a
+     * lookup only costs a hash when a ray enters another block.
+     */
+    template <std::size_t N>
+    auto raycast_bundle(const std::array<point_type, N>& origins, const point_type& direction,
+                        double max_range, bool ignore_unknown_voxels = false,
+                        bool stop_at_first_hit = false) const -> RaycastBundle<N> {
+        static_assert(0 < N && N <= 32, "the hit mask has room for at most 32 rays");
+        const auto timer = utils::trace::scoped_timer(utils::trace::stage::raycast);
+        utils::trace::count(utils::trace::stage::raycast, N);
+
+        auto bundle = RaycastBundle<N>{};
+        const auto dir = direction.normalized();
+        constexpr auto inf = std::numeric_limits<double>::max();
+        // like castRay, a non-positive max_range means the rays are unbounded
+        const auto range = max_range > 0.0 ? max_range : inf;
+
+        // shared by all rays in the bundle
+        auto step = std::array<int, 3>{};
+        auto t_delta = std::array<double, 3>{};
+        for (unsigned int i = 0; i < 3; ++i) {
+            step[i] = dir(i) > 0.0f ? 1 : (dir(i) < 0.0f ? -1 : 0);
+            t_delta[i] = step[i] != 0 ? resolution_ / std::abs(dir(i)) : inf;
+        }
+
+        struct ray_state {
+            key_type key;
+            std::array<double, 3> t_max;
+            std::uint64_t block_key;
+            const block_* block;
+            bool alive;
+        };
+
+        auto rays = std::array<ray_state, N>{};
+        auto n_alive = std::size_t{0};
+
+        const auto classify = [&](ray_state& ray, std::size_t idx) {
+            const auto bk = block_key_(ray.key);
+            if (bk != ray.block_key) {
+                const auto it = blocks_.find(bk);
+                ray.block = it == blocks_.end() ? nullptr : &it->second;
+                ray.block_key = bk;
+            }
+            const auto status =
+                ray.block == nullptr ? VoxelStatus::Unknown : ray.block->get(voxel_index_(ray.key));
+            const bool hit = status == VoxelStatus::Occupied ||
+                             (status == VoxelStatus::Unknown && ! ignore_unknown_voxels);
+            if (hit) {
+                bundle.hits |= 1u << idx;
+                bundle.hit_centers[idx] = key_to_coord_(ray.key);
+                ray.alive = false;
+                --n_alive;
+            }
+            return hit;
+        };
+
+        for (std::size_t r = 0; r < N; ++r) {
+            auto& ray = rays[r];
+            // rays starting outside the octree bounds are treated as not hitting, like castRay
+            ray.alive = coord_to_key_checked_(origins[r], ray.key);
+            if (! ray.alive) {
+                continue;
+            }
+            ++n_alive;
+            ray.block_key = NO_BLOCK;
+            ray.block = nullptr;
+            for (unsigned int i = 0; i < 3; ++i) {
+                if (step[i] != 0) {
+                    const double voxel_border = key_to_coord_(ray.key[i]) +
+                                                static_cast<double>(step[i]) * resolution_ * 0.5;
+                    ray.t_max[i] = (voxel_border - origins[r](i)) / dir(i);
+                } else {
+                    ray.t_max[i] = inf;
+                }
+            }
+            if (classify(ray, r) && stop_at_first_hit) {
+                return bundle;
+            }
+        }
+
+        while (n_alive > 0) {
+            auto any_hit = false;
+            for (std::size_t r = 0; r < N; ++r) {
+                auto& ray = rays[r];
+                if (! ray.alive) {
+                    continue;
+                }
+
+                const auto& t = ray.t_max;
+                const unsigned int dim =
+                    t[0] < t[1] ? (t[0] < t[2] ? 0 : 2) : (t[1] < t[2] ? 1 : 2);
+                // distance along the ray at which the next voxel is entered
+                if (t[dim] > range || (step[dim] < 0 && ray.key[dim] == 0) ||
+                    (step[dim] > 0 && ray.key[dim] == key_max_)) {
+                    ray.alive = false;
+                    --n_alive;
+                    continue;
+                }
+
+                ray.key[dim] += step[dim];
+                ray.t_max[dim] += t_delta[dim];
+                any_hit |= classify(ray, r);
+            }
+
+            if (any_hit && stop_at_first_hit) {
+                break;
+            }
+        }
+
+        return bundle;
+    }
+
+   private:
+    friend class MappedOctomapSnapshot;
+
+    static constexpr auto key_max_ = std::numeric_limits<octomap::key_type>::max();
+    static constexpr auto NO_BLOCK = std::numeric_limits<std::uint64_t>::max();
+
+    /**
+     * @brief 2 bits per voxel, 0 is unknown, so a zeroed block is all unknown.
+     */
+    struct block_ {
+        static constexpr std::size_t VOXELS_PER_WORD = 32;
+        std::array<std::uint64_t, VOXELS_PER_BLOCK / VOXELS_PER_WORD> words{};
+
+        [[nodiscard]] auto get(std::size_t i) const -> VoxelStatus {
+            const auto bits = (words[i / VOXELS_PER_WORD] >> (2 * (i % VOXELS_PER_WORD))) & 3u;
+            return bits == 1u ? VoxelStatus::Free
+                   : bits == 2u ? VoxelStatus::Occupied
+                                : VoxelStatus::Unknown;
+        }
+
+        auto set(std::size_t i, VoxelStatus vs) -> void {
+            const auto shift = 2 * (i % VOXELS_PER_WORD);
+            auto& word = words[i / VOXELS_PER_WORD];
+            word = (word & ~(std::uint64_t{3} << shift)) | (bits_(vs) << shift);
+        }
+
+        auto fill(VoxelStatus vs) -> void {
+            // the 2 bits of vs repeated over the whole word
+            words.fill(bits_(vs) * 0x5555555555555555ull);
+        }
+
+        static auto bits_(VoxelStatus vs) -> std::uint64_t {
+            return vs == VoxelStatus::Free ? 1u : vs == VoxelStatus::Occupied ? 2u : 0u;
+        }
+    };
+
+    double resolution_;
+    double resolution_factor_ = 0.0;
+    octomap::key_type max_key_value_ = 0;
+    std::unordered_map<std::uint64_t, block_> blocks_{};
+
+    /**
+     * @brief an all unknown snapshot with the keys of a map of the given resolution and depth
+     */
+    OctomapSnapshot(double resolution, octomap::key_type max_key_value)
+        : resolution_{resolution},
+          resolution_factor_{1.0 / resolution},
+          max_key_value_{max_key_value} {}
+
+    static auto block_key_(std::uint64_t bx, std::uint64_t by, std::uint64_t bz) -> std::uint64_t {
+        return (bx << 32) | (by << 16) | bz;
+    }
+
+    static auto block_key_(const key_type& key) -> std::uint64_t {
+        return block_key_(key[0] >> BLOCK_BITS, key[1] >> BLOCK_BITS, key[2] >> BLOCK_BITS);
+    }
+
+    static auto voxel_index_(const key_type& key) -> std::size_t {
+        constexpr auto mask = BLOCK_SIZE - 1;
+        return (key[0] & mask) | ((key[1] & mask) << BLOCK_BITS) |
+               ((key[2] & mask) << (2 * BLOCK_BITS));
+    }
+
+    /**
+     * @brief the inclusive range of keys [lo, hi] is set to vs. Blocks it covers whole are
+     * filled at once.
+     */
+    auto fill_(const std::array<unsigned int, 3>& lo, const std::array<unsigned int, 3>& hi,
+               VoxelStatus vs) -> void {
+        const auto whole = [&](unsigned int i, unsigned int b) {
+            return lo[i] <= (b << BLOCK_BITS) && ((b + 1) << BLOCK_BITS) - 1 <= hi[i];
+        };
+        for (auto bx = lo[0] >> BLOCK_BITS; bx <= hi[0] >> BLOCK_BITS; ++bx) {
+            for (auto by = lo[1] >> BLOCK_BITS; by <= hi[1] >> BLOCK_BITS; ++by) {
+                for (auto bz = lo[2] >> BLOCK_BITS; bz <= hi[2] >> BLOCK_BITS; ++bz) {
+                    auto& block = blocks_[block_key_(bx, by, bz)];
+                    if (whole(0, bx) && whole(1, by) && whole(2, bz)) {
+                        block.fill(vs);
+                        continue;
+                    }
+                    const auto clamp = [&](unsigned int i, unsigned int b) {
+                        return std::make_pair(std::max(lo[i], b << BLOCK_BITS),
+                                              std::min(hi[i], ((b + 1) << BLOCK_BITS) - 1));
+                    };
+                    const auto [x0, x1] = clamp(0, bx);
+                    const auto [y0, y1] = clamp(1, by);
+                    const auto [z0, z1] = clamp(2, bz);
+                    for (auto x = x0; x <= x1; ++x) {
+                        for (auto y = y0; y <= y1; ++y) {
+                            for (auto z = z0; z <= z1; ++z) {
+                                const auto key = key_type{static_cast<octomap::key_type>(x),
+                                                          static_cast<octomap::key_type>(y),
+                                                          static_cast<octomap::key_type>(z)};
+                                block.set(voxel_index_(key), vs);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // same conversions as octomap::OcTree at the finest depth
+    auto coord_to_key_checked_(const point_type& point, key_type& key) const -> bool {
+        for (unsigned int i = 0; i < 3; ++i) {
+            const auto scaled =
+                static_cast<long>(std::floor(resolution_factor_ * point(i))) + max_key_value_;
+            if (scaled < 0 || scaled >= 2 * static_cast<long>(max_key_value_)) {
+                return false;
+            }
+            key[i] = static_cast<octomap::key_type>(scaled);
+        }
+        return true;
+    }
+
+    [[nodiscard]] auto key_to_coord_(octomap::key_type k) const -> double {
+        return (static_cast<double>(static_cast<int>(k) - static_cast<int>(max_key_value_)) + 0.5) *
+               resolution_;
+    }
+
+    [[nodiscard]] auto key_to_coord_(const key_type& key) const -> point_type {
+        return {static_cast<float>(key_to_coord_(key[0])),
+                static_cast<float>(key_to_coord_(key[1])),
+                static_cast<float>(key_to_coord_(key[2]))};
+    }
+};
+
+inline auto Octomap::snapshot(const std::optional<types::BBX>& region) const -> OctomapSnapshot {
+    return OctomapSnapshot(*this, region);
+}
+
+}  // namespace uoe
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "uoe/octomap_snapshot.hpp"
+#include "uoe/voxelstatus.hpp"
+
+namespace uoe {
+
+/**
+ * @brief layout of a snapshot file, as written by OctomapSnapshot::write().
+ *
+ * The file is the header, followed by the index and the blocks, each starting at a multiple of
+ * ALIGNMENT bytes. The index holds an entry per block of the snapshot, sorted by block key, so a
+ * lookup is a binary search. Blocks that are all free or all occupied, as pruned regions of the
+ * octree are, only have an entry in the index, which is where most of the size of a snapshot goes.
+ * Everything is stored in the byte order of the machine that wrote it.
+ */
+struct SnapshotFileHeader {
+    static constexpr std::array<char, 8> MAGIC = {'U', 'O', 'E', 'S', 'N', 'A', 'P', '\0'};
+    static constexpr std::uint32_t VERSION = 1;
+    static constexpr std::size_t ALIGNMENT = 64;
+    static constexpr auto FILE_EXTENSION = ".snap";
+
+    std::array<char, 8> magic = MAGIC;
+    std::uint32_t version = VERSION;
+    std::uint32_t max_key_value = 0;
+    double resolution = 0.0;
+    std::uint64_t n_blocks = 0;         // entries in the index
+    std::uint64_t n_stored_blocks = 0;  // blocks that are not uniform
+    std::uint64_t n_free_voxels = 0;
+    std::uint64_t n_occupied_voxels = 0;
+    std::uint64_t index_offset = 0;
+    std::uint64_t blocks_offset = 0;
+
+    [[nodiscard]] auto valid() const -> bool { return magic == MAGIC && version == VERSION; }
+
+    /**
+     * @brief reads only the header of the file at `path`, e.g. to summarise many maps.
+     * @throw std::runtime_error if the file can not be read, or is not a snapshot
+     */
+    static auto read(const std::filesystem::path& path) -> SnapshotFileHeader {
+        auto header = SnapshotFileHeader{};
+        auto f = std::ifstream(path, std::ios_base::binary);
+        if (! f.read(reinterpret_cast<char*>(&header), sizeof(header)) || ! header.valid()) {
+            throw std::runtime_error(path.string() + " is not an octomap snapshot");
+        }
+        return header;
+    }
+};
+
+/**
+ * @brief a snapshot file, mapped into memory rather than read. Opening it costs a system call,
+ * and the pages of the index and the blocks are only read from disk when a lookup touches them,
+ * so many maps can be opened at once, and queried sparsely, without loading them.
+ *
+ * Lookups give the same status as OctomapSnapshot::status() of the snapshot that was written.
+ * The mapping is read only, so a MappedOctomapSnapshot can be shared between threads.
+ */
+class MappedOctomapSnapshot final {
+   public:
+    using point_type = OctomapSnapshot::point_type;
+    using key_type = OctomapSnapshot::key_type;
+
+    /**
+     * @throw std::runtime_error if the file can not be mapped, or is not a snapshot
+     */
+    explicit MappedOctomapSnapshot(const std::filesystem::path& path) {
+        const auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("could not open " + path.string());
+        }
+        struct stat st {};
+        if (::fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) >= sizeof(header_)) {
+            size_ = static_cast<std::size_t>(st.st_size);
+            data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        // the mapping keeps the file alive
+        ::close(fd);
+        if (data_ == nullptr || data_ == MAP_FAILED) {
+            data_ = nullptr;
+            throw std::runtime_error("could not map " + path.string());
+        }
+        // lookups are scattered, so reading ahead would mostly read pages that are never used
+        ::madvise(data_, size_, MADV_RANDOM);
+
+        std::memcpy(&header_, data_, sizeof(header_));
+        // the counts and offsets are read from the file, so a truncated or corrupt file must not
+        // be able to place the index or the blocks past the end of the mapping
+        if (! header_.valid() ||
+            ! fits_<index_entry_>(header_.index_offset, header_.n_blocks) ||
+            ! fits_<OctomapSnapshot::block_>(header_.blocks_offset, header_.n_stored_blocks)) {
+            unmap_();
+            throw std::runtime_error(path.string() + " is not an octomap snapshot");
+        }
+        index_ = reinterpret_cast<const index_entry_*>(bytes_() + header_.index_offset);
+        blocks_ =
+            reinterpret_cast<const OctomapSnapshot::block_*>(bytes_() + header_.blocks_offset);
+        grid_ = OctomapSnapshot(header_.resolution,
+                                static_cast<octomap::key_type>(header_.max_key_value));
+    }
+
+    MappedOctomapSnapshot(const MappedOctomapSnapshot&) = delete;
+    auto operator=(const MappedOctomapSnapshot&) -> MappedOctomapSnapshot& = delete;
+    MappedOctomapSnapshot(MappedOctomapSnapshot&& other) noexcept
+        : header_{other.header_},
+          grid_{std::move(other.grid_)},
+          data_{std::exchange(other.data_, nullptr)},
+          size_{std::exchange(other.size_, 0)},
+          index_{std::exchange(other.index_, nullptr)},
+          blocks_{std::exchange(other.blocks_, nullptr)} {}
+    ~MappedOctomapSnapshot() { unmap_(); }
+
+    [[nodiscard]] auto header() const -> const SnapshotFileHeader& { return header_; }
+    [[nodiscard]] auto resolution() const -> double { return header_.resolution; }
+    [[nodiscard]] auto n_blocks() const -> std::size_t { return header_.n_blocks; }
+
+    [[nodiscard]] auto status(const key_type& key) const -> VoxelStatus {
+        const auto block_key = OctomapSnapshot::block_key_(key);
+        const auto* end = index_ + header_.n_blocks;
+        const auto* it = std::lower_bound(
+            index_, end, block_key, [](const auto& entry, auto k) { return entry.key < k; });
+        if (it == end || it->key != block_key) {
+            return VoxelStatus::Unknown;
+        }
+        switch (it->payload) {
+            case UNIFORM_FREE:
+                return VoxelStatus::Free;
+            case UNIFORM_OCCUPIED:
+                return VoxelStatus::Occupied;
+            default:
+                // a corrupt entry, pointing past the stored blocks, is unknown space
+                return it->payload < header_.n_stored_blocks
+                           ? blocks_[it->payload].get(OctomapSnapshot::voxel_index_(key))
+                           : VoxelStatus::Unknown;
+        }
+    }
+
+    [[nodiscard]] auto get_voxel_status_at_point(const point_type& point) const -> VoxelStatus {
+        auto key = key_type{};
+        return grid_.coord_to_key_checked_(point, key) ? status(key) : VoxelStatus::Unknown;
+    }
+
+    /**
+     * @brief reads the whole file into an OctomapSnapshot, e.g. for raycasts
+     */
+    [[nodiscard]] auto load() const -> OctomapSnapshot {
+        auto snapshot = grid_;
+        snapshot.blocks_.reserve(header_.n_blocks);
+        for (std::size_t i = 0; i < header_.n_blocks; ++i) {
+            const auto& entry = index_[i];
+            if (entry.payload >= header_.n_stored_blocks && entry.payload != UNIFORM_FREE &&
+                entry.payload != UNIFORM_OCCUPIED) {
+                continue;  // a corrupt entry, left unknown as status() does
+            }
+            auto& block = snapshot.blocks_[entry.key];
+            switch (entry.payload) {
+                case UNIFORM_FREE:
+                    block.fill(VoxelStatus::Free);
+                    break;
+                case UNIFORM_OCCUPIED:
+                    block.fill(VoxelStatus::Occupied);
+                    break;
+                default:
+                    block = blocks_[entry.payload];
+                    break;
+            }
+        }
+        return snapshot;
+    }
+
+   private:
+    friend class OctomapSnapshot;
+
+    static constexpr auto UNIFORM_FREE = std::numeric_limits<std::uint64_t>::max();
+    static constexpr auto UNIFORM_OCCUPIED = UNIFORM_FREE - 1;
+
+    struct index_entry_ {
+        std::uint64_t key;
+        std::uint64_t payload;  // number of the stored block, or one of the UNIFORM_ values
+    };
+
+    SnapshotFileHeader header_{};
+    // all unknown, with the keys of the map the file was written from
+    OctomapSnapshot grid_{1.0, 0};
+    void* data_ = nullptr;
+    std::size_t size_ = 0;
+    const index_entry_* index_ = nullptr;
+    const OctomapSnapshot::block_* blocks_ = nullptr;
+
+    [[nodiscard]] auto bytes_() const -> const char* { return static_cast<const char*>(data_); }
+
+    /**
+     * @brief true if n elements of T, starting offset bytes into the mapping, are aligned for T
+     * and end inside of it, without overflowing on counts and offsets read from a corrupt file.
+     */
+    template <typename T>
+    [[nodiscard]] auto fits_(std::uint64_t offset, std::uint64_t n) const -> bool {
+        return offset % alignof(T) == 0 && offset <= size_ && n <= (size_ - offset) / sizeof(T);
+    }
+
+    auto unmap_() -> void {
+        if (data_ != nullptr) {
+            ::munmap(data_, size_);
+            data_ = nullptr;
+        }
+    }
+};
+
+inline auto OctomapSnapshot::write(const std::filesystem::path& path, bool overwrite) const
+    -> bool {
+    if (! overwrite && std::filesystem::is_regular_file(path)) {
+        return false;
+    }
+    using index_entry = MappedOctomapSnapshot::index_entry_;
+    const auto align = [](std::uint64_t offset) {
+        constexpr auto a = SnapshotFileHeader::ALIGNMENT;
+        return (offset + a - 1) / a * a;
+    };
+
+    auto keys = std::vector<std::uint64_t>();
+    keys.reserve(blocks_.size());
+    for (const auto& [key, block] : blocks_) {
+        keys.push_back(key);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    auto header = SnapshotFileHeader{};
+    header.max_key_value = max_key_value_;
+    header.resolution = resolution_;
+    header.n_blocks = keys.size();
+
+    // a uniform block repeats the 2 bits of its status over every word
+    constexpr auto ALL_FREE = 0x5555555555555555ull;
+    constexpr auto ALL_OCCUPIED = 0xAAAAAAAAAAAAAAAAull;
+    const auto uniform = [](const block_& block, std::uint64_t word) {
+        return std::all_of(block.words.begin(), block.words.end(),
+                           [word](auto w) { return w == word; });
+    };
+
+    auto index = std::vector<index_entry>();
+    index.reserve(keys.size());
+    auto stored = std::vector<const block_*>();
+    for (const auto key : keys) {
+        const auto& block = blocks_.at(key);
+        auto payload = std::uint64_t{0};
+        if (uniform(block, ALL_FREE)) {
+            payload = MappedOctomapSnapshot::UNIFORM_FREE;
+        } else if (uniform(block, ALL_OCCUPIED)) {
+            payload = MappedOctomapSnapshot::UNIFORM_OCCUPIED;
+        } else {
+            payload = stored.size();
+            stored.push_back(&block);
+        }
+        index.push_back({key, payload});
+        for (const auto w : block.words) {
+            // the low bit of a voxel is set if it is free, the high bit if it is occupied
+            header.n_free_voxels += __builtin_popcountll(w & ALL_FREE);
+            header.n_occupied_voxels += __builtin_popcountll(w & ALL_OCCUPIED);
+        }
+    }
+    header.n_stored_blocks = stored.size();
+    header.index_offset = align(sizeof(header));
+    header.blocks_offset = align(header.index_offset + index.size() * sizeof(index_entry));
+
+    auto f = std::ofstream(path, std::ios_base::binary | std::ios_base::trunc);
+    const auto pad_to = [&](std::uint64_t offset) {
+        static constexpr auto zeros = std::array<char, SnapshotFileHeader::ALIGNMENT>{};
+        const auto pos = static_cast<std::uint64_t>(f.tellp());
+        f.write(zeros.data(), static_cast<std::streamsize>(offset - pos));
+    };
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    pad_to(header.index_offset);
+    f.write(reinterpret_cast<const char*>(index.data()),
+            static_cast<std::streamsize>(index.size() * sizeof(index_entry)));
+    pad_to(header.blocks_offset);
+    for (const auto* block : stored) {
+        f.write(reinterpret_cast<const char*>(block->words.data()), sizeof(block->words));
+    }
+    return static_cast<bool>(f);
+}
+
+}  // namespace uoe
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <eigen3/Eigen/Dense>
+
+#include "uoe/utils/eigen.hpp"
+#include "uoe/utils/state.hpp"
+#include "uoe/utils/utils.hpp"
+
+namespace uoe::control {
+
+constexpr auto VELOCITY_MAX = 5.f;
+constexpr auto VELOCITY_MIN = -VELOCITY_MAX;
+constexpr auto VELOCITY_MAX_YAW = 1.f;
+constexpr auto VELOCITY_MIN_YAW = -VELOCITY_MAX_YAW;
+
+struct PID {
+    float p, i, d;
+};
+
+/**
+ * @brief the control law of PIDController: PID control of the position, with separate gains for
+ * xy and z, and of the yaw, to velocity commands. Only the math, without ros, so it can also be
+ * stepped offline, e.g. against a model of the drone, see test/pid_tuning.cpp.
+ *
+ * The errors are integrated once the drone is in the air, and the derivative is the difference
+ * from the previous step over dt, so the law has to be stepped every dt seconds.
+ */
+class PositionYawPID final {
+   public:
+    PositionYawPID(PID gains_xy, PID gains_z, PID gains_yaw, float dt)
+        : gains_xy_(gains_xy), gains_z_(gains_z), gains_yaw_(gains_yaw), dt_(dt) {}
+
+    /**
+     * @brief one step of the position controller
+     * @return the linear velocity command, its speed clamped to VELOCITY_MAX
+     */
+    auto compute_linear_velocities(const Eigen::Vector3f& position, const Eigen::Vector3f& target)
+        -> Eigen::Vector3f {
+        error_position_ = target - position;
+        // update integral error if the drone is in the air
+        if (position.z() > utils::SMALL_DISTANCE_TOLERANCE) {
+            error_position_integral_ += error_position_;
+        }
+        // change in error since previous time step
+        const Eigen::Vector3f error_derivative = (error_position_ - error_position_previous_) / dt_;
+        error_position_previous_ = error_position_;
+
+        // apply seperate gains for xy and z
+        const auto output = [&](const PID& gains, int axis) {
+            return gains.p * error_position_[axis] + gains.i * error_position_integral_[axis] +
+                   gains.d * error_derivative[axis];
+        };
+        const auto command =
+            Eigen::Vector3f{output(gains_xy_, 0), output(gains_xy_, 1), output(gains_z_, 2)};
+        return utils::eigen::clamp_vec3(command, VELOCITY_MIN, VELOCITY_MAX);
+    }
+
+    /**
+     * @brief one step of the yaw controller. The error is the smaller angle from yaw to
+     * target_yaw, both in radians.
+     * @return the yaw velocity command, clamped to [VELOCITY_MIN_YAW, VELOCITY_MAX_YAW]
+     */
+    auto compute_yaw_velocity(const Eigen::Vector3f& position, double yaw, double target_yaw)
+        -> float {
+        error_yaw_ = utils::state::yaw_representation(target_yaw - yaw);
+        // update integral error if the drone is in the air
+        if (position.z() > utils::SMALL_DISTANCE_TOLERANCE) {
+            error_yaw_integral_ += error_yaw_;
+        }
+        // change in error since previous time step
+        const auto error_yaw_derivative = (error_yaw_ - error_yaw_previous_) / dt_;
+        error_yaw_previous_ = error_yaw_;
+
+        const auto command = gains_yaw_.p * error_yaw_ + gains_yaw_.i * error_yaw_integral_ +
+                             gains_yaw_.d * error_yaw_derivative;
+        return std::clamp(command, VELOCITY_MIN_YAW, VELOCITY_MAX_YAW);
+    }
+
+    /**
+     * @brief the errors of the last step
+     */
+    [[nodiscard]] auto error_position() const -> const Eigen::Vector3f& { return error_position_; }
+    [[nodiscard]] auto error_yaw() const -> float { return error_yaw_; }
+    [[nodiscard]] auto dt() const -> float { return dt_; }
+
+   private:
+    PID gains_xy_;
+    PID gains_z_;
+    PID gains_yaw_;
+    float dt_;
+
+    Eigen::Vector3f error_position_ = Eigen::Vector3f::Zero();
+    Eigen::Vector3f error_position_integral_ = Eigen::Vector3f::Zero();
+    Eigen::Vector3f error_position_previous_ = Eigen::Vector3f::Zero();
+    float error_yaw_ = 0;
+    float error_yaw_integral_ = 0;
+    float error_yaw_previous_ = 0;
+};
+
+}  // namespace uoe::control
@@ -2,9 +2,16 @@
 
 #include <ros/ros.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <eigen3/Eigen/Dense>
+#include <thread>
 
 #include "geometry_msgs/TwistStamped.h"
+#include "uoe/pid.hpp"
+#include "uoe/utils/concurrency.hpp"
 #include "uoe/utils/eigen.hpp"
 #include "uoe/utils/rviz.hpp"
 #include "uoe/utils/state.hpp"
@@ -18,36 +25,73 @@
 
 namespace uoe::control {
 
-constexpr auto VELOCITY_MAX = 5.f;
-constexpr auto VELOCITY_MIN = -VELOCITY_MAX;
-constexpr auto VELOCITY_MAX_YAW = 1.f;
-constexpr auto VELOCITY_MIN_YAW = -VELOCITY_MAX_YAW;
-
-struct PID {
-    float p, i, d;
-};
-
+/**
+ * @brief PID position and yaw controller, publishing velocity setpoints to MAVROS. The control
+ * law itself is PositionYawPID.
+ *
+ * The control loop runs on its own thread with a fixed period. It reads the latest odometry and
+ * mission setpoint from lock free buffers, written by the ROS callbacks on the thread spinning
+ * the queue of the node handle, and keeps the controller state and the command message across
+ * periods. Publishing the velocity setpoint still serializes it into a buffer of its own. The
+ * controller state and the RViz markers are published from a third thread, so they do not delay
+ * the velocity setpoints.
+ */
 class PIDController {
    public:
     PIDController(ros::NodeHandle& nh, ros::Rate& rate, PID gains_xy, PID gains_z, PID gains_yaw,
                   bool visualise = false);
+    ~PIDController();
+    /**
+     * @brief runs the control loop until ros shuts down, serving the callbacks on this thread
+     */
     auto run() -> void;
+    /**
+     * @brief starts the control loop and returns, leaving the callbacks to whoever spins the
+     * queue of the node handle, e.g. a nodelet manager. The loop stops when the controller is
+     * destroyed.
+     */
+    auto start() -> void;
 
    private:
+    // plain copies of the callback messages, so they can be shared through a SeqLock
+    struct odometry_state {
+        std::array<double, 3> position;
+        std::array<double, 4> orientation;  // x, y, z, w
+    };
+    struct setpoint_state {
+        std::array<double, 3> position;
+        std::array<double, 4> orientation;  // x, y, z, w
+        std::array<double, 3> closest_point;
+        std::uint8_t mission_state;
+    };
+    // output of one control step, for the reporting thread
+    struct controller_report {
+        std::array<float, 3> position;
+        std::array<float, 3> error_position;
+        std::array<float, 3> command_linear;
+        std::array<double, 3> closest_point;
+        float error_yaw;
+        float command_yaw;
+        float max_wakeup_latency;  // seconds the control loop has woken up late, at most
+    };
+
     ros::Rate rate;
+    std::chrono::nanoseconds period;
 
-    auto compute_linear_velocities() -> void;
-    auto compute_yaw_velocity() -> void;
-    auto publish() -> void;
-    auto visualise() -> void;
+    auto control_loop() -> void;
+    auto report_loop() -> void;
+    auto compute_linear_velocities(const odometry_state& odom, const setpoint_state& setpoint)
+        -> void;
+    auto compute_yaw_velocity(const odometry_state& odom, const setpoint_state& setpoint) -> void;
+    auto publish_command() -> void;
+    auto publish_state(const controller_report& report) -> void;
+    auto visualise(const controller_report& report) -> void;
 
     auto odom_cb(const nav_msgs::Odometry::ConstPtr& msg) -> void;
     auto mission_state_cb(const uoe_msgs::MissionStateStamped::ConstPtr& msg) -> void;
 
-    // controller gains
-    PID gains_xy;
-    PID gains_z;
-    PID gains_yaw;
+    // the control law, with the errors of the last step
+    PositionYawPID pid;
 
     // ros
     ros::Publisher pub_velocity;
@@ -56,21 +100,20 @@ class PIDController {
     ros::Subscriber sub_mission_state;
     ros::Subscriber sub_odom;
 
-    // cb variables
-    uoe_msgs::MissionStateStamped mission_state;
-    nav_msgs::Odometry odom;
+    // cb variables, written by the callbacks, read by the control loop
+    utils::concurrency::SeqLock<setpoint_state> mission_state;
+    utils::concurrency::SeqLock<odometry_state> odom;
+    // written by the control loop, read by the reporting thread
+    utils::concurrency::SeqLock<controller_report> report;
+
+    // threads
+    std::atomic<bool> running;
+    std::thread control_thread;
+    std::thread report_thread;
 
-    // state
+    // state, only used by the control loop
     tf2::Quaternion drone_attitude;
-    uoe_msgs::ControllerStateStamped state;
-
-    // errors
-    Eigen::Vector3f error_position;
-    Eigen::Vector3f error_position_integral;
-    Eigen::Vector3f error_position_previous;
-    float error_yaw;
-    float error_yaw_integral;
-    float error_yaw_previous;
+    geometry_msgs::TwistStamped command_msg;  // reused across periods
 
     // commands
     Eigen::Vector3f command_linear;
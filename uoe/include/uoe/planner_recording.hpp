@@ -0,0 +1,149 @@
+#pragma once
+
+#include <ros/serialization.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "uoe/octomap.hpp"
+
+// recordings of the requests served by rrt_service, to replay them offline, see test/replay.cpp.
+// A recording is a directory with a file per request, holding the serialized request message,
+// the octomaps the requests were planned against, as .bt files, and an index with a line per
+// request, in the order they were served:
+//   <seq> <kind> <request file> <map file, or - if there was no map>
+// separated by tabs. A map is only written when it differs from the one of the previous request.
+namespace uoe::recording {
+
+constexpr auto INDEX_FILE = "index.tsv";
+constexpr auto NO_MAP = "-";
+
+struct entry {
+    std::size_t seq;
+    std::string kind;  // e.g. "nbv" or "find_path"
+    std::filesystem::path request;
+    std::filesystem::path map;  // empty if the request had no map
+};
+
+template <typename Message>
+auto write_message(const std::filesystem::path& path, const Message& msg) -> bool {
+    const auto n = ros::serialization::serializationLength(msg);
+    auto buffer = std::vector<std::uint8_t>(n);
+    auto stream = ros::serialization::OStream(buffer.data(), n);
+    ros::serialization::serialize(stream, msg);
+    auto f = std::ofstream(path, std::ios_base::binary | std::ios_base::trunc);
+    f.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(n));
+    return static_cast<bool>(f);
+}
+
+/**
+ * @throw std::runtime_error if the file can not be read, or does not hold a Message
+ */
+template <typename Message>
+auto read_message(const std::filesystem::path& path) -> Message {
+    auto f = std::ifstream(path, std::ios_base::binary);
+    auto buffer = std::vector<std::uint8_t>(std::istreambuf_iterator<char>(f), {});
+    if (! f && ! f.eof()) {
+        throw std::runtime_error("could not read " + path.string());
+    }
+    auto msg = Message{};
+    try {
+        auto stream = ros::serialization::IStream(buffer.data(), buffer.size());
+        ros::serialization::deserialize(stream, msg);
+    } catch (const ros::serialization::StreamOverrunException&) {
+        throw std::runtime_error(path.string() + " is truncated");
+    }
+    return msg;
+}
+
+/**
+ * @brief the requests of the recording in dir, in the order they were served. The paths of the
+ * entries are relative to the working directory.
+ * @throw std::runtime_error if dir has no index
+ */
+inline auto read_index(const std::filesystem::path& dir) -> std::vector<entry> {
+    auto f = std::ifstream(dir / INDEX_FILE);
+    if (! f) {
+        throw std::runtime_error(dir.string() + " is not a recording");
+    }
+    auto entries = std::vector<entry>();
+    auto line = std::string();
+    while (std::getline(f, line)) {
+        auto fields = std::istringstream(line);
+        auto e = entry{};
+        auto request = std::string();
+        auto map = std::string();
+        if (! (fields >> e.seq >> e.kind >> request >> map)) {
+            continue;
+        }
+        e.request = dir / request;
+        e.map = map == NO_MAP ? std::filesystem::path() : dir / map;
+        entries.push_back(std::move(e));
+    }
+    return entries;
+}
+
+/**
+ * @brief appends requests to a recording. Requests can be recorded from several threads at once.
+ */
+class recorder final {
+   public:
+    /**
+     * @brief starts a new recording in dir, which is created if it does not exist. The index of a
+     * previous recording in dir is overwritten.
+     */
+    explicit recorder(std::filesystem::path dir) : dir_{std::move(dir)} {
+        std::filesystem::create_directories(dir_);
+        index_.open(dir_ / INDEX_FILE, std::ios_base::trunc);
+        if (! index_) {
+            throw std::runtime_error("could not create a recording in " + dir_.string());
+        }
+    }
+
+    [[nodiscard]] auto dir() const -> const std::filesystem::path& { return dir_; }
+
+    template <typename Request>
+    auto record(const std::string& kind, const Request& request,
+                const std::shared_ptr<const Octomap>& map) -> void {
+        const auto lock = std::scoped_lock(mutex_);
+        const auto seq = n_recorded_++;
+        const auto name = [&](const std::string& prefix, const std::string& extension) {
+            auto s = std::ostringstream();
+            s << prefix << std::setw(6) << std::setfill('0') << seq << extension;
+            return s.str();
+        };
+
+        const auto request_file = name(kind + "-", ".msg");
+        write_message(dir_ / request_file, request);
+        if (map == nullptr) {
+            last_map_file_ = NO_MAP;
+        } else if (map != last_map_) {
+            last_map_file_ = name("map-", ".bt");
+            map->write(dir_ / last_map_file_, true);
+        }
+        // the shared map is kept alive, so an equal pointer is the same map
+        last_map_ = map;
+        index_ << seq << '\t' << kind << '\t' << request_file << '\t' << last_map_file_
+               << std::endl;
+    }
+
+   private:
+    std::filesystem::path dir_;
+    std::ofstream index_{};
+    std::mutex mutex_{};
+    std::size_t n_recorded_ = 0;
+    std::shared_ptr<const Octomap> last_map_{};
+    std::string last_map_file_ = NO_MAP;
+};
+
+}  // namespace uoe::recording
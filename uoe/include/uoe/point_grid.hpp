@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "uoe/common_types.hpp"
+
+namespace uoe {
+
+/**
+ * @brief a set of points hashed into a uniform grid, for radius queries that only look at the
+ * cells around the query point, instead of every point in the set, e.g. if a candidate viewpoint
+ * is too close to one of the viewpoints already visited.
+ *
+ * Points are only ever added, so the grid is kept across requests, and grows with them. With the
+ * edge of a cell at least the radius of the queries, a query looks at the 27 cells around the
+ * query point, however many points there are.
+ */
+class PointGrid final {
+   public:
+    using vec3 = types::vec3;
+
+    /**
+     * @throws std::invalid_argument if cell_size is not greater than 0.
+     */
+    explicit PointGrid(float cell_size) : cell_size_{cell_size} {
+        if (! (cell_size > 0)) {
+            throw std::invalid_argument("cell_size must be greater than 0");
+        }
+    }
+
+    auto insert(const vec3& point) -> void {
+        cells_[pack_(cell_of_(point))].push_back(point);
+        ++size_;
+    }
+
+    auto clear() -> void {
+        cells_.clear();
+        size_ = 0;
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t { return size_; }
+    [[nodiscard]] auto empty() const -> bool { return size_ == 0; }
+    [[nodiscard]] auto cell_size() const -> float { return cell_size_; }
+
+    /**
+     * @brief if any point is within radius of point, inclusive.
+     */
+    [[nodiscard]] auto any_within(const vec3& point, float radius) const -> bool {
+        if (cells_.empty() || radius < 0) {
+            return false;
+        }
+        const auto reach = std::max(1, static_cast<std::int32_t>(std::ceil(radius / cell_size_)));
+        const auto center = cell_of_(point);
+        const auto radius_squared = radius * radius;
+        for (auto x = center[0] - reach; x <= center[0] + reach; ++x) {
+            for (auto y = center[1] - reach; y <= center[1] + reach; ++y) {
+                for (auto z = center[2] - reach; z <= center[2] + reach; ++z) {
+                    const auto it = cells_.find(pack_({x, y, z}));
+                    if (it == cells_.end()) {
+                        continue;
+                    }
+                    for (const auto& p : it->second) {
+                        if ((p - point).squaredNorm() <= radius_squared) {
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+   private:
+    using cell_ = std::array<std::int32_t, 3>;
+
+    // 21 bits per axis, as in Frontiers, and points outside of it are clamped to its border
+    static constexpr std::int32_t OFFSET = 1 << 20;
+
+    float cell_size_;
+    std::unordered_map<std::uint64_t, std::vector<vec3>> cells_{};
+    std::size_t size_ = 0;
+
+    [[nodiscard]] auto cell_of_(const vec3& p) const -> cell_ {
+        auto c = cell_{};
+        for (int i = 0; i < 3; ++i) {
+            const auto index = std::floor(p[i] / cell_size_);
+            c[i] = static_cast<std::int32_t>(std::clamp(index, -float(OFFSET), float(OFFSET - 1)));
+        }
+        return c;
+    }
+
+    [[nodiscard]] static auto pack_(const cell_& c) -> std::uint64_t {
+        const auto bits = [](std::int32_t v) {
+            return static_cast<std::uint64_t>(std::clamp(v, -OFFSET, OFFSET - 1) + OFFSET);
+        };
+        return bits(c[0]) | bits(c[1]) << 21 | bits(c[2]) << 42;
+    }
+};
+
+}  // namespace uoe
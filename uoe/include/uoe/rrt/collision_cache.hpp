@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <eigen3/Eigen/Dense>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace uoe::rrt {
+
+/**
+ * @brief memoizes the results of collision checks of segments against one version of a map.
+ *
+ * A segment is identified by its endpoints, quantized to a grid with a spacing of quantum. Two
+ * segments whose endpoints fall in the same cells share a result, so a check is answered from
+ * the cache when a corridor through nearly the same voxels has been checked before, as happens
+ * when waypoint optimization tries many pairs of waypoints, or when a lazily inserted edge is
+ * validated. The endpoints of the segments sharing a result differ by at most
+ * sqrt(3) * quantum, so quantum should be well below the map resolution.
+ *
+ * The results are only valid for the map they were computed against, so the cache has to be
+ * cleared whenever the map changes.
+ */
+class CollisionCache final {
+   public:
+    using vec3 = Eigen::Vector3f;
+
+    explicit CollisionCache(float quantum = 0.01f) { set_quantum(quantum); }
+
+    /**
+     * @brief change the spacing of the quantization grid. Clears the cache, as the keys depend
+     * on it.
+     */
+    auto set_quantum(float quantum) -> void {
+        if (! (quantum > 0.0f)) {
+            throw std::invalid_argument("quantum must be greater than 0");
+        }
+        quantum_ = quantum;
+        clear();
+    }
+
+    /**
+     * @brief forget every result, e.g. because the map has changed.
+     */
+    auto clear() -> void { results_.clear(); }
+
+    /**
+     * @return the cached result of the segment from a to b, if any.
+     */
+    [[nodiscard]] auto find(const vec3& a, const vec3& b) -> std::optional<bool> {
+        const auto it = results_.find(key_(a, b));
+        if (it == results_.end()) {
+            ++misses_;
+            return std::nullopt;
+        }
+        ++hits_;
+        return it->second;
+    }
+
+    auto insert(const vec3& a, const vec3& b, bool collision_free) -> void {
+        results_.insert_or_assign(key_(a, b), collision_free);
+    }
+
+    [[nodiscard]] auto quantum() const -> float { return quantum_; }
+    [[nodiscard]] auto size() const -> std::size_t { return results_.size(); }
+    [[nodiscard]] auto hits() const -> std::size_t { return hits_; }
+    [[nodiscard]] auto misses() const -> std::size_t { return misses_; }
+
+   private:
+    // the quantized coordinates of both endpoints. The order matters, as a segment is checked in
+    // the direction from its first to its second endpoint.
+    using key_type = std::array<std::int32_t, 6>;
+
+    struct key_hash {
+        auto operator()(const key_type& key) const -> std::size_t {
+            // boost::hash_combine
+            auto seed = std::size_t{0};
+            for (const auto k : key) {
+                seed ^= std::hash<std::int32_t>{}(k) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            }
+            return seed;
+        }
+    };
+
+    float quantum_{};
+    std::unordered_map<key_type, bool, key_hash> results_{};
+    std::size_t hits_ = 0;
+    std::size_t misses_ = 0;
+
+    [[nodiscard]] auto key_(const vec3& a, const vec3& b) const -> key_type {
+        const auto q = [this](float x) {
+            return static_cast<std::int32_t>(std::floor(x / quantum_));
+        };
+        return {q(a.x()), q(a.y()), q(a.z()), q(b.x()), q(b.y()), q(b.z())};
+    }
+};
+
+}  // namespace uoe::rrt
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "uoe/rrt/rrt.hpp"
+#include "uoe/utils/concurrency.hpp"
+
+namespace uoe::rrt {
+
+struct PortfolioOptions {
+    /**
+     * @brief number of independently seeded trees.
+     */
+    std::size_t n_trees = uoe::utils::concurrency::default_number_of_workers();
+    unsigned int n_workers = uoe::utils::concurrency::default_number_of_workers();
+    /**
+     * @brief tree i is seeded with seed, and stream i of it.
+     */
+    std::uint64_t seed = std::random_device{}();
+    /**
+     * @brief if not set, the search stops at the first path found. Otherwise every tree runs
+     * until it has found a path, or the deadline has passed, and the shortest path is returned.
+     */
+    std::optional<std::chrono::steady_clock::duration> deadline = std::nullopt;
+};
+
+struct PortfolioResult {
+    RRT::Waypoints waypoints;
+    double length;
+    // the tree that found the path
+    std::size_t tree;
+    // the number of trees that found a path, before the search was stopped
+    std::size_t n_solutions;
+};
+
+/**
+ * @brief grow a portfolio of copies of prototype in parallel, each with its own seed, against
+ * the same octomap. The latency of a single tree has a long tail, as an unlucky tree can spend
+ * all its iterations in a dead end, while the time until the first of n trees finds a path is
+ * much more predictable.
+ *
+ * The searches are stopped cooperatively, through RRT::run(cancelled), so a tree stops growing
+ * within one iteration of the portfolio being done.
+ *
+ * @note the callbacks of prototype are not copied, as they would be called from several
+ * threads at once. The octomap, and distance field if any, assigned to prototype are shared by
+ * all trees, and only read.
+ * @param stats if not nullptr, the work done by all the trees is added to it, whether a path was
+ * found or not.
+ * @return the shortest path found, or std::nullopt if no tree found one.
+ */
+inline auto run_portfolio(const RRT& prototype, const PortfolioOptions& options = {},
+                          RRT::Stats* stats = nullptr) -> std::optional<PortfolioResult> {
+    using clock = std::chrono::steady_clock;
+    const auto n_trees = std::max(options.n_trees, std::size_t{1});
+
+    auto solutions = std::vector<std::optional<RRT::Waypoints>>(n_trees);
+    auto cancelled = std::atomic<bool>{false};
+    auto mutex = std::mutex{};
+    auto done = std::condition_variable{};
+    auto n_finished = std::size_t{0};
+
+    const auto grow_tree = [&](std::size_t& i) {
+        auto rrt = prototype;
+        rrt.unregister_cbs_for_all_events();
+        rrt.reset_stats();
+        rrt.seed(options.seed, i);
+        auto solution = rrt.run(cancelled);
+        {
+            auto lock = std::scoped_lock{mutex};
+            if (solution && ! options.deadline) {
+                cancelled.store(true);
+            }
+            solutions[i] = std::move(solution);
+            ++n_finished;
+            if (stats != nullptr) {
+                *stats += rrt.stats();
+            }
+        }
+        done.notify_one();
+    };
+
+    {
+        auto pool = uoe::utils::concurrency::WorkerPool<std::size_t>(
+            std::min<std::size_t>(options.n_workers, n_trees), n_trees, grow_tree);
+        for (std::size_t i = 0; i < n_trees; ++i) {
+            pool.submit(i);
+        }
+
+        auto lock = std::unique_lock{mutex};
+        const auto stop = [&] { return cancelled.load() || n_finished == n_trees; };
+        if (options.deadline) {
+            done.wait_until(lock, clock::now() + *options.deadline, stop);
+        } else {
+            done.wait(lock, stop);
+        }
+        cancelled.store(true);
+        lock.unlock();
+        // trees that have not started yet return immediately, as the search is cancelled
+        pool.join();
+    }
+
+    auto best = std::optional<PortfolioResult>{};
+    auto n_solutions = std::size_t{0};
+    for (std::size_t i = 0; i < n_trees; ++i) {
+        if (! solutions[i]) {
+            continue;
+        }
+        ++n_solutions;
+        const auto l = RRT::path_length(*solutions[i]);
+        if (! best || l < best->length) {
+            best = PortfolioResult{std::move(*solutions[i]), l, i, 0};
+        }
+    }
+    if (best) {
+        best->n_solutions = n_solutions;
+    }
+    return best;
+}
+
+}  // namespace uoe::rrt
@@ -0,0 +1,401 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <eigen3/Eigen/Dense>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "uoe/bbx.hpp"
+#include "uoe/octomap.hpp"
+#include "uoe/utils/random.hpp"
+#include "uoe/voxelstatus.hpp"
+
+namespace uoe::rrt {
+
+/**
+ * @brief a probabilistic roadmap of the free space of a map, for answering many point to point
+ * queries in the same environment, where an rrt would be grown from scratch for every one.
+ *
+ * The vertices are sampled in the free voxels of the map, and connected to their nearest
+ * neighbours within a radius. The edges are checked lazily: a query runs A* over every edge not
+ * yet known to be in collision, and only checks the edges on the path it finds, with the checker
+ * it is given. An edge in collision is marked, and A* runs again without it. So a query in a
+ * known part of the roadmap checks no edges at all, and the roadmap is only ever checked where
+ * the queries go. The results are kept with the edges, so they are only valid for the drone the
+ * checker was for, and the map it checked against. When the map changes in a region, only the
+ * edges near it are checked again, see invalidate().
+ */
+class Roadmap final {
+   public:
+    using vec3 = Eigen::Vector3f;
+    using Waypoints = std::vector<vec3>;
+    /**
+     * @brief if the segment between two points is collision free
+     */
+    using edge_checker = std::function<bool(const vec3&, const vec3&)>;
+
+    struct Options {
+        std::size_t n_vertices = 2000;
+        float connection_radius = 4.0f;
+        std::size_t max_neighbors = 12;
+        // the edges on the paths of a query are checked at most this many times, before it
+        // gives up
+        std::size_t max_replans = 64;
+        std::uint64_t seed = 0;
+    };
+
+    struct Stats {
+        std::size_t edges_checked = 0;
+        std::size_t replans = 0;
+        std::size_t vertices_expanded = 0;
+    };
+
+    /**
+     * @brief samples the vertices in the free voxels of map, and connects them. The map is not
+     * referenced afterwards.
+     * @throws std::invalid_argument if the connection radius is not greater than 0.
+     */
+    Roadmap(const Octomap& map, Options options)
+        : options_{options}, bounds_{map.metric_bounds()} {
+        if (! (options.connection_radius > 0)) {
+            throw std::invalid_argument("connection_radius must be greater than 0");
+        }
+        sample_vertices_(map);
+        connect_vertices_();
+    }
+
+    [[nodiscard]] auto n_vertices() const -> std::size_t { return positions_.size(); }
+    [[nodiscard]] auto n_edges() const -> std::size_t { return edges_.size(); }
+    [[nodiscard]] auto n_edges_in_collision() const -> std::size_t {
+        const auto blocked = [](const edge_& e) { return e.status == status_::blocked; };
+        return static_cast<std::size_t>(std::count_if(edges_.begin(), edges_.end(), blocked));
+    }
+    [[nodiscard]] auto bounds() const -> const types::BBX& { return bounds_; }
+    [[nodiscard]] auto options() const -> const Options& { return options_; }
+
+    /**
+     * @brief forget if the edges within margin of region are collision free, e.g. because the map
+     * has changed there, see Octomap::changed_region(). The margin should cover the clearance the
+     * edges were checked with. Without a region every edge is forgotten, e.g. because the edges
+     * are checked for another drone.
+     * @return the number of edges forgotten
+     */
+    auto invalidate(const std::optional<types::BBX>& region = std::nullopt, float margin = 0.0f)
+        -> std::size_t {
+        auto n = std::size_t{0};
+        for (auto& e : edges_) {
+            if (e.status != status_::unchecked && (! region || overlaps_(e, *region, margin))) {
+                e.status = status_::unchecked;
+                ++n;
+            }
+        }
+        return n;
+    }
+
+    /**
+     * @brief the shortest path in the roadmap from start to goal, shortcut where check allows
+     * it. start and goal are connected to their neighbours in the roadmap, like a vertex.
+     * @return std::nullopt if the roadmap does not connect them.
+     */
+    auto find_path(const vec3& start, const vec3& goal, const edge_checker& check,
+                   Stats* stats = nullptr) -> std::optional<Waypoints> {
+        auto local_stats = Stats{};
+        auto& s = stats != nullptr ? *stats : local_stats;
+        const auto checked = [&](const vec3& a, const vec3& b) {
+            ++s.edges_checked;
+            return check(a, b);
+        };
+        if (checked(start, goal)) {
+            return Waypoints{start, goal};
+        }
+
+        // start and goal are the two vertices after the roadmap, with edges of their own, which
+        // are checked, like the edges of the roadmap, when a path goes through them
+        const auto start_vertex = static_cast<std::uint32_t>(positions_.size());
+        const auto goal_vertex = start_vertex + 1;
+        auto query_edges = std::vector<query_edge_>();
+        for (const auto& [endpoint, vertex] : {std::pair{start, start_vertex},
+                                               std::pair{goal, goal_vertex}}) {
+            for (const auto v : near_(endpoint, options_.max_neighbors)) {
+                const auto length = (positions_[v] - endpoint).norm();
+                query_edges.push_back({vertex, v, length, status_::unchecked});
+            }
+        }
+
+        for (std::size_t replan = 0; replan <= options_.max_replans; ++replan) {
+            s.replans = replan;
+            const auto path = a_star_(start, goal, start_vertex, goal_vertex, query_edges, s);
+            if (path.empty()) {
+                return std::nullopt;
+            }
+            // check the unchecked edges along the path, from the start
+            auto in_collision = false;
+            for (std::size_t i = 0; i + 1 < path.size() && ! in_collision; ++i) {
+                auto& status = status_of_(path[i], path[i + 1], query_edges);
+                if (status == status_::unchecked) {
+                    const auto a = position_(path[i], start, goal);
+                    const auto b = position_(path[i + 1], start, goal);
+                    status = checked(a, b) ? status_::free : status_::blocked;
+                }
+                in_collision = status == status_::blocked;
+            }
+            if (! in_collision) {
+                auto waypoints = Waypoints();
+                waypoints.reserve(path.size());
+                for (const auto v : path) {
+                    waypoints.push_back(position_(v, start, goal));
+                }
+                return shortcut_(std::move(waypoints), checked);
+            }
+        }
+        return std::nullopt;
+    }
+
+   private:
+    enum class status_ : std::uint8_t { unchecked, free, blocked };
+
+    struct edge_ {
+        std::uint32_t from, to;
+        float length;
+        status_ status;
+    };
+    using query_edge_ = edge_;
+
+    Options options_;
+    types::BBX bounds_;
+    std::vector<vec3> positions_{};
+    std::vector<edge_> edges_{};
+    // the edges of vertex v are adjacency_[offsets_[v]..offsets_[v + 1]), as indices into edges_
+    std::vector<std::uint32_t> offsets_{};
+    std::vector<std::uint32_t> adjacency_{};
+    // the vertices in each cell of a grid with cells of the connection radius
+    std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> grid_{};
+
+    auto sample_vertices_(const Octomap& map) -> void {
+        auto rng = utils::random::random_point_generator(0.0f, 1.0f, options_.seed);
+        const vec3 min = bounds_.min();
+        const vec3 extent = bounds_.max() - min;
+        // most of a map can be unknown or occupied, so the number of attempts is bounded
+        const auto max_attempts = 20 * options_.n_vertices;
+        positions_.reserve(options_.n_vertices);
+        for (std::size_t i = 0; i < max_attempts && positions_.size() < options_.n_vertices;
+             ++i) {
+            const vec3 p = min + vec3(rng.random01(), rng.random01(), rng.random01())
+                                     .cwiseProduct(extent);
+            if (map.get_voxel_status_at_point({p.x(), p.y(), p.z()}) == VoxelStatus::Free) {
+                grid_[pack_(cell_of_(p))].push_back(static_cast<std::uint32_t>(positions_.size()));
+                positions_.push_back(p);
+            }
+        }
+    }
+
+    auto connect_vertices_() -> void {
+        for (std::uint32_t u = 0; u < positions_.size(); ++u) {
+            for (const auto v : near_(positions_[u], options_.max_neighbors + 1)) {
+                // every edge once, from the lower vertex
+                if (u < v) {
+                    const auto length = (positions_[v] - positions_[u]).norm();
+                    edges_.push_back({u, v, length, status_::unchecked});
+                }
+            }
+        }
+        offsets_.assign(positions_.size() + 1, 0);
+        for (const auto& e : edges_) {
+            ++offsets_[e.from + 1];
+            ++offsets_[e.to + 1];
+        }
+        for (std::size_t v = 0; v < positions_.size(); ++v) {
+            offsets_[v + 1] += offsets_[v];
+        }
+        adjacency_.resize(2 * edges_.size());
+        auto next = std::vector<std::uint32_t>(offsets_.begin(), offsets_.end() - 1);
+        for (std::uint32_t i = 0; i < edges_.size(); ++i) {
+            adjacency_[next[edges_[i].from]++] = i;
+            adjacency_[next[edges_[i].to]++] = i;
+        }
+    }
+
+    [[nodiscard]] auto cell_of_(const vec3& p) const -> std::array<std::int32_t, 3> {
+        const vec3 c = (p - bounds_.min()) / options_.connection_radius;
+        return {static_cast<std::int32_t>(std::floor(c.x())),
+                static_cast<std::int32_t>(std::floor(c.y())),
+                static_cast<std::int32_t>(std::floor(c.z()))};
+    }
+
+    // the cells are relative to the minimum of the bounds, so they fit in 21 bits per axis
+    [[nodiscard]] static auto pack_(const std::array<std::int32_t, 3>& c) -> std::uint64_t {
+        const auto bits = [](std::int32_t v) {
+            return static_cast<std::uint64_t>(v + (1 << 20)) & ((std::uint64_t{1} << 21) - 1);
+        };
+        return bits(c[0]) | bits(c[1]) << 21 | bits(c[2]) << 42;
+    }
+
+    /**
+     * @brief the at most k vertices within the connection radius of p, nearest first, excluding
+     * a vertex at p itself
+     */
+    [[nodiscard]] auto near_(const vec3& p, std::size_t k) const -> std::vector<std::uint32_t> {
+        auto candidates = std::vector<std::pair<float, std::uint32_t>>();
+        const auto r2 = options_.connection_radius * options_.connection_radius;
+        const auto center = cell_of_(p);
+        for (auto x = center[0] - 1; x <= center[0] + 1; ++x) {
+            for (auto y = center[1] - 1; y <= center[1] + 1; ++y) {
+                for (auto z = center[2] - 1; z <= center[2] + 1; ++z) {
+                    const auto it = grid_.find(pack_({x, y, z}));
+                    if (it == grid_.end()) {
+                        continue;
+                    }
+                    for (const auto v : it->second) {
+                        const auto d2 = (positions_[v] - p).squaredNorm();
+                        if (d2 > 0 && d2 <= r2) {
+                            candidates.emplace_back(d2, v);
+                        }
+                    }
+                }
+            }
+        }
+        const auto n = std::min(k, candidates.size());
+        std::partial_sort(candidates.begin(), candidates.begin() + static_cast<std::ptrdiff_t>(n),
+                          candidates.end());
+        auto out = std::vector<std::uint32_t>(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = candidates[i].second;
+        }
+        return out;
+    }
+
+    [[nodiscard]] auto position_(std::uint32_t v, const vec3& start, const vec3& goal) const
+        -> vec3 {
+        if (v < positions_.size()) {
+            return positions_[v];
+        }
+        return v == positions_.size() ? start : goal;
+    }
+
+    /**
+     * @brief the status of the edge between u and v, which are consecutive on a path found by
+     * a_star_(), so the edge exists
+     */
+    auto status_of_(std::uint32_t u, std::uint32_t v, std::vector<query_edge_>& query_edges)
+        -> status_& {
+        const auto n = static_cast<std::uint32_t>(positions_.size());
+        if (u >= n || v >= n) {
+            for (auto& e : query_edges) {
+                if ((e.from == u && e.to == v) || (e.from == v && e.to == u)) {
+                    return e.status;
+                }
+            }
+        }
+        for (auto i = offsets_[u]; i < offsets_[u + 1]; ++i) {
+            auto& e = edges_[adjacency_[i]];
+            if (e.from == v || e.to == v) {
+                return e.status;
+            }
+        }
+        throw std::logic_error("no edge between consecutive vertices of a path");
+    }
+
+    /**
+     * @brief A* from start_vertex to goal_vertex, over the edges not known to be in collision,
+     * with the distance to the goal as the heuristic.
+     * @return the vertices of the path, or an empty vector if there is none.
+     */
+    auto a_star_(const vec3& start, const vec3& goal, std::uint32_t start_vertex,
+                 std::uint32_t goal_vertex, const std::vector<query_edge_>& query_edges,
+                 Stats& stats) const -> std::vector<std::uint32_t> {
+        constexpr auto none = std::numeric_limits<std::uint32_t>::max();
+        const auto n = positions_.size() + 2;
+        auto cost = std::vector<float>(n, std::numeric_limits<float>::infinity());
+        auto previous = std::vector<std::uint32_t>(n, none);
+        const auto heuristic = [&](std::uint32_t v) {
+            return (position_(v, start, goal) - goal).norm();
+        };
+
+        using entry = std::pair<float, std::uint32_t>;
+        auto open = std::priority_queue<entry, std::vector<entry>, std::greater<>>{};
+        cost[start_vertex] = 0;
+        open.emplace(heuristic(start_vertex), start_vertex);
+        const auto relax = [&](std::uint32_t u, std::uint32_t v, float length) {
+            if (cost[u] + length < cost[v]) {
+                cost[v] = cost[u] + length;
+                previous[v] = u;
+                open.emplace(cost[v] + heuristic(v), v);
+            }
+        };
+        while (! open.empty()) {
+            const auto [f, u] = open.top();
+            open.pop();
+            if (u == goal_vertex) {
+                break;
+            }
+            if (f > cost[u] + heuristic(u)) {
+                continue;  // stale entry
+            }
+            ++stats.vertices_expanded;
+            for (const auto& e : query_edges) {
+                if (e.status != status_::blocked && (e.from == u || e.to == u)) {
+                    relax(u, e.from == u ? e.to : e.from, e.length);
+                }
+            }
+            if (u < positions_.size()) {
+                for (auto i = offsets_[u]; i < offsets_[u + 1]; ++i) {
+                    const auto& e = edges_[adjacency_[i]];
+                    if (e.status != status_::blocked) {
+                        relax(u, e.from == u ? e.to : e.from, e.length);
+                    }
+                }
+            }
+        }
+
+        auto path = std::vector<std::uint32_t>();
+        if (previous[goal_vertex] == none) {
+            return path;
+        }
+        for (auto v = goal_vertex; v != none; v = previous[v]) {
+            path.push_back(v);
+        }
+        std::reverse(path.begin(), path.end());
+        return path;
+    }
+
+    /**
+     * @brief from every waypoint, skip ahead over the waypoints it can reach directly, until the
+     * first it can not, so a path takes a check per waypoint, not per pair of them
+     */
+    template <typename Check>
+    [[nodiscard]] static auto shortcut_(Waypoints waypoints, Check&& check) -> Waypoints {
+        auto out = Waypoints{waypoints.front()};
+        auto i = std::size_t{0};
+        while (i + 1 < waypoints.size()) {
+            auto next = i + 1;
+            while (next + 1 < waypoints.size() && check(waypoints[i], waypoints[next + 1])) {
+                ++next;
+            }
+            out.push_back(waypoints[next]);
+            i = next;
+        }
+        return out;
+    }
+
+    [[nodiscard]] auto overlaps_(const edge_& e, const types::BBX& region, float margin) const
+        -> bool {
+        const vec3 a = positions_[e.from];
+        const vec3 b = positions_[e.to];
+        const vec3 lo = a.cwiseMin(b) - vec3::Constant(margin);
+        const vec3 hi = a.cwiseMax(b) + vec3::Constant(margin);
+        return (lo.array() <= region.max().array()).all() &&
+               (region.min().array() <= hi.array()).all();
+    }
+};
+
+}  // namespace uoe::rrt
@@ -2,15 +2,27 @@
 
 #include <ros/ros.h>
 
+#include <atomic>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <memory>
 
+#include "uoe/bbx.hpp"
+#include "uoe/coarse_free_space.hpp"
 #include "uoe/common_headers.hpp"
+#include "uoe/esdf.hpp"
+#include "uoe/inflated_occupancy.hpp"
 #include "uoe/octomap.hpp"
+#include "uoe/octomap_snapshot.hpp"
+#include "uoe/rrt/collision_cache.hpp"
+#include "uoe/rrt/tree.hpp"
 #include "uoe/utils/random.hpp"
+#include "uoe/utils/trace.hpp"
 
 #ifdef USE_KDTREE
-#include "kdtree/kdtree3.hpp"
+#include "kdtree/incremental_kdtree3.hpp"
 #endif  // USE_KDTREE
 
 namespace uoe::rrt {
@@ -32,6 +44,62 @@ class RRT {
     using coordinate_type = vec3;
     using Waypoint = coordinate_type;
     using Waypoints = std::vector<Waypoint>;
+    using node_index = Tree::index_type;
+    static constexpr node_index no_node = Tree::null;
+
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief whether events are dispatched. Building with RRT_NO_EVENTS compiles the dispatch in
+     * the hot paths away, for nodes that do not observe the search. Callbacks can still be
+     * registered, but are never called.
+     */
+#ifdef RRT_NO_EVENTS
+    static constexpr bool events_enabled = false;
+#else
+    static constexpr bool events_enabled = true;
+#endif  // RRT_NO_EVENTS
+
+    /**
+     * @brief result of @ref run_until and @ref run_for.
+     */
+    struct AnytimeResult {
+        /**
+         * @brief the path to the goal if it was reached, otherwise the path to the node nearest
+         * to the goal. Empty if the tree is empty.
+         */
+        Waypoints waypoints{};
+        bool reached_goal = false;
+        std::size_t iterations = 0;
+        double iterations_per_second = 0.0;
+    };
+
+    /**
+     * @brief work done by the tree since construction, or the last @ref reset_stats, to
+     * correlate the latency of a search with the map it ran against. Collision checks answered
+     * by the collision cache are not counted.
+     */
+    struct Stats {
+        std::size_t nn_queries = 0;
+        std::size_t nn_nodes_visited = 0;  // by nearest neighbor queries, not k nearest ones
+        std::size_t kdtree_rebuilds = 0;
+        std::size_t collision_checks = 0;
+        std::size_t collisions_rejected = 0;  // collision checks that found an obstacle
+        std::size_t raycasts = 0;
+        // collision checks accepted by the coarse free space, without a raycast
+        std::size_t coarse_accepted = 0;
+
+        auto operator+=(const Stats& other) -> Stats& {
+            nn_queries += other.nn_queries;
+            nn_nodes_visited += other.nn_nodes_visited;
+            kdtree_rebuilds += other.kdtree_rebuilds;
+            collision_checks += other.collision_checks;
+            collisions_rejected += other.collisions_rejected;
+            raycasts += other.raycasts;
+            coarse_accepted += other.coarse_accepted;
+            return *this;
+        }
+    };
 
     using on_new_node_created_cb = std::function<void(const vec3&, const vec3&)>;
     using on_goal_reached_cb = std::function<void(const vec3&, size_t)>;
@@ -48,6 +116,44 @@ class RRT {
      * found. Otherwise std::nullopt.
      */
     auto run() -> std::optional<Waypoints>;
+    /**
+     * @brief like @ref run, but gives up as soon as cancelled is true. It is checked once per
+     * iteration, so another thread can stop the search, e.g. when a competing tree has found a
+     * path.
+     */
+    auto run(const std::atomic<bool>& cancelled) -> std::optional<Waypoints>;
+    /**
+     * @brief anytime variant of @ref run. Grow the tree until a path is found, the deadline has
+     * passed, or the iterations are used up, and return the best path there is, which may only
+     * lead part of the way to the goal. With informed sampling, the tree keeps growing after a
+     * path is found, and the shortest path found is returned.
+     */
+    auto run_until(clock::time_point deadline) -> AnytimeResult;
+    auto run_for(clock::duration budget) -> AnytimeResult {
+        return run_until(clock::now() + budget);
+    }
+    /**
+     * @brief the rate at which the tree grew during the most recent @ref run_until or
+     * @ref run_for, which is what a time budget should be derived from.
+     */
+    [[nodiscard]] auto iterations_per_second() const -> double { return iterations_per_second_; }
+
+    /**
+     * @brief reseed the sampling. Trees with different seeds, or the same seed and different
+     * streams, grow independently.
+     */
+    auto seed(std::uint64_t seed, std::uint64_t stream = 0) -> void { rng_.seed(seed, stream); }
+    /**
+     * @brief sample near points, e.g. the frontiers of the explored space, rather than everywhere.
+     * With the given probability an iteration samples within radius of one of the points, picked
+     * uniformly, and otherwise as usual. An empty set of points turns the bias off.
+     */
+    auto bias_sampling_towards(std::vector<vec3> points, float probability, float radius)
+        -> void {
+        sampling_targets_ = std::move(points);
+        sampling_target_probability_ = probability;
+        sampling_target_radius_ = radius;
+    }
     /**
      * @brief // grow the tree n nodes.
      * @throws std::invalid_argument if n < 0.
@@ -69,14 +175,16 @@ class RRT {
      * the same arguments.
      */
     auto clear() -> void {
-        nodes_.clear();
+        tree_.clear();
+        goal_tree_.clear();
 #ifdef USE_KDTREE
-        std::for_each(kdtree3s_.begin(), kdtree3s_.end(),
-                      [&](auto& bucket) { bucket.delete_trees(); });
-        kdtree3s_.erase(kdtree3s_.begin() + 1, kdtree3s_.end());
+        index_.clear();
+        goal_index_.clear();
 #endif  // USE_KDTREE
 
         remaining_iterations_ = max_iterations_;
+        best_path_length_ = std::numeric_limits<float>::infinity();
+        best_waypoints_.clear();
         call_cbs_for_event_on_clearing_nodes_in_tree_();
         unregister_cbs_for_all_events();
     }
@@ -94,20 +202,52 @@ class RRT {
         return waypoints_;
     }
 
+    // in lazy mode an edge on the path may turn out to be in collision, in which case it is
+    // removed together with its subtree, and the search is repeated on the pruned tree.
     auto waypoints_from_newest_node() -> std::optional<Waypoints> {
-        backtrack_and_set_waypoints_starting_at_(&nodes_[nodes_.size() - 1]);
+        while (! backtrack_and_set_waypoints_starting_at_(newest_node()) && ! tree_.empty()) {
+        }
         return {waypoints_};
     }
 
     auto get_waypoints_from_nearsest_node_to(const vec3& pt) -> std::optional<Waypoints> {
-        const auto nearest_node = find_nearest_neighbor_(pt);
-        backtrack_and_set_waypoints_starting_at_(nearest_node);
-
+        while (! backtrack_and_set_waypoints_starting_at_(find_nearest_neighbor_(pt)) &&
+               ! tree_.empty()) {
+        }
         return {waypoints_};
     }
 
     [[nodiscard]] auto get_frontier_nodes() const -> std::vector<vec3>;
 
+    /**
+     * @brief reuse the tree for a new search starting at start. The node nearest to start
+     * becomes the root. If it is not at start, a node at start is added, provided the edge to it
+     * is collision free. The remaining iterations are reset to max_iterations.
+     * @return false if the tree could not be connected to start, in which case it is unchanged.
+     */
+    auto reroot(const vec3& start) -> bool;
+
+    /**
+     * @brief remove every edge that is no longer collision free, e.g. after the octomap has been
+     * updated, together with the subtree below it. Node indices are compacted.
+     * @param region if set, only edges passing near it are checked, i.e. the region of the
+     * octomap that has changed.
+     * @return old_to_new, the new index of each node, or no_node if it was removed.
+     */
+    auto prune_edges_in_collision(const std::optional<types::BBX>& region = std::nullopt)
+        -> std::vector<node_index>;
+
+    /**
+     * @brief the index of the most recently inserted node. When called from a on_new_node_created
+     * callback, it is the node the callback was called for.
+     */
+    [[nodiscard]] auto newest_node() const -> node_index {
+        return static_cast<node_index>(tree_.size() - 1);
+    }
+    [[nodiscard]] auto node_position(node_index node) const -> const vec3& {
+        return tree_.position(node);
+    }
+
     /**
      * @brief traverse tree in breath first order, and call @ref f, for every node
      * @param f the function to call.
@@ -142,15 +282,8 @@ class RRT {
      */
     [[nodiscard]] auto connected() const -> bool { return reachable_nodes() == size(); }
 
-#ifdef MEASURE_PERF
-    ~RRT();
-
-    auto enable_perf_logging(const std::filesystem::path& p) -> void {
-        log_perf_measurements_enabled_ = true;
-        file_path_csv_ = p;
-    }
-    auto disable_perf_logging() -> void { log_perf_measurements_enabled_ = false; }
-#endif  // MEASURE_PERF
+    [[nodiscard]] auto stats() const -> const Stats& { return stats_; }
+    auto reset_stats() -> void { stats_ = {}; }
 
     auto register_cb_for_event_on_new_node_created(on_new_node_created_cb cb) {
         on_new_node_created_cb_list.push_back(cb);
@@ -261,18 +394,93 @@ class RRT {
         on_raycast_status_ = ! on_clearing_nodes_in_tree_status_;
     }
 
-    [[nodiscard]] auto empty() const -> bool { return nodes_.empty(); }
-    [[nodiscard]] auto size() const -> std::size_t { return nodes_.size(); };
+    [[nodiscard]] auto empty() const -> bool { return tree_.empty(); }
+    [[nodiscard]] auto size() const -> std::size_t { return tree_.size(); };
     [[nodiscard]] auto remaining_iterations() const -> int { return remaining_iterations_; }
     [[nodiscard]] auto max_iterations() const -> std::size_t { return max_iterations_; }
     [[nodiscard]] auto sampling_radius() const -> float { return sampling_radius_; }
     [[nodiscard]] auto start_position() const -> vec3 { return start_position_; }
     [[nodiscard]] auto goal_position() const -> vec3 { return goal_position_; }
+    [[nodiscard]] auto rrt_star_enabled() const -> bool { return rrt_star_enabled_; }
+    [[nodiscard]] auto rrt_connect_enabled() const -> bool { return rrt_connect_enabled_; }
+    [[nodiscard]] auto informed_sampling_enabled() const -> bool {
+        return informed_sampling_enabled_;
+    }
+    [[nodiscard]] static auto path_length(const Waypoints& waypoints) -> float {
+        auto length = 0.0f;
+        for (std::size_t i = 1; i < waypoints.size(); ++i) {
+            length += (waypoints[i] - waypoints[i - 1]).norm();
+        }
+        return length;
+    }
+    /**
+     * @return the length of the shortest path to the goal found, or infinity.
+     */
+    [[nodiscard]] auto best_path_length() const -> float { return best_path_length_; }
+    [[nodiscard]] auto lazy_collision_checking_enabled() const -> bool {
+        return lazy_collision_checking_enabled_;
+    }
     [[nodiscard]] auto can_grow() const -> bool {
         return remaining_iterations_ - 10 > 0;
     }  // crashes without -10
 
-    auto assign_octomap(uoe::Octomap* map) -> void { octomap_ = map; };
+    /**
+     * @brief the map collision checks are done against. Cached collision results are discarded,
+     * so the map has to be assigned again when it has been modified in place.
+     */
+    auto assign_octomap(const uoe::Octomap* map) -> void {
+        octomap_ = map;
+        if (map != nullptr) {
+            collision_cache_.set_quantum(static_cast<float>(map->resolution()) *
+                                         COLLISION_CACHE_QUANTUM_PER_RESOLUTION);
+        } else {
+            collision_cache_.clear();
+        }
+    };
+    /**
+     * @brief check edges against a distance field instead of raycasting the octomap. The field is
+     * expected to be built from the assigned octomap. nullptr goes back to raycasting.
+     */
+    auto assign_esdf(const uoe::Esdf* esdf) -> void {
+        esdf_ = esdf;
+        collision_cache_.clear();
+    }
+    /**
+     * @brief check edges as a single ray through an occupancy layer, built from the assigned
+     * octomap, with the obstacles and unknown space grown by at least the clearance of the drone.
+     * Used before a distance field, if its clearance suffices for the drone. nullptr disables it.
+     */
+    auto assign_inflated_occupancy(const uoe::InflatedOccupancy* inflated) -> void {
+        inflated_occupancy_ = inflated;
+        collision_cache_.clear();
+    }
+    /**
+     * @brief raycast a snapshot of the octomap instead of the octomap itself. The snapshot is
+     * expected to be taken of the assigned octomap. nullptr goes back to the octomap.
+     */
+    auto assign_snapshot(const uoe::OctomapSnapshot* snapshot) -> void {
+        snapshot_ = snapshot;
+        collision_cache_.clear();
+    }
+    /**
+     * @brief check edges coarse to fine: an edge whose swept volume only passes through cells
+     * known to be entirely free is accepted without a raycast, and only the edges near obstacles
+     * or unknown space are raycast at the resolution of the map. The cells are expected to be
+     * built from the assigned octomap. nullptr raycasts every edge. Not used with a distance
+     * field, nor while raycasts are listened for, as then every ray has to be cast.
+     */
+    auto assign_coarse_free_space(const uoe::CoarseFreeSpace* coarse) -> void {
+        coarse_free_space_ = coarse;
+    }
+    [[nodiscard]] auto collision_cache() const -> const CollisionCache& { return collision_cache_; }
+    /**
+     * @brief if the drone can fly from a to b, checked like an edge of the tree, against the maps
+     * assigned to it, e.g. for the edges of a roadmap of the same map. The checks count towards
+     * stats().
+     */
+    [[nodiscard]] auto edge_is_collision_free(const vec3& a, const vec3& b) const -> bool {
+        return collision_free_(a, b);
+    }
 
    private:
     RRT() = default;
@@ -280,36 +488,9 @@ class RRT {
         std::size_t max_iterations, float max_dist_goal_tolerance,
         float probability_of_testing_full_path_from_new_node_to_goal);
 
-    struct node_t {
-       public:
-        node_t(vec3 pos, node_t* parent_ = nullptr)
-            : parent(parent_), children{}, position_(std::move(pos)) {}
-
-        node_t* parent = nullptr;
-        std::vector<node_t*> children{};
-        vec3 position_{};
-        float gain = 0.0f;
-
-        [[nodiscard]] auto is_leaf() const -> bool { return children.empty(); }
-        [[nodiscard]] auto is_root() const -> bool { return parent == nullptr; }
-        [[nodiscard]] auto number_of_children() const -> std::size_t { return children.size(); }
-
-        friend std::ostream& operator<<(std::ostream& ostream, const node_t& n) {
-            ostream << "RRT::node:\n";
-            ostream << "  root: " << (n.is_root() ? "true" : "false") << '\n';
-            ostream << "  leaf: " << (n.is_leaf() ? "true" : "false") << '\n';
-            ostream << "  position:\n";
-            ostream << "    x: " << n.position_.x() << '\n';
-            ostream << "    y: " << n.position_.y() << '\n';
-            ostream << "    z: " << n.position_.z() << '\n';
-            ostream << "  number_of_children: " << n.number_of_children() << '\n';
-            return ostream;
-        }
-    };
-
     auto sample_random_point_() -> vec3;
     // TODO: make kdtree or list transparent to the caller
-    auto find_nearest_neighbor_(const vec3& pt) -> node_t*;
+    auto find_nearest_neighbor_(const vec3& pt, bool in_goal_tree = false) -> node_index;
 
     auto gain_() const -> double;
 
@@ -322,20 +503,95 @@ class RRT {
     auto bft_(const std::function<void(const vec3& parent_pt, const vec3& child_pt)>& f,
               bool skip_root = true) const -> void;
     [[nodiscard]] auto grow_() -> bool;
+    /**
+     * @brief one iteration of RRT-Connect. One of the trees is extended a step towards a random
+     * point, and the other tree is then extended towards the new node, until it reaches it, or an
+     * edge is in collision. Which tree is extended first alternates between iterations.
+     * @return true if the trees are connected.
+     */
+    [[nodiscard]] auto grow_connect_() -> bool;
+    /**
+     * @brief graft the path from goal_node to the root of goal_tree_ onto start_node, and
+     * backtrack from the goal.
+     */
+    auto connect_trees_(node_index start_node, node_index goal_node) -> bool;
 
-    auto insert_node_(const vec3& pos, node_t* parent) -> node_t&;
+    auto insert_node_(const vec3& pos, node_index parent) -> node_index;
+
+    // RRT*
+    /**
+     * @brief fill near_nodes_ with the indices of the (at most rewire_neighbors_) nodes closest
+     * to pt, that are within rewire_radius_ of it.
+     */
+    auto find_near_nodes_(const vec3& pt) -> void;
+    /**
+     * @brief of the near nodes, the one that gives pt the lowest cost, while being collision
+     * free. nearest is assumed to have a collision free edge to pt already.
+     */
+    auto choose_parent_(const vec3& pt, node_index nearest) -> node_index;
+    /**
+     * @brief make node the parent of every near node, whose cost it lowers.
+     */
+    auto rewire_(node_index node) -> void;
 
-    auto backtrack_and_set_waypoints_starting_at_(node_t* start_node) -> bool;
+    /**
+     * @brief set the waypoints to the path from the root to start_node.
+     * @return false if there is no path. In lazy mode this is also the case, when an edge on it
+     * is in collision. That edge is then removed, together with its subtree.
+     */
+    auto backtrack_and_set_waypoints_starting_at_(node_index start_node) -> bool;
+    /**
+     * @brief collision check the unchecked edges on the path from the root to node, in that
+     * order. The first edge in collision is removed together with its subtree, which contains
+     * the rest of the path, so no more edges are checked.
+     * @return true if every edge on the path is collision free.
+     */
+    auto validate_path_to_(node_index node) -> bool;
+    /**
+     * @brief remove the subtrees of every node for which remove(node) is true, and keep the
+     * spatial index in sync.
+     */
+    template <typename Predicate>
+    auto remove_subtrees_if_(Predicate&& remove) -> std::vector<node_index> {
+        auto old_to_new = tree_.remove_subtrees_if(std::forward<Predicate>(remove));
+#ifdef USE_KDTREE
+        index_.clear();
+        sync_index_();
+#endif  // USE_KDTREE
+        waypoints_.clear();
+        return old_to_new;
+    }
+    /**
+     * @brief of the nodes at the goal, the one with the shortest path from the root, or
+     * no_node if the goal has not been reached.
+     */
+    [[nodiscard]] auto cheapest_goal_node_() const -> node_index;
     auto optimize_waypoints_() -> void;
 
-    [[nodiscard]] auto collision_free_(const vec3& a, const vec3& b, double depth, double width, double height/* , double padding,
-                         double end_of_raycast_padding = 1.0f */) const -> bool;
+    /**
+     * @brief the work done is added to stats, which lets checks run on several threads at once
+     */
+    [[nodiscard]] auto collision_free_(const vec3& a, const vec3& b, double depth, double width,
+                                       double height, Stats& stats) const -> bool;
     // inline auto collision_free_(const vec3& a, const vec3& b, double r, double padding,
     //                             double end_of_raycast_padding = 1.0f) const -> bool {
     //     return collision_free_(a, b, r, r, r, padding, end_of_raycast_padding);
     // }
     [[nodiscard]] inline auto collision_free_(const vec3& a, const vec3& b) const -> bool {
-        return collision_free_(a, b, drone_depth_, drone_width_, drone_height_);
+        // raycast listeners expect every check to raycast
+        const auto use_cache =
+            collision_cache_enabled_ && (octomap_ != nullptr || esdf_) && ! raycast_listeners_();
+        if (use_cache) {
+            if (const auto cached = collision_cache_.find(a, b)) {
+                return *cached;
+            }
+        }
+        const auto free =
+            collision_free_(a, b, drone_depth_, drone_width_, drone_height_, stats_);
+        if (use_cache) {
+            collision_cache_.insert(a, b, free);
+        }
+        return free;
     }
 
     double drone_width_;
@@ -366,6 +622,67 @@ class RRT {
     vec3 direction_from_start_to_goal_{};
 
     double sampling_radius_{};
+    double iterations_per_second_ = 0.0;
+
+    /**
+     * @brief RRT* parameters. When enabled, every new node is connected to the cheapest of
+     * its near nodes, and the near nodes are rewired through it, if that shortens their path
+     * to the root. The near nodes are the rewire_neighbors_ closest nodes within
+     * rewire_radius_. A rewire_radius_ <= 0 means twice the step size.
+     */
+    bool rrt_star_enabled_ = false;
+    float rewire_radius_ = 0.0f;
+    std::size_t rewire_neighbors_ = 16;
+    /**
+     * @brief shortcut and resample the waypoints, after backtracking from the goal.
+     */
+    bool optimize_waypoints_enabled_ = true;
+    /**
+     * @brief threads checking the shortcuts between waypoints. With 1 they are checked on the
+     * calling thread, through the collision cache.
+     */
+    unsigned int shortcut_workers_ = 1;
+    /**
+     * @brief LazyRRT. When enabled, new edges are inserted without being collision checked. The
+     * edges of a path are only checked when it is backtracked, and the ones in collision are
+     * removed, so the tree regrows around them. In mostly free space, most edges never end up on
+     * a path, and are never checked.
+     */
+    bool lazy_collision_checking_enabled_ = false;
+    /**
+     * @brief RRT-Connect. When enabled, a second tree is grown from the goal, and the trees are
+     * connected greedily. Edges are always collision checked, and the tree is not rewired, so
+     * the lazy and RRT* modes do not apply. The goal bias and the probability of testing the
+     * full path to the goal are not needed, as the goal tree reaches out for the start tree
+     * every other iteration.
+     */
+    bool rrt_connect_enabled_ = false;
+    // the tree extended first in the next iteration of grow_connect_()
+    bool extend_goal_tree_next_ = false;
+    /**
+     * @brief Informed RRT*. When enabled, once a path of length c has been found, points are
+     * only sampled from the prolate spheroid with the start and goal as foci, and c as the
+     * transverse diameter, as only nodes inside it can be on a shorter path. Every path
+     * backtracked from the goal updates the bound.
+     */
+    bool informed_sampling_enabled_ = false;
+    float best_path_length_ = std::numeric_limits<float>::infinity();
+    std::vector<vec3> best_waypoints_{};
+    /**
+     * @brief see bias_sampling_towards()
+     */
+    std::vector<vec3> sampling_targets_{};
+    float sampling_target_probability_ = 0.0f;
+    float sampling_target_radius_ = 0.0f;
+    /**
+     * @brief memoize collision checks against the assigned octomap. The endpoints of segments
+     * are quantized to a fraction of the map resolution.
+     */
+    static constexpr float COLLISION_CACHE_QUANTUM_PER_RESOLUTION = 0.25f;
+    bool collision_cache_enabled_ = true;
+    // a cache hit does not change the outcome of a collision check, so it is updated from the
+    // const collision_free_()
+    mutable CollisionCache collision_cache_{};
     /**
      * @brief the interface which is used to query the voxel grid about
      * occupancy status.
@@ -373,94 +690,106 @@ class RRT {
     // TODO: implement
     // VoxelGrid voxelgrid_;
     std::vector<vec3> waypoints_{};
-    std::vector<node_t> nodes_{};
-
-    std::size_t linear_search_start_index_{0};
+    Tree tree_{};
+    // only used by RRT-Connect, rooted at the goal. Its root is added by the first iteration.
+    Tree goal_tree_{};
 
-    uoe::Octomap* octomap_ = nullptr;
+    const uoe::Octomap* octomap_ = nullptr;
+    const uoe::Esdf* esdf_ = nullptr;
+    const uoe::InflatedOccupancy* inflated_occupancy_ = nullptr;
+    const uoe::OctomapSnapshot* snapshot_ = nullptr;
+    const uoe::CoarseFreeSpace* coarse_free_space_ = nullptr;
 
 #ifdef USE_KDTREE
+    /**
+     * @brief spatial index over tree_, the value of each point is its index in tree_.
+     * Nodes are inserted lazily by sync_index_(), so every way of adding a node to tree_
+     * (constructor, builder, insert_node_) is covered.
+     */
+    kdtree::incremental_kdtree3<std::size_t> index_{};
+    kdtree::incremental_kdtree3<std::size_t> goal_index_{};
+    auto sync_index_(const Tree& tree, kdtree::incremental_kdtree3<std::size_t>& index) -> void {
+        if (index.size() == tree.size()) {
+            return;
+        }
+        const auto timer = utils::trace::scoped_timer(utils::trace::stage::kdtree_insert);
+        utils::trace::count(utils::trace::stage::kdtree_insert, tree.size() - index.size());
+        const auto rebuilds_before = index.n_rebuilds();
+        for (auto i = index.size(); i < tree.size(); ++i) {
+            index.insert(tree.position(static_cast<node_index>(i)), i);
+        }
+        stats_.kdtree_rebuilds += index.n_rebuilds() - rebuilds_before;
+    }
+    auto sync_index_() -> void { sync_index_(tree_, index_); }
+#endif  // USE_KDTREE
 
-    static constexpr std::int32_t max_number_of_kdtrees_per_bucket_ = 10;
-    static constexpr std::int32_t max_number_of_nodes_to_do_linear_search_on_ = 1000;
-    std::int32_t n_kdtree_nodes_ = 0;
+    // mutable, as the collision checks are const
+    mutable Stats stats_{};
 
-    using kdtree3 = kdtree::kdtree3<std::size_t>;
+    // scratch buffers reused between iterations
+    std::vector<std::size_t> near_nodes_{};
+    std::vector<node_index> path_{};
+#ifdef USE_KDTREE
+    std::vector<kdtree::incremental_kdtree3<std::size_t>::NearestNeighborResult> neighbors_{};
+#endif  // USE_KDTREE
 
-    struct kdtree3_bucket_t {
-        int size_of_a_tree;
-        // TODO: use std::unique_ptr
-        std::array<kdtree3*, max_number_of_kdtrees_per_bucket_> forest{};
-        kdtree3_bucket_t(int size_of_a_tree_) : size_of_a_tree(size_of_a_tree_) {}
+    uoe::utils::random::random_point_generator rng_{0.0, 1.0};
 
-        [[nodiscard]] auto number_of_trees() const {
-            return std::count_if(forest.begin(), forest.end(),
-                                 [](const auto& tree) { return tree != nullptr; });
-        }
-        [[nodiscard]] auto bucket_is_full() const -> bool {
-            return number_of_trees() == max_number_of_kdtrees_per_bucket_;
-        }
-        [[nodiscard]] auto empty() const { return number_of_trees() == 0; }
+    template <typename... Ts>
+    using action = std::function<void(Ts...)>;
 
-        [[nodiscard]] auto number_of_nodes_in_bucket() const {
-            return number_of_trees() * size_of_a_tree;
+    // the events raised by grow_() and collision_free_() are dispatched inline, so they compile
+    // to nothing without events_enabled.
+    [[nodiscard]] auto raycast_listeners_() const -> bool {
+        if constexpr (events_enabled) {
+            return on_raycast_status_ && ! on_raycast_cb_list.empty();
+        } else {
+            return false;
         }
-
-        auto delete_trees() {
-            std::for_each(forest.begin(), forest.end(), [&](auto& tree) {
-                if (tree != nullptr) {
-                    delete tree;
-                    tree = nullptr;
+    }
+    auto call_cbs_for_event_on_new_node_created_(const vec3& parent_pt, const vec3& new_pt) const
+        -> void {
+        if constexpr (events_enabled) {
+            if (on_new_node_created_status_) {
+                for (const auto& cb : on_new_node_created_cb_list) {
+                    cb(parent_pt, new_pt);
                 }
-            });
+            }
         }
-
-        auto add_kdtree(kdtree3::fn&& fn, int size) {
-            if (bucket_is_full()) {
-                throw std::runtime_error("bucket is full");
+    }
+    auto call_cbs_for_event_on_goal_reached_(const vec3& pt) const -> void {
+        if constexpr (events_enabled) {
+            if (on_goal_reached_status_) {
+                for (const auto& cb : on_goal_reached_cb_list) {
+                    cb(pt, tree_.size());
+                }
             }
-
-            if (size != size_of_a_tree) {
-                // should never happen
-                std::exit(EXIT_FAILURE);
+        }
+    }
+    auto call_cbs_for_event_on_trying_full_path_(const vec3& new_node, const vec3& goal) const
+        -> void {
+        if constexpr (events_enabled) {
+            if (on_trying_full_path_status_) {
+                for (const auto& cb : on_trying_full_path_cb_list) {
+                    cb(new_node, goal);
+                }
             }
-
-            if (size < 0) {
-                throw std::runtime_error("size cannot be negative");
+        }
+    }
+    auto call_cbs_for_event_on_raycast_(const vec3& origin, const vec3& direction,
+                                        const float length, bool did_hit,
+                                        const vec3& center_of_hit_voxel) const -> void {
+        if constexpr (events_enabled) {
+            if (on_raycast_status_) {
+                for (const auto& cb : on_raycast_cb_list) {
+                    cb(origin, direction, length, did_hit, center_of_hit_voxel);
+                }
             }
-
-            auto index = number_of_trees();
-            index -= index > 0 ? -1 : 0;  // handle index
-            forest[index] = new kdtree3(std::move(fn), size);
         }
-
-    };  // kdtree3_forest_t
-
-    // precompute
-    std::vector<kdtree3_bucket_t> kdtree3s_{{max_number_of_nodes_to_do_linear_search_on_}};
-
-    auto add_bucket() -> void {
-        kdtree3s_.emplace_back(
-            static_cast<int>(max_number_of_nodes_to_do_linear_search_on_ *
-                             std::pow(max_number_of_kdtrees_per_bucket_, kdtree3s_.size())));
     }
-
-#endif  // USE_KDTREE
-
-    uoe::utils::random::random_point_generator rng_{0.0, 1.0};
-
-    template <typename... Ts>
-    using action = std::function<void(Ts...)>;
-
-    auto call_cbs_for_event_on_new_node_created_(const vec3&, const vec3&) const -> void;
-    auto call_cbs_for_event_on_goal_reached_(const vec3&) const -> void;
-    auto call_cbs_for_event_on_trying_full_path_(const vec3&, const vec3&) const -> void;
     auto call_cbs_for_event_on_clearing_nodes_in_tree_() const -> void;
     auto call_cbs_for_event_after_optimizing_waypoints_(const vec3&, const vec3&) const -> void;
     auto call_cbs_for_event_before_optimizing_waypoints_(const vec3&, const vec3&) const -> void;
-    auto call_cbs_for_event_on_raycast_(const vec3& origin, const vec3& direction,
-                                        const float length, bool did_hit,
-                                        const vec3& center_of_hit_voxel) const -> void;
 
     std::vector<on_new_node_created_cb> on_new_node_created_cb_list{};
     std::vector<on_goal_reached_cb> on_goal_reached_cb_list{};
@@ -477,13 +806,6 @@ class RRT {
     bool before_optimizing_waypoints_status_ = true;
     bool after_optimizing_waypoints_status_ = true;
     bool on_raycast_status_ = false;
-
-#ifdef MEASURE_PERF
-    bool log_perf_measurements_enabled_ = false;
-    std::filesystem::path file_path_csv_;
-    using microseconds_t = std::chrono::duration<double, std::nano>;
-    std::vector<std::chrono::nanoseconds> timimg_measurements_{};
-#endif  // MEASURE_PERF
 };
 
 }  // namespace uoe::rrt
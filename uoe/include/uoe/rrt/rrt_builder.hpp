@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <eigen3/Eigen/Dense>
 #include <memory>
 
@@ -19,8 +20,7 @@ class RRTBuilder final {
         // the sampling volume should be large enough to contain the goal.
         // rrt_.sampling_radius_ = (start - goal).norm() * 2;
         // insert root node
-        // rrt_.nodes_.emplace_back(RRT::node{start, std::numeric_limits<std::size_t>::max()});
-        rrt_.nodes_.emplace_back(start);
+        rrt_.tree_.add_root(start);
         return *this;
     }
 
@@ -36,7 +36,10 @@ class RRTBuilder final {
     RRTBuilder& max_iterations(std::size_t max_iterations) {
         rrt_.max_iterations_ = max_iterations;
         rrt_.remaining_iterations_ = max_iterations;
-        rrt_.nodes_.reserve(max_iterations * 2);
+        rrt_.tree_.reserve(max_iterations * 2);
+#ifdef USE_KDTREE
+        rrt_.index_.reserve(max_iterations * 2);
+#endif  // USE_KDTREE
         return *this;
     }
 
@@ -97,6 +100,92 @@ class RRTBuilder final {
         return *this;
     }
 
+    /**
+     * @brief enable RRT* rewiring of the tree. The paths found are shorter, so the waypoint
+     * optimization can often be disabled with @ref optimize_waypoints.
+     */
+    RRTBuilder& rrt_star(bool enabled = true) {
+        rrt_.rrt_star_enabled_ = enabled;
+        return *this;
+    }
+
+    /**
+     * @param radius a value <= 0 means twice the step size.
+     */
+    RRTBuilder& rewire_radius(float radius) {
+        rrt_.rewire_radius_ = radius;
+        return *this;
+    }
+
+    RRTBuilder& rewire_neighbors(std::size_t k) {
+        if (k == 0) {
+            auto err_msg = "rewire_neighbors must be greater than 0";
+            throw std::invalid_argument(err_msg);
+        }
+        rrt_.rewire_neighbors_ = k;
+        return *this;
+    }
+
+    RRTBuilder& optimize_waypoints(bool enabled) {
+        rrt_.optimize_waypoints_enabled_ = enabled;
+        return *this;
+    }
+
+    /**
+     * @brief check the shortcuts considered by the waypoint optimization on n threads.
+     * @throws std::invalid_argument if n is 0.
+     */
+    RRTBuilder& shortcut_workers(unsigned int n) {
+        if (n == 0) {
+            auto err_msg = "shortcut_workers must be greater than 0";
+            throw std::invalid_argument(err_msg);
+        }
+        rrt_.shortcut_workers_ = n;
+        return *this;
+    }
+
+    /**
+     * @brief defer collision checks of new edges, until a path through them is backtracked.
+     */
+    RRTBuilder& lazy_collision_checking(bool enabled = true) {
+        rrt_.lazy_collision_checking_enabled_ = enabled;
+        return *this;
+    }
+
+    /**
+     * @brief grow a second tree from the goal, and connect the two, see RRT::grow_connect_().
+     */
+    RRTBuilder& rrt_connect(bool enabled = true) {
+        rrt_.rrt_connect_enabled_ = enabled;
+        return *this;
+    }
+
+    /**
+     * @brief sample only where a shorter path can be, once a path has been found. Best paired
+     * with @ref rrt_star, and RRT::run_until(), which keeps improving the path until the
+     * deadline.
+     */
+    RRTBuilder& informed_sampling(bool enabled = true) {
+        rrt_.informed_sampling_enabled_ = enabled;
+        return *this;
+    }
+
+    /**
+     * @brief make the sampling reproducible. By default the seed comes from std::random_device.
+     */
+    RRTBuilder& seed(std::uint64_t seed) {
+        rrt_.seed(seed);
+        return *this;
+    }
+
+    /**
+     * @brief memoize collision checks, which is enabled by default.
+     */
+    RRTBuilder& collision_cache(bool enabled) {
+        rrt_.collision_cache_enabled_ = enabled;
+        return *this;
+    }
+
     RRTBuilder& on_new_node_created(
         std::function<void(const Eigen::Vector3f& parent_node, const Eigen::Vector3f& new_node)>
             cb) {
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <eigen3/Eigen/Dense>
+#include <limits>
+#include <vector>
+
+namespace uoe::rrt {
+
+/**
+ * @brief node storage of a RRT.
+ *
+ * Nodes are identified by their index, and stored as a structure of arrays. Positions and costs
+ * are kept apart from the topology, so a nearest neighbor scan only touches positions, and a
+ * traversal only touches the topology. The children of a node form a singly linked list through
+ * first_child and next_sibling, so adding a node never allocates beyond amortized growth of the
+ * arrays. Every array holds trivially destructible elements, so clear() is O(1) and keeps the
+ * capacity, which makes building and discarding a tree per request allocation free, once the
+ * arrays have grown.
+ *
+ * Each edge also records whether it has been collision checked. Edges are checked when they are
+ * added, unless the caller defers the check, as the lazy mode of RRT does.
+ */
+class Tree final {
+   public:
+    using vec3 = Eigen::Vector3f;
+    using index_type = std::uint32_t;
+    static constexpr index_type null = std::numeric_limits<index_type>::max();
+
+    struct topology_t {
+        index_type parent = null;
+        index_type first_child = null;
+        index_type next_sibling = null;
+    };
+
+    // PUBLIC INTERFACE
+    // ---------------------------------------------------------------------------------------------
+
+    auto reserve(std::size_t n) -> void {
+        positions_.reserve(n);
+        costs_.reserve(n);
+        topology_.reserve(n);
+        edge_checked_.reserve(n);
+    }
+
+    /**
+     * @brief remove all nodes. The storage is kept.
+     */
+    auto clear() -> void {
+        positions_.clear();
+        costs_.clear();
+        topology_.clear();
+        edge_checked_.clear();
+        root_ = null;
+    }
+
+    /**
+     * @brief insert a node without a parent, with a cost of 0. It becomes the root of the tree.
+     */
+    auto add_root(const vec3& pos) -> index_type {
+        root_ = add_(pos, null, 0.0f);
+        return root_;
+    }
+
+    /**
+     * @brief insert a node as a child of parent. Its cost is the cost of parent plus the
+     * distance between them.
+     * @param checked whether the edge from parent has been collision checked.
+     */
+    auto add(const vec3& pos, index_type parent, bool checked = true) -> index_type {
+        assert(parent < size());
+        const auto cost = costs_[parent] + (pos - positions_[parent]).norm();
+        const auto idx = add_(pos, parent, cost);
+        link_(idx, parent);
+        edge_checked_[idx] = checked;
+        return idx;
+    }
+
+    /**
+     * @brief move node, with its subtree, to be a child of new_parent. The costs of the subtree
+     * are updated.
+     * @note new_parent must not be in the subtree of node.
+     */
+    auto reparent(index_type node, index_type new_parent, bool checked = true) -> void {
+        assert(node < size() && new_parent < size());
+        unlink_(node);
+        link_(node, new_parent);
+        edge_checked_[node] = checked;
+
+        const auto delta =
+            costs_[node] - (costs_[new_parent] + (positions_[node] - positions_[new_parent]).norm());
+        for_each_in_subtree(node, [&](index_type i) { costs_[i] -= delta; });
+    }
+
+    /**
+     * @brief make node the root, by reversing the edges on the path from it to the current root.
+     * Every other edge is kept, and the costs of all nodes are recomputed.
+     */
+    auto make_root(index_type node) -> void {
+        assert(node < size());
+        auto previous = null;
+        // the reversed edge from previous to current is the edge previous had to its parent
+        auto previous_checked = true;
+        for (auto current = node; current != null;) {
+            const auto next = topology_[current].parent;
+            const auto checked = edge_checked_[current];
+            unlink_(current);
+            if (previous != null) {
+                link_(current, previous);
+            }
+            edge_checked_[current] = previous_checked;
+            previous_checked = checked;
+            previous = current;
+            current = next;
+        }
+        root_ = node;
+
+        // depth first order visits every parent before its children
+        for_each_in_subtree(root_, [&](index_type i) {
+            const auto p = topology_[i].parent;
+            costs_[i] = p == null ? 0.0f : costs_[p] + (positions_[i] - positions_[p]).norm();
+        });
+    }
+
+    /**
+     * @brief remove every node for which remove(index) is true, together with its subtree. The
+     * remaining nodes are compacted, keeping their relative order.
+     * @return old_to_new, where old_to_new[i] is the new index of node i, or null if removed.
+     */
+    template <typename Predicate>
+    auto remove_subtrees_if(Predicate&& remove) -> std::vector<index_type> {
+        auto old_to_new = std::vector<index_type>(size(), 0);
+        for (index_type i = 0; i < size(); ++i) {
+            if (old_to_new[i] != null && remove(i)) {
+                for_each_in_subtree(i, [&](index_type j) { old_to_new[j] = null; });
+            }
+        }
+
+        index_type n = 0;
+        for (auto& i : old_to_new) {
+            if (i != null) {
+                i = n++;
+            }
+        }
+
+        // after make_root() a parent may come after its children, so the mapping is complete
+        // before any parent is remapped.
+        for (index_type i = 0; i < size(); ++i) {
+            if (old_to_new[i] == null) {
+                continue;
+            }
+            const auto j = old_to_new[i];
+            positions_[j] = positions_[i];
+            costs_[j] = costs_[i];
+            // a kept node always has a kept parent, as removal takes the whole subtree
+            const auto p = topology_[i].parent;
+            topology_[j] = topology_t{p == null ? null : old_to_new[p], null, null};
+            edge_checked_[j] = edge_checked_[i];
+        }
+        positions_.resize(n);
+        costs_.resize(n);
+        topology_.resize(n);
+        edge_checked_.resize(n);
+        root_ = root_ == null ? null : old_to_new[root_];
+
+        // relink in reverse, so the children keep their order
+        for (auto i = n; i-- > 0;) {
+            if (topology_[i].parent != null) {
+                link_(i, topology_[i].parent);
+            }
+        }
+        return old_to_new;
+    }
+
+    /**
+     * @brief call f with the index of every child of node.
+     */
+    template <typename F>
+    auto for_each_child(index_type node, F&& f) const -> void {
+        for (auto c = topology_[node].first_child; c != null; c = topology_[c].next_sibling) {
+            f(c);
+        }
+    }
+
+    /**
+     * @brief call f with the index of node, and every node below it, in depth first order.
+     */
+    template <typename F>
+    auto for_each_in_subtree(index_type node, F&& f) const -> void {
+        // walks the first_child/next_sibling links, so no stack is needed.
+        auto current = node;
+        while (true) {
+            f(current);
+            if (topology_[current].first_child != null) {
+                current = topology_[current].first_child;
+                continue;
+            }
+            while (current != node && topology_[current].next_sibling == null) {
+                current = topology_[current].parent;
+            }
+            if (current == node) {
+                return;
+            }
+            current = topology_[current].next_sibling;
+        }
+    }
+
+    /**
+     * @return the root, or null if the tree is empty.
+     */
+    [[nodiscard]] auto root() const -> index_type { return root_; }
+    [[nodiscard]] auto size() const -> std::size_t { return positions_.size(); }
+    [[nodiscard]] auto empty() const -> bool { return positions_.empty(); }
+
+    [[nodiscard]] auto position(index_type i) const -> const vec3& { return positions_[i]; }
+    [[nodiscard]] auto positions() const -> const std::vector<vec3>& { return positions_; }
+    [[nodiscard]] auto cost(index_type i) const -> float { return costs_[i]; }
+    [[nodiscard]] auto parent(index_type i) const -> index_type { return topology_[i].parent; }
+
+    /**
+     * @return whether the edge from the parent of i to i has been collision checked. True for the
+     * root, which has no edge.
+     */
+    [[nodiscard]] auto edge_checked(index_type i) const -> bool { return edge_checked_[i] != 0; }
+    auto set_edge_checked(index_type i) -> void { edge_checked_[i] = true; }
+
+    [[nodiscard]] auto is_root(index_type i) const -> bool { return topology_[i].parent == null; }
+    [[nodiscard]] auto is_leaf(index_type i) const -> bool {
+        return topology_[i].first_child == null;
+    }
+    [[nodiscard]] auto number_of_children(index_type i) const -> std::size_t {
+        auto n = std::size_t{0};
+        for_each_child(i, [&](index_type) { ++n; });
+        return n;
+    }
+
+   private:
+    std::vector<vec3> positions_{};
+    std::vector<float> costs_{};
+    std::vector<topology_t> topology_{};
+    // std::uint8_t rather than bool, as std::vector<bool> is not a container of bool
+    std::vector<std::uint8_t> edge_checked_{};
+    index_type root_ = null;
+
+    auto add_(const vec3& pos, index_type parent, float cost) -> index_type {
+        assert(size() < null);
+        const auto idx = static_cast<index_type>(size());
+        positions_.push_back(pos);
+        costs_.push_back(cost);
+        topology_.push_back(topology_t{parent, null, null});
+        edge_checked_.push_back(true);
+        return idx;
+    }
+
+    auto link_(index_type node, index_type parent) -> void {
+        topology_[node].parent = parent;
+        topology_[node].next_sibling = topology_[parent].first_child;
+        topology_[parent].first_child = node;
+    }
+
+    auto unlink_(index_type node) -> void {
+        const auto parent = topology_[node].parent;
+        if (parent == null) {
+            return;
+        }
+        auto* link = &topology_[parent].first_child;
+        while (*link != node) {
+            link = &topology_[*link].next_sibling;
+        }
+        *link = topology_[node].next_sibling;
+        topology_[node].parent = null;
+        topology_[node].next_sibling = null;
+    }
+};
+
+}  // namespace uoe::rrt
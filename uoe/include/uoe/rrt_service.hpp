@@ -0,0 +1,51 @@
+#pragma once
+
+#include <ros/ros.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "uoe_msgs/NBV.h"
+#include "uoe_msgs/RrtFindPath.h"
+
+namespace uoe {
+class Octomap;
+}  // namespace uoe
+
+// the planning code of the rrt_service node, built without its main() as the rrt_service_planner
+// library, so requests can be served without a ros master, e.g. to replay a recording of them.
+namespace uoe::rrt_service {
+
+/**
+ * @brief reads the parameters of the service from /uoe/rrt_service/<name>. Parameters that are
+ * not set keep their value.
+ */
+auto load_params(ros::NodeHandle& nh) -> void;
+
+/**
+ * @brief sets the parameter called name, as if it had been read from the parameter server.
+ * @return false if the service has no parameter called name
+ * @throw std::invalid_argument if value can not be converted to the type of the parameter
+ */
+auto set_param(const std::string& name, const std::string& value) -> bool;
+
+/**
+ * @brief serve requests against the map returned by source, rather than the map of the
+ * octomap server.
+ */
+auto set_octomap_source(std::function<std::shared_ptr<const Octomap>()> source) -> void;
+
+/**
+ * @brief forget everything kept across requests: the warm started nbv trees and the viewpoints
+ * claimed by the drones of the fleet, the roadmap, the views of the maps, and the number of
+ * seeded requests, so the requests that follow are planned as if the service had just started.
+ * Must not be called while a request is being served.
+ */
+auto reset_state() -> void;
+
+auto find_path(uoe_msgs::RrtFindPath::Request& request, uoe_msgs::RrtFindPath::Response& response)
+    -> bool;
+auto nbv(uoe_msgs::NBV::Request& request, uoe_msgs::NBV::Response& response) -> bool;
+
+}  // namespace uoe::rrt_service
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <eigen3/Eigen/Dense>
+#include <stdexcept>
+#include <vector>
+
+#include "uoe/compound_trajectory.hpp"
+
+namespace uoe::trajectory {
+
+struct TrajectorySample {
+    Eigen::Vector3f position;
+    Eigen::Vector3f velocity;
+    float yaw;  // heading along the trajectory, in radians
+};
+
+/**
+ * @brief a trajectory flown at a constant speed, sampled once at a fixed time step, e.g. the
+ * period of the control loop. Looking up the setpoint at some time is then an interpolation
+ * between two neighbouring samples, a constant amount of work, instead of an arc length lookup
+ * and a dispatch over the sections of a CompoundTrajectory. The samples are immutable once
+ * built, so they can be built on another thread than the one flying them.
+ */
+class SampledTrajectory final {
+   public:
+    SampledTrajectory() {}
+    SampledTrajectory(CompoundTrajectory& trajectory, float velocity, float time_step)
+        : velocity_(velocity), time_step_(time_step) {
+        if (! (velocity > 0)) {
+            throw std::invalid_argument("velocity must be greater than 0");
+        }
+        if (! (time_step > 0)) {
+            throw std::invalid_argument("time_step must be greater than 0");
+        }
+        const auto length = trajectory.get_length();
+        const auto n_samples = static_cast<std::size_t>(std::ceil(length / (velocity * time_step)));
+        samples_.resize(n_samples + 1);
+        for (std::size_t i = 0; i <= n_samples; ++i) {
+            const auto distance = std::min(static_cast<float>(i) * velocity * time_step, length);
+            samples_[i].position = trajectory.get_point_at_distance(distance);
+        }
+
+        // central differences, one sided at the ends
+        for (std::size_t i = 0; i < samples_.size(); ++i) {
+            const auto before = i > 0 ? i - 1 : i;
+            const auto after = std::min(i + 1, samples_.size() - 1);
+            const auto steps = static_cast<float>(after - before);
+            samples_[i].velocity =
+                steps > 0 ? Eigen::Vector3f((samples_[after].position - samples_[before].position) /
+                                            (steps * time_step))
+                          : Eigen::Vector3f::Zero();
+        }
+        // the heading is undefined when moving vertically, so the previous one is kept
+        auto yaw = 0.f;
+        for (auto& sample : samples_) {
+            if (sample.velocity.head<2>().norm() > HEADING_SPEED_THRESHOLD) {
+                yaw = std::atan2(sample.velocity.y(), sample.velocity.x());
+            }
+            sample.yaw = yaw;
+        }
+    }
+
+    /**
+     * @brief the setpoint `time` seconds after the start, interpolated linearly between the
+     * neighbouring samples. Times outside of the trajectory are clamped to its ends.
+     */
+    [[nodiscard]] auto sample_at(float time) const -> TrajectorySample {
+        if (samples_.empty()) {
+            return {Eigen::Vector3f::Zero(), Eigen::Vector3f::Zero(), 0};
+        }
+        if (samples_.size() == 1) {
+            return samples_.front();
+        }
+        const auto x = std::clamp(time / time_step_, 0.f, static_cast<float>(samples_.size() - 1));
+        const auto i = std::min(static_cast<std::size_t>(x), samples_.size() - 2);
+        const auto frac = x - static_cast<float>(i);
+        const auto& s0 = samples_[i];
+        const auto& s1 = samples_[i + 1];
+        // interpolate the yaw along the shortest arc
+        auto yaw_diff = s1.yaw - s0.yaw;
+        if (yaw_diff > M_PI) {
+            yaw_diff -= 2 * M_PI;
+        } else if (yaw_diff < -M_PI) {
+            yaw_diff += 2 * M_PI;
+        }
+        return {s0.position + frac * (s1.position - s0.position),
+                s0.velocity + frac * (s1.velocity - s0.velocity), s0.yaw + frac * yaw_diff};
+    }
+
+    [[nodiscard]] auto empty() const -> bool { return samples_.empty(); }
+    [[nodiscard]] auto size() const -> std::size_t { return samples_.size(); }
+    [[nodiscard]] auto velocity() const -> float { return velocity_; }
+    [[nodiscard]] auto time_step() const -> float { return time_step_; }
+    [[nodiscard]] auto duration() const -> float {
+        return samples_.empty() ? 0 : static_cast<float>(samples_.size() - 1) * time_step_;
+    }
+
+   private:
+    static constexpr auto HEADING_SPEED_THRESHOLD = 1e-3f;
+
+    std::vector<TrajectorySample> samples_{};
+    float velocity_{};
+    float time_step_{};
+};
+
+}  // namespace uoe::trajectory
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "uoe/octomap.hpp"
+
+namespace uoe {
+
+/**
+ * @brief the current version of a map, shared read-copy-update style between a writer and any
+ * number of readers, e.g. the threads planning against it.
+ *
+ * A reader takes a snapshot, an immutable map and its version, and keeps using it for as long as
+ * it holds it, while the writer builds the next version off to the side, and publishes it with a
+ * single atomic swap. Readers never wait for the writer to finish a map, nor for each other, and
+ * never see a map that is being modified. A version is freed once its last reader lets go of it.
+ */
+class SharedOctomap final {
+   public:
+    using version_type = std::uint64_t;
+
+    struct Snapshot {
+        std::shared_ptr<const Octomap> map;
+        // 0 before the first map is published
+        version_type version = 0;
+    };
+
+    SharedOctomap() = default;
+    SharedOctomap(const SharedOctomap&) = delete;
+    auto operator=(const SharedOctomap&) -> SharedOctomap& = delete;
+
+    /**
+     * @brief makes map the current version, for the snapshots taken from now on. Only one thread
+     * may publish at a time.
+     * @return the version of map, one more than the version it replaces
+     */
+    auto publish(std::shared_ptr<const Octomap> map) -> version_type {
+        return publish(std::move(map), version() + 1);
+    }
+
+    /**
+     * @brief as publish(map), for a writer that versions its maps itself, e.g. by the message they
+     * are decoded from. Versions must increase from one publish to the next.
+     */
+    auto publish(std::shared_ptr<const Octomap> map, version_type version) -> version_type {
+        std::atomic_store(&current_,
+                          std::make_shared<const Snapshot>(Snapshot{std::move(map), version}));
+        return version;
+    }
+
+    /**
+     * @brief the current version. The map is nullptr if none has been published.
+     */
+    [[nodiscard]] auto snapshot() const -> Snapshot {
+        const auto current = std::atomic_load(&current_);
+        return current != nullptr ? *current : Snapshot{};
+    }
+
+    [[nodiscard]] auto version() const -> version_type { return snapshot().version; }
+
+   private:
+    std::shared_ptr<const Snapshot> current_ = nullptr;
+};
+
+}  // namespace uoe
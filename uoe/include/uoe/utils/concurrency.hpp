@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace uoe::utils::concurrency {
+
+/**
+ * @brief number of worker threads to use, leaving one core for the calling thread.
+ */
+inline auto default_number_of_workers() -> unsigned int {
+    const auto n = std::thread::hardware_concurrency();
+    return n > 1 ? n - 1 : 1;
+}
+
+/**
+ * @brief multi producer multi consumer FIFO queue with a fixed capacity.
+ * push() blocks while the queue is full, which applies backpressure to the producer,
+ * and pop() blocks while the queue is empty. After close() has been called, push() fails and
+ * pop() returns std::nullopt once the remaining items have been drained.
+ */
+template <typename T>
+class BoundedQueue final {
+   public:
+    explicit BoundedQueue(std::size_t capacity) : capacity_{std::max(capacity, std::size_t{1})} {}
+    BoundedQueue(const BoundedQueue&) = delete;
+    auto operator=(const BoundedQueue&) -> BoundedQueue& = delete;
+
+    /**
+     * @return false if the queue has been closed, in which case item is dropped
+     */
+    auto push(T item) -> bool {
+        auto lock = std::unique_lock{mutex_};
+        not_full_.wait(lock, [&] { return closed_ || items_.size() < capacity_; });
+        if (closed_) {
+            return false;
+        }
+        items_.push_back(std::move(item));
+        lock.unlock();
+        not_empty_.notify_one();
+        return true;
+    }
+
+    auto pop() -> std::optional<T> {
+        auto lock = std::unique_lock{mutex_};
+        not_empty_.wait(lock, [&] { return closed_ || ! items_.empty(); });
+        if (items_.empty()) {
+            return std::nullopt;
+        }
+        auto item = std::move(items_.front());
+        items_.pop_front();
+        lock.unlock();
+        not_full_.notify_one();
+        return item;
+    }
+
+    /**
+     * @brief wake up all blocked producers and consumers. Items already in the queue can still be
+     * popped, unless discard_remaining is true.
+     */
+    auto close(bool discard_remaining = false) -> void {
+        {
+            auto lock = std::scoped_lock{mutex_};
+            closed_ = true;
+            if (discard_remaining) {
+                items_.clear();
+            }
+        }
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t {
+        auto lock = std::scoped_lock{mutex_};
+        return items_.size();
+    }
+    [[nodiscard]] auto capacity() const -> std::size_t { return capacity_; }
+
+   private:
+    const std::size_t capacity_;
+    mutable std::mutex mutex_;
+    std::condition_variable not_empty_, not_full_;
+    std::deque<T> items_;
+    bool closed_ = false;
+};
+
+/**
+ * @brief fixed set of threads that each pop items from a BoundedQueue and hand them to the
+ * same consumer function, until the queue is closed and drained. The destructor closes the queue
+ * and joins the threads.
+ */
+template <typename T>
+class WorkerPool final {
+   public:
+    using consumer_fn = std::function<void(T&)>;
+
+    WorkerPool(unsigned int n_workers, std::size_t queue_capacity, consumer_fn consumer)
+        : queue_{queue_capacity}, consumer_{std::move(consumer)} {
+        workers_.reserve(n_workers);
+        for (unsigned int i = 0; i < std::max(n_workers, 1u); ++i) {
+            workers_.emplace_back([this] {
+                while (auto item = queue_.pop()) {
+                    consumer_(item.value());
+                }
+            });
+        }
+    }
+    WorkerPool(const WorkerPool&) = delete;
+    auto operator=(const WorkerPool&) -> WorkerPool& = delete;
+    ~WorkerPool() { join(); }
+
+    /**
+     * @brief blocks while the queue is full
+     * @return false if the pool is shutting down
+     */
+    auto submit(T item) -> bool { return queue_.push(std::move(item)); }
+
+    /**
+     * @brief stop accepting work and wait for the workers to finish. If discard_pending is false
+     * the items already submitted are processed first.
+     */
+    auto join(bool discard_pending = false) -> void {
+        queue_.close(discard_pending);
+        for (auto& worker : workers_) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t { return workers_.size(); }
+
+   private:
+    BoundedQueue<T> queue_;
+    consumer_fn consumer_;
+    std::vector<std::thread> workers_;
+};
+
+/**
+ * @brief the latest value of T, written by a single thread and read by any number of threads,
+ * without locks or allocation. A reader copies the value and retries if a write overlapped the
+ * copy, which it detects from a sequence number that is odd while a write is in progress, so
+ * readers never block the writer. Meant for small values shared between a callback and a
+ * periodic loop, where only the latest one matters.
+ */
+template <typename T>
+class SeqLock final {
+    static_assert(std::is_trivially_copyable_v<T>, "T is copied with memcpy");
+
+   public:
+    SeqLock() = default;
+    explicit SeqLock(const T& value) { store(value); }
+    SeqLock(const SeqLock&) = delete;
+    auto operator=(const SeqLock&) -> SeqLock& = delete;
+
+    /**
+     * @brief must only be called from one thread at a time
+     */
+    auto store(const T& value) -> void {
+        const auto seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&value_, &value, sizeof(T));
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    [[nodiscard]] auto load() const -> T {
+        auto value = T{};
+        auto before = std::uint64_t{0};
+        auto after = std::uint64_t{0};
+        do {
+            before = seq_.load(std::memory_order_acquire);
+            std::memcpy(&value, &value_, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = seq_.load(std::memory_order_relaxed);
+        } while (before != after || (before & 1) != 0);
+        return value;
+    }
+
+    /**
+     * @brief number of values stored so far
+     */
+    [[nodiscard]] auto version() const -> std::uint64_t {
+        return seq_.load(std::memory_order_acquire) / 2;
+    }
+
+   private:
+    std::atomic<std::uint64_t> seq_{0};
+    T value_{};
+};
+
+}  // namespace uoe::utils::concurrency
@@ -21,6 +21,24 @@ constexpr auto binomial_coefficient(int n, int i) -> int {
     return factorial(n) / (factorial(i) * factorial(n - i));
 }
 
+//--------------------------------------------------------------------------------------------------
+// Returns the integral of `f` over [a;b], approximated by 5-point Gauss-Legendre quadrature,
+// which is exact for polynomials up to degree 9
+template <typename F>
+auto gauss_legendre(F&& f, float a, float b) -> float {
+    constexpr float nodes[5] = {0.f, -0.5384693101056831f, 0.5384693101056831f,
+                                -0.9061798459386640f, 0.9061798459386640f};
+    constexpr float weights[5] = {0.5688888888888889f, 0.4786286704993665f, 0.4786286704993665f,
+                                  0.2369268850561891f, 0.2369268850561891f};
+    const auto half_width = (b - a) / 2;
+    const auto middle = (a + b) / 2;
+    auto sum = 0.f;
+    for (int i = 0; i < 5; i++) {
+        sum += weights[i] * f(middle + half_width * nodes[i]);
+    }
+    return sum * half_width;
+}
+
 inline auto square(const float x) { return std::pow(x, 2); };
 
 inline auto squared_distance(const Vector3f& v1, const Vector3f& v2) -> float {
@@ -1,15 +1,20 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <chrono>
 #include <cmath>
 #include <complex>
+#include <cstdint>
 #include <cstdlib>
 #include <ctime>
 #include <eigen3/Eigen/Dense>
 #include <eigen3/Eigen/Geometry>
 #include <iostream>
+#include <limits>
 #include <random>
+#include <stdexcept>
 
 namespace uoe::utils::random {
 
@@ -18,25 +23,121 @@ using Eigen::Vector2f;
 using Eigen::Vector3d;
 using Eigen::Vector3f;
 
+/**
+ * @brief xoshiro256** of Blackman and Vigna. 256 bits of state, and a handful of shifts and xors
+ * per number, where std::default_random_engine is a division per number with a 31 bit state. It
+ * satisfies UniformRandomBitGenerator, so it also works with the distributions of <random>.
+ *
+ * Generators with the same seed and different streams never overlap in practice: a stream is
+ * 2^128 numbers ahead of the previous one, so a generator per thread or tree can be derived from
+ * one seed, e.g. the seed of a request.
+ */
+class xoshiro256ss final {
+   public:
+    using result_type = std::uint64_t;
+
+    static constexpr auto min() -> result_type { return 0; }
+    static constexpr auto max() -> result_type { return std::numeric_limits<result_type>::max(); }
+
+    explicit xoshiro256ss(std::uint64_t seed = 0, std::uint64_t stream = 0) {
+        this->seed(seed, stream);
+    }
+
+    /**
+     * @note the cost of a stream is linear in its number, ~256 numbers per stream, which is
+     * nothing for a stream per thread.
+     */
+    auto seed(std::uint64_t seed, std::uint64_t stream = 0) -> void {
+        // splitmix64, as the authors recommend, so nearby seeds give unrelated states
+        for (auto& s : s_) {
+            seed += 0x9e3779b97f4a7c15ull;
+            auto z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            s = z ^ (z >> 31);
+        }
+        for (std::uint64_t i = 0; i < stream; ++i) {
+            jump();
+        }
+    }
+
+    auto operator()() -> result_type {
+        const auto result = rotl_(s_[1] * 5, 7) * 9;
+        const auto t = s_[1] << 17;
+        s_[2] ^= s_[0];
+        s_[3] ^= s_[1];
+        s_[1] ^= s_[2];
+        s_[0] ^= s_[3];
+        s_[2] ^= t;
+        s_[3] = rotl_(s_[3], 45);
+        return result;
+    }
+
+    /**
+     * @brief advances the generator by 2^128 numbers, to the start of the next stream
+     */
+    auto jump() -> void {
+        constexpr auto JUMP = std::array<std::uint64_t, 4>{
+            0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull, 0xa9582618e03fc9aaull,
+            0x39abdc4529b1661cull};
+        auto s = std::array<std::uint64_t, 4>{};
+        for (const auto word : JUMP) {
+            for (int bit = 0; bit < 64; ++bit) {
+                if (word & (std::uint64_t{1} << bit)) {
+                    for (std::size_t i = 0; i < s.size(); ++i) {
+                        s[i] ^= s_[i];
+                    }
+                }
+                (*this)();
+            }
+        }
+        s_ = s;
+    }
+
+    /**
+     * @brief uniform in [0, 1), from the top 24 bits, as many as a float has in its mantissa
+     */
+    auto unit_float() -> float { return static_cast<float>((*this)() >> 40) * 0x1.0p-24f; }
+
+   private:
+    std::array<std::uint64_t, 4> s_{};
+
+    static constexpr auto rotl_(std::uint64_t x, int k) -> std::uint64_t {
+        return (x << k) | (x >> (64 - k));
+    }
+};
+
 struct random_point_generator {
     random_point_generator(float min, float max)
-        : engine_(std::random_device()()), distribution_(min, max) {}
-    //   distribution_(min, std::nextafter(max, std::numeric_limits<float>::max())) {}
+        : engine_((std::uint64_t{std::random_device()()} << 32) | std::random_device()()),
+          min_(min),
+          max_(max) {}
+    /**
+     * @brief generator with a reproducible sequence. Generators with different seeds, or the same
+     * seed and different streams, produce independent sequences, e.g. for trees grown in parallel.
+     */
+    random_point_generator(float min, float max, std::uint64_t seed, std::uint64_t stream = 0)
+        : random_point_generator(min, max) {
+        this->seed(seed, stream);
+    }
+
+    auto seed(std::uint64_t seed, std::uint64_t stream = 0) -> void { engine_.seed(seed, stream); }
 
     Eigen::Vector3d operator()() {
-        float x = distribution_(engine_);
-        float y = distribution_(engine_);
-        float z = distribution_(engine_);
+        float x = random01();
+        float y = random01();
+        float z = random01();
         return {x, y, z};
     }
 
-    // std::mt19937 engine_;
-    std::default_random_engine engine_;
-    std::uniform_real_distribution<float> distribution_;
+    xoshiro256ss engine_;
+    float min_;
+    float max_;
 
-    auto random01() -> float {  //    std::random_device rd;
-        return distribution_(engine_);
-    }
+    /**
+     * @brief uniform in [min, max) of the generator
+     */
+    auto random01() -> float { return min_ + (max_ - min_) * engine_.unit_float(); }
 
     auto get_bias_rotation_interval(float bias) -> float {
 #ifndef NDEBUG
@@ -68,47 +169,44 @@ struct random_point_generator {
         return sample_random_point_on_unit_circle_surface(direction, bias) * random01();
     }
 
+    //----------------------------------------------------------------
+
     /**
-     * @brief
-     * imp ref: https://datagenetics.com/blog/january32020/index.html
-     * @return Vector3f
+     * @brief uniformly distributed rotation, with the method of Shoemake, which is also what
+     * Eigen::Quaternionf::UnitRandom() uses. That one draws from std::rand() though, which is
+     * shared by every generator, so sequences would neither be reproducible nor independent.
      */
-    // auto sample_random_point_inside_unit_sphere() -> Vector3f {
-    //     float x, y, z;
-    //     do {
-    //         // select random point in "eight cube" i.e. within [-1, 1]
-    //         x = random01() * 2 - 1;
-    //         y = random01() * 2 - 1;
-    //         z = random01() * 2 - 1;
-    //     } while (sqrt((x * x) + (y * y) + (z * z)) > 1);  // discard if not within unit sphere.
-    //     return Vector3f(x, y, z);
-    // }
-
-    //----------------------------------------------------------------
+    auto random_unit_quaternion() -> Eigen::Quaternionf {
+        const auto u1 = engine_.unit_float();
+        const auto u2 = static_cast<float>(2 * M_PI) * engine_.unit_float();
+        const auto u3 = static_cast<float>(2 * M_PI) * engine_.unit_float();
+        const auto a = std::sqrt(1 - u1);
+        const auto b = std::sqrt(u1);
+        return {b * std::cos(u3), a * std::sin(u2), a * std::cos(u2), b * std::sin(u3)};
+    }
 
+    /**
+     * @brief uniformly distributed on the unit sphere. By Archimedes' hat-box theorem, the height
+     * of a uniform point on the sphere is uniform in [-1, 1], so two numbers are enough.
+     */
     auto sample_random_point_on_unit_sphere_surface() -> Vector3f {
-        auto quat = Eigen::Quaternionf::UnitRandom();
-        auto unit = Vector3f{random01(), random01(), random01()}.normalized();
-        // std::cout << "   (quat * unit).normalized() " << (quat * unit).normalized() << std::endl;
-        return (quat * unit).normalized();
+        const auto z = 2 * engine_.unit_float() - 1;
+        const auto phi = static_cast<float>(2 * M_PI) * engine_.unit_float();
+        const auto rho = std::sqrt(std::max(1 - z * z, 0.0f));
+        return {rho * std::cos(phi), rho * std::sin(phi), z};
     }
 
     auto sample_random_point_on_unit_sphere_surface(Vector3f direction, float x_bias, float y_bias,
                                                     float z_bias) -> Vector3f {
         direction.normalize();
-        // std::cout << "direction: " << direction << std::endl;
         auto roll = get_bias_rotation_interval(x_bias);
         auto pitch = get_bias_rotation_interval(y_bias);
         auto yaw = get_bias_rotation_interval(z_bias);
-        // std::cout << "roll interval is " << std::to_string(roll) << " pitch interval is "
-        //   << std::to_string(pitch) << " yaw interval is " << std::to_string(yaw) << std::endl;
         Eigen::Matrix3f quat;
         quat = AngleAxisf(roll, Vector3f::UnitX()) * AngleAxisf(pitch, Vector3f::UnitY()) *
                AngleAxisf(yaw, Vector3f::UnitZ());
 
         auto rotated = quat * direction;
-        // std::cout << "rotated " << rotated << std::endl;
-        // std::cout << "rotated again" << rotated << std::endl;
         return rotated;
     }
 
@@ -118,27 +216,21 @@ struct random_point_generator {
 
     // -------------------------------
 
+    /**
+     * @brief uniformly distributed inside the unit ball. The radius is the cube root of a uniform
+     * number, as the volume within a radius r grows with r^3, so nothing is rejected.
+     * @note fill_uniform_inside_unit_ball() draws the same points, a batch at a time.
+     */
     auto sample_random_point_inside_unit_sphere() -> Vector3f {
-        auto radial_distance = random01();
-        // std::cout << "[DEBUG] " << __FILE__ << ":" << __LINE__ << ": "
-        //   << " radial_distance" << radial_distance << '\n';
-
-        auto a = sample_random_point_on_unit_sphere_surface() * radial_distance;
-        // std::cout << "[DEBUG] " << __FILE__ << ":" << __LINE__ << ": "
-        //   << " a" << a << '\n';
-
-        return a;
+        const auto on_surface = sample_random_point_on_unit_sphere_surface();
+        return std::cbrt(engine_.unit_float()) * on_surface;
     }
 
     auto sample_random_point_inside_unit_sphere(Vector3f direction, float x_bias, float y_bias,
                                                 float z_bias) -> Vector3f {
-        auto radial_distance = random01();
-        radial_distance *= 1.f;
-        // DO NOT REMOVE LINE BELOW. RADIAL_DISTANCE IS NOT RANDOM IF NOT
-        // std::cout << "radial distance: " << radial_distance << std::endl;
         auto v = sample_random_point_on_unit_sphere_surface(direction, x_bias, y_bias, z_bias);
-        // std::cout << "v is " << v << std::endl;
-        return radial_distance * v;
+        // the bias is on the direction only, radially the points are uniform within the ball
+        return std::cbrt(engine_.unit_float()) * v;
     }
 
     /**
@@ -152,6 +244,69 @@ struct random_point_generator {
     auto sample_random_point_inside_unit_sphere(Vector3f direction, float bias) -> Vector3f {
         return sample_random_point_inside_unit_sphere(direction, bias, bias, bias);
     }
+
+    /**
+     * @brief uniformly distributed inside the unit ball, same as
+     * sample_random_point_inside_unit_sphere()
+     */
+    auto sample_random_point_uniformly_inside_unit_ball() -> Vector3f {
+        return sample_random_point_inside_unit_sphere();
+    }
+
+    /**
+     * @brief uniformly distributed inside the prolate spheroid with foci a and b, and transverse
+     * diameter c, i.e. the points whose distances to a and b sum to at most c.
+     * @note c must be at least the distance between a and b.
+     */
+    auto sample_random_point_inside_prolate_spheroid(const Vector3f& a, const Vector3f& b, float c)
+        -> Vector3f {
+        const Vector3f axis = b - a;
+        const auto c_min = axis.norm();
+        const auto r_transverse = c / 2;
+        const auto r_conjugate = std::sqrt(std::max(c * c - c_min * c_min, 0.0f)) / 2;
+        const auto rotation = Eigen::Quaternionf::FromTwoVectors(Vector3f::UnitX(), axis);
+        const auto radii = Vector3f{r_transverse, r_conjugate, r_conjugate};
+        return (a + b) / 2 +
+               rotation * radii.cwiseProduct(sample_random_point_uniformly_inside_unit_ball());
+    }
+
+    // batches -------------------------------
+    // A column per point. The numbers are drawn first, and then transformed a row at a time over
+    // the whole batch, which Eigen vectorizes, trigonometry included.
+
+    /**
+     * @brief fills points with points uniformly distributed inside the unit ball. The points are
+     * those sample_random_point_inside_unit_sphere() would give, called once per column.
+     */
+    auto fill_uniform_inside_unit_ball(Eigen::Ref<Eigen::Matrix3Xf> points) -> void {
+        const auto u = unit_floats_(points.cols());
+        const Eigen::ArrayXf z = 2 * u.row(0).transpose() - 1;
+        const Eigen::ArrayXf phi = static_cast<float>(2 * M_PI) * u.row(1).transpose();
+        const Eigen::ArrayXf r = u.row(2).transpose().pow(1.0f / 3.0f);
+        const Eigen::ArrayXf rho = r * (1 - z.square()).max(0.0f).sqrt();
+        points.row(0) = (rho * phi.cos()).matrix().transpose();
+        points.row(1) = (rho * phi.sin()).matrix().transpose();
+        points.row(2) = (r * z).matrix().transpose();
+    }
+
+    /**
+     * @brief fills points with points uniformly distributed inside the axis aligned box [min, max)
+     */
+    auto fill_uniform_inside_box(const Vector3f& min, const Vector3f& max,
+                                 Eigen::Ref<Eigen::Matrix3Xf> points) -> void {
+        const auto u = unit_floats_(points.cols());
+        points = ((u.colwise() * (max - min).array()).colwise() + min.array()).matrix();
+    }
+
+   private:
+    /**
+     * @brief 3 x n uniform numbers in [0, 1), drawn in the order of the points, i.e. column major
+     */
+    auto unit_floats_(Eigen::Index n) -> Eigen::Array3Xf {
+        auto u = Eigen::Array3Xf(3, n);
+        std::generate_n(u.data(), u.size(), [&] { return engine_.unit_float(); });
+        return u;
+    }
 };
 
 // /**
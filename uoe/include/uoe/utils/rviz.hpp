@@ -5,10 +5,18 @@
 
 #include <cassert>
 #include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <eigen3/Eigen/Dense>
+#include <functional>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 
 #include "uoe/utils/time.hpp"
 #include "visualization_msgs/MarkerArray.h"
@@ -271,4 +279,131 @@ struct text_msg_gen : public visualization_marker_msg_gen {
     }
 };
 
+/**
+ * @brief collects markers, e.g. from the callbacks of a planner, and publishes them as a single
+ * MarkerArray at most max_rate times a second, from a background thread, so whoever adds a marker
+ * never waits on the publisher, nor has to spin or sleep for it to go out.
+ *
+ * The markers collected since the last flush are double buffered: add() appends to one array,
+ * while the thread publishes the other, and the two are swapped on every flush. The arrays are
+ * cleared, not freed, so once they have grown to the largest batch so far, adding a marker does
+ * not allocate. A marker with the same namespace and id as one still pending replaces it, as it
+ * would in rviz, so a marker updated every tick is only sent once per flush. At most capacity
+ * markers are pending at a time, and the markers added past that are dropped, see n_dropped().
+ *
+ * The publisher has to publish visualization_msgs::MarkerArray. Every member function is thread
+ * safe.
+ */
+class marker_aggregator final {
+   public:
+    marker_aggregator(ros::Publisher publisher, double max_rate, std::size_t capacity = 1 << 14)
+        : publisher_{std::move(publisher)},
+          period_{std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+              std::chrono::duration<double>(max_rate > 0 ? 1.0 / max_rate : 0.0))},
+          capacity_{capacity} {
+        thread_ = std::thread([this] { run_(); });
+    }
+    marker_aggregator(const marker_aggregator&) = delete;
+    auto operator=(const marker_aggregator&) -> marker_aggregator& = delete;
+    /**
+     * @brief publishes the markers still pending before returning
+     */
+    ~marker_aggregator() {
+        {
+            auto lock = std::scoped_lock{mutex_};
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        thread_.join();
+    }
+
+    auto add(visualization_msgs::Marker marker) -> void {
+        auto lock = std::scoped_lock{mutex_};
+        add_(std::move(marker));
+    }
+
+    auto add(visualization_msgs::MarkerArray markers) -> void {
+        auto lock = std::scoped_lock{mutex_};
+        for (auto& marker : markers.markers) {
+            add_(std::move(marker));
+        }
+    }
+
+    /**
+     * @brief publish the pending markers now, instead of at the next flush
+     */
+    auto flush() -> void {
+        {
+            auto lock = std::scoped_lock{mutex_};
+            flush_requested_ = true;
+        }
+        wake_.notify_one();
+    }
+
+    [[nodiscard]] auto n_dropped() const -> std::uint64_t {
+        auto lock = std::scoped_lock{mutex_};
+        return n_dropped_;
+    }
+
+   private:
+    ros::Publisher publisher_;
+    std::chrono::steady_clock::duration period_;
+    std::size_t capacity_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    // guarded by mutex_
+    visualization_msgs::MarkerArray pending_{};
+    // the index in pending_ of the markers by the hash of their namespace and id
+    std::unordered_map<std::uint64_t, std::size_t> index_{};
+    bool flush_requested_ = false;
+    bool stopping_ = false;
+    std::uint64_t n_dropped_ = 0;
+    // only touched by the thread
+    visualization_msgs::MarkerArray publishing_{};
+    std::thread thread_;
+
+    auto add_(visualization_msgs::Marker marker) -> void {
+        const auto key = std::hash<std::string>{}(marker.ns) * 31 +
+                         static_cast<std::uint64_t>(static_cast<std::uint32_t>(marker.id));
+        if (const auto it = index_.find(key); it != index_.end()) {
+            auto& existing = pending_.markers[it->second];
+            // unless the hashes of two namespaces collide
+            if (existing.id == marker.id && existing.ns == marker.ns) {
+                existing = std::move(marker);
+                return;
+            }
+        }
+        if (pending_.markers.size() >= capacity_) {
+            ++n_dropped_;
+            return;
+        }
+        index_[key] = pending_.markers.size();
+        pending_.markers.push_back(std::move(marker));
+    }
+
+    auto run_() -> void {
+        auto next_flush = std::chrono::steady_clock::now() + period_;
+        auto lock = std::unique_lock{mutex_};
+        while (true) {
+            wake_.wait_until(lock, next_flush, [&] { return flush_requested_ || stopping_; });
+            const auto stop = stopping_;
+            flush_requested_ = false;
+            std::swap(pending_, publishing_);
+            index_.clear();
+            lock.unlock();
+
+            if (! publishing_.markers.empty()) {
+                publisher_.publish(publishing_);
+                publishing_.markers.clear();
+            }
+            if (stop) {
+                return;
+            }
+            next_flush = std::chrono::steady_clock::now() + period_;
+            lock.lock();
+        }
+    }
+};
+
 }  // namespace uoe::utils::rviz
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
 namespace uoe::utils::segmentation {
 constexpr auto BACKGROUND = 0;
 constexpr auto GATE = 0;
@@ -18,4 +23,42 @@ TRUCK = margin*4
 BRIDGE = margin*5
 PLANE = margin*6
 */
+
+/**
+ * @brief calls f(begin, end) for every run [begin, end) of pixels that are not background, in
+ * order, of the first n_pixels of mask, a class per pixel.
+ */
+template <typename F>
+auto for_each_foreground_run(const std::vector<std::uint8_t>& mask, std::size_t n_pixels, F&& f)
+    -> void {
+    const auto is_background = [](std::uint8_t c) { return c == BACKGROUND; };
+    const auto end = mask.begin() + std::min(n_pixels, mask.size());
+    for (auto it = std::find_if_not(mask.begin(), end, is_background); it != end;
+         it = std::find_if_not(it, end, is_background)) {
+        const auto first = it;
+        it = std::find_if(first, end, is_background);
+        f(static_cast<std::size_t>(first - mask.begin()),
+          static_cast<std::size_t>(it - mask.begin()));
+    }
+}
+
+/**
+ * @brief as for_each_foreground_run(mask, n_pixels, f), of a run length encoded mask, whose runs of
+ * run_lengths[i] pixels are of class run_classes[i]. Only the runs are visited, not the pixels.
+ */
+template <typename F>
+auto for_each_foreground_run(const std::vector<std::uint32_t>& run_lengths,
+                             const std::vector<std::uint8_t>& run_classes, std::size_t n_pixels,
+                             F&& f) -> void {
+    const auto n_runs = std::min(run_lengths.size(), run_classes.size());
+    auto begin = std::size_t{0};
+    for (std::size_t i = 0; i < n_runs && begin < n_pixels; ++i) {
+        const auto end = std::min(n_pixels, begin + run_lengths[i]);
+        if (run_classes[i] != BACKGROUND) {
+            f(begin, end);
+        }
+        begin = end;
+    }
+}
+
 }  // namespace uoe::utils::segmentation
\ No newline at end of file
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "uoe/utils/concurrency.hpp"
+
+// timers and counters for the hot paths of the planner. They are always compiled, and cost a
+// load of a flag when tracing is disabled, which it is by default, so a per stage breakdown of
+// any build is a call to enable() away.
+// EXAMPLE
+// uoe::utils::trace::enable();
+// {
+//     const auto timer = uoe::utils::trace::scoped_timer(uoe::utils::trace::stage::raycast);
+//     ...
+// }
+// uoe::utils::trace::write_chrome_trace(std::ofstream("trace.json"));
+namespace uoe::utils::trace {
+
+enum class stage : std::uint8_t {
+    grow,
+    nearest_neighbor,
+    collision_check,
+    kdtree_insert,
+    raycast,
+    gain_of_fov,
+    spline_fit,
+};
+
+constexpr std::size_t N_STAGES = 7;
+constexpr auto STAGE_NAMES = std::array<const char*, N_STAGES>{
+    "grow", "nearest_neighbor", "collision_check", "kdtree_insert", "raycast", "gain_of_fov",
+    "spline_fit"};
+
+[[nodiscard]] constexpr auto name_of(stage s) -> const char* {
+    return STAGE_NAMES[static_cast<std::size_t>(s)];
+}
+
+struct event {
+    std::int64_t start_ns;  // since the first use of the clock, in the whole process
+    std::int64_t duration_ns;
+    stage s;
+};
+
+struct stage_summary {
+    std::uint64_t calls = 0;  // number of timed calls
+    std::uint64_t total_ns = 0;
+    std::uint64_t max_ns = 0;
+    std::uint64_t count = 0;  // sum of count(), e.g. nodes visited, independent of the timers
+};
+
+inline std::atomic<bool> enabled_{false};
+
+inline auto enable(bool on = true) -> void { enabled_.store(on, std::memory_order_relaxed); }
+inline auto disable() -> void { enable(false); }
+[[nodiscard]] inline auto enabled() -> bool { return enabled_.load(std::memory_order_relaxed); }
+
+[[nodiscard]] inline auto now_ns() -> std::int64_t {
+    using clock = std::chrono::steady_clock;
+    static const auto epoch = clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - epoch).count();
+}
+
+/**
+ * @brief the events and aggregates of a single thread. Only the owning thread writes to it, and
+ * any thread can read it while it does, without a lock: the aggregates are relaxed atomics, and
+ * every slot of the ring of the latest events is a SeqLock. Once the ring is full, the oldest
+ * events are overwritten, so memory use is bounded however long a process traces for, as
+ * the buffer of a thread that exits is reused by the next thread to trace, see
+ * detail::buffer_owner.
+ */
+class thread_buffer final {
+   public:
+    static constexpr std::size_t CAPACITY = 1 << 14;
+
+    explicit thread_buffer(std::uint32_t thread_id)
+        : thread_id_{thread_id},
+          ring_{std::make_unique<std::array<concurrency::SeqLock<event>, CAPACITY>>()} {}
+
+    auto record(stage s, std::int64_t start_ns, std::int64_t duration_ns) -> void {
+        auto& st = stats_[static_cast<std::size_t>(s)];
+        const auto d = static_cast<std::uint64_t>(duration_ns);
+        // single writer, so a load and a store is enough, and cheaper than a read-modify-write
+        st.calls.store(st.calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        st.total_ns.store(st.total_ns.load(std::memory_order_relaxed) + d,
+                          std::memory_order_relaxed);
+        if (d > st.max_ns.load(std::memory_order_relaxed)) {
+            st.max_ns.store(d, std::memory_order_relaxed);
+        }
+        const auto head = head_.load(std::memory_order_relaxed);
+        (*ring_)[head % CAPACITY].store(event{start_ns, duration_ns, s});
+        head_.store(head + 1, std::memory_order_release);
+    }
+
+    auto count(stage s, std::uint64_t n) -> void {
+        auto& c = stats_[static_cast<std::size_t>(s)].count;
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] auto thread_id() const -> std::uint32_t { return thread_id_; }
+
+    [[nodiscard]] auto summary(stage s) const -> stage_summary {
+        const auto& st = stats_[static_cast<std::size_t>(s)];
+        return {st.calls.load(std::memory_order_relaxed),
+                st.total_ns.load(std::memory_order_relaxed),
+                st.max_ns.load(std::memory_order_relaxed),
+                st.count.load(std::memory_order_relaxed)};
+    }
+
+    /**
+     * @brief the events still in the ring, oldest first. Events recorded while copying may
+     * replace some of the oldest ones.
+     */
+    [[nodiscard]] auto events() const -> std::vector<event> {
+        const auto head = head_.load(std::memory_order_acquire);
+        const auto first = head > CAPACITY ? head - CAPACITY : 0;
+        auto out = std::vector<event>();
+        out.reserve(head - first);
+        for (auto i = first; i < head; ++i) {
+            out.push_back((*ring_)[i % CAPACITY].load());
+        }
+        return out;
+    }
+
+   private:
+    struct stage_stats_ {
+        std::atomic<std::uint64_t> calls{0};
+        std::atomic<std::uint64_t> total_ns{0};
+        std::atomic<std::uint64_t> max_ns{0};
+        std::atomic<std::uint64_t> count{0};
+    };
+
+    std::uint32_t thread_id_;
+    std::array<stage_stats_, N_STAGES> stats_{};
+    std::unique_ptr<std::array<concurrency::SeqLock<event>, CAPACITY>> ring_;
+    std::atomic<std::uint64_t> head_{0};
+};
+
+namespace detail {
+
+struct registry {
+    std::mutex mutex;
+    // every buffer ever handed out, owned or not, in the order they were created
+    std::vector<std::shared_ptr<thread_buffer>> buffers;
+    // the buffers of threads that have exited, handed to the next threads that trace, so a
+    // process that starts short lived threads, e.g. a WorkerPool per request, does not grow a
+    // buffer per thread
+    std::vector<std::shared_ptr<thread_buffer>> free;
+};
+
+inline auto global_registry() -> registry& {
+    static auto r = registry{};
+    return r;
+}
+
+/**
+ * @brief the buffer of a thread, taken from the free list of the registry, or created and
+ * registered if it is empty, and handed back when the thread exits. The registry keeps it, so
+ * the events of the thread can still be exported, until the next thread to trace reuses it and
+ * eventually overwrites them. The thread id of a buffer is then shared by threads that never
+ * ran at the same time.
+ */
+class buffer_owner final {
+   public:
+    buffer_owner() : registry_{global_registry()} {
+        const auto lock = std::scoped_lock(registry_.mutex);
+        if (registry_.free.empty()) {
+            buffer_ = std::make_shared<thread_buffer>(
+                static_cast<std::uint32_t>(registry_.buffers.size()));
+            registry_.buffers.push_back(buffer_);
+        } else {
+            buffer_ = std::move(registry_.free.back());
+            registry_.free.pop_back();
+        }
+    }
+    buffer_owner(const buffer_owner&) = delete;
+    auto operator=(const buffer_owner&) -> buffer_owner& = delete;
+    ~buffer_owner() {
+        const auto lock = std::scoped_lock(registry_.mutex);
+        registry_.free.push_back(std::move(buffer_));
+    }
+
+    [[nodiscard]] auto buffer() const -> thread_buffer& { return *buffer_; }
+
+   private:
+    // the registry is a function local static constructed before the first owner, so it is
+    // destroyed after the owner of every thread, including the main thread
+    registry& registry_;
+    std::shared_ptr<thread_buffer> buffer_;
+};
+
+/**
+ * @brief the buffer of the calling thread, taken on first use, see buffer_owner
+ */
+inline auto local_buffer() -> thread_buffer& {
+    thread_local const auto owner = buffer_owner{};
+    return owner.buffer();
+}
+
+inline auto buffers() -> std::vector<std::shared_ptr<const thread_buffer>> {
+    auto& r = global_registry();
+    const auto lock = std::scoped_lock(r.mutex);
+    return {r.buffers.begin(), r.buffers.end()};
+}
+
+/**
+ * @brief number of buffers created so far, i.e. the most threads that have traced at once
+ */
+inline auto n_buffers() -> std::size_t {
+    auto& r = global_registry();
+    const auto lock = std::scoped_lock(r.mutex);
+    return r.buffers.size();
+}
+
+}  // namespace detail
+
+/**
+ * @brief records the time from construction to destruction as an event of `s`, if tracing was
+ * enabled at construction.
+ */
+class scoped_timer final {
+   public:
+    explicit scoped_timer(stage s) : stage_{s}, start_ns_{enabled() ? now_ns() : -1} {}
+    scoped_timer(const scoped_timer&) = delete;
+    auto operator=(const scoped_timer&) -> scoped_timer& = delete;
+    ~scoped_timer() {
+        if (start_ns_ >= 0) {
+            detail::local_buffer().record(stage_, start_ns_, now_ns() - start_ns_);
+        }
+    }
+
+   private:
+    stage stage_;
+    std::int64_t start_ns_;
+};
+
+inline auto count(stage s, std::uint64_t n = 1) -> void {
+    if (enabled()) {
+        detail::local_buffer().count(s, n);
+    }
+}
+
+/**
+ * @brief aggregates of every stage, over all threads that have traced so far
+ */
+[[nodiscard]] inline auto summary() -> std::array<stage_summary, N_STAGES> {
+    auto out = std::array<stage_summary, N_STAGES>{};
+    for (const auto& b : detail::buffers()) {
+        for (std::size_t i = 0; i < N_STAGES; ++i) {
+            const auto s = b->summary(static_cast<stage>(i));
+            out[i].calls += s.calls;
+            out[i].total_ns += s.total_ns;
+            out[i].max_ns = std::max(out[i].max_ns, s.max_ns);
+            out[i].count += s.count;
+        }
+    }
+    return out;
+}
+
+/**
+ * @brief calls f(thread_id, event) for the events still in the rings, thread by thread
+ */
+template <typename F>
+auto for_each_event(F f) -> void {
+    for (const auto& b : detail::buffers()) {
+        for (const auto& e : b->events()) {
+            f(b->thread_id(), e);
+        }
+    }
+}
+
+/**
+ * @brief writes the events still in the rings in the Chrome trace event format, which
+ * chrome://tracing and Perfetto open, with a track per thread.
+ */
+inline auto write_chrome_trace(std::ostream& os) -> void {
+    os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    auto first = true;
+    os << std::fixed << std::setprecision(3);
+    for_each_event([&](std::uint32_t tid, const event& e) {
+        os << (first ? "\n" : ",\n") << "{\"name\":\"" << name_of(e.s)
+           << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid << ",\"ts\":" << e.start_ns / 1e3
+           << ",\"dur\":" << e.duration_ns / 1e3 << '}';
+        first = false;
+    });
+    os << "\n]}\n";
+}
+
+inline auto write_chrome_trace(std::ostream&& os) -> void { write_chrome_trace(os); }
+
+}  // namespace uoe::utils::trace
@@ -5,8 +5,13 @@
 #include <tf2_eigen/tf2_eigen.h>
 #include <tf2_ros/transform_listener.h>
 
+#include <array>
+#include <cstddef>
 #include <eigen3/Eigen/Dense>
+#include <mutex>
 #include <optional>
+#include <string>
+#include <vector>
 
 namespace uoe::utils::transform {
 
@@ -18,12 +23,41 @@ class TransformListener {
     auto lookup_tf(const std::string& to_frame, const std::string& from_frame,
                    ros::Time time = ros::Time(0)) -> std::optional<geometry_msgs::TransformStamped>;
 
+    /**
+     * @brief the transform from from_frame to to_frame at time, as an Eigen isometry. Transforms
+     * at a given time do not change once they are available, so the most recent lookups with a
+     * time other than ros::Time(0) are cached, and looking up the same frames at the same time
+     * again, e.g. for each point cloud and FoV of a camera frame, does not query the TF buffer.
+     */
+    auto lookup_isometry(const std::string& to_frame, const std::string& from_frame,
+                         ros::Time time = ros::Time(0)) -> std::optional<Eigen::Isometry3f>;
+
     auto transform_vec3(const std::string& to_frame, const std::string& from_frame,
                         const Eigen::Vector3f& vec3, ros::Time time = ros::Time(0))
         -> std::optional<Eigen::Vector3f>;
 
+    /**
+     * @brief transform points from from_frame to to_frame in place, with a single lookup of the
+     * transform, applied to all of them in one matrix product.
+     * @return false if the transform is not available, points are then left as they are.
+     */
+    auto transform_points(const std::string& to_frame, const std::string& from_frame,
+                          std::vector<Eigen::Vector3f>& points, ros::Time time = ros::Time(0))
+        -> bool;
+
    private:
     tf2_ros::Buffer buffer = {};
     tf2_ros::TransformListener listener = {buffer};
+
+    struct cached_tf_ {
+        std::string to_frame, from_frame;
+        ros::Time time;
+        Eigen::Isometry3f tf = Eigen::Isometry3f::Identity();
+    };
+    static constexpr std::size_t CACHE_SIZE = 16;
+    // the lookups of several threads are cached together, the oldest entry is replaced first
+    std::mutex cache_mutex_;
+    std::array<cached_tf_, CACHE_SIZE> cache_{};
+    std::size_t cache_next_ = 0;
 };
 }  // namespace uoe::utils::transform
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "uoe/common_types.hpp"
+#include "uoe/fov.hpp"
+#include "uoe/voxelstatus.hpp"
+
+namespace uoe {
+
+/**
+ * @brief spherical depth buffer centered at the origin of a FoV.
+ *
+ * The angular window spanned by the FoV is divided into bins of (azimuth, elevation), measured
+ * in a frame looking along fov.direction(). Every voxel that blocks line of sight (occupied or
+ * unknown) is splatted into the bins covered by its angular footprint, and each bin keeps the
+ * distance to the nearest blocking voxel. Once all blockers are inserted, the visibility of a
+ * voxel is a single lookup, instead of a raycast through the octree.
+ *
+ * This mirrors what Octomap::raycast from the FoV origin reports: a voxel is visible if no
+ * occupied or unknown voxel lies in front of it.
+ */
+class VisibilityMap final {
+   public:
+    // CONSTRUCTORS
+    // ---------------------------------------------------------------------------------------------
+
+    /**
+     * @param angular_resolution size of a bin in radians. A value <= 0 picks the angle a voxel of
+     * size voxel_resolution subtends at the far plane of the FoV, so bins are never larger than
+     * a voxel inside the depth range.
+     */
+    VisibilityMap(const types::FoV& fov, double voxel_resolution, double angular_resolution = 0.0)
+        : origin_{fov.pose().position} {
+        using types::vec3;
+        forward_ = fov.direction().normalized();
+        const vec3 up_hint = std::abs(forward_.z()) < 0.99f ? vec3::UnitZ() : vec3::UnitX();
+        left_ = up_hint.cross(forward_).normalized();
+        up_ = forward_.cross(left_);
+
+        resolution_ = angular_resolution > 0.0
+                          ? angular_resolution
+                          : std::atan2(voxel_resolution, fov.depth_range().max);
+
+        // the window is the angular extent of the frustum edges, padded by one bin on each side
+        auto azimuth_half = 0.0;
+        auto elevation_half = 0.0;
+        for (const auto& v : fov.bounding_direction_vectors()) {
+            const auto [az, el] = angles_(v);
+            azimuth_half = std::max(azimuth_half, std::abs(az));
+            elevation_half = std::max(elevation_half, std::abs(el));
+        }
+        // keep the buffer bounded, at the cost of coarser bins for very wide or fine setups
+        const auto widest = std::max(azimuth_half, elevation_half);
+        resolution_ =
+            std::max(resolution_, 2 * widest / static_cast<double>(MAX_BINS_PER_AXIS - 3));
+
+        azimuth_min_ = -azimuth_half - resolution_;
+        elevation_min_ = -elevation_half - resolution_;
+        const auto bins = [&](double half) {
+            return static_cast<std::size_t>(std::ceil(2 * half / resolution_)) + 3;
+        };
+        n_azimuth_ = bins(azimuth_half);
+        n_elevation_ = bins(elevation_half);
+
+        depth_.assign(n_azimuth_ * n_elevation_, std::numeric_limits<float>::max());
+        status_.assign(n_azimuth_ * n_elevation_, VoxelStatus::Free);
+    }
+
+    // PUBLIC INTERFACE
+    // ---------------------------------------------------------------------------------------------
+
+    /**
+     * @brief insert a voxel that blocks line of sight. All occluders should be inserted before
+     * first_hit() is called.
+     */
+    auto insert_occluder(const types::vec3& center, double size, VoxelStatus status) -> void {
+        const types::vec3 d = center - origin_;
+        const double r = d.norm();
+        const double half_size = size / 2.0;
+        // like the raycast, the voxel containing the origin does not occlude anything
+        if (r <= half_size * std::sqrt(3.0)) {
+            return;
+        }
+
+        const auto [az, el] = angles_(d);
+        const double half_width = std::atan2(half_size, r);
+        const auto [az_lo, az_hi] = bin_range_(az, half_width, azimuth_min_, n_azimuth_);
+        const auto [el_lo, el_hi] = bin_range_(el, half_width, elevation_min_, n_elevation_);
+        const auto near = static_cast<float>(r - half_size);
+
+        for (auto i = az_lo; i < az_hi; ++i) {
+            for (auto j = el_lo; j < el_hi; ++j) {
+                const auto idx = i * n_elevation_ + j;
+                if (near < depth_[idx]) {
+                    depth_[idx] = near;
+                    status_[idx] = status;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief status of the first voxel seen when looking from the origin towards the voxel at
+     * center. VoxelStatus::Free means nothing is in front of it, i.e. the voxel is visible.
+     */
+    [[nodiscard]] auto first_hit(const types::vec3& center, double size) const -> VoxelStatus {
+        const types::vec3 d = center - origin_;
+        const auto [az, el] = angles_(d);
+        const auto i = bin_(az, azimuth_min_, n_azimuth_);
+        const auto j = bin_(el, elevation_min_, n_elevation_);
+        if (i >= n_azimuth_ || j >= n_elevation_) {
+            return VoxelStatus::Free;
+        }
+
+        const auto idx = i * n_elevation_ + j;
+        const auto near = static_cast<float>(d.norm() - size / 2.0);
+        return near <= depth_[idx] + DEPTH_TOLERANCE ? VoxelStatus::Free : status_[idx];
+    }
+
+    [[nodiscard]] auto visible(const types::vec3& center, double size) const -> bool {
+        return first_hit(center, size) == VoxelStatus::Free;
+    }
+
+    [[nodiscard]] auto angular_resolution() const -> double { return resolution_; }
+    [[nodiscard]] auto shape() const -> std::pair<std::size_t, std::size_t> {
+        return {n_azimuth_, n_elevation_};
+    }
+
+   private:
+    static constexpr std::size_t MAX_BINS_PER_AXIS = 1024;
+    static constexpr float DEPTH_TOLERANCE = 1e-3f;
+
+    types::vec3 origin_;
+    types::vec3 forward_, left_, up_;
+    double resolution_ = 0.0;
+    double azimuth_min_ = 0.0, elevation_min_ = 0.0;
+    std::size_t n_azimuth_ = 0, n_elevation_ = 0;
+    std::vector<float> depth_;
+    std::vector<VoxelStatus> status_;
+
+    // PRIVATE METHODS
+    // ---------------------------------------------------------------------------------------------
+    [[nodiscard]] auto angles_(const types::vec3& d) const -> std::pair<double, double> {
+        const double x = d.dot(forward_);
+        const double y = d.dot(left_);
+        const double z = d.dot(up_);
+        return {std::atan2(y, x), std::atan2(z, std::hypot(x, y))};
+    }
+
+    /**
+     * @brief index of the bin containing angle, or n if it is outside the window
+     */
+    [[nodiscard]] auto bin_(double angle, double min, std::size_t n) const -> std::size_t {
+        const auto b = std::floor((angle - min) / resolution_);
+        return b < 0 || b >= static_cast<double>(n) ? n : static_cast<std::size_t>(b);
+    }
+
+    /**
+     * @brief half open range of bins covered by [angle - half_width, angle + half_width],
+     * clamped to the window. Always contains the bin of angle itself, if it is inside the window.
+     */
+    [[nodiscard]] auto bin_range_(double angle, double half_width, double min, std::size_t n) const
+        -> std::pair<std::size_t, std::size_t> {
+        const auto lo = std::floor((angle - half_width - min) / resolution_);
+        const auto hi = std::floor((angle + half_width - min) / resolution_) + 1;
+        const auto clamp = [n](double b) {
+            return static_cast<std::size_t>(std::clamp(b, 0.0, static_cast<double>(n)));
+        };
+        return {clamp(lo), clamp(hi)};
+    }
+};
+
+}  // namespace uoe
@@ -0,0 +1,330 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <eigen3/Eigen/Dense>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "kdtree/neighbors.hpp"
+
+namespace kdtree {
+
+/**
+ * @brief 3 dimensional kdtree that supports insertion of single points, without having to
+ * rebuild the whole tree.
+ *
+ * Balance is maintained the same way as in a scapegoat tree. When an insertion ends up deeper
+ * than log_{1/alpha}(n), the deepest ancestor on the insertion path whose subtree is not alpha
+ * weight balanced is rebuilt around its median. This gives O(log n) amortized insertion and keeps
+ * the depth of the tree O(log n), so a nearest neighbor query is a single traversal, no matter
+ * how many points have been inserted.
+ *
+ * Nodes are stored contiguously and refer to each other by index, so growing the storage never
+ * invalidates the tree. All queries are const, and keep their state on the stack.
+ */
+template <typename Value>
+class incremental_kdtree3 final {
+   public:
+    using vec3 = Eigen::Vector3f;
+    using distance_type = double;
+    using Point = vec3;
+    using coordinate_type = float;
+    using index_type = std::uint32_t;
+
+    struct NearestNeighborResult {
+        Point point;
+        distance_type distance{};
+        Value value;
+        /**
+         * @brief number of nodes visited to answer the query. Only set by nearest().
+         */
+        std::size_t n_visited{};
+    };
+
+    static constexpr int dimensions = 3;
+
+    /**
+     * @param alpha weight balance factor in the range (0.5, 1). Lower values keep the tree more
+     * balanced, at the cost of more frequent rebuilds.
+     */
+    explicit incremental_kdtree3(double alpha = 0.7) : alpha_{alpha} {
+        if (! (0.5 < alpha && alpha < 1.0)) {
+            throw std::invalid_argument("alpha must be in the range (0.5, 1)");
+        }
+        log_inv_alpha_ = std::log(1.0 / alpha_);
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t { return nodes_.size(); }
+    [[nodiscard]] auto empty() const -> bool { return nodes_.empty(); }
+    /**
+     * @return the number of subtrees rebuilt since construction or the last call to clear()
+     */
+    [[nodiscard]] auto n_rebuilds() const -> std::size_t { return n_rebuilds_; }
+
+    auto reserve(std::size_t n) -> void { nodes_.reserve(n); }
+
+    /**
+     * @brief remove all points. The storage is kept, so refilling the tree does not allocate.
+     */
+    auto clear() -> void {
+        nodes_.clear();
+        root_ = null;
+        n_rebuilds_ = 0;
+    }
+
+    auto insert(const Point& pt, const Value& value) -> void {
+        const auto idx = static_cast<index_type>(nodes_.size());
+        nodes_.push_back(Node{pt, value, null, null, 1, 0});
+
+        if (root_ == null) {
+            root_ = idx;
+            return;
+        }
+
+        // descend to the leaf position of pt, remembering the path for rebalancing.
+        path_.clear();
+        auto current = root_;
+        while (true) {
+            path_.push_back(current);
+            auto& node = nodes_[current];
+            ++node.size;
+            auto& child = pt(node.axis) < node.point(node.axis) ? node.left : node.right;
+            if (child == null) {
+                child = idx;
+                nodes_[idx].axis = static_cast<std::uint8_t>((node.axis + 1) % dimensions);
+                break;
+            }
+            current = child;
+        }
+
+        const auto depth = path_.size();
+        const auto max_depth = std::log(static_cast<double>(nodes_.size())) / log_inv_alpha_;
+        if (static_cast<double>(depth) <= max_depth + 1) {
+            return;
+        }
+
+        // find the deepest ancestor that is not alpha weight balanced (the scapegoat), and
+        // rebuild it.
+        for (auto i = path_.size(); i-- > 0;) {
+            const auto& node = nodes_[path_[i]];
+            const auto max_child = std::max(size_of_(node.left), size_of_(node.right));
+            if (static_cast<double>(max_child) > alpha_ * static_cast<double>(node.size)) {
+                const auto parent = i == 0 ? null : path_[i - 1];
+                rebuild_(path_[i], parent);
+                break;
+            }
+        }
+    }
+
+    /**
+     * Finds the nearest point in the tree to the given point.
+     * @return std::nullopt if the tree is empty.
+     */
+    [[nodiscard]] auto nearest(const Point& pt) const -> std::optional<NearestNeighborResult> {
+        if (root_ == null) {
+            return std::nullopt;
+        }
+
+        auto best = root_;
+        auto best_squared_distance = std::numeric_limits<distance_type>::max();
+        auto n_visited = std::size_t{0};
+        nearest_(root_, pt, best, best_squared_distance, n_visited);
+
+        const auto& node = nodes_[best];
+        return NearestNeighborResult{node.point, std::sqrt(best_squared_distance), node.value,
+                                     n_visited};
+    }
+
+    /**
+     * @brief finds the k nearest points to pt, sorted by ascending distance.
+     * The results are written to out, which is cleared first. Reusing the same buffer between
+     * calls means no allocations once its capacity has reached k.
+     * @return the number of results, min(k, size())
+     */
+    auto k_nearest(const Point& pt, std::size_t k, std::vector<NearestNeighborResult>& out) const
+        -> std::size_t {
+        out.clear();
+        if (root_ == null || k == 0) {
+            return 0;
+        }
+        k_nearest_(root_, pt, k, out);
+        detail::finalize(out, true);
+        return out.size();
+    }
+
+    [[nodiscard]] auto k_nearest(const Point& pt, std::size_t k) const
+        -> std::vector<NearestNeighborResult> {
+        auto out = std::vector<NearestNeighborResult>{};
+        out.reserve(k);
+        k_nearest(pt, k, out);
+        return out;
+    }
+
+    /**
+     * @brief finds all points within radius of pt, sorted by ascending distance.
+     * The results are written to out, which is cleared first.
+     * @return the number of results
+     */
+    auto within_radius(const Point& pt, distance_type radius,
+                       std::vector<NearestNeighborResult>& out) const -> std::size_t {
+        out.clear();
+        if (root_ == null || radius < 0) {
+            return 0;
+        }
+        within_radius_(root_, pt, radius * radius, out);
+        detail::finalize(out, false);
+        return out.size();
+    }
+
+    [[nodiscard]] auto within_radius(const Point& pt, distance_type radius) const
+        -> std::vector<NearestNeighborResult> {
+        auto out = std::vector<NearestNeighborResult>{};
+        within_radius(pt, radius, out);
+        return out;
+    }
+
+   private:
+    static constexpr index_type null = std::numeric_limits<index_type>::max();
+
+    struct Node {
+        Point point;
+        Value value;
+        index_type left, right;
+        index_type size;  // number of nodes in the subtree rooted at this node
+        std::uint8_t axis;
+    };
+
+    double alpha_;
+    double log_inv_alpha_;
+    index_type root_ = null;
+    std::size_t n_rebuilds_ = 0;
+    std::vector<Node> nodes_{};
+    // scratch buffers reused between insertions
+    std::vector<index_type> path_{};
+    std::vector<index_type> subtree_{};
+
+    [[nodiscard]] auto size_of_(index_type idx) const -> index_type {
+        return idx == null ? 0 : nodes_[idx].size;
+    }
+
+    auto rebuild_(index_type subtree_root, index_type parent) -> void {
+        ++n_rebuilds_;
+        const auto axis = nodes_[subtree_root].axis;
+
+        subtree_.clear();
+        collect_(subtree_root);
+        const auto new_root = build_(0, subtree_.size(), axis);
+
+        if (parent == null) {
+            root_ = new_root;
+        } else {
+            auto& p = nodes_[parent];
+            (p.left == subtree_root ? p.left : p.right) = new_root;
+        }
+    }
+
+    auto collect_(index_type idx) -> void {
+        if (idx == null) {
+            return;
+        }
+        subtree_.push_back(idx);
+        collect_(nodes_[idx].left);
+        collect_(nodes_[idx].right);
+    }
+
+    auto build_(std::size_t begin, std::size_t end, std::uint8_t axis) -> index_type {
+        if (end <= begin) {
+            return null;
+        }
+        const auto mid = begin + (end - begin) / 2;
+        const auto first = subtree_.begin();
+        std::nth_element(first + begin, first + mid, first + end,
+                         [&](index_type a, index_type b) {
+                             return nodes_[a].point(axis) < nodes_[b].point(axis);
+                         });
+
+        const auto idx = subtree_[mid];
+        const auto next_axis = static_cast<std::uint8_t>((axis + 1) % dimensions);
+        auto& node = nodes_[idx];
+        node.axis = axis;
+        node.size = static_cast<index_type>(end - begin);
+        // points equal to the median may end up on either side, which is fine as the pruning in
+        // nearest_() only relies on the left side being <= and the right side >= the median.
+        const auto left = build_(begin, mid, next_axis);
+        const auto right = build_(mid + 1, end, next_axis);
+        nodes_[idx].left = left;
+        nodes_[idx].right = right;
+        return idx;
+    }
+
+    auto nearest_(index_type idx, const Point& pt, index_type& best,
+                  distance_type& best_squared_distance, std::size_t& n_visited) const -> void {
+        if (idx == null) {
+            return;
+        }
+        ++n_visited;
+        const auto& node = nodes_[idx];
+        const distance_type d = (node.point - pt).squaredNorm();
+        if (d < best_squared_distance) {
+            best_squared_distance = d;
+            best = idx;
+        }
+        // can not get a better distance
+        if (best_squared_distance == 0) {
+            return;
+        }
+
+        const distance_type dx = node.point(node.axis) - pt(node.axis);
+        const auto near = dx > 0 ? node.left : node.right;
+        const auto far = dx > 0 ? node.right : node.left;
+        nearest_(near, pt, best, best_squared_distance, n_visited);
+        // check hypersphere intersection with the splitting plane
+        if (dx * dx < best_squared_distance) {
+            nearest_(far, pt, best, best_squared_distance, n_visited);
+        }
+    }
+
+    auto k_nearest_(index_type idx, const Point& pt, std::size_t k,
+                    std::vector<NearestNeighborResult>& heap) const -> void {
+        if (idx == null) {
+            return;
+        }
+        const auto& node = nodes_[idx];
+        const distance_type d = (node.point - pt).squaredNorm();
+        if (d < detail::bound(heap, k)) {
+            detail::push_bounded(heap, k, NearestNeighborResult{node.point, d, node.value});
+        }
+
+        const distance_type dx = node.point(node.axis) - pt(node.axis);
+        k_nearest_(dx > 0 ? node.left : node.right, pt, k, heap);
+        if (dx * dx < detail::bound(heap, k)) {
+            k_nearest_(dx > 0 ? node.right : node.left, pt, k, heap);
+        }
+    }
+
+    auto within_radius_(index_type idx, const Point& pt, distance_type squared_radius,
+                        std::vector<NearestNeighborResult>& out) const -> void {
+        if (idx == null) {
+            return;
+        }
+        const auto& node = nodes_[idx];
+        const distance_type d = (node.point - pt).squaredNorm();
+        if (d <= squared_radius) {
+            out.push_back(NearestNeighborResult{node.point, d, node.value});
+        }
+
+        const distance_type dx = node.point(node.axis) - pt(node.axis);
+        within_radius_(dx > 0 ? node.left : node.right, pt, squared_radius, out);
+        if (dx * dx <= squared_radius) {
+            within_radius_(dx > 0 ? node.right : node.left, pt, squared_radius, out);
+        }
+    }
+};  // incremental_kdtree3
+
+}  // namespace kdtree
@@ -1,32 +1,70 @@
 #pragma once
 
 #include <algorithm>
-#include <array>
+#include <cassert>
 #include <cmath>
+#include <cstddef>
+#include <eigen3/Eigen/Dense>
 #include <functional>
-#include <iostream>
+#include <limits>
 #include <optional>
+#include <stdexcept>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
-#include "point.hpp"
+#include "kdtree/metrics.hpp"
+#include "kdtree/neighbors.hpp"
 
 namespace kdtree {
 
 /**
- * C++ k-d tree implementation, based on the C version at rosettacode.org.
+ * @brief a k-d tree over the points of a metric, see metrics.hpp, built once from all its points,
+ * based on the C version at rosettacode.org.
+ *
+ * The dimension and the metric are compile time parameters, so the distance computations are
+ * unrolled for each of them, and a tree over kdtree::euclidean<3> does the same work as a
+ * handwritten 3D tree.
  */
-template <typename coordinate_t, typename value_t, std::size_t dimensions>
-class kdtree {
-    static_assert(std::is_floating_point_v<coordinate_t> || std::is_integral_v<coordinate_t>,
-                  "coordinate_t must be an integer of floating point");
-
+template <typename Value, typename Metric = euclidean<3>>
+class kdtree final {
    public:
-    using point_t = point<coordinate_t, dimensions>;
+    using metric_type = Metric;
+    using Point = typename Metric::point_type;
+    using coordinate_type = typename Point::Scalar;
+    using distance_type = double;
+    static constexpr int dimensions = Metric::dimensions;
+
+    /**
+     * @brief an axis aligned box in the coordinates of the points, boundary included. No
+     * coordinate wraps around, whatever the metric.
+     */
+    struct RangeQuery {
+        RangeQuery(Point min, Point max) : min(std::move(min)), max(std::move(max)) {}
+        template <int D = dimensions, typename = std::enable_if_t<D == 3>>
+        RangeQuery(float x_min, float y_min, float z_min, float x_max, float y_max, float z_max)
+            : min{x_min, y_min, z_min}, max{x_max, y_max, z_max} {}
+        Point min, max;
+    };
+
+    struct RangeQueryResult {
+        Point point;
+        Value value;
+    };
+
+    struct NearestNeighborResult {
+        Point point;
+        distance_type distance{};
+        Value value;
+        /**
+         * @brief number of nodes visited to answer the query. Only set by nearest().
+         */
+        std::size_t n_visited{};
+    };
 
     kdtree(const kdtree&) = delete;             // remove copy constructor
     kdtree& operator=(const kdtree&) = delete;  // remove copy assignment operator
+
     /**
      * Constructor taking a pair of iterators. Adds each
      * point in the range [begin, end) to the tree.
@@ -47,88 +85,183 @@ class kdtree {
      * @param f function that returns a point
      * @param n number of points to add
      */
-    using fn = std::function<std::pair<point_t, value_t>()>;
-    kdtree(fn&& f, int n) {
-        if (n < 0) {
-            throw std::invalid_argument("n must be positive");
-        }
-
+    using fn = std::function<std::pair<Point, Value>()>;
+    kdtree(fn&& f, std::size_t n) {
         nodes_.reserve(n);
-        for (size_t i = 0; i < n; ++i) {
+        for (std::size_t i = 0; i < n; ++i) {
             const auto&& [point, value] = f();
             nodes_.emplace_back(point, value);
         }
         root_ = make_tree_(0, nodes_.size(), 0);
     }
 
-    [[nodiscard]] auto size() const -> std::size_t { return nodes_.size(); }
-    [[nodiscard]] auto empty() const -> bool { return nodes_.empty(); }
+    [[nodiscard]] auto size() const { return nodes_.size(); }
+    [[nodiscard]] auto empty() const { return nodes_.empty(); }
 
     /**
-     * @return size_t the number of nodes visited by the last call to @ref
-     * nearest().
+     * Finds the nearest point in the tree to the given point.
+     * The traversal state lives on the stack, so the tree can be queried from multiple threads
+     * at once, as long as nobody modifies it.
+     *
+     * @param pt a point
+     * @return the nearest point in the tree to the given point, and the distance to it.
+     * std::nullopt if the tree is empty.
      */
-    [[nodiscard]] auto n_visited() const -> std::size_t { return n_visited_; }
+    [[nodiscard]] auto nearest(const Point& pt) const -> std::optional<NearestNeighborResult> {
+        if (root_ == nullptr) {
+            return {};
+        }
+        auto search = nearest_search{};
+        nearest_(root_, pt, 0, search);
+        const auto& best = *search.best;
+        return NearestNeighborResult{best.point_, std::sqrt(search.best_squared_distance),
+                                     best.value_, search.n_visited};
+    }
 
     /**
-     * @brief distance between the input point and return value
-     * from the last call to nearest().
+     * @brief finds the k nearest points to pt, sorted by ascending distance.
+     * The results are written to out, which is cleared first. Reusing the same buffer between
+     * calls means no allocations once its capacity has reached k.
+     * @return the number of results, min(k, size())
      */
-    [[nodiscard]] auto distance() const -> float { return std::sqrt(best_distance_); }
+    auto k_nearest(const Point& pt, std::size_t k, std::vector<NearestNeighborResult>& out) const
+        -> std::size_t {
+        out.clear();
+        if (root_ == nullptr || k == 0) {
+            return 0;
+        }
+        k_nearest_(root_, pt, 0, k, out);
+        detail::finalize(out, true);
+        return out.size();
+    }
 
-    // auto nearest(const point_t& pt) -> std::optional<std::pair<point_t, value_t>>;
+    [[nodiscard]] auto k_nearest(const Point& pt, std::size_t k) const
+        -> std::vector<NearestNeighborResult> {
+        auto out = std::vector<NearestNeighborResult>{};
+        out.reserve(k);
+        k_nearest(pt, k, out);
+        return out;
+    }
 
     /**
-     * Finds the nearest point in the tree to the given point.
-     * It is not valid to call this function if the tree is empty.
-     *
-     * @param pt a point
-     * @return the nearest point in the tree to the given point
+     * @brief finds all points within radius of pt, sorted by ascending distance.
+     * The results are written to out, which is cleared first.
+     * @return the number of results
      */
-    auto nearest(const point_t& pt) -> std::optional<std::pair<point_t, value_t>> {
-        if (root_ == nullptr) {
+    auto within_radius(const Point& pt, distance_type radius,
+                       std::vector<NearestNeighborResult>& out) const -> std::size_t {
+        out.clear();
+        if (root_ == nullptr || radius < 0) {
+            return 0;
+        }
+        within_radius_(root_, pt, 0, radius * radius, out);
+        detail::finalize(out, false);
+        return out.size();
+    }
+
+    [[nodiscard]] auto within_radius(const Point& pt, distance_type radius) const
+        -> std::vector<NearestNeighborResult> {
+        auto out = std::vector<NearestNeighborResult>{};
+        within_radius(pt, radius, out);
+        return out;
+    }
+
+    /**
+     * @brief performs a range query on the kdtree.
+     * A range query takes an axis aligned bounding box, and visits all points inside it,
+     * boundary included. A subtree is only descended into when the query box overlaps the half
+     * space it covers, so no allocations are made.
+     * @param query the corners of the box, in any order.
+     * @param visit called with the point and value of every point inside the box.
+     */
+    template <typename Visitor>
+    auto range_query(const RangeQuery& query, Visitor&& visit) const -> void {
+        const Point lo = query.min.cwiseMin(query.max);
+        const Point hi = query.min.cwiseMax(query.max);
+        range_query_(root_, lo, hi, 0, visit);
+    }
+
+    /**
+     * @brief performs a range query on the kdtree, appending the results to out, which is cleared
+     * first.
+     * @return the number of results
+     */
+    auto range_query(const RangeQuery& query, std::vector<RangeQueryResult>& out) const
+        -> std::size_t {
+        out.clear();
+        range_query(query, [&out](const Point& pt, const Value& value) {
+            out.push_back(RangeQueryResult{pt, value});
+        });
+        return out.size();
+    }
+
+    /**
+     * @brief performs a range query on the kdtree.
+     * @param query
+     * @return std::optional<std::vector<RangeQueryResult>> std::nullopt if no points are inside
+     * the box.
+     */
+    [[nodiscard]] auto range_query(const RangeQuery& query) const
+        -> std::optional<std::vector<RangeQueryResult>> {
+        auto points_in_range_query = std::vector<RangeQueryResult>{};
+        range_query(query, points_in_range_query);
+        if (points_in_range_query.empty()) {
             return std::nullopt;
         }
-        best_ = nullptr;
-        n_visited_ = 0;
-        best_distance_ = 0;
-        nearest_(root_, pt, 0);
-        return std::make_pair(best_->point_, best_->value_);
+        return points_in_range_query;
     }
-    // auto bft(std::function<void(const point_t& pt, std::size_t depth)> f) -> void {}
 
    private:
-    struct node_t {
-        node_t(const point_t& pt, const value_t& value)
-            : point_(pt), value_(value), left_(nullptr), right_(nullptr) {}
-        coordinate_t get_element_in_dimension(std::size_t index) const {
-            return point_.get_element_in_dimension(index);
-        }
-        auto distance(const point_t& pt) const -> double { return point_.distance(pt); }
-        point_t point_;
-        value_t value_;
-        node_t* left_;
-        node_t* right_;
+    struct Node {
+        Node(Point pt, const Value& value)
+            : point_(std::move(pt)), value_(value), left_(nullptr), right_(nullptr) {}
+
+        [[nodiscard]] auto squared_distance(const Point& pt) const -> distance_type {
+            return Metric::squared_distance(point_, pt);
+        }
+        [[nodiscard]] auto get_element_in_dimension(int index) const -> coordinate_type {
+            assert(0 <= index && index < dimensions);
+            return point_(index);
+        }
+
+        Point point_;
+        Value value_;
+        Node* left_;
+        Node* right_;
     };
 
     struct dimension_comparator {
-        dimension_comparator(std::size_t index) : index_(index) {}
-        bool operator()(const node_t& node1, const node_t& node2) const {
-            return node1.point_.get_element_in_dimension(index_) <
-                   node2.point_.get_element_in_dimension(index_);
+        dimension_comparator(int index) : index_(index) {}
+        bool operator()(const Node& node1, const Node& node2) const {
+            return node1.get_element_in_dimension(index_) < node2.get_element_in_dimension(index_);
         }
-        std::size_t index_;
+        int index_;
     };
 
-    node_t* root_ = nullptr;
-    node_t* best_ = nullptr;
-    double best_distance_ = 0;
-    std::size_t n_visited_ = 0;
-    std::vector<node_t> nodes_{};
+    Node* root_ = nullptr;
+    std::vector<Node> nodes_{};
 
-    // auto make_tree_(std::size_t begin, std::size_t end, std::size_t index) -> node_t*;
+    /**
+     * @brief state of a single call to nearest()
+     */
+    struct nearest_search {
+        const Node* best = nullptr;
+        distance_type best_squared_distance = std::numeric_limits<distance_type>::max();
+        std::size_t n_visited = 0;
+    };
 
-    auto make_tree_(std::size_t begin, std::size_t end, std::size_t index) -> node_t* {
+    /**
+     * @brief squared lower bound of the distance from pt to the points on the other side of the
+     * splitting plane of root.
+     */
+    [[nodiscard]] static auto squared_split_distance_(const Node* root, const Point& pt,
+                                                      std::size_t index) -> distance_type {
+        const distance_type d =
+            Metric::split_distance(pt, root->get_element_in_dimension(index), index);
+        return d * d;
+    }
+
+    auto make_tree_(std::size_t begin, std::size_t end, std::size_t index) -> Node* {
         if (end <= begin) {
             return nullptr;
         }
@@ -141,39 +274,101 @@ class kdtree {
         nodes_[n].right_ = make_tree_(n + 1, end, index);
         return &nodes_[n];
     }
-    // auto nearest_(node_t* root, const point_t& point, std::size_t index) -> void;
 
-    auto nearest_(node_t* root, const point_t& point, std::size_t index) -> void {
+    auto nearest_(const Node* root, const Point& point, std::size_t index,
+                  nearest_search& search) const -> void {
         if (root == nullptr) {
             return;
         }
-        ++n_visited_;
-        const auto distance = root->distance(point);
+        ++search.n_visited;
+        // squared distances, as they are compared against the squared distance to the splitting
+        // plane below.
+        const distance_type distance = root->squared_distance(point);
         // update best candidate if distance is better than the current best.
-        if (best_ == nullptr || distance < best_distance_) {
-            best_distance_ = distance;
-            best_ = root;
+        if (search.best == nullptr || distance < search.best_squared_distance) {
+            search.best_squared_distance = distance;
+            search.best = root;
         }
         // can not get a better distance
-        if (best_distance_ == 0) {
+        if (search.best_squared_distance == 0) {
             return;
         }
         // if dx is positive then point is less than root in this dimension,
         // and we should go left. otherwise right.
-        const auto dx =
-            root->get_element_in_dimension(index) - point.get_element_in_dimension(index);
-        auto less_than = dx > 0;
+        const distance_type dx = root->get_element_in_dimension(index) - point(index);
+        const auto less_than = dx > 0;
         // get next axis
-        index = (index + 1) % dimensions;
-        nearest_(less_than ? root->left_ : root->right_, point, index);
+        const auto next_index = (index + 1) % dimensions;
+        nearest_(less_than ? root->left_ : root->right_, point, next_index, search);
         // check hypersphere intersection
-        if (dx * dx >= best_distance_) {
+        if (squared_split_distance_(root, point, index) >= search.best_squared_distance) {
             // we can ignore the other subtree as the hypersphere does not intersect.
             return;
         }
         // we have to check the other subtree as well
-        nearest_(less_than ? root->right_ : root->left_, point, index);
+        nearest_(less_than ? root->right_ : root->left_, point, next_index, search);
+    }
+
+    auto k_nearest_(const Node* root, const Point& pt, std::size_t index, std::size_t k,
+                    std::vector<NearestNeighborResult>& heap) const -> void {
+        if (root == nullptr) {
+            return;
+        }
+        const distance_type d = root->squared_distance(pt);
+        if (d < detail::bound(heap, k)) {
+            detail::push_bounded(heap, k, NearestNeighborResult{root->point_, d, root->value_});
+        }
+
+        const distance_type dx = root->get_element_in_dimension(index) - pt(index);
+        const auto next_index = (index + 1) % dimensions;
+        k_nearest_(dx > 0 ? root->left_ : root->right_, pt, next_index, k, heap);
+        if (squared_split_distance_(root, pt, index) < detail::bound(heap, k)) {
+            k_nearest_(dx > 0 ? root->right_ : root->left_, pt, next_index, k, heap);
+        }
+    }
+
+    auto within_radius_(const Node* root, const Point& pt, std::size_t index,
+                        distance_type squared_radius, std::vector<NearestNeighborResult>& out) const
+        -> void {
+        if (root == nullptr) {
+            return;
+        }
+        const distance_type d = root->squared_distance(pt);
+        if (d <= squared_radius) {
+            out.push_back(NearestNeighborResult{root->point_, d, root->value_});
+        }
+
+        const distance_type dx = root->get_element_in_dimension(index) - pt(index);
+        const auto next_index = (index + 1) % dimensions;
+        within_radius_(dx > 0 ? root->left_ : root->right_, pt, next_index, squared_radius, out);
+        if (squared_split_distance_(root, pt, index) <= squared_radius) {
+            within_radius_(dx > 0 ? root->right_ : root->left_, pt, next_index, squared_radius,
+                           out);
+        }
+    }
+
+    template <typename Visitor>
+    auto range_query_(const Node* root, const Point& lo, const Point& hi, std::size_t index,
+                      Visitor& visit) const -> void {
+        // https://slides.com/cos226/kd-tree-range-search/fullscreen#/1
+        if (root == nullptr) {
+            return;
+        }
+        const auto& pt = root->point_;
+        if ((lo.array() <= pt.array()).all() && (pt.array() <= hi.array()).all()) {
+            visit(pt, root->value_);
+        }
+
+        // points equal to the median may be on either side, so both sides are inclusive.
+        const auto split = root->get_element_in_dimension(index);
+        const auto next_index = (index + 1) % dimensions;
+        if (lo(index) <= split) {
+            range_query_(root->left_, lo, hi, next_index, visit);
+        }
+        if (split <= hi(index)) {
+            range_query_(root->right_, lo, hi, next_index, visit);
+        }
     }
-};
+};  // kdtree
 
 }  // namespace kdtree
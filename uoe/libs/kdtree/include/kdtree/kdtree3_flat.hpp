@@ -0,0 +1,278 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <eigen3/Eigen/Dense>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "kdtree/neighbors.hpp"
+
+namespace kdtree {
+
+/**
+ * @brief static 3 dimensional kdtree with an implicit layout, and points stored in leaf buckets.
+ *
+ * The tree is complete, so the split planes are stored in breadth first order in a single array,
+ * where the children of node i are 2i + 1 and 2i + 2, and no child pointers are needed. Each leaf
+ * holds up to LeafSize points stored as a structure of arrays, so the squared distance to every
+ * point in a bucket is computed by one loop the compiler vectorizes. Unused slots are padded with
+ * points at infinity, so the loop always runs over the full bucket.
+ *
+ * Compared to kdtree3, which visits one node with one point, and follows a pointer, per level,
+ * a query descends log2(n / LeafSize) levels of contiguous split planes, and then scans a few
+ * buckets.
+ */
+template <typename Value, std::size_t LeafSize = 16>
+class kdtree3_flat final {
+    static_assert(LeafSize > 0, "LeafSize must be greater than 0");
+
+   public:
+    using vec3 = Eigen::Vector3f;
+    using distance_type = double;
+    using Point = vec3;
+    using coordinate_type = float;
+
+    struct NearestNeighborResult {
+        Point point;
+        distance_type distance{};
+        Value value;
+    };
+
+    static constexpr int dimensions = 3;
+    static constexpr std::size_t leaf_size = LeafSize;
+
+    /**
+     * Constructor taking a pair of iterators over std::pair<Point, Value>. Adds each
+     * point in the range [begin, end) to the tree.
+     */
+    template <typename iterator>
+    kdtree3_flat(iterator begin, iterator end) {
+        auto items = std::vector<std::pair<Point, Value>>(begin, end);
+        build_(items);
+    }
+
+    /**
+     * Constructor taking a function object that generates
+     * points. The function object will be called n times
+     * to populate the tree.
+     *
+     * @param f function that returns a point
+     * @param n number of points to add
+     */
+    using fn = std::function<std::pair<Point, Value>()>;
+    kdtree3_flat(fn&& f, std::size_t n) {
+        auto items = std::vector<std::pair<Point, Value>>{};
+        items.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            items.push_back(f());
+        }
+        build_(items);
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t { return size_; }
+    [[nodiscard]] auto empty() const -> bool { return size_ == 0; }
+    [[nodiscard]] auto n_leaves() const -> std::size_t { return leaves_.size(); }
+
+    /**
+     * Finds the nearest point in the tree to the given point.
+     * @return std::nullopt if the tree is empty.
+     */
+    [[nodiscard]] auto nearest(const Point& pt) const -> std::optional<NearestNeighborResult> {
+        if (empty()) {
+            return std::nullopt;
+        }
+        auto best = std::size_t{0};
+        auto best_squared_distance = std::numeric_limits<float>::max();
+        nearest_(0, pt, best, best_squared_distance);
+        return NearestNeighborResult{point_at_(best), std::sqrt(best_squared_distance),
+                                     values_[best]};
+    }
+
+    /**
+     * @brief finds the k nearest points to pt, sorted by ascending distance.
+     * The results are written to out, which is cleared first. Reusing the same buffer between
+     * calls means no allocations once its capacity has reached k.
+     * @return the number of results, min(k, size())
+     */
+    auto k_nearest(const Point& pt, std::size_t k, std::vector<NearestNeighborResult>& out) const
+        -> std::size_t {
+        out.clear();
+        if (empty() || k == 0) {
+            return 0;
+        }
+        k_nearest_(0, pt, k, out);
+        detail::finalize(out, true);
+        return out.size();
+    }
+
+    [[nodiscard]] auto k_nearest(const Point& pt, std::size_t k) const
+        -> std::vector<NearestNeighborResult> {
+        auto out = std::vector<NearestNeighborResult>{};
+        out.reserve(k);
+        k_nearest(pt, k, out);
+        return out;
+    }
+
+   private:
+    struct Split {
+        coordinate_type value;
+        std::uint8_t axis;
+    };
+
+    struct alignas(32) Leaf {
+        std::array<coordinate_type, LeafSize> x, y, z;
+    };
+
+    std::size_t size_ = 0;
+    // internal nodes in breadth first order, there are n_leaves - 1 of them
+    std::vector<Split> splits_{};
+    std::vector<Leaf> leaves_{};
+    // the value of slot i in leaf l is values_[l * LeafSize + i]
+    std::vector<Value> values_{};
+
+    auto build_(std::vector<std::pair<Point, Value>>& items) -> void {
+        size_ = items.size();
+        if (items.empty()) {
+            return;
+        }
+        // the smallest power of two number of leaves, for which no bucket overflows
+        auto n_leaves = std::size_t{1};
+        while (n_leaves * LeafSize < items.size()) {
+            n_leaves *= 2;
+        }
+
+        splits_.resize(n_leaves - 1);
+        constexpr auto inf = std::numeric_limits<coordinate_type>::infinity();
+        auto padding = Leaf{};
+        padding.x.fill(inf);
+        padding.y.fill(inf);
+        padding.z.fill(inf);
+        leaves_.assign(n_leaves, padding);
+        values_.resize(n_leaves * LeafSize, items.front().second);
+
+        build_(items, 0, 0, items.size());
+    }
+
+    auto build_(std::vector<std::pair<Point, Value>>& items, std::size_t node, std::size_t begin,
+                std::size_t end) -> void {
+        const auto first = items.begin();
+        if (node >= splits_.size()) {
+            const auto leaf = node - splits_.size();
+            for (auto i = begin; i < end; ++i) {
+                const auto slot = i - begin;
+                const auto& [p, value] = items[i];
+                leaves_[leaf].x[slot] = p.x();
+                leaves_[leaf].y[slot] = p.y();
+                leaves_[leaf].z[slot] = p.z();
+                values_[leaf * LeafSize + slot] = value;
+            }
+            return;
+        }
+
+        // split along the axis with the largest spread
+        Point lo = Point::Constant(std::numeric_limits<coordinate_type>::max());
+        Point hi = Point::Constant(std::numeric_limits<coordinate_type>::lowest());
+        for (auto i = begin; i < end; ++i) {
+            lo = lo.cwiseMin(items[i].first);
+            hi = hi.cwiseMax(items[i].first);
+        }
+        auto axis = 0;
+        (hi - lo).maxCoeff(&axis);
+
+        const auto mid = begin + (end - begin) / 2;
+        std::nth_element(first + begin, first + mid, first + end,
+                         [axis](const auto& a, const auto& b) {
+                             return a.first(axis) < b.first(axis);
+                         });
+        // an empty range can only occur for tiny trees, where any split works
+        splits_[node] = Split{mid < end ? items[mid].first(axis) : 0.0f,
+                              static_cast<std::uint8_t>(axis)};
+
+        build_(items, 2 * node + 1, begin, mid);
+        build_(items, 2 * node + 2, mid, end);
+    }
+
+    [[nodiscard]] auto point_at_(std::size_t slot) const -> Point {
+        const auto& leaf = leaves_[slot / LeafSize];
+        const auto i = slot % LeafSize;
+        return {leaf.x[i], leaf.y[i], leaf.z[i]};
+    }
+
+    /**
+     * @brief squared distances from pt to every slot of the leaf.
+     */
+    static auto scan_leaf_(const Leaf& leaf, const Point& pt,
+                           std::array<coordinate_type, LeafSize>& squared_distances) -> void {
+        const auto px = pt.x();
+        const auto py = pt.y();
+        const auto pz = pt.z();
+        for (std::size_t i = 0; i < LeafSize; ++i) {
+            const auto dx = leaf.x[i] - px;
+            const auto dy = leaf.y[i] - py;
+            const auto dz = leaf.z[i] - pz;
+            squared_distances[i] = dx * dx + dy * dy + dz * dz;
+        }
+    }
+
+    auto nearest_(std::size_t node, const Point& pt, std::size_t& best,
+                  coordinate_type& best_squared_distance) const -> void {
+        if (node >= splits_.size()) {
+            const auto leaf = node - splits_.size();
+            auto squared_distances = std::array<coordinate_type, LeafSize>{};
+            scan_leaf_(leaves_[leaf], pt, squared_distances);
+            for (std::size_t i = 0; i < LeafSize; ++i) {
+                if (squared_distances[i] < best_squared_distance) {
+                    best_squared_distance = squared_distances[i];
+                    best = leaf * LeafSize + i;
+                }
+            }
+            return;
+        }
+
+        const auto& split = splits_[node];
+        const auto dx = pt(split.axis) - split.value;
+        const auto near = dx < 0 ? 2 * node + 1 : 2 * node + 2;
+        const auto far = dx < 0 ? 2 * node + 2 : 2 * node + 1;
+        nearest_(near, pt, best, best_squared_distance);
+        // check hypersphere intersection with the splitting plane
+        if (dx * dx < best_squared_distance) {
+            nearest_(far, pt, best, best_squared_distance);
+        }
+    }
+
+    auto k_nearest_(std::size_t node, const Point& pt, std::size_t k,
+                    std::vector<NearestNeighborResult>& heap) const -> void {
+        if (node >= splits_.size()) {
+            const auto leaf = node - splits_.size();
+            auto squared_distances = std::array<coordinate_type, LeafSize>{};
+            scan_leaf_(leaves_[leaf], pt, squared_distances);
+            for (std::size_t i = 0; i < LeafSize; ++i) {
+                const distance_type d = squared_distances[i];
+                // padding slots are infinitely far away, and never pass the bound
+                if (d < detail::bound(heap, k) && std::isfinite(d)) {
+                    const auto slot = leaf * LeafSize + i;
+                    detail::push_bounded(heap, k,
+                                         NearestNeighborResult{point_at_(slot), d, values_[slot]});
+                }
+            }
+            return;
+        }
+
+        const auto& split = splits_[node];
+        const distance_type dx = pt(split.axis) - split.value;
+        k_nearest_(dx < 0 ? 2 * node + 1 : 2 * node + 2, pt, k, heap);
+        if (dx * dx < detail::bound(heap, k)) {
+            k_nearest_(dx < 0 ? 2 * node + 2 : 2 * node + 1, pt, k, heap);
+        }
+    }
+};  // kdtree3_flat
+
+}  // namespace kdtree
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <eigen3/Eigen/Core>
+#include <ratio>
+
+namespace kdtree {
+
+// metrics of the points of a kdtree. A metric provides
+//   dimensions        the number of coordinates of a point
+//   point_type        an Eigen vector of that many floats
+//   squared_distance  the squared distance between two points
+//   split_distance    a lower bound of the distance from a point to any point on the other side of
+//                     the plane where coordinate axis equals split, used to prune subtrees
+
+/**
+ * @brief the euclidean distance in D dimensions.
+ */
+template <int D>
+struct euclidean {
+    static constexpr int dimensions = D;
+    using point_type = Eigen::Matrix<float, D, 1>;
+
+    static auto squared_distance(const point_type& a, const point_type& b) -> double {
+        if constexpr (D == 3) {
+            const double dx = a.x() - b.x();
+            const double dy = a.y() - b.y();
+            const double dz = a.z() - b.z();
+            return dx * dx + dy * dy + dz * dz;
+        } else {
+            return (a - b).squaredNorm();
+        }
+    }
+
+    static auto split_distance(const point_type& pt, float split, std::size_t axis) -> double {
+        return std::abs(static_cast<double>(split) - pt(axis));
+    }
+};
+
+/**
+ * @brief the distance between poses (x, y, z, yaw), with the yaw in radians in [-pi, pi]. The
+ * difference in yaw is the smaller angle between the two, wrapped around, weighted by YawWeight,
+ * a std::ratio, in meters per radian.
+ */
+template <typename YawWeight = std::ratio<1>>
+struct pose {
+    static constexpr int dimensions = 4;
+    using point_type = Eigen::Vector4f;
+    static constexpr double yaw_weight = static_cast<double>(YawWeight::num) / YawWeight::den;
+
+    /**
+     * @brief the smaller angle between two yaws in [-pi, pi]
+     */
+    static auto yaw_difference(double a, double b) -> double {
+        const auto d = std::abs(a - b);
+        return d > M_PI ? 2 * M_PI - d : d;
+    }
+
+    static auto squared_distance(const point_type& a, const point_type& b) -> double {
+        const double dx = a.x() - b.x();
+        const double dy = a.y() - b.y();
+        const double dz = a.z() - b.z();
+        const auto dyaw = yaw_weight * yaw_difference(a.w(), b.w());
+        return dx * dx + dy * dy + dz * dz + dyaw * dyaw;
+    }
+
+    static auto split_distance(const point_type& pt, float split, std::size_t axis) -> double {
+        if (axis != 3) {
+            return std::abs(static_cast<double>(split) - pt(axis));
+        }
+        // the other side of the split is reached either directly, or around through -pi = pi
+        const double yaw = pt.w();
+        const double s = split;
+        const auto d = yaw < s ? std::min(s - yaw, yaw + M_PI) : std::min(yaw - s, M_PI - yaw);
+        return yaw_weight * std::max(0.0, d);
+    }
+};
+
+}  // namespace kdtree
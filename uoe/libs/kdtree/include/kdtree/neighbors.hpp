@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace kdtree::detail {
+
+// helpers shared by the k nearest and radius queries of the kdtrees. While a query runs, the
+// distance member of the results holds the squared distance, and the results in the output buffer
+// form a max heap ordered by it, so the farthest of the k best results is always in front.
+
+template <typename Result>
+auto closer(const Result& a, const Result& b) -> bool {
+    return a.distance < b.distance;
+}
+
+/**
+ * @brief the squared distance a candidate has to beat to be added to a heap of at most k results.
+ */
+template <typename Result>
+auto bound(const std::vector<Result>& heap, std::size_t k) -> double {
+    return heap.size() < k ? std::numeric_limits<double>::max() : heap.front().distance;
+}
+
+/**
+ * @brief insert a result into a max heap holding at most k results. Once the heap is full, the
+ * farthest result is replaced, so the buffer never grows beyond k elements.
+ */
+template <typename Result>
+auto push_bounded(std::vector<Result>& heap, std::size_t k, Result&& result) -> void {
+    if (heap.size() < k) {
+        heap.push_back(std::move(result));
+        std::push_heap(heap.begin(), heap.end(), closer<Result>);
+    } else if (result.distance < heap.front().distance) {
+        std::pop_heap(heap.begin(), heap.end(), closer<Result>);
+        heap.back() = std::move(result);
+        std::push_heap(heap.begin(), heap.end(), closer<Result>);
+    }
+}
+
+/**
+ * @brief sort the results by ascending distance, and convert squared distances to distances.
+ */
+template <typename Result>
+auto finalize(std::vector<Result>& results, bool is_heap) -> void {
+    if (is_heap) {
+        std::sort_heap(results.begin(), results.end(), closer<Result>);
+    } else {
+        std::sort(results.begin(), results.end(), closer<Result>);
+    }
+    for (auto& r : results) {
+        r.distance = std::sqrt(r.distance);
+    }
+}
+
+}  // namespace kdtree::detail
@@ -110,8 +110,17 @@ def semantic_segmentation_inference_CB(image_msg):  # Consider nograd
         resp.height = image_msg.image.height
         resp.width = image_msg.image.width
         print("before flattenning")
-        resp.data = torch.flatten(pred).type(
-            torch.uint8).cpu().numpy().tolist()
+        mask = torch.flatten(pred).type(torch.uint8).cpu().numpy()
+        if image_msg.run_length_encoded:
+            # a run starts at the first pixel, and at every pixel whose class differs from the one
+            # before it
+            starts = np.concatenate(
+                ([0], np.flatnonzero(mask[1:] != mask[:-1]) + 1))
+            resp.run_lengths = np.diff(
+                np.append(starts, mask.size)).astype(np.uint32).tolist()
+            resp.run_classes = mask[starts].tolist()
+        else:
+            resp.data = mask.tolist()
         print("after flattenning")
         resp.successful = True
 
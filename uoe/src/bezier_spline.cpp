@@ -1,5 +1,6 @@
 #include "uoe/bezier_spline.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 namespace uoe::trajectory {
@@ -27,20 +28,14 @@ auto BezierSpline::generate_spline(vector<Vector3f> points, int resolution) -> v
     this->offset = points.back();
 
     this->generate_offset_points();
-
-    // std::cerr << "[DEBUG] " << __FILE__ << ":" << __LINE__ << ": "
-    //           << " binomial: " << this->binomial_lut.size() << '\n';
-    // std::cerr << "[DEBUG] " << __FILE__ << ":" << __LINE__ << ": "
-    //           << " binomial: " << points.size() << '\n';
-
-    assert(points.size() == binomial_lut.size());
+    this->generate_weighted_points();
 
     // let t run through [0;resolution] with steps defined by the resolution
+    auto times = vector<float>(this->resolution);
     for (int t_idx = 0; t_idx < this->resolution; t_idx += 1) {
-        auto time = (float)t_idx / (float)resolution;
-        auto spline_point = f(time);
-        this->spline_points.push_back(spline_point);
+        times[t_idx] = (float)t_idx / (float)resolution;
     }
+    this->spline_points = this->evaluate(times);
 
     this->generate_distance_lut();
 }
@@ -78,41 +73,113 @@ auto BezierSpline::generate_spline(vector<Vector3f> points, int resolution) -> v
 
 //--------------------------------------------------------------------------------------------------
 // Returns the point along the spline at time `t`
-// Uses the binomial LUT to perform these calculation fast
-auto BezierSpline::f(float t) -> Vector3f {
-    // sum up all bezier terms, using the explicit definition given by:
-    // https://en.wikipedia.org/wiki/B%C3%A9zier_curve
-    auto spline_point = Vector3f(0, 0, 0);
-    auto half_integer_size = size / 2;
-    auto odd = ! (size % 2 == 0);
-
-    std::vector<int> bin;
+// The polynomial is the sum of the terms w_i * t^i * (1 - t)^(size - i) for i in [0;size],
+// where w_i is the i'th weighted point, see generate_weighted_points.
+// It is evaluated with Horner's method in s = t / (1 - t), because
+//   sum w_i * t^i * (1 - t)^(size - i) = (1 - t)^size * sum w_i * s^i
+// or for t > 0.5 in u = (1 - t) / t, so the ratio never exceeds 1.
+auto BezierSpline::f(float t) -> Vector3f { return evaluate_polynomial(weighted_points, t); }
+
+//--------------------------------------------------------------------------------------------------
+// Returns the derivative of the spline at time `t`
+// Differentiating every term of f and collecting the terms of t^j * (1 - t)^(size - 1 - j) gives
+// a polynomial of the same form, one degree lower, see generate_weighted_points.
+auto BezierSpline::df(float t) -> Vector3f { return evaluate_polynomial(derivative_points, t); }
+
+//--------------------------------------------------------------------------------------------------
+// Returns sum c_i * t^i * (1 - t)^(n - i) for i in [0;n], where c is `coefficients` and n its
+// size minus 1, with Horner's method as described for f
+auto BezierSpline::evaluate_polynomial(const vector<Vector3f>& coefficients, float t) -> Vector3f {
+    const auto n = static_cast<int>(coefficients.size()) - 1;
+    if (t <= 0.5f) {
+        const auto s = t / (1 - t);
+        auto point = coefficients[n];
+        for (int i = n - 1; i >= 0; i--) {
+            point = point * s + coefficients[i];
+        }
+        return point * std::pow(1 - t, n);
+    }
+    const auto u = (1 - t) / t;
+    auto point = coefficients[0];
+    for (int i = 1; i <= n; i++) {
+        point = point * u + coefficients[i];
+    }
+    return point * std::pow(t, n);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Returns f(t) for every t in `ts`
+// Same evaluation as f, but with the loop over the samples innermost, so every step of
+// Horner's method is a multiply add over contiguous arrays, which the compiler can vectorize.
+auto BezierSpline::evaluate(const vector<float>& ts) -> vector<Vector3f> {
+    const auto n = ts.size();
+    auto ratio = vector<float>(n);
+    auto x = vector<float>(n);
+    auto y = vector<float>(n);
+    auto z = vector<float>(n);
+    // samples in the second half of the spline traverse the weighted points in reverse
+    const auto first_half = [&](std::size_t j) { return ts[j] <= 0.5f; };
+    for (std::size_t j = 0; j < n; j++) {
+        const auto t = ts[j];
+        ratio[j] = first_half(j) ? t / (1 - t) : (1 - t) / t;
+        const auto& w = first_half(j) ? weighted_points[size] : weighted_points[0];
+        x[j] = w.x();
+        y[j] = w.y();
+        z[j] = w.z();
+    }
+    for (int k = 1; k <= size; k++) {
+        const auto& lower = weighted_points[size - k];
+        const auto& upper = weighted_points[k];
+        for (std::size_t j = 0; j < n; j++) {
+            const auto& w = first_half(j) ? lower : upper;
+            x[j] = x[j] * ratio[j] + w.x();
+            y[j] = y[j] * ratio[j] + w.y();
+            z[j] = z[j] * ratio[j] + w.z();
+        }
+    }
+    auto points = vector<Vector3f>(n);
+    for (std::size_t j = 0; j < n; j++) {
+        const auto t = ts[j];
+        const auto scale = std::pow(first_half(j) ? 1 - t : t, size);
+        points[j] = Vector3f(x[j], y[j], z[j]) * scale;
+    }
+    return points;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Multiplies every offset point with its binomial weight, once per spline, so evaluating the
+// spline does not have to. The weights are the binomial coefficients of `size`, mirrored around
+// the middle point. The last term, of the point at t = 1, has no offset point, as the offset
+// points are relative to the last input point.
+auto BezierSpline::generate_weighted_points() -> void {
+    const auto half_integer_size = size / 2;
+    const auto odd = ! (size % 2 == 0);
+
+    auto bin = std::vector<int>{};
     for (int i = 0; i < half_integer_size; i++) {
-        bin.push_back(binomial_lut[i + (size * binomial_coefficient_amount)]);
+        bin.push_back(uoe::utils::binomial_coefficient(size, i));
     }
     if (odd) {
-        bin.push_back(binomial_lut[half_integer_size + (size * binomial_coefficient_amount)]);
+        bin.push_back(uoe::utils::binomial_coefficient(size, half_integer_size));
     }
     for (int i = 0; i < half_integer_size; i++) {
-        bin.push_back(
-            binomial_lut[half_integer_size - 1 - i + (size * binomial_coefficient_amount)]);
+        bin.push_back(uoe::utils::binomial_coefficient(size, half_integer_size - 1 - i));
     }
-    // std::cout << bin.size() << std::endl;
-    // for (auto& b : bin) {
-    //     std::cout << b << "\t";
-    // }
-    // std::cout << std::endl;
-
-    // for (auto& bc : binomial_lut) {
-    //     std::cout << bc << " ";
-    // }
-    // std::cout << std::endl;
 
+    this->weighted_points = vector<Vector3f>();
     for (int i = 0; i < size; i++) {
-        auto w = bin[i] * pow(t, i) * pow(1 - t, size - i);
-        spline_point += w * offset_input_points[i];
+        this->weighted_points.emplace_back(static_cast<float>(bin[i]) * offset_input_points[i]);
+    }
+    this->weighted_points.emplace_back(Vector3f(0, 0, 0));
+
+    // d/dt w_i * t^i * (1 - t)^(size - i)
+    //   = i * w_i * t^(i - 1) * (1 - t)^(size - i)
+    //     - (size - i) * w_i * t^i * (1 - t)^(size - 1 - i)
+    this->derivative_points = vector<Vector3f>();
+    for (int j = 0; j < size; j++) {
+        this->derivative_points.emplace_back(static_cast<float>(j + 1) * weighted_points[j + 1] -
+                                             static_cast<float>(size - j) * weighted_points[j]);
     }
-    return spline_point;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -128,30 +195,19 @@ auto BezierSpline::generate_offset_points() -> void {
 }
 
 //--------------------------------------------------------------------------------------------------
-// Approximates the arc length of the spline from the sum of euclidean distances
-// between all the calculated points along the spline
+// Computes the arc length of the spline at every time step, by integrating the speed |f'(t)|
+// between consecutive time steps with Gauss-Legendre quadrature
 auto BezierSpline::generate_distance_lut() -> void {
-    // assume that all the points have been generated
-    assert(this->spline_points.size() == this->resolution);
-    // Approximate the arc length of the spline
-    auto arc_length_sum = 0.f;
+    this->distance_lut = vector<float>();
+    this->distance_lut.reserve(this->resolution);
     // first entry into distance LUT at time 0
+    auto arc_length_sum = 0.f;
     this->distance_lut.push_back(arc_length_sum);
-    // std::cout << "this->spline_points.size() = " << this->spline_points.size() << std::endl;
-    for (int i = 0; i < this->spline_points.size(); i++) {
-        // std::cout << "point[" << i << "](0): " << this->spline_points[i](0) << std::endl;
-        // std::cout << "point[" << i << "](1): " << this->spline_points[i](1) << std::endl;
-        // std::cout << "point[" << i << "](2): " << this->spline_points[i](2) << std::endl;
-    }
-    // std::cout << "resolution = " << this->resolution << std::endl;
+    const auto speed = [this](float t) { return this->df(t).norm(); };
     for (int t_idx = 1; t_idx < this->resolution; t_idx++) {
-        // difference vector between every two points
-        // std::cout << "iteration = " << t_idx << std::endl;
-        auto diff = this->spline_points[t_idx - 1] - this->spline_points[t_idx];
-        // std::cout << "diff.norm() = " << diff.norm() << std::endl;
-        // euclidean norm of the difference vector
-        arc_length_sum += diff.norm();
-        // std::cout << "arc_length_sum = " << arc_length_sum << std::endl;
+        const auto t0 = (float)(t_idx - 1) / (float)resolution;
+        const auto t1 = (float)t_idx / (float)resolution;
+        arc_length_sum += uoe::utils::gauss_legendre(speed, t0, t1);
         // cumulative distance entry for ever time step
         this->distance_lut.push_back(arc_length_sum);
     }
@@ -185,18 +241,13 @@ auto BezierSpline::get_point_at_distance(float distance) -> Vector3f {
     // given that the found time idx is the last idx,
     // the given distance must have been >= arc length,
     // thus the last point is returned
-    // std::cout << "this->resolution - 1 = " << this->resolution - 1 << std::endl;
     if (t_idx == this->resolution - 1) {
-        return this->spline_points[t_idx];
+        return this->spline_points[t_idx] + this->offset;
     }
     // otherwise we want to interpolate between two time values,
     // the one given, which is the closest before the `distance`,
     // and the next one after the given `distance`
 
-    // for (auto& d : this->distance_lut) {
-    //     std::cout << "distance: " << d << std::endl;
-    // }
-
     // distance range to map from
     auto distance_diff = this->distance_lut[t_idx + 1] - this->distance_lut[t_idx];
     // std::cout << "distance_diff = " << distance_diff << std::endl;
@@ -218,21 +269,21 @@ auto BezierSpline::get_point_at_distance(float distance) -> Vector3f {
 // Returns the closes time idx, the given `distance` comes after
 // If `distance`<0 return minimum time idx; 0
 // If `distance`>arc_length, return max time idx; resolution
+// The distance LUT is monotonic, so it is binary searched.
 auto BezierSpline::get_time_idx(float distance) -> int {
-    auto found_t_idx = 0;
-    for (int t_idx = 0; t_idx < this->resolution && this->distance_lut[t_idx] < distance; t_idx++) {
-        found_t_idx = t_idx;
-    }
-    return found_t_idx;
+    const auto begin = this->distance_lut.begin();
+    const auto it = std::lower_bound(begin, this->distance_lut.end(), distance);
+    return std::max(0, static_cast<int>(std::distance(begin, it)) - 1);
 }
 
 //--------------------------------------------------------------------------------------------------
 // Returns a vector of all points along the spline
 auto BezierSpline::get_spline_points() -> vector<Vector3f> {
-    auto copy = vector<Vector3f>(this->spline_points.size());
+    auto copy = vector<Vector3f>();
+    copy.reserve(this->spline_points.size());
     std::transform(this->spline_points.begin(), this->spline_points.end(), std::back_inserter(copy),
                    [this](const Vector3f& point) { return point + this->offset; });
-    return this->spline_points;  // copy;
+    return copy;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -247,15 +298,17 @@ auto BezierSpline::get_length() -> float {
 }
 
 auto BezierSpline::get_closest_point(Vector3f point) -> Vector3f {
+    // the spline points are relative to the offset, so the query is moved instead of every point
+    const Vector3f offset_point = point - this->offset;
     auto closest_point = Eigen::Vector3f{0, 0, 0};
-    auto smallest_distance = std::numeric_limits<double>::max();
-    for (auto& p : get_spline_points()) {
-        auto dist = (p - point).norm();
+    auto smallest_distance = std::numeric_limits<float>::max();
+    for (const auto& p : this->spline_points) {
+        auto dist = (p - offset_point).squaredNorm();
         if (dist < smallest_distance) {
             smallest_distance = dist;
             closest_point = p;
         }
     }
-    return closest_point;
+    return closest_point + this->offset;
 }
-}  // namespace uoe::trajectory
\ No newline at end of file
+}  // namespace uoe::trajectory
@@ -1,12 +1,25 @@
 #include "uoe/compound_trajectory.hpp"
 
+#include "uoe/utils/trace.hpp"
+
 namespace uoe::trajectory {
-CompoundTrajectory::CompoundTrajectory(ros::NodeHandle& nh, ros::Rate& rate,
+CompoundTrajectory::CompoundTrajectory(ros::NodeHandle& nh, ros::Rate& /* rate */,
                                        std::vector<Eigen::Vector3f> path, bool visualise,
                                        float marker_scale)
-    : seq_marker(0), rate(rate) {
-    pub_visualisation = nh.advertise<visualization_msgs::MarkerArray>("/uoe/visualisation",
-                                                                      utils::DEFAULT_QUEUE_SIZE);
+    : CompoundTrajectory(std::move(path)) {
+    // latched, so the markers reach subscribers that connect after they are published, instead of
+    // waiting for them to connect before publishing
+    pub_visualisation = nh.advertise<visualization_msgs::MarkerArray>(
+        "/uoe/visualisation", utils::DEFAULT_QUEUE_SIZE, true);
+
+    // visualise in rviz if specified
+    if (visualise) {
+        this->visualise(marker_scale);
+    }
+}
+
+CompoundTrajectory::CompoundTrajectory(std::vector<Eigen::Vector3f> path) : seq_marker(0) {
+    const auto timer = utils::trace::scoped_timer(utils::trace::stage::spline_fit);
 
     // std::cout << "PATH: " << std::endl;
     // for (auto& p : path) {
@@ -111,6 +124,9 @@ CompoundTrajectory::CompoundTrajectory(ros::NodeHandle& nh, ros::Rate& rate,
                        // make check between spline and linear trajectory
                        if (straight) {
                            return LinearTrajectory(section.front(), section.back());
+                       } else if (section.size() > binomial_coefficient_amount) {
+                           // a Bezier spline would drop the points beyond its degree limit
+                           return CubicSpline(section);
                        } else {
                            return BezierSpline(section);
                        }
@@ -124,19 +140,13 @@ CompoundTrajectory::CompoundTrajectory(ros::NodeHandle& nh, ros::Rate& rate,
         distance_lut.push_back(a);
     }
 
-    for (auto t : trajectories) {
-        auto t_length = std::visit([](auto& t) { return t.get_length(); }, t);
-        for (float d = 0; t_length - d > 0; d += 0.05) {
-            auto point = std::visit([&](auto& t) { return t.get_point_at_distance(d); }, t);
-            points.push_back(point);
-        }
-    }
-
-    // visualise in rviz if specified
-    // std::cout << "visualise bool = " << visualise << std::endl;
-    if (visualise) {
-        this->visualise(marker_scale);
+    // samples the whole trajectory in order from its start, for closest point queries
+    auto points = vector<Eigen::Vector3f>();
+    for (float d = 0; get_length() - d > 0; d += 0.05) {
+        points.push_back(get_point_at_distance(d));
     }
+    points.push_back(get_point_at_distance(get_length()));
+    closest_point_index = ClosestPointIndex(std::move(points));
 }
 
 auto CompoundTrajectory::visualise(float scale) -> void {
@@ -206,12 +216,7 @@ auto CompoundTrajectory::visualise(float scale) -> void {
         }
     }
 
-    ros::spinOnce();
-    rate.sleep();
-    // ros::Duration(2).sleep();
     pub_visualisation.publish(ma);
-    ros::spinOnce();
-    rate.sleep();
 }
 
 auto CompoundTrajectory::get_length() -> float {
@@ -220,39 +225,40 @@ auto CompoundTrajectory::get_length() -> float {
 }
 
 auto CompoundTrajectory::get_point_at_distance(float distance) -> Eigen::Vector3f {
-    // std::cout << "get_point_at_distance" << std::endl;
     assert(distance >= 0);
-    int trajectory_idx = 0;
-    for (trajectory_idx = 0; trajectory_idx < distance_lut.size(); trajectory_idx++) {
-        // std::cout << "distance_lut[" << trajectory_idx << "] = " << distance_lut[trajectory_idx]
-        // << std::endl;
-        if (distance < distance_lut[trajectory_idx]) {
-            break;
-        }
-    }
-    if (trajectory_idx >= distance_lut.size()) {
-        trajectory_idx = distance_lut.size() - 1;
-    }
-    // std::cout << "found index: " << trajectory_idx << std::endl;
+    const auto trajectory_idx = get_trajectory_idx(distance);
+    const auto start = trajectory_idx > 0 ? distance_lut[trajectory_idx - 1] : 0.f;
 
-    auto t = trajectories[trajectory_idx];
+    auto& t = trajectories[trajectory_idx];
     auto t_length = std::visit([](auto& t) { return t.get_length(); }, t);
-    auto distance_in_spline = t_length - (distance - distance_lut[trajectory_idx - 1]);
+    // clamped, as the sum of the section lengths in the LUT may round past the last section
+    auto distance_in_spline = std::max(0.f, t_length - (distance - start));
     return std::visit([&](auto& t) { return t.get_point_at_distance(distance_in_spline); }, t);
 }
 
-auto CompoundTrajectory::get_closest_point(Eigen::Vector3f point) -> Eigen::Vector3f {
-    auto closest_point = Eigen::Vector3f{0, 0, 0};
-    auto smallest_distance = std::numeric_limits<double>::max();
-    for (auto& p : points) {
-        // auto t_closest_point = std::visit([&](auto& t) { return t.get_closest_point(point); },
-        // t);
-        auto dist = (p - point).norm();
-        if (dist < smallest_distance) {
-            smallest_distance = dist;
-            closest_point = p;
-        }
+/**
+ * @brief index of the first trajectory ending after `distance`, or the last trajectory.
+ * While flying, the queried distance grows monotonically, so the trajectory of the previous query,
+ * or the one after it, is tried before binary searching the distance LUT.
+ */
+auto CompoundTrajectory::get_trajectory_idx(float distance) -> std::size_t {
+    const auto contains = [&](std::size_t idx) {
+        const auto start = idx > 0 ? distance_lut[idx - 1] : 0.f;
+        return idx < distance_lut.size() && start <= distance && distance < distance_lut[idx];
+    };
+    if (contains(cursor)) {
+        return cursor;
+    }
+    if (contains(cursor + 1)) {
+        return ++cursor;
     }
-    return closest_point;
+    const auto it = std::upper_bound(distance_lut.begin(), distance_lut.end(), distance);
+    cursor = std::min(static_cast<std::size_t>(std::distance(distance_lut.begin(), it)),
+                      distance_lut.size() - 1);
+    return cursor;
+}
+
+auto CompoundTrajectory::get_closest_point(Eigen::Vector3f point) -> Eigen::Vector3f {
+    return closest_point_index.closest_point(point);
 }
-}  // namespace uoe::trajectory
\ No newline at end of file
+}  // namespace uoe::trajectory
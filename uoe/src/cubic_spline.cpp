@@ -0,0 +1,172 @@
+#include "uoe/cubic_spline.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+
+#include "uoe/utils/math.hpp"
+
+namespace uoe::trajectory {
+//--------------------------------------------------------------------------------------------------
+// Constructor; fits the spline through `points`, and tabulates its arc length at
+// `samples_per_segment` parameter values per segment
+CubicSpline::CubicSpline(std::vector<Eigen::Vector3f> points, int samples_per_segment) {
+    // coincident consecutive points would give segments of zero parameter length
+    points.erase(std::unique(points.begin(), points.end(),
+                             [](const auto& p1, const auto& p2) {
+                                 return (p1 - p2).norm() <= std::numeric_limits<float>::epsilon();
+                             }),
+                 points.end());
+    if (points.size() < 2) {
+        throw std::invalid_argument("a cubic spline needs at least 2 distinct points");
+    }
+    if (samples_per_segment < 1) {
+        throw std::invalid_argument("samples_per_segment must be at least 1");
+    }
+    generate_segments(points);
+    generate_distance_lut(samples_per_segment);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Solves for the second derivatives m_i at the knots, with m_0 = m_n = 0, from the tridiagonal
+// system given by C2 continuity at the inner knots
+//   h_{i-1} m_{i-1} + 2 (h_{i-1} + h_i) m_i + h_i m_{i+1} = 6 (s_i - s_{i-1})
+// where h_i is the parameter length of segment i and s_i its slope, using the Thomas algorithm.
+// The matrix is the same for every axis, so all three are solved at once.
+auto CubicSpline::generate_segments(const std::vector<Eigen::Vector3f>& points) -> void {
+    const auto n = static_cast<int>(points.size()) - 1;  // number of segments
+    knots.resize(n + 1);
+    knots[0] = 0;
+    auto h = std::vector<float>(n);
+    auto slopes = std::vector<Eigen::Vector3f>(n);
+    for (int i = 0; i < n; ++i) {
+        h[i] = (points[i + 1] - points[i]).norm();
+        slopes[i] = (points[i + 1] - points[i]) / h[i];
+        knots[i + 1] = knots[i] + h[i];
+    }
+
+    auto m = std::vector<Eigen::Vector3f>(n + 1, Eigen::Vector3f::Zero());
+    if (n > 1) {
+        // forward sweep over the inner knots 1..n-1
+        auto upper = std::vector<float>(n);
+        auto rhs = std::vector<Eigen::Vector3f>(n);
+        for (int i = 1; i < n; ++i) {
+            auto diagonal = 2 * (h[i - 1] + h[i]);
+            Eigen::Vector3f r = 6 * (slopes[i] - slopes[i - 1]);
+            if (i > 1) {
+                diagonal -= h[i - 1] * upper[i - 1];
+                r -= h[i - 1] * rhs[i - 1];
+            }
+            upper[i] = h[i] / diagonal;
+            rhs[i] = r / diagonal;
+        }
+        // back substitution
+        m[n - 1] = rhs[n - 1];
+        for (int i = n - 2; i >= 1; --i) {
+            m[i] = rhs[i] - upper[i] * m[i + 1];
+        }
+    }
+
+    segments.resize(n);
+    for (int i = 0; i < n; ++i) {
+        segments[i].a = points[i];
+        segments[i].b = slopes[i] - h[i] * (2 * m[i] + m[i + 1]) / 6;
+        segments[i].c = m[i] / 2;
+        segments[i].d = (m[i + 1] - m[i]) / (6 * h[i]);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Computes the arc length at evenly spaced parameter values, by integrating the speed |p'(t)|
+// between them with Gauss-Legendre quadrature
+auto CubicSpline::generate_distance_lut(int samples_per_segment) -> void {
+    time_lut.clear();
+    distance_lut.clear();
+    time_lut.push_back(0);
+    distance_lut.push_back(0);
+    const auto speed = [this](float t) { return get_velocity_at_time(t).norm(); };
+    for (std::size_t i = 0; i < segments.size(); ++i) {
+        const auto h = knots[i + 1] - knots[i];
+        for (int s = 1; s <= samples_per_segment; ++s) {
+            const auto t = knots[i] + h * s / samples_per_segment;
+            distance_lut.push_back(distance_lut.back() +
+                                   utils::gauss_legendre(speed, time_lut.back(), t));
+            time_lut.push_back(t);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Returns the index of the segment containing `time`, clamped to the first and last segment
+auto CubicSpline::get_segment_idx(float time) const -> int {
+    const auto it = std::upper_bound(knots.begin(), knots.end(), time);
+    const auto idx = static_cast<int>(std::distance(knots.begin(), it)) - 1;
+    return std::clamp(idx, 0, static_cast<int>(segments.size()) - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Returns the point at parameter value `time`, where 0<=time<=get_duration()
+auto CubicSpline::get_point_at_time(float time) const -> Eigen::Vector3f {
+    const auto idx = get_segment_idx(time);
+    const auto& s = segments[idx];
+    const auto u = time - knots[idx];
+    return s.a + u * (s.b + u * (s.c + u * s.d));
+}
+
+auto CubicSpline::get_velocity_at_time(float time) const -> Eigen::Vector3f {
+    const auto idx = get_segment_idx(time);
+    const auto& s = segments[idx];
+    const auto u = time - knots[idx];
+    return s.b + u * (2 * s.c + u * 3 * s.d);
+}
+
+auto CubicSpline::get_acceleration_at_time(float time) const -> Eigen::Vector3f {
+    const auto idx = get_segment_idx(time);
+    const auto& s = segments[idx];
+    const auto u = time - knots[idx];
+    return 2 * s.c + u * 6 * s.d;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Returns the parameter value at the arc length `distance` from the first point,
+// interpolating linearly between the samples of the distance LUT
+auto CubicSpline::get_time_at_distance(float distance) const -> float {
+    distance = std::clamp(distance, 0.f, distance_lut.back());
+    const auto it = std::upper_bound(distance_lut.begin(), distance_lut.end(), distance);
+    if (it == distance_lut.end()) {
+        return time_lut.back();
+    }
+    const auto idx = static_cast<int>(std::distance(distance_lut.begin(), it)) - 1;
+    const auto distance_diff = distance_lut[idx + 1] - distance_lut[idx];
+    const auto frac = distance_diff > 0 ? (distance - distance_lut[idx]) / distance_diff : 0;
+    return time_lut[idx] + frac * (time_lut[idx + 1] - time_lut[idx]);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Returns the point at the `distance` along the spline. Like BezierSpline and LinearTrajectory,
+// the distance is measured from the last point.
+auto CubicSpline::get_point_at_distance(float distance) const -> Eigen::Vector3f {
+    return get_point_at_time(get_time_at_distance(get_length() - distance));
+}
+
+auto CubicSpline::get_length() const -> float {
+    return distance_lut.empty() ? 0 : distance_lut.back();
+}
+
+auto CubicSpline::get_duration() const -> float { return knots.empty() ? 0 : knots.back(); }
+
+auto CubicSpline::get_closest_point(Eigen::Vector3f point) const -> Eigen::Vector3f {
+    auto closest_point = Eigen::Vector3f{0, 0, 0};
+    auto smallest_distance = std::numeric_limits<float>::max();
+    for (const auto t : time_lut) {
+        const auto p = get_point_at_time(t);
+        const auto dist = (p - point).norm();
+        if (dist < smallest_distance) {
+            smallest_distance = dist;
+            closest_point = p;
+        }
+    }
+    return closest_point;
+}
+}  // namespace uoe::trajectory
@@ -39,6 +39,10 @@ Mission::Mission(ros::NodeHandle& nh, ros::Rate& rate, types::vec3 target, float
                                                                      utils::DEFAULT_QUEUE_SIZE);
     pub_visualise_ = nh.advertise<visualization_msgs::MarkerArray>("/uoe/mission/visualisation",
                                                                    utils::DEFAULT_QUEUE_SIZE);
+    if (should_visualise_) {
+        visualisation_ =
+            std::make_shared<utils::rviz::marker_aggregator>(pub_visualise_, VISUALISATION_RATE);
+    }
     pub_setpoint_ = nh.advertise<geometry_msgs::PoseStamped>("/mavros/setpoint_local/local",
                                                              utils::DEFAULT_QUEUE_SIZE);
 
@@ -75,6 +79,62 @@ Mission::Mission(ros::NodeHandle& nh, ros::Rate& rate, types::vec3 target, float
         std::exit(EXIT_FAILURE);
     }
     experiment_param_ = experiment_param;
+
+    nh.param("/uoe/mission/nbv_look_ahead", nbv_look_ahead_, nbv_look_ahead_);
+    load_planner_config_();
+}
+
+/**
+ * @brief reads the parameters of the planning requests once, into the messages the requests are
+ * built from, so a request only has to fill in its start and goal
+ */
+auto Mission::load_planner_config_() -> void {
+    const auto get_param = [](const std::string& name, auto& param) {
+        ros::param::get(name, param);
+        if (param.empty()) {
+            std::cerr << name << " is empty" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    };
+    auto drone_param = std::map<std::string, double>();
+    get_param("/uoe/drone", drone_param);
+    auto rrt_param = std::map<std::string, float>();
+    get_param("/uoe/rrt/params", rrt_param);
+    auto nbv_param = std::map<std::string, double>();
+    get_param("/uoe/nbv", nbv_param);
+    auto camera_param = std::map<std::string, float>();
+    get_param("/uoe/camera", camera_param);
+
+    drone_config_.width = drone_param["width"];
+    drone_config_.height = drone_param["height"];
+    drone_config_.depth = drone_param["depth"];
+    // node names are unique, so they tell the drones of a fleet apart
+    drone_config_.id = ros::this_node::getName();
+
+    rrt_config_.probability_of_testing_full_path_from_new_node_to_goal =
+        rrt_param["probability_of_testing_full_path_from_new_node_to_goal"];
+    rrt_config_.goal_bias = rrt_param["goal_bias"];
+    rrt_config_.goal_tolerance = rrt_param["goal_tolerance"];
+    rrt_config_.max_iterations = static_cast<uint>(rrt_param["max_iterations"]);
+    rrt_config_.step_size = rrt_param["step_size"];
+
+    nbv_rrt_config_ = rrt_config_;
+    nbv_rrt_config_.max_iterations = static_cast<uint>(nbv_param["max_iterations"]);
+
+    nbv_config_.gain_of_interest_threshold = nbv_param["information_threshold"];
+    nbv_config_.weight_free = nbv_param["free"];
+    nbv_config_.weight_occupied = nbv_param["occupied"];
+    nbv_config_.weight_unknown = nbv_param["unknown"];
+    nbv_config_.weight_not_visible = nbv_param["not_visible"];
+    nbv_config_.weight_distance_to_object = nbv_param["distance_to_object"];
+    nbv_config_.excluded_points_distance_tolerance =
+        nbv_param["excluded_points_distance_tolerance"];
+
+    fov_.depth_range.max = camera_param["depth_max"];
+    fov_.depth_range.min = camera_param["depth_min"];
+    fov_.horizontal.angle = camera_param["horisontal_fov"];
+    fov_.vertical.angle = camera_param["vertical_fov"];
+    fov_.pitch.angle = camera_param["pitch"];
 }
 
 auto Mission::mavros_state_cb_(const mavros_msgs::State::ConstPtr& state) -> void {
@@ -193,7 +253,6 @@ auto Mission::publish_() -> void {
 }
 
 auto Mission::visualise_() -> void {
-    visualization_msgs::MarkerArray ma;
     visualization_msgs::Marker m;
     m.id = -1;
     m.header.frame_id = utils::FRAME_WORLD;
@@ -215,7 +274,7 @@ auto Mission::visualise_() -> void {
     m.color.g = 1;
     m.color.b = 1;
 
-    ma.markers.push_back(m);
+    visualisation_->add(m);
 
     m.id = -2;
     m.pose.position = uoe::utils::transform::vec_to_geometry_msg_point(closest_position_);
@@ -225,9 +284,7 @@ auto Mission::visualise_() -> void {
     m.color.g = 0;
     m.color.b = 0;
 
-    ma.markers.push_back(m);
-
-    pub_visualise_.publish(ma);
+    visualisation_->add(std::move(m));
 }
 
 auto Mission::find_path_(Eigen::Vector3f start, Eigen::Vector3f end)
@@ -236,41 +293,14 @@ auto Mission::find_path_(Eigen::Vector3f start, Eigen::Vector3f end)
                     << "[" << start.x() << "," << start.y() << "," << start.z() << "] to "
                     << "[" << end.x() << "," << end.y() << "," << end.z() << "]");
     auto rrt_msg = uoe_msgs::RrtFindPath{};
-
-    auto drone_param = std::map<std::string, double>();
-    ros::param::get("/uoe/drone", drone_param);
-    if (drone_param.empty()) {
-        std::cerr << "drone_param is empty" << std::endl;
-        std::exit(EXIT_FAILURE);
-    }
-    auto& drone = rrt_msg.request.drone_config;
-    drone.width = drone_param["width"];
-    drone.height = drone_param["height"];
-    drone.depth = drone_param["depth"];
-
-    auto rrt_param = std::map<std::string, float>();
-    ros::param::get("/uoe/rrt/params", rrt_param);
-    if (rrt_param.empty()) {
-        std::cerr << "rrt_param is empty" << std::endl;
-        std::exit(EXIT_FAILURE);
-    }
-
+    rrt_msg.request.drone_config = drone_config_;
     auto& rrt = rrt_msg.request.rrt_config;
+    rrt = rrt_config_;
+    rrt.start = uoe::utils::transform::vec_to_geometry_msg_point(start);
+    rrt.goal = uoe::utils::transform::vec_to_geometry_msg_point(end);
 
-    rrt.probability_of_testing_full_path_from_new_node_to_goal =
-        rrt_param["probability_of_testing_full_path_from_new_node_to_goal"];
-    rrt.goal_bias = rrt_param["goal_bias"];
-    rrt.goal_tolerance = rrt_param["goal_tolerance"];
-    rrt.start.x = start.x();
-    rrt.start.y = start.y();
-    rrt.start.z = start.z();
-    rrt.goal.x = end.x();
-    rrt.goal.y = end.y();
-    rrt.goal.z = end.z();
-    rrt.max_iterations = static_cast<uint>(rrt_param["max_iterations"]);
-    rrt.step_size = rrt_param["step_size"];
-
-    if (client_rrt_.call(rrt_msg)) {
+    // with a time budget, the service may respond with a path that only leads part of the way
+    if (client_rrt_.call(rrt_msg) && rrt_msg.response.found_path) {
         auto& waypoints = rrt_msg.response.waypoints;
         auto path = std::vector<Eigen::Vector3f>();
         // std::cout << "before for loop" << std::endl;
@@ -289,97 +319,69 @@ auto Mission::find_path_(Eigen::Vector3f start, Eigen::Vector3f end)
     return {};
 }
 
-auto Mission::find_nbv_path_(Eigen::Vector3f start) -> std::optional<std::vector<Eigen::Vector3f>> {
-    ROS_INFO_STREAM("Requesting NBV path from "
-                    << "[" << start.x() << "," << start.y() << "," << start.z() << "]");
-
+auto Mission::make_nbv_request_(Eigen::Vector3f start) -> uoe_msgs::NBV {
     auto nbv_srv = uoe_msgs::NBV{};
-    {
-        auto drone_param = std::map<std::string, double>();
-        ros::param::get("/uoe/drone", drone_param);
-        if (drone_param.empty()) {
-            std::cerr << "drone_param is empty" << std::endl;
-            std::exit(EXIT_FAILURE);
-        }
-        auto& drone = nbv_srv.request.drone_config;
-        drone.width = drone_param["width"];
-        drone.height = drone_param["height"];
-        drone.depth = drone_param["depth"];
+    auto& request = nbv_srv.request;
+    request.drone_config = drone_config_;
+    request.fov = fov_;
+    request.nbv_config = nbv_config_;
+    request.rrt_config = nbv_rrt_config_;
+    request.rrt_config.start = uoe::utils::transform::vec_to_geometry_msg_point(start);
+    request.rrt_config.goal = uoe::utils::transform::vec_to_geometry_msg_point(object_center_);
+
+    // the service keeps the excluded points of earlier requests, so only the new ones are sent
+    auto& nbv = request.nbv_config;
+    nbv.excluded_points_offset = nbv_excluded_points_sent_;
+    for (auto i = nbv_excluded_points_sent_; i < interest_points_.size(); ++i) {
+        nbv.excluded_points.emplace_back(
+            uoe::utils::transform::vec_to_geometry_msg_point(interest_points_[i]));
     }
+    nbv_excluded_points_sent_ = interest_points_.size();
 
-    {
-        auto nbv_param = std::map<std::string, double>();
-        ros::param::get("/uoe/nbv", nbv_param);
-        if (nbv_param.empty()) {
-            std::cerr << "nbv_param is empty" << std::endl;
-            std::exit(EXIT_FAILURE);
-        }
-
-        auto& nbv = nbv_srv.request.nbv_config;
-        nbv.gain_of_interest_threshold = nbv_param["information_threshold"];
-        nbv.weight_free = nbv_param["free"];
-        nbv.weight_occupied = nbv_param["occupied"];
-        nbv.weight_unknown = nbv_param["unknown"];
-        nbv.weight_not_visible = nbv_param["not_visible"];
-        nbv.weight_distance_to_object = nbv_param["distance_to_object"];
-        nbv.excluded_points_distance_tolerance = nbv_param["excluded_points_distance_tolerance"];
-        for (const auto& ip : interest_points_) {
-            nbv.excluded_points.emplace_back(uoe::utils::transform::vec_to_geometry_msg_point(ip));
-        }
+    return nbv_srv;
+}
 
-        auto rrt_param = std::map<std::string, float>();
-        ros::param::get("/uoe/rrt/params", rrt_param);
-        if (rrt_param.empty()) {
-            std::cerr << "rrt_param is empty" << std::endl;
-            std::exit(EXIT_FAILURE);
-        }
+/**
+ * @brief sends a NBV request from `start` on another thread, so the mission keeps streaming
+ * setpoints while the service is planning. The request is built here, as it reads the interest
+ * points, and only the service call runs on the other thread.
+ */
+auto Mission::request_nbv_path_(Eigen::Vector3f start) -> void {
+    ROS_INFO_STREAM((timeout_ - timeout_delta_time_).toSec()
+                    << " Requesting NBV path from "
+                    << "[" << start.x() << "," << start.y() << "," << start.z() << "]");
+    nbv_request_ = std::async(std::launch::async,
+                              [this, nbv_srv = make_nbv_request_(start)]() mutable
+                              -> std::optional<uoe_msgs::NBV> {
+                                  if (client_nbv_.call(nbv_srv)) {
+                                      return {nbv_srv};
+                                  }
+                                  return {};
+                              });
+}
 
-        auto& rrt = nbv_srv.request.rrt_config;
-        rrt.probability_of_testing_full_path_from_new_node_to_goal =
-            rrt_param["probability_of_testing_full_path_from_new_node_to_goal"];
-        rrt.goal_bias = rrt_param["goal_bias"];
-        rrt.goal_tolerance = rrt_param["goal_tolerance"];
-        rrt.start.x = start.x();
-        rrt.start.y = start.y();
-        rrt.start.z = start.z();
-        rrt.goal.x = object_center_.x();
-        rrt.goal.y = object_center_.y();
-        rrt.goal.z = object_center_.z();
-        rrt.max_iterations = static_cast<uint>(nbv_param["max_iterations"]);
-        rrt.step_size = rrt_param["step_size"];
+auto Mission::nbv_path_from_response_(const std::optional<uoe_msgs::NBV>& nbv_srv)
+    -> std::optional<std::vector<Eigen::Vector3f>> {
+    if (! nbv_srv) {
+        // unknown which of the excluded points arrived, so all of them are sent again
+        nbv_excluded_points_sent_ = 0;
+        return {};
     }
-
-    {
-        auto camera_param = std::map<std::string, float>();
-        ros::param::get("/uoe/camera", camera_param);
-        if (camera_param.empty()) {
-            std::cerr << "camera_param is empty" << std::endl;
-            std::exit(EXIT_FAILURE);
-        }
-
-        auto& fov = nbv_srv.request.fov;
-        fov.depth_range.max = camera_param["depth_max"];
-        fov.depth_range.min = camera_param["depth_min"];
-        fov.horizontal.angle = camera_param["horisontal_fov"];
-        fov.vertical.angle = camera_param["vertical_fov"];
-        fov.pitch.angle = camera_param["pitch"];
+    // fewer than were sent, if the service lost its state. The rest are sent again next time.
+    nbv_excluded_points_sent_ =
+        std::min<std::size_t>(nbv_excluded_points_sent_, nbv_srv->response.excluded_points_count);
+    if (nbv_srv->response.waypoints.empty()) {
+        return {};
     }
-
-    if (client_nbv_.call(nbv_srv)) {
-        auto path = std::vector<Eigen::Vector3f>();
-        auto& waypoints = nbv_srv.response.waypoints;
-        // TODO: should check if list of waypoints is NOT empty
-        for (auto& wp : waypoints) {
-            path.emplace_back(wp.x, wp.y, wp.z);
-        }
-
-        if (interest_points_.back() != path.back()) {
-            interest_points_.push_back(path.back());
-        }
-        return {path};
+    auto path = std::vector<Eigen::Vector3f>();
+    for (auto& wp : nbv_srv->response.waypoints) {
+        path.emplace_back(wp.x, wp.y, wp.z);
     }
 
-    return {};
+    if (interest_points_.back() != path.back()) {
+        interest_points_.push_back(path.back());
+    }
+    return {path};
 }
 
 auto Mission::fit_trajectory_(std::vector<Eigen::Vector3f> path)
@@ -436,7 +438,13 @@ auto Mission::trajectory_step_(float vel, bool look_forwards) -> bool {
         target_ = object_center_;
         end_reached = true;
     } else {  // otherwise the next expected position is computed for the current time step
-        expected_position_ = trajectory_.get_point_at_distance(distance);
+        // the samples are only valid for the velocity they were taken at
+        if (! trajectory_samples_.empty() && trajectory_samples_.velocity() == vel) {
+            const auto sample = trajectory_samples_.sample_at(trajectory_delta_time_.toSec());
+            expected_position_ = sample.position;
+        } else {
+            expected_position_ = trajectory_.get_point_at_distance(distance);
+        }
         // here the heading should be towards the expected position
         if (look_forwards) {
             target_ = expected_position_;
@@ -452,6 +460,19 @@ auto Mission::trajectory_step_(float vel, bool look_forwards) -> bool {
     return end_reached;
 }
 
+/**
+ * @brief starts flying `trajectory` from its beginning, sampling it once at the rate of the
+ * control loop, so trajectory_step_ only has to interpolate between samples
+ */
+auto Mission::set_trajectory_(trajectory::CompoundTrajectory trajectory) -> void {
+    trajectory_ = std::move(trajectory);
+    const auto time_step = rate_.expectedCycleTime().toSec();
+    trajectory_samples_ = velocity_target_ > 0 ? trajectory::SampledTrajectory(
+                                                     trajectory_, velocity_target_, time_step)
+                                               : trajectory::SampledTrajectory();
+    step_count_ = 0;
+}
+
 auto Mission::set_home_trajectory_() -> bool {
     // std::cout << "Going to home position" << std::endl;
     const auto start = interest_points_.back();
@@ -468,8 +489,7 @@ auto Mission::set_home_trajectory_() -> bool {
         }
 
         if (const auto trajectory_opt = fit_trajectory_(path)) {
-            trajectory_ = *trajectory_opt;
-            step_count_ = 0;
+            set_trajectory_(*trajectory_opt);
             ROS_INFO_STREAM("Path viable");
             return true;
         } else {
@@ -500,8 +520,7 @@ auto Mission::set_takeoff_trajectory_() -> void {
         home_position_};
 
     if (auto trajectory_opt = fit_trajectory_(path)) {
-        trajectory_ = *trajectory_opt;
-        step_count_ = 0;
+        set_trajectory_(*trajectory_opt);
         ROS_INFO_STREAM("Path viable");
     } else {
         ROS_INFO_STREAM("Path not viable");
@@ -510,16 +529,34 @@ auto Mission::set_takeoff_trajectory_() -> void {
     target_ = home_position_;
 }
 
-auto Mission::set_nbv_trajectory_() -> void {
-    if (auto path_opt = find_nbv_path_(interest_points_.back())) {
+/**
+ * @brief swaps in the trajectory to the next best view, once the service has answered. With
+ * look-ahead, the request for the view after that is sent straight away, starting from the end of
+ * the new trajectory, so it is planned while the drone is flying there.
+ *
+ * @return true if a new trajectory was set
+ * @return false while the service is still planning, or if it found no viable path
+ */
+auto Mission::set_nbv_trajectory_() -> bool {
+    if (! nbv_request_.valid()) {
+        request_nbv_path_(interest_points_.back());
+    }
+    // the drone hovers at the end of the current trajectory until the service answers
+    if (nbv_request_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return false;
+    }
+    if (auto path_opt = nbv_path_from_response_(nbv_request_.get())) {
         if (auto trajectory_opt = fit_trajectory_(path_opt.value())) {
-            trajectory_ = *trajectory_opt;
-            step_count_ = 0;
+            set_trajectory_(*trajectory_opt);
             ROS_INFO_STREAM("Path viable");
-        } else {
-            ROS_INFO_STREAM("Path not viable");
+            if (nbv_look_ahead_) {
+                request_nbv_path_(interest_points_.back());
+            }
+            return true;
         }
+        ROS_INFO_STREAM("Path not viable");
     }
+    return false;
 }
 
 auto Mission::set_test_trajectory_() -> void {
@@ -661,8 +698,7 @@ auto Mission::set_test_trajectory_() -> void {
     path.push_back(home_position_);
 
     if (auto trajectory_opt = fit_trajectory_(path)) {
-        trajectory_ = *trajectory_opt;
-        step_count_ = 0;
+        set_trajectory_(*trajectory_opt);
         ROS_INFO_STREAM("Path viable");
     } else {
         ROS_INFO_STREAM("Path not viable");
@@ -765,9 +801,6 @@ auto Mission::run_step() -> void {
                     end();
                     break;
                 }
-                ROS_INFO_STREAM((timeout_ - timeout_delta_time_).toSec()
-                                << " Finding new NBV interest point...");
-                publish_();
                 set_nbv_trajectory_();
                 // ros::Duration(10).sleep();
             }
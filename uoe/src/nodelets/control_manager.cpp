@@ -0,0 +1,44 @@
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros/ros.h>
+
+#include <optional>
+#include <string>
+
+#include "uoe/pid_controller.hpp"
+
+namespace uoe::nodelets {
+
+/**
+ * @brief the control_manager node as a nodelet. The gains are read from the private parameters
+ * xy_p, xy_i, xy_d, yaw_p, yaw_i, yaw_d, z_p, z_i and z_d, instead of the arguments of the node.
+ * The gains of z default to those of xy.
+ */
+class ControlManager final : public nodelet::Nodelet {
+   private:
+    std::optional<ros::Rate> rate_;
+    std::optional<uoe::control::PIDController> controller_;
+
+    auto onInit() -> void override {
+        auto& nh = getNodeHandle();
+        auto& private_nh = getPrivateNodeHandle();
+        const auto gains = [&](const std::string& axis, const uoe::control::PID& fallback) {
+            auto pid = fallback;
+            private_nh.param(axis + "_p", pid.p, pid.p);
+            private_nh.param(axis + "_i", pid.i, pid.i);
+            private_nh.param(axis + "_d", pid.d, pid.d);
+            return pid;
+        };
+        const auto gains_xy = gains("xy", {});
+        const auto gains_yaw = gains("yaw", {});
+        const auto gains_z = gains("z", gains_xy);
+
+        rate_.emplace(uoe::utils::DEFAULT_LOOP_RATE * 6);
+        controller_.emplace(nh, *rate_, gains_xy, gains_z, gains_yaw, true);
+        controller_->start();
+    }
+};
+
+}  // namespace uoe::nodelets
+
+PLUGINLIB_EXPORT_CLASS(uoe::nodelets::ControlManager, nodelet::Nodelet)
@@ -0,0 +1,50 @@
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros/ros.h>
+
+#include <optional>
+
+#include "uoe/mission.hpp"
+
+namespace uoe::nodelets {
+
+/**
+ * @brief the mission_manager node as a nodelet. The arguments of the node are read from the
+ * private parameters vel, alt, target_x, target_y and target_z instead.
+ *
+ * The mission is stepped by a timer, rather than by Mission::run(), so its step and its callbacks
+ * are served one at a time, by the callback queue of the nodelet.
+ */
+class MissionManager final : public nodelet::Nodelet {
+   private:
+    std::optional<ros::Rate> rate_;
+    std::optional<uoe::Mission> mission_;
+    ros::Timer timer_;
+
+    auto onInit() -> void override {
+        auto& nh = getNodeHandle();
+        auto& private_nh = getPrivateNodeHandle();
+        auto velocity_target = 0.f;
+        auto altitude = 2.f;
+        auto target = uoe::types::vec3{5, 5, 5};
+        private_nh.param("vel", velocity_target, velocity_target);
+        private_nh.param("alt", altitude, altitude);
+        private_nh.param("target_x", target.x(), target.x());
+        private_nh.param("target_y", target.y(), target.y());
+        private_nh.param("target_z", target.z(), target.z());
+
+        rate_.emplace(uoe::utils::DEFAULT_LOOP_RATE);
+        mission_.emplace(nh, *rate_, target, 120, velocity_target,
+                         Eigen::Vector3f{0, 0, altitude}, true);
+        timer_ = nh.createTimer(rate_->expectedCycleTime(), [this](const ros::TimerEvent&) {
+            // as the node does, the mission starts once the FCU is connected
+            if (mission_->get_drone_state().connected) {
+                mission_->run_step();
+            }
+        });
+    }
+};
+
+}  // namespace uoe::nodelets
+
+PLUGINLIB_EXPORT_CLASS(uoe::nodelets::MissionManager, nodelet::Nodelet)
@@ -0,0 +1,45 @@
+#include <nodelet/nodelet.h>
+#include <octomap_msgs/Octomap.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros/ros.h>
+
+#include <memory>
+
+#include "uoe/octomap.hpp"
+#include "uoe/octomap_cache.hpp"
+#include "uoe/rrt_service.hpp"
+
+namespace uoe::nodelets {
+
+/**
+ * @brief the find_path and nbv services of the rrt_service node as a nodelet, built on the
+ * rrt_service_planner library. The octomap is taken from the messages of the octomap server,
+ * which a nodelet of it loaded into the same manager hands over without the round trip through
+ * the GetOctomap service the node falls back to. The planner keeps its state in globals, so a
+ * manager can only load one of these.
+ */
+class RrtService final : public nodelet::Nodelet {
+   private:
+    uoe::OctomapCache octomap_cache_;
+    ros::Subscriber octomap_sub_;
+    ros::ServiceServer find_path_service_;
+    ros::ServiceServer nbv_service_;
+
+    auto onInit() -> void override {
+        // the requests of several drones are served concurrently, as by the spinner of the node
+        auto& nh = getMTNodeHandle();
+        uoe::rrt_service::load_params(nh);
+        octomap_sub_ = nh.subscribe<octomap_msgs::Octomap>(
+            "/environment_voxel_map/octomap_binary", 1,
+            [this](const octomap_msgs::Octomap::ConstPtr& msg) { octomap_cache_.update(msg); });
+        uoe::rrt_service::set_octomap_source([this] { return octomap_cache_.get(); });
+
+        find_path_service_ =
+            nh.advertiseService("/uoe/rrt_service/find_path", &uoe::rrt_service::find_path);
+        nbv_service_ = nh.advertiseService("/uoe/rrt_service/nbv", &uoe::rrt_service::nbv);
+    }
+};
+
+}  // namespace uoe::nodelets
+
+PLUGINLIB_EXPORT_CLASS(uoe::nodelets::RrtService, nodelet::Nodelet)
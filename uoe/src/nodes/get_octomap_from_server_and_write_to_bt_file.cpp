@@ -7,18 +7,20 @@
 #include <string>
 
 #include "uoe/octomap.hpp"
+#include "uoe/octomap_snapshot_file.hpp"
 #include "ros/service.h"
 
 using namespace std::string_literals;
 
 std::unique_ptr<ros::ServiceClient> get_octomap_client;
 
-auto call_get_octomap() -> uoe::Octomap* {
+auto call_get_octomap() -> std::unique_ptr<uoe::Octomap> {
     auto request = octomap_msgs::GetOctomap::Request{};  // empty request
     auto response = octomap_msgs::GetOctomap::Response{};
 
     get_octomap_client->call(request, response);
-    return response.map.data.size() == 0 ? nullptr : new uoe::Octomap{response.map};
+    return response.map.data.size() == 0 ? nullptr
+                                         : std::make_unique<uoe::Octomap>(response.map);
 }
 
 auto main(int argc, char* argv[]) -> int {
@@ -68,7 +70,12 @@ auto main(int argc, char* argv[]) -> int {
         // }
 
         std::cerr << "writing octomap to file: " << path << '\n';
-        octomap_ptr->write(path);
+        // a .snap file can be mapped into memory by analysis tools, instead of deserialized
+        if (path.extension() == uoe::SnapshotFileHeader::FILE_EXTENSION) {
+            octomap_ptr->snapshot().write(path);
+        } else {
+            octomap_ptr->write(path);
+        }
 #endif  // WRITE_BT_FILE
 
 #ifdef COMPUTE_VOLUME_AND_WRITE_TO_STDERR
@@ -77,8 +84,6 @@ auto main(int argc, char* argv[]) -> int {
         std::cerr << "total volume of occupied voxels in octomap: " << volume_total << " m3"
                   << '\n';
 #endif  // COMPUTE_VOLUME_AND_WRITE_TO_STDERR
-
-        delete octomap_ptr;
     }
 #ifdef WRITE_BT_FILE
     else {
@@ -0,0 +1,118 @@
+#include <octomap_msgs/GetOctomap.h>
+#include <octomap_msgs/conversions.h>
+#include <ros/ros.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "uoe/map_merger.hpp"
+#include "uoe/utils/concurrency.hpp"
+#include "uoe/utils/utils.hpp"
+#include "uoe_msgs/MapChange.h"
+#include "uoe_msgs/MapDelta.h"
+
+// fuses the object maps of the drones of a fleet into one, from the MapDelta each object_map node
+// publishes with /uoe/object_map/publish_deltas, and serves it on /uoe/merged_object_map like the
+// object map of a single drone, e.g. for object_map_percentage_completion and the planners. The
+// callbacks and the main loop run on the same thread, so nothing is guarded.
+
+std::optional<uoe::MapMerger> merger;
+std::string frame_id = "world_enu";
+
+auto get_merged_map(octomap_msgs::GetOctomap::Request& request,
+                    octomap_msgs::GetOctomap::Response& response) -> bool {
+    response.map.header.frame_id = frame_id;
+    response.map.header.stamp = ros::Time::now();
+    return octomap_msgs::binaryMapToMsg(merger->map().octree(), response.map);
+}
+
+// the deltas received since the previous iteration of the main loop
+std::vector<uoe_msgs::MapDelta::ConstPtr> pending_deltas;
+auto delta_cb(const uoe_msgs::MapDelta::ConstPtr& delta) -> void {
+    pending_deltas.push_back(delta);
+}
+
+auto main(int argc, char* argv[]) -> int {
+    ros::init(argc, argv, "map_merger");
+    auto nh = ros::NodeHandle();
+    ros::Rate rate(uoe::utils::DEFAULT_LOOP_RATE);
+
+    // every drone has to build its object map with the same resolution and frame
+    auto resolution = 0.5;
+    nh.param("/uoe/object_map/resolution", resolution, resolution);
+    nh.param("/uoe/object_map/frame_id", frame_id, frame_id);
+    auto deltas_topic = std::string{"/uoe/object_map/deltas"};
+    nh.param("/uoe/object_map/deltas_topic", deltas_topic, deltas_topic);
+    // threads fusing the deltas, see uoe::MapMerger
+    auto n_shards = static_cast<int>(uoe::utils::concurrency::default_number_of_workers());
+    nh.param("/uoe/map_merger/shards", n_shards, n_shards);
+
+    merger.emplace(resolution, static_cast<unsigned int>(std::max(n_shards, 1)));
+    merger->map().enable_change_tracking();
+
+    auto merged_map_service = nh.advertiseService("/uoe/merged_object_map", get_merged_map);
+    auto pub_changes = nh.advertise<uoe_msgs::MapChange>("/uoe/merged_object_map/changes",
+                                                         uoe::utils::DEFAULT_QUEUE_SIZE);
+    // large enough to not drop the deltas of a fleet between two iterations of the main loop
+    auto sub_deltas = nh.subscribe<uoe_msgs::MapDelta>(
+        deltas_topic, 16 * uoe::utils::DEFAULT_QUEUE_SIZE, delta_cb);
+
+    // the seq of the last delta of each source, to notice lost deltas
+    auto last_seq = std::map<std::string, std::uint32_t>{};
+    auto deltas = std::vector<uoe::MapMerger::Delta>{};
+    while (ros::ok()) {
+        ros::spinOnce();
+
+        deltas.clear();
+        for (const auto& msg : pending_deltas) {
+            const auto fits = std::abs(msg->resolution - merger->resolution()) < 1e-6 &&
+                              msg->header.frame_id == frame_id &&
+                              msg->keys.size() == 3 * msg->log_odds.size();
+            if (! fits) {
+                ROS_WARN_STREAM_THROTTLE(10, "the deltas of "
+                                                 << msg->source << " are not of a map in "
+                                                 << frame_id << " with resolution " << resolution
+                                                 << ", they are not merged");
+                continue;
+            }
+            const auto [it, first] = last_seq.try_emplace(msg->source, msg->header.seq);
+            if (! first && msg->header.seq != it->second + 1) {
+                ROS_WARN_STREAM("lost " << msg->header.seq - it->second - 1 << " deltas of "
+                                        << msg->source
+                                        << ", the merged map lags until their voxels change");
+            }
+            it->second = msg->header.seq;
+            deltas.push_back({msg->source, msg->keys.data(), msg->log_odds.data(),
+                              msg->log_odds.size()});
+        }
+        if (! deltas.empty()) {
+            const auto n_changed = merger->merge(deltas);
+            ROS_DEBUG_STREAM("merged " << deltas.size() << " deltas, " << n_changed
+                                       << " voxels changed");
+        }
+        pending_deltas.clear();
+
+        if (const auto region = merger->map().dirty_region()) {
+            auto msg = uoe_msgs::MapChange{};
+            msg.n_changed_voxels = merger->map().n_changed_voxels();
+            merger->map().reset_changes();
+            msg.min.x = region->min().x();
+            msg.min.y = region->min().y();
+            msg.min.z = region->min().z();
+            msg.max.x = region->max().x();
+            msg.max.y = region->max().y();
+            msg.max.z = region->max().z();
+            msg.header.frame_id = frame_id;
+            msg.header.stamp = ros::Time::now();
+            pub_changes.publish(msg);
+        }
+        rate.sleep();
+    }
+
+    return 0;
+}
@@ -1,19 +1,33 @@
 #include <octomap_msgs/GetOctomap.h>
 #include <octomap_msgs/conversions.h>
 #include <octomap_server/OctomapServer.h>
-#include <pcl/PCLPointCloud2.h>
-#include <pcl/conversions.h>
-#include <pcl/filters/extract_indices.h>
-#include <pcl/point_cloud.h>
-#include <pcl/point_types.h>
 #include <ros/ros.h>
 #include <sensor_msgs/Image.h>
 #include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "uoe/depth_image.hpp"
 #include "uoe/octomap.hpp"
+#include "uoe/utils/concurrency.hpp"
 #include "uoe/utils/segmentation.hpp"
+#include "uoe/utils/transformlistener.hpp"
 #include "uoe/utils/utils.hpp"
 #include "uoe_msgs/ControllerStateStamped.h"
+#include "uoe_msgs/MapChange.h"
+#include "uoe_msgs/MapDelta.h"
 #include "uoe_msgs/Model.h"
 
 // zed-ros-wrapper
@@ -24,34 +38,265 @@
 // https://pointclouds.org/documentation/index.html
 // CITE
 
-// uoe::Octomap* object_map;
-// auto get_object_map(octomap_msgs::GetOctomap::Request& request, octomap_msgs::GetOctomap::Response& response) -> bool
-// {
-//     return octomap_msgs::binaryMapToMsg(object_map->octree(), response.map);
-// };
+/**
+ * @brief the object map, when it is built by this node from the filtered clouds, rather than by an
+ * octomap_server subscribed to /uoe/point_cloud/object. The workers insert into it, and the
+ * service callbacks serialize it, so it is guarded by the mutex.
+ */
+struct object_map_state {
+    std::mutex mutex;
+    std::optional<uoe::Octomap> map;
+    std::string frame_id;
+    // scans have been inserted with lazy_eval since the inner nodes were last updated
+    bool inner_occupancy_outdated = false;
+};
+object_map_state object_map;
+
+auto get_object_map(octomap_msgs::GetOctomap::Request& request,
+                    octomap_msgs::GetOctomap::Response& response) -> bool {
+    auto lock = std::scoped_lock{object_map.mutex};
+    if (! object_map.map) {
+        return false;
+    }
+    if (object_map.inner_occupancy_outdated) {
+        object_map.map->update_inner_occupancy();
+        object_map.inner_occupancy_outdated = false;
+    }
+    response.map.header.frame_id = object_map.frame_id;
+    response.map.header.stamp = ros::Time::now();
+    return octomap_msgs::binaryMapToMsg(object_map.map->octree(), response.map);
+}
+
+/**
+ * @brief insert the points of cloud into the object map, transformed to the frame of the map at
+ * the time the cloud was captured. The sensor is at the origin of the frame of the cloud.
+ * The inner nodes are only updated once the map is requested.
+ * @return false if the transform is not available.
+ */
+auto insert_into_object_map(const sensor_msgs::PointCloud2& cloud,
+                            uoe::utils::transform::TransformListener& tf_listener,
+                            double max_range) -> bool {
+    const auto cloud_to_map = tf_listener.lookup_isometry(
+        object_map.frame_id, cloud.header.frame_id, cloud.header.stamp);
+    if (! cloud_to_map) {
+        return false;
+    }
+
+    auto scan = octomap::Pointcloud{};
+    scan.reserve(std::size_t{cloud.width} * cloud.height);
+    auto x = sensor_msgs::PointCloud2ConstIterator<float>(cloud, "x");
+    auto y = sensor_msgs::PointCloud2ConstIterator<float>(cloud, "y");
+    auto z = sensor_msgs::PointCloud2ConstIterator<float>(cloud, "z");
+    for (; x != x.end(); ++x, ++y, ++z) {
+        if (! std::isfinite(*x) || ! std::isfinite(*y) || ! std::isfinite(*z)) {
+            continue;
+        }
+        const Eigen::Vector3f p = *cloud_to_map * Eigen::Vector3f{*x, *y, *z};
+        scan.push_back(p.x(), p.y(), p.z());
+    }
+
+    const auto& t = cloud_to_map->translation();
+    const auto origin = uoe::Octomap::point_type{t.x(), t.y(), t.z()};
+    auto lock = std::scoped_lock{object_map.mutex};
+    object_map.map->insert_point_cloud(scan, origin, max_range, true);
+    object_map.inner_occupancy_outdated = true;
+    return true;
+}
+
+/**
+ * @brief integrate the pixels of depth_image selected by mask into the object map projectively,
+ * see uoe::Octomap::integrate_depth_image(), at the time the image was captured. The depth image
+ * is a 32FC1 image in meters, in the optical frame of the camera.
+ * @return false if the transform is not available.
+ */
+auto integrate_into_object_map(const sensor_msgs::Image& depth_image,
+                               const std::vector<std::uint8_t>& mask,
+                               const uoe::PinholeCamera& camera,
+                               uoe::utils::transform::TransformListener& tf_listener) -> bool {
+    const auto camera_to_map = tf_listener.lookup_isometry(
+        object_map.frame_id, depth_image.header.frame_id, depth_image.header.stamp);
+    if (! camera_to_map) {
+        return false;
+    }
+    const auto image = uoe::DepthImageView{reinterpret_cast<const float*>(depth_image.data.data()),
+                                           depth_image.width, depth_image.height,
+                                           depth_image.step / sizeof(float), mask.data()};
+
+    auto lock = std::scoped_lock{object_map.mutex};
+    object_map.map->integrate_depth_image(image, camera, *camera_to_map, true);
+    object_map.inner_occupancy_outdated = true;
+    return true;
+}
 
-pcl::PointCloud<pcl::PointXYZ> unfiltered_point_cloud{};
 /**
- * @brief callback for /zed/rgb/image/rect/color converts sensor_msgs::PointCloud2 to pcl::PointCloud2
+ * @brief publishes the region of the object map that has changed since the previous call, if any
+ * has, and starts tracking changes anew. If pub_deltas is valid, the changed voxels themselves are
+ * published on it too, as a delta of the map of source, see uoe::MapMerger.
+ */
+auto publish_object_map_changes(const ros::Publisher& pub, const ros::Publisher& pub_deltas,
+                                const std::string& source) -> void {
+    auto msg = uoe_msgs::MapChange{};
+    auto delta = uoe_msgs::MapDelta{};
+    {
+        auto lock = std::scoped_lock{object_map.mutex};
+        const auto region = object_map.map->dirty_region();
+        if (! region) {
+            return;
+        }
+        if (pub_deltas) {
+            const auto& octree = object_map.map->octree();
+            const auto keys = object_map.map->changed_keys();
+            delta.keys.reserve(3 * keys.size());
+            delta.log_odds.reserve(keys.size());
+            for (const auto& key : keys) {
+                // changes are tracked at the leaves, whose log-odds are up to date with lazy_eval
+                if (const auto* node = octree.search(key)) {
+                    delta.keys.insert(delta.keys.end(), {key[0], key[1], key[2]});
+                    delta.log_odds.push_back(node->getLogOdds());
+                }
+            }
+        }
+        msg.n_changed_voxels = object_map.map->n_changed_voxels();
+        object_map.map->reset_changes();
+        const auto min = region->min();
+        const auto max = region->max();
+        msg.min.x = min.x();
+        msg.min.y = min.y();
+        msg.min.z = min.z();
+        msg.max.x = max.x();
+        msg.max.y = max.y();
+        msg.max.z = max.z();
+    }
+    msg.header.frame_id = object_map.frame_id;
+    msg.header.stamp = ros::Time::now();
+    pub.publish(msg);
+    if (pub_deltas) {
+        // per source, for a merger to tell if it missed any
+        static auto delta_seq = std::uint32_t{0};
+        delta.header = msg.header;
+        delta.header.seq = delta_seq++;
+        delta.source = source;
+        delta.resolution = object_map.map->resolution();
+        pub_deltas.publish(delta);
+    }
+}
+
+/**
+ * @brief the points of cloud whose pixel in mask is not background, written to filtered. The bytes
+ * of each point are copied as they are, so the fields of cloud are kept, and nothing is converted
+ * to or from a pcl::PointCloud. The points of a run of foreground pixels are copied a row at a
+ * time, as they are contiguous in cloud.
  *
- * @param cloud message from /zed/rgb/image/rect/color
+ * @param cloud an organized cloud, with a point per pixel of the image the mask was computed from
+ * @param mask the segmentation of that image, row major, either run length encoded or with a class
+ * per pixel in mask.data
+ * @param filtered reuses its buffer, so no allocation is needed once it has grown to the largest
+ * number of points kept so far.
+ * @return the number of points kept
+ */
+auto filter_point_cloud_by_mask(const sensor_msgs::PointCloud2& cloud,
+                                const uoe_msgs::Model::Response& mask,
+                                sensor_msgs::PointCloud2& filtered) -> std::size_t {
+    const auto n_points = std::size_t{cloud.width} * cloud.height;
+    const auto for_each_foreground_run = [&](auto&& f) {
+        if (! mask.run_lengths.empty()) {
+            uoe::utils::segmentation::for_each_foreground_run(mask.run_lengths, mask.run_classes,
+                                                              n_points, f);
+        } else {
+            uoe::utils::segmentation::for_each_foreground_run(mask.data, n_points, f);
+        }
+    };
+    auto n_kept = std::size_t{0};
+    for_each_foreground_run([&](std::size_t begin, std::size_t end) { n_kept += end - begin; });
+
+    filtered.header = cloud.header;
+    filtered.fields = cloud.fields;
+    filtered.is_bigendian = cloud.is_bigendian;
+    filtered.point_step = cloud.point_step;
+    filtered.is_dense = cloud.is_dense;
+    filtered.height = 1;
+    auto modifier = sensor_msgs::PointCloud2Modifier{filtered};
+    modifier.resize(n_kept);
+
+    const auto point_step = std::size_t{cloud.point_step};
+    const auto row_step = std::size_t{cloud.row_step};
+    auto out = filtered.data.data();
+    for_each_foreground_run([&](std::size_t begin, std::size_t end) {
+        while (begin < end) {
+            const auto row = begin / cloud.width;
+            const auto col = begin % cloud.width;
+            const auto n = std::min<std::size_t>(end - begin, cloud.width - col);
+            std::memcpy(out, &cloud.data[row * row_step + col * point_step], n * point_step);
+            out += n * point_step;
+            begin += n;
+        }
+    });
+
+    return n_kept;
+}
+
+// the most recent point clouds or depth images, oldest first, so an image can be paired with the
+// one captured at the same time rather than with the newest one. Only touched by the callbacks and
+// the main loop, which run on the same thread.
+std::deque<sensor_msgs::PointCloud2::ConstPtr> recent_point_clouds;
+std::deque<sensor_msgs::Image::ConstPtr> recent_depth_images;
+constexpr std::size_t MAX_RECENT_POINT_CLOUDS = 16;
+/**
+ * @brief callback for /camera/depth/points. Only the pointer to the message is kept.
+ *
+ * @param cloud message from /camera/depth/points
  * @return void
  */
 auto point_cloud_cb(const sensor_msgs::PointCloud2::ConstPtr& cloud) -> void {
-    // pcl::PCLPointCloud2::Ptr pc2{};
-    // pcl_conversions::toPCL(*cloud, *pc2);
-    // pcl::fromPCLPointCloud2(*pc2, *unfiltered_point_cloud);
-    // std::cout << cloud->data.size() << std::endl;
-    // for (auto& d : cloud->data) {
-    //     std::cout << d << std::endl;
-    // }
-    pcl::fromROSMsg(*cloud, unfiltered_point_cloud);
+    recent_point_clouds.push_back(cloud);
+    if (recent_point_clouds.size() > MAX_RECENT_POINT_CLOUDS) {
+        recent_point_clouds.pop_front();
+    }
 }
-sensor_msgs::Image raw_image;
-auto image_cb(const sensor_msgs::Image::ConstPtr& image) -> void {
-    // std::cout << image << std::endl;
-    raw_image = *image;
+/**
+ * @brief callback for the depth images, when they are integrated instead of the point clouds.
+ */
+auto depth_image_cb(const sensor_msgs::Image::ConstPtr& depth_image) -> void {
+    recent_depth_images.push_back(depth_image);
+    if (recent_depth_images.size() > MAX_RECENT_POINT_CLOUDS) {
+        recent_depth_images.pop_front();
+    }
 }
+sensor_msgs::Image::ConstPtr raw_image;
+auto image_cb(const sensor_msgs::Image::ConstPtr& image) -> void { raw_image = image; }
+
+/**
+ * @brief the recent message with the stamp closest to stamp, if it is at most max_difference
+ * seconds away. A max_difference <= 0 disables the time sync, and the newest message is used.
+ */
+template <typename MsgPtr>
+auto closest_in_time(const std::deque<MsgPtr>& recent, const ros::Time& stamp,
+                     double max_difference) -> MsgPtr {
+    if (recent.empty()) {
+        return nullptr;
+    }
+    if (max_difference <= 0) {
+        return recent.back();
+    }
+    const auto difference = [&](const MsgPtr& msg) {
+        return std::abs((msg->header.stamp - stamp).toSec());
+    };
+    const auto closest =
+        *std::min_element(recent.begin(), recent.end(), [&](const auto& a, const auto& b) {
+            return difference(a) < difference(b);
+        });
+    return difference(closest) <= max_difference ? closest : nullptr;
+}
+
+/**
+ * @brief an image and the point cloud or depth image captured with it, on their way through
+ * segmentation.
+ */
+struct frame {
+    sensor_msgs::Image::ConstPtr image;
+    sensor_msgs::PointCloud2::ConstPtr point_cloud;
+    sensor_msgs::Image::ConstPtr depth_image;
+};
 
 auto main(int argc, char* argv[]) -> int {
     // ros
@@ -77,64 +322,175 @@ auto main(int argc, char* argv[]) -> int {
     auto pub_pointcloud =
         nh.advertise<sensor_msgs::PointCloud2>("/uoe/point_cloud/object", uoe::utils::DEFAULT_QUEUE_SIZE);
 
-    auto client_model = nh.serviceClient<uoe_msgs::Model>("/uoe/semantic_segmentation");
+    // build the object map in this node, and serve it on /uoe/object_map, instead of publishing
+    // every filtered cloud for an octomap_server to build it. Saves serializing each cloud, and
+    // the octomap_server deserializing it again.
+    auto insert_in_process = false;
+    nh.param("/uoe/object_map/insert_in_process", insert_in_process, insert_in_process);
+    auto map_resolution = 0.5;
+    nh.param("/uoe/object_map/resolution", map_resolution, map_resolution);
+    object_map.frame_id = "world_enu";
+    nh.param("/uoe/object_map/frame_id", object_map.frame_id, object_map.frame_id);
+    // same range as the sensor model of the octomap_server
+    auto max_range = 15.0;
+    nh.param("/uoe/object_map/max_range", max_range, max_range);
 
-    // object_map = new uoe::Octomap{resolution, thresh_prob_min, thresh_prob_max};
+    // integrate the depth images of the camera into the object map projectively, instead of
+    // inserting the filtered point clouds converted from them. Only when inserting in process.
+    auto integrate_depth_images = false;
+    nh.param("/uoe/object_map/integrate_depth_images", integrate_depth_images,
+             integrate_depth_images);
+    integrate_depth_images = integrate_depth_images && insert_in_process;
+    auto depth_image_topic = std::string{"/airsim_node/PX4/rgbd_camera/DepthPlanar"};
+    nh.param("/uoe/object_map/depth_image_topic", depth_image_topic, depth_image_topic);
+    auto sub_depth_image = ros::Subscriber{};
+    auto camera_param = std::map<std::string, float>{};
+    if (integrate_depth_images) {
+        sub_depth_image = nh.subscribe<sensor_msgs::Image>(
+            depth_image_topic, uoe::utils::DEFAULT_QUEUE_SIZE, depth_image_cb);
+        nh.getParam("/uoe/camera", camera_param);
+    }
+    // the intrinsics of an image from the field of view of rosparam/camera.yaml
+    const auto camera_for = [&](const sensor_msgs::Image& depth_image) {
+        const auto param = [&](const std::string& name, float fallback) {
+            const auto it = camera_param.find(name);
+            return it != camera_param.end() ? it->second : fallback;
+        };
+        return uoe::PinholeCamera::from_fov(
+            depth_image.width, depth_image.height, param("horisontal_fov", 90),
+            param("vertical_fov", 60), param("depth_min", 0.1f),
+            std::min(param("depth_max", 15), static_cast<float>(max_range)));
+    };
 
-    // nh.advertiseService<octomap_msgs::GetOctomap::Request, octomap_msgs::GetOctomap::Response>("/uoe/object_map",
-    //    get_object_map);
+    auto tf_listener = std::optional<uoe::utils::transform::TransformListener>{};
+    auto object_map_service = ros::ServiceServer{};
+    // the regions the inserted clouds have changed, published once per iteration of the main loop
+    auto pub_object_map_changes = ros::Publisher{};
+    // and the changed voxels, for a map_merger to fuse the object maps of a fleet, identified by
+    // the name of this node unless /uoe/object_map/source is set
+    auto publish_deltas = false;
+    nh.param("/uoe/object_map/publish_deltas", publish_deltas, publish_deltas);
+    auto deltas_topic = std::string{"/uoe/object_map/deltas"};
+    nh.param("/uoe/object_map/deltas_topic", deltas_topic, deltas_topic);
+    auto source = ros::this_node::getName();
+    nh.param("/uoe/object_map/source", source, source);
+    auto pub_object_map_deltas = ros::Publisher{};
+    if (insert_in_process) {
+        object_map.map.emplace(map_resolution);
+        object_map.map->enable_change_tracking();
+        tf_listener.emplace();
+        object_map_service = nh.advertiseService("/uoe/object_map", get_object_map);
+        pub_object_map_changes = nh.advertise<uoe_msgs::MapChange>(
+            "/uoe/object_map/changes", uoe::utils::DEFAULT_QUEUE_SIZE);
+        if (publish_deltas) {
+            pub_object_map_deltas = nh.advertise<uoe_msgs::MapDelta>(
+                deltas_topic, uoe::utils::DEFAULT_QUEUE_SIZE);
+        }
+    }
+
+    // number of frames being segmented at the same time. Each is handled by its own thread, so
+    // throughput is bounded by the latency of the segmentation model, not the sum of every stage.
+    auto max_frames_in_flight = 2;
+    nh.param("/uoe/object_map/max_frames_in_flight", max_frames_in_flight, max_frames_in_flight);
+    // max difference in seconds between the stamps of an image and its point cloud
+    auto max_stamp_difference = 0.1;
+    nh.param("/uoe/object_map/max_stamp_difference", max_stamp_difference, max_stamp_difference);
 
     ros::service::waitForService("/uoe/semantic_segmentation");
-    while (ros::ok()) {
-        // point cloud filter with model output
-        auto current_image = raw_image;
-        auto id = current_image.header.seq;
-        auto current_point_cloud = unfiltered_point_cloud;
 
+    auto frames_in_flight = std::atomic<int>{0};
+    const auto segment_and_publish = [&](frame& f) {
         uoe_msgs::Model srv;
-        srv.request.image = current_image;
-        // std::cout << srv.request.image << std::endl;
-
-        // using pcl library to filter point cloud
-        ROS_INFO("Requesting classification mask");
-        if (client_model.call(srv) && srv.response.successful) {
-            ROS_INFO_STREAM("Received Point Cloud size: " << unfiltered_point_cloud.points.size());
-            ROS_INFO_STREAM("Received size: " << srv.response.data.size());
-            // for (auto& d : srv.response.data) {
-            //     std::cout << d << std::endl;
-            // }
-            // fill the filter with the segmented indices from the model output
-            auto indices_filter = std::make_shared<pcl::PointIndices>();
-            if (indices_filter.get() == nullptr) {
-                ROS_INFO_STREAM("NULLPOINTER");
-            }
-            for (int i = 0; i < srv.response.data.size(); i++) {
-                if (srv.response.data[i] != uoe::utils::segmentation::BACKGROUND) {
-                    indices_filter->indices.push_back(i);
+        srv.request.image = *f.image;
+        srv.request.run_length_encoded = true;
+
+        ROS_INFO_STREAM("Requesting classification mask for frame " << f.image->header.seq);
+        // a client per call, as the workers call the service concurrently
+        if (! ros::service::call("/uoe/semantic_segmentation", srv) || ! srv.response.successful) {
+            --frames_in_flight;
+            return;
+        }
+        if (f.depth_image != nullptr) {
+            const auto& depth_image = *f.depth_image;
+            if (depth_image.encoding != "32FC1" || depth_image.width != srv.response.width ||
+                depth_image.height != srv.response.height) {
+                ROS_WARN_STREAM("the depth image is not a 32FC1 image of the size of the mask, it "
+                                "is not integrated");
+            } else {
+                // the mask as a byte per pixel, as the integrator looks it up per voxel
+                thread_local auto mask = std::vector<std::uint8_t>{};
+                const auto n_pixels = std::size_t{depth_image.width} * depth_image.height;
+                mask.assign(n_pixels, 0);
+                const auto select = [&](std::size_t begin, std::size_t end) {
+                    std::fill(mask.begin() + begin, mask.begin() + end, 1);
+                };
+                if (! srv.response.run_lengths.empty()) {
+                    uoe::utils::segmentation::for_each_foreground_run(
+                        srv.response.run_lengths, srv.response.run_classes, n_pixels, select);
+                } else {
+                    uoe::utils::segmentation::for_each_foreground_run(srv.response.data,
+                                                                      n_pixels, select);
+                }
+                if (! integrate_into_object_map(depth_image, mask, camera_for(depth_image),
+                                                *tf_listener)) {
+                    ROS_WARN_STREAM("no transform from " << depth_image.header.frame_id << " to "
+                                                         << object_map.frame_id
+                                                         << ", the depth image is not integrated");
                 }
             }
-            ROS_INFO_STREAM("Filter size: " << indices_filter->indices.size());
-
-            // construct index filter
-            auto filter = pcl::ExtractIndices<pcl::PointXYZ>();
-            filter.setInputCloud(std::make_shared<pcl::PointCloud<pcl::PointXYZ>>(unfiltered_point_cloud));
-            filter.setIndices(indices_filter);
-            // perform filtration and output to filtered cloud
-            auto filtered_cloud = pcl::PointCloud<pcl::PointXYZ>{};
-            filter.filter(filtered_cloud);
-
-            ROS_INFO_STREAM("Filtered point cloud size: " << filtered_cloud.points.size());
-
-            // inserting the filtered point cloud
-            // object_map->insert_points(filtered_cloud->points);
-            auto pcl2 = pcl::PCLPointCloud2{};
-            pcl::toPCLPointCloud2(filtered_cloud, pcl2);
-
-            auto msg = sensor_msgs::PointCloud2{};
-            pcl::toROSMsg(filtered_cloud, msg);
-            pub_pointcloud.publish(msg);
+        } else {
+            const auto n_points = std::size_t{f.point_cloud->width} * f.point_cloud->height;
+            ROS_INFO_STREAM("Received Point Cloud size: " << n_points);
+            ROS_INFO_STREAM("Received runs: " << srv.response.run_lengths.size());
+
+            // each worker reuses its own buffer
+            thread_local auto filtered_cloud = sensor_msgs::PointCloud2{};
+            const auto n_kept =
+                filter_point_cloud_by_mask(*f.point_cloud, srv.response, filtered_cloud);
+            ROS_INFO_STREAM("Filtered point cloud size: " << n_kept);
+
+            if (insert_in_process &&
+                ! insert_into_object_map(filtered_cloud, *tf_listener, max_range)) {
+                ROS_WARN_STREAM("no transform from " << filtered_cloud.header.frame_id << " to "
+                                                     << object_map.frame_id
+                                                     << ", the cloud is not inserted");
+            }
+            if (! insert_in_process || pub_pointcloud.getNumSubscribers() > 0) {
+                pub_pointcloud.publish(filtered_cloud);
+            }
         }
+        --frames_in_flight;
+    };
+    const auto n_workers = static_cast<unsigned int>(std::max(max_frames_in_flight, 1));
+    auto segmentation_pool =
+        uoe::utils::concurrency::WorkerPool<frame>(n_workers, n_workers, segment_and_publish);
+
+    auto last_submitted_seq = std::optional<std::uint32_t>{};
+    while (ros::ok()) {
         ros::spinOnce();
+
+        // the newest image is submitted once it has a point cloud and a worker is free. Images
+        // arriving while all workers are busy are skipped, rather than queued up.
+        const auto image = raw_image;
+        if (image != nullptr && image->header.seq != last_submitted_seq &&
+            frames_in_flight.load() < static_cast<int>(n_workers)) {
+            if (integrate_depth_images) {
+                if (const auto depth_image = closest_in_time(
+                        recent_depth_images, image->header.stamp, max_stamp_difference)) {
+                    last_submitted_seq = image->header.seq;
+                    ++frames_in_flight;
+                    segmentation_pool.submit(frame{image, nullptr, depth_image});
+                }
+            } else if (const auto cloud = closest_in_time(recent_point_clouds, image->header.stamp,
+                                                          max_stamp_difference)) {
+                last_submitted_seq = image->header.seq;
+                ++frames_in_flight;
+                segmentation_pool.submit(frame{image, cloud, nullptr});
+            }
+        }
+        if (insert_in_process) {
+            publish_object_map_changes(pub_object_map_changes, pub_object_map_deltas, source);
+        }
         rate.sleep();
     }
 
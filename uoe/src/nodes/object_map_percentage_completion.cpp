@@ -2,8 +2,12 @@
 #include <ros/ros.h>
 
 #include <cmath>
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "uoe/octomap.hpp"
 #include "uoe/utils/utils.hpp"
@@ -14,12 +18,14 @@
 
 std::unique_ptr<ros::ServiceClient> get_octomap_client;
 
-auto call_get_octomap() -> uoe::Octomap* {
+auto call_get_octomap() -> std::optional<octomap_msgs::Octomap> {
     auto request = octomap_msgs::GetOctomap::Request{};  // empty request
     auto response = octomap_msgs::GetOctomap::Response{};
 
-    get_octomap_client->call(request, response);
-    return response.map.data.size() == 0 ? nullptr : new uoe::Octomap{response.map};
+    if (! get_octomap_client->call(request, response) || response.map.data.empty()) {
+        return std::nullopt;
+    }
+    return std::move(response.map);
 }
 
 auto main(int argc, char* argv[]) -> int {
@@ -62,16 +68,26 @@ auto main(int argc, char* argv[]) -> int {
         // ros::Rate(uoe::utils::DEFAULT_LOOP_RATE).sleep();
     };
 
-    while (ros::ok()) {
-        if (auto octomap = call_get_octomap()) {
-            ROS_INFO_STREAM("calculating object map completeness...");
-
-            // calculate the total volume of the received object map
-            const auto volume_total = octomap->compute_total_volume_of_occupied_voxels();
-            std::cout << topic << " | " << volume_total << std::endl;
-            publish_object_map_completeness(volume_total);
+    // the map only changes when a drone inserts a new scan, so most of the time it is the same as
+    // in the previous loop. The volume is only recomputed, and published, when it has changed.
+    auto previous_map_data = std::vector<std::int8_t>{};
+    auto previous_volume = std::optional<double>{};
 
-            delete octomap;
+    while (ros::ok()) {
+        if (auto map = call_get_octomap()) {
+            if (map->data != previous_map_data) {
+                ROS_INFO_STREAM("calculating object map completeness...");
+
+                // calculate the total volume of the received object map
+                const auto octomap = uoe::Octomap{*map};
+                const auto volume_total = octomap.compute_total_volume_of_occupied_voxels();
+                if (volume_total != previous_volume) {
+                    std::cout << topic << " | " << volume_total << std::endl;
+                    publish_object_map_completeness(volume_total);
+                    previous_volume = volume_total;
+                }
+                previous_map_data = std::move(map->data);
+            }
         } else {
             ROS_WARN_STREAM("no object map received by service on topic "
                             << object_map_client_topic_name);
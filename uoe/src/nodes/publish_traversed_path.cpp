@@ -2,50 +2,161 @@
 #include <nav_msgs/Path.h>
 #include <ros/ros.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <deque>
+#include <eigen3/Eigen/Core>
+#include <utility>
+#include <vector>
+
 #include "uoe/utils/utils.hpp"
 #include "uoe_msgs/MissionStateStamped.h"
 
+/**
+ * @brief a path of at most capacity poses, decimated as they are added: a pose is only kept if the
+ * path has moved max_distance since the last kept pose, or turned more than max_angle after moving
+ * at least min_distance, so straight stretches are a few poses, and turns keep their shape. Once
+ * full, the oldest poses are dropped, so memory and the size of the path stay bounded however long
+ * a mission is.
+ */
+class decimated_path final {
+   public:
+    struct options {
+        double min_distance = 0.1;
+        double max_distance = 1.0;
+        double max_angle = 10.0 * M_PI / 180.0;  // radians
+        std::size_t capacity = 10000;
+    };
+
+    explicit decimated_path(options opts) : options_{opts} {}
+
+    /**
+     * @return if the pose was kept
+     */
+    auto add(const geometry_msgs::PoseStamped& pose) -> bool {
+        if (! poses_.empty() && ! keep_(pose)) {
+            return false;
+        }
+        poses_.push_back(pose);
+        if (poses_.size() > options_.capacity) {
+            poses_.pop_front();
+        }
+        ++n_added_;
+        return true;
+    }
+
+    /**
+     * @brief the poses kept since the previous segment, preceded by the last pose of it, so the
+     * segments join up. Empty if no pose has been kept since.
+     */
+    auto take_segment() -> std::vector<geometry_msgs::PoseStamped> {
+        const auto n_new = std::min(n_added_ - n_taken_, poses_.size());
+        if (n_new == 0) {
+            return {};
+        }
+        const auto n = std::min(n_new + (n_taken_ > 0 ? 1 : 0), poses_.size());
+        n_taken_ = n_added_;
+        return {poses_.end() - static_cast<std::ptrdiff_t>(n), poses_.end()};
+    }
+
+    [[nodiscard]] auto poses() const -> std::vector<geometry_msgs::PoseStamped> {
+        return {poses_.begin(), poses_.end()};
+    }
+
+   private:
+    options options_;
+    std::deque<geometry_msgs::PoseStamped> poses_{};
+    std::size_t n_added_ = 0;  // over the lifetime of the path, including the dropped poses
+    std::size_t n_taken_ = 0;
+
+    static auto position_(const geometry_msgs::PoseStamped& pose) -> Eigen::Vector3d {
+        return {pose.pose.position.x, pose.pose.position.y, pose.pose.position.z};
+    }
+
+    [[nodiscard]] auto keep_(const geometry_msgs::PoseStamped& pose) const -> bool {
+        const Eigen::Vector3d last = position_(poses_.back());
+        const Eigen::Vector3d step = position_(pose) - last;
+        const auto distance = step.norm();
+        if (distance >= options_.max_distance) {
+            return true;
+        }
+        if (distance < options_.min_distance || poses_.size() < 2) {
+            return false;
+        }
+        const Eigen::Vector3d previous = last - position_(poses_[poses_.size() - 2]);
+        if (previous.isZero()) {
+            return false;
+        }
+        const auto cos_angle = previous.dot(step) / (previous.norm() * distance);
+        return std::acos(std::clamp(cos_angle, -1.0, 1.0)) > options_.max_angle;
+    }
+};
+
 auto main(int argc, char* argv[]) -> int {
     ros::init(argc, argv, "publish_traversed_path");
     auto nh = ros::NodeHandle();
-    auto spin_rate = ros::Rate(uoe::utils::DEFAULT_LOOP_RATE);
 
-    auto path_est = nav_msgs::Path{};
-    auto path_target = nav_msgs::Path{};
-    path_est.header.frame_id = uoe::utils::FRAME_WORLD;
-    path_target.header.frame_id = uoe::utils::FRAME_WORLD;
+    auto opts = decimated_path::options{};
+    nh.param("/uoe/traversed_path/min_distance", opts.min_distance, opts.min_distance);
+    nh.param("/uoe/traversed_path/max_distance", opts.max_distance, opts.max_distance);
+    auto max_angle_degrees = opts.max_angle * 180.0 / M_PI;
+    nh.param("/uoe/traversed_path/max_angle", max_angle_degrees, max_angle_degrees);
+    opts.max_angle = max_angle_degrees * M_PI / 180.0;
+    auto capacity = static_cast<int>(opts.capacity);
+    nh.param("/uoe/traversed_path/capacity", capacity, capacity);
+    opts.capacity = static_cast<std::size_t>(std::max(capacity, 2));
+    // how often the full paths are published, in seconds. 0 only publishes the segments.
+    auto full_path_period = 10.0;
+    nh.param("/uoe/traversed_path/full_path_period", full_path_period, full_path_period);
+
+    auto path_est = decimated_path(opts);
+    auto path_target = decimated_path(opts);
 
     auto sub_odom = nh.subscribe<geometry_msgs::PoseStamped>(
         "/mavros/local_position/pose", 10,
-        [&path_est](const geometry_msgs::PoseStamped::ConstPtr& msg) { path_est.poses.push_back(*msg); });
+        [&path_est](const geometry_msgs::PoseStamped::ConstPtr& msg) { path_est.add(*msg); });
     auto sub_target = nh.subscribe<uoe_msgs::MissionStateStamped>(
         "/uoe/state", 10, [&path_target](const uoe_msgs::MissionStateStamped::ConstPtr& msg) {
             geometry_msgs::PoseStamped pose;
             pose.header = msg->header;
             pose.pose = msg->target;
-            path_target.poses.push_back(pose);
+            path_target.add(pose);
         });
 
-    auto pub_path_est = nh.advertise<nav_msgs::Path>("/uoe/paths/estimated", 10);
-    auto pub_path_target = nh.advertise<nav_msgs::Path>("/uoe/paths/target", 10);
-    auto seq_est = 0;
-    auto seq_target = 0;
+    // the full paths are latched, so a subscriber, e.g. rviz, gets the latest one when it connects,
+    // and the segments since then after it
+    auto pub_path_est = nh.advertise<nav_msgs::Path>("/uoe/paths/estimated", 1, true);
+    auto pub_path_target = nh.advertise<nav_msgs::Path>("/uoe/paths/target", 1, true);
+    auto pub_segment_est = nh.advertise<nav_msgs::Path>("/uoe/paths/estimated/segment", 10);
+    auto pub_segment_target = nh.advertise<nav_msgs::Path>("/uoe/paths/target/segment", 10);
 
-    auto publish = [&](auto& msg, ros::Publisher& publisher, int seq) {
-        msg.header.seq = seq;
+    const auto publish = [](std::vector<geometry_msgs::PoseStamped> poses,
+                            const ros::Publisher& publisher) {
+        auto msg = nav_msgs::Path{};
+        msg.header.frame_id = uoe::utils::FRAME_WORLD;
         msg.header.stamp = ros::Time::now();
+        msg.poses = std::move(poses);
         publisher.publish(msg);
-        ROS_INFO("published path");
-        ros::spinOnce();
-        spin_rate.sleep();
-        // path_est.poses.clear();
     };
 
+    auto last_full_path = ros::Time(0);
     auto publish_rate = ros::Rate(5);
     while (ros::ok()) {
+        ros::spinOnce();
+        if (auto segment = path_est.take_segment(); ! segment.empty()) {
+            publish(std::move(segment), pub_segment_est);
+        }
+        if (auto segment = path_target.take_segment(); ! segment.empty()) {
+            publish(std::move(segment), pub_segment_target);
+        }
+        if (full_path_period > 0 &&
+            (ros::Time::now() - last_full_path).toSec() >= full_path_period) {
+            publish(path_est.poses(), pub_path_est);
+            publish(path_target.poses(), pub_path_target);
+            last_full_path = ros::Time::now();
+        }
         publish_rate.sleep();
-        publish(path_est, pub_path_est, seq_est++);
-        publish(path_target, pub_path_target, seq_target++);
     }
 
     return 0;
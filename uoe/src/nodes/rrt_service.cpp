@@ -1,3 +1,4 @@
+#include <diagnostic_msgs/DiagnosticArray.h>
 #include <octomap/OcTree.h>
 #include <octomap_msgs/BoundingBoxQuery.h>
 #include <octomap_msgs/GetOctomap.h>
@@ -8,28 +9,55 @@
 #include <visualization_msgs/MarkerArray.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
 #include <eigen3/Eigen/Core>
 #include <functional>
+#include <future>
 #include <iostream>
 #include <iterator>
 #include <limits>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
 #include <vector>
 
 // #include "Eigen/src/Geometry/AngleAxis.h"
 #include "uoe/bbx.hpp"
+#include "uoe/coarse_free_space.hpp"
 #include "uoe/common_headers.hpp"
 #include "uoe/common_types.hpp"
+#include "uoe/esdf.hpp"
+#include "uoe/inflated_occupancy.hpp"
+#include "uoe/frontiers.hpp"
 #include "uoe/gain.hpp"
+#include "uoe/gain_cache.hpp"
 #include "uoe/octomap.hpp"
+#include "uoe/octomap_cache.hpp"
+#include "uoe/octomap_snapshot.hpp"
+#include "uoe/planner_recording.hpp"
+#include "uoe/point_grid.hpp"
+#include "uoe/rrt/portfolio.hpp"
+#include "uoe/rrt/roadmap.hpp"
 #include "uoe/rrt/rrt.hpp"
 #include "uoe/rrt/rrt_builder.hpp"
+#include "uoe/rrt_service.hpp"
+#include "uoe/utils/concurrency.hpp"
 #include "uoe/utils/rviz.hpp"
+#include "uoe/utils/trace.hpp"
 #include "uoe/utils/transform.hpp"
 #include "uoe/utils/utils.hpp"
 #include "uoe_msgs/FoVGainMetric.h"
 #include "uoe_msgs/NBV.h"
+#include "uoe_msgs/PlannerStats.h"
 #include "uoe_msgs/RrtFindPath.h"
 #include "octomap/octomap_types.h"
 #include "ros/duration.h"
@@ -38,6 +66,7 @@
 #include "ros/rate.h"
 #include "ros/service_client.h"
 #include "ros/service_server.h"
+#include "ros/subscriber.h"
 #include "ros/time.h"
 
 #ifdef VISUALIZE_MARKERS_IN_RVIZ
@@ -49,12 +78,19 @@ std::unique_ptr<ros::Publisher> marker_array_pub;
 std::unique_ptr<ros::Publisher> rrt_marker_array_pub;
 std::unique_ptr<ros::Publisher> exclusion_marker_array_pub;
 
+// the markers of every request are collected by these, and published at most MARKER_RATE times a
+// second, so the callbacks of the rrt neither publish nor wait
+constexpr auto MARKER_RATE = 10.0;
+std::unique_ptr<uoe::utils::rviz::marker_aggregator> rrt_markers;
+std::unique_ptr<uoe::utils::rviz::marker_aggregator> unknown_voxel_markers;
+std::unique_ptr<uoe::utils::rviz::marker_aggregator> exclusion_markers;
+
 // marker_array.markers
 // visualization_msgs::MarkerArray marker_array;
 
 #endif  // VISUALIZE_MARKERS_IN_RVIZ
 static constexpr auto MARKER_TIMEOUT = 10;
-double voxel_resolution = 0.5;
+std::atomic<double> voxel_resolution{0.5};
 using namespace std::string_literals;
 using vec3 = Eigen::Vector3f;
 
@@ -66,7 +102,214 @@ using namespace uoe::types;
 std::unique_ptr<ros::ServiceClient> clear_octomap_client, clear_region_of_octomap_client,
     get_octomap_client;
 
+std::unique_ptr<ros::Subscriber> octomap_sub;
+
 std::unique_ptr<ros::Publisher> nbv_metric_pub;
+
+// number of threads scoring nbv candidates, 0 scores them on the thread growing the tree
+unsigned int nbv_worker_threads = uoe::utils::concurrency::default_number_of_workers();
+constexpr std::size_t NBV_CANDIDATES_QUEUED_PER_WORKER = 4;
+// if > 0 (meters), nbv candidates within the same cell of this size share a gain, instead of
+// each being scored. Their FoVs all look at the target, so they nearly coincide.
+double nbv_gain_cache_quantum = 0.0;
+// number of nbv candidates scored together, with a single traversal of the octomap for the batch
+unsigned int nbv_gain_batch_size = 1;
+// skip the gain of nbv candidates whose upper bound, see uoe::gain_upper_bound, can neither beat
+// the best gain so far nor reach the gain of interest threshold. The nbv found is the same.
+bool nbv_gain_bound = true;
+// plan paths with RRT*, which makes the waypoint optimization pass unnecessary
+bool use_rrt_star = false;
+// defer collision checks of find_path edges until they end up on the path to the goal. Not used
+// for nbv requests, where every node is scored, and a node in collision is a wasted FoV gain.
+bool use_lazy_collision_checking = false;
+// grow trees from both the start and the goal of find_path requests (RRT-Connect)
+bool use_rrt_connect = false;
+// find_path grows this many independently seeded trees in parallel, see uoe::rrt::run_portfolio.
+// With a deadline > 0 (seconds) the shortest path found within it is returned, otherwise the
+// first one.
+int portfolio_trees = 1;
+double portfolio_deadline = 0.0;
+// if > 0 (seconds), a find_path request gives up after this long, and responds with the path to
+// the node nearest to the goal, and found_path false.
+double find_path_time_budget = 0.0;
+// spend the rest of the time budget shortening the path found, see uoe::rrt::RRT::run_until
+bool use_informed_sampling = false;
+// check edges against a distance field built from the octomap, instead of raycasting it
+bool use_esdf = false;
+double esdf_max_distance = 5.0;
+
+struct esdf_state {
+    std::shared_ptr<uoe::Esdf> esdf;
+    // the map the field is in sync with
+    std::shared_ptr<const uoe::Octomap> octomap;
+};
+esdf_state esdf_cache;
+
+// check edges as a single ray through an occupancy layer built from the octomap, with the space
+// that is not free grown by inflated_occupancy_clearance (meters), see uoe::InflatedOccupancy.
+// Drones wider than the clearance fall back to the other checks. The default fits the drone of
+// rosparam/drone.yaml.
+bool use_inflated_occupancy = false;
+double inflated_occupancy_clearance = 1.5;
+
+struct inflated_occupancy_state {
+    std::shared_ptr<uoe::InflatedOccupancy> inflated;
+    // the map the layer is in sync with
+    std::shared_ptr<const uoe::Octomap> octomap;
+};
+inflated_occupancy_state inflated_occupancy_cache;
+
+// raycast a flat copy of the octomap, taken once per map, instead of the octree
+bool use_octomap_snapshot = false;
+
+struct snapshot_state {
+    std::shared_ptr<const uoe::OctomapSnapshot> snapshot;
+    // the map the snapshot was taken of
+    std::shared_ptr<const uoe::Octomap> octomap;
+};
+snapshot_state snapshot_cache;
+
+// if > 0, accept edges through cells of this many levels above the leaves of the octomap that are
+// known to be entirely free, and only raycast the edges near obstacles or unknown space, see
+// uoe::CoarseFreeSpace. The cell edge is the resolution times 2^levels.
+unsigned int coarse_collision_levels = 0;
+
+struct coarse_free_space_state {
+    std::shared_ptr<const uoe::CoarseFreeSpace> coarse;
+    // the map the cells were built from, which they reference
+    std::shared_ptr<const uoe::Octomap> octomap;
+};
+coarse_free_space_state coarse_free_space_cache;
+
+// with this probability, a nbv tree samples near the frontiers of the explored space facing the
+// target of the request, instead of anywhere, see uoe::Frontiers. 0 turns it off.
+double nbv_frontier_bias = 0.0;
+
+struct frontiers_state {
+    std::shared_ptr<uoe::Frontiers> frontiers;
+    // the map the frontiers are in sync with
+    std::shared_ptr<const uoe::Octomap> octomap;
+};
+frontiers_state frontiers_cache;
+
+// answer find_path requests with an A* query over a roadmap of the environment, kept across
+// requests, see uoe::rrt::Roadmap, and only grow an rrt for the requests it can not answer. The
+// roadmap is built in the background, from the first map, and again whenever the map outgrows it.
+bool use_roadmap = false;
+unsigned int roadmap_vertices = 2000;
+double roadmap_connection_radius = 4.0;
+
+struct roadmap_state {
+    std::shared_ptr<uoe::rrt::Roadmap> roadmap;
+    // the map the edges of the roadmap were checked against, and the drone they were checked for
+    std::shared_ptr<const uoe::Octomap> octomap;
+    std::array<double, 3> drone_size{};
+    // the roadmap being built, and the map it is built from
+    std::future<std::shared_ptr<uoe::rrt::Roadmap>> building;
+    std::shared_ptr<const uoe::Octomap> building_from;
+};
+roadmap_state roadmap_cache;
+// guards roadmap_cache, for the whole of a query, as queries mark the edges they check
+std::mutex roadmap_mutex;
+// guards esdf_cache, inflated_occupancy_cache, snapshot_cache, coarse_free_space_cache and
+// frontiers_cache, which concurrent requests share
+std::mutex map_views_mutex;
+
+// number of threads serving requests. With more than one, the requests of several drones are
+// planned at the same time, against the same read-only octomap. Each drone, see
+// DroneConfig::id, keeps its own warm-started nbv tree.
+int spinner_threads = 1;
+// keep the nbv of a drone out of the viewpoints last chosen for the other drones, the same way
+// it is kept out of its own excluded_points
+bool fleet_exclusion = true;
+
+// time the stages of the planner, see uoe/utils/trace.hpp, and publish their aggregates on
+// /diagnostics. The latest events are written to trace_file on shutdown, if it is set.
+bool trace = false;
+std::string trace_file{};
+constexpr auto TRACE_DIAGNOSTICS_PERIOD = 1.0;  // seconds
+
+// if set, every request is recorded to this directory, with the octomap it was planned against,
+// so it can be replayed offline, see uoe/planner_recording.hpp
+std::string record_dir{};
+std::unique_ptr<uoe::recording::recorder> recorder;
+// if >= 0, the trees of the i'th request are seeded with seed + i, so replaying the same
+// requests grows the same trees. Otherwise every tree is seeded randomly.
+int seed = -1;
+std::atomic<std::uint64_t> n_seeded_requests{0};
+
+auto next_seed() -> std::optional<std::uint64_t> {
+    if (seed < 0) {
+        return std::nullopt;
+    }
+    return static_cast<std::uint64_t>(seed) + n_seeded_requests.fetch_add(1);
+}
+
+auto trace_diagnostics() -> diagnostic_msgs::DiagnosticArray {
+    auto msg = diagnostic_msgs::DiagnosticArray{};
+    msg.header.stamp = ros::Time::now();
+    const auto summary = uoe::utils::trace::summary();
+    for (std::size_t i = 0; i < summary.size(); ++i) {
+        const auto& s = summary[i];
+        auto status = diagnostic_msgs::DiagnosticStatus{};
+        status.level = diagnostic_msgs::DiagnosticStatus::OK;
+        status.name = "rrt_service: "s + uoe::utils::trace::STAGE_NAMES[i];
+        status.hardware_id = ros::this_node::getName();
+        status.message = std::to_string(s.calls) + " calls";
+        const auto add = [&](const std::string& key, double value) {
+            auto kv = diagnostic_msgs::KeyValue{};
+            kv.key = key;
+            kv.value = std::to_string(value);
+            status.values.push_back(kv);
+        };
+        add("calls", static_cast<double>(s.calls));
+        add("count", static_cast<double>(s.count));
+        add("total_ms", static_cast<double>(s.total_ns) / 1e6);
+        add("mean_us", s.calls > 0 ? static_cast<double>(s.total_ns) / s.calls / 1e3 : 0.0);
+        add("max_us", static_cast<double>(s.max_ns) / 1e3);
+        msg.status.push_back(status);
+    }
+    return msg;
+}
+
+// consecutive nbv requests during an inspection mostly differ in where the drone is, so the tree
+// of the previous request is kept, re-rooted at the new start, and pruned where the octomap has
+// changed. Gains are only recomputed for nodes whose FoV overlaps the changed region.
+bool nbv_warm_start = true;
+// the tree is discarded once it has grown to this many times max_iterations
+constexpr std::size_t NBV_WARM_START_MAX_TREE_GROWTH = 4;
+
+struct nbv_cached_gain {
+    uoe::FoVGainMetric metric;
+    uoe::types::BBX fov_bbx;
+};
+
+struct nbv_warm_start_state {
+    std::optional<uoe::rrt::RRT> rrt;
+    // the map the tree and the gains were last validated against
+    std::shared_ptr<const uoe::Octomap> octomap;
+    // request parameters the tree and the gains depend on. A change invalidates them.
+    std::vector<double> tree_params, gain_params;
+    // indexed by node
+    std::vector<std::optional<nbv_cached_gain>> gains;
+    // accumulated over the requests, which only carry the points added since the previous one
+    std::vector<vec3> excluded_points;
+    // excluded_points, hashed into cells as large as the distance tolerance of the requests, so
+    // a candidate is checked against the points around it. Grown with excluded_points, and only
+    // rebuilt if the tolerance changes, or points are taken back.
+    uoe::PointGrid excluded_point_grid{1.0f};
+    // held for the duration of a request
+    std::mutex mutex;
+};
+
+struct fleet_state {
+    std::mutex mutex;
+    // by drone id. Entries are never erased, so references to them stay valid.
+    std::unordered_map<std::string, nbv_warm_start_state> nbv_states;
+    // the end of the last nbv path planned for each drone
+    std::unordered_map<std::string, vec3> claimed_viewpoints;
+};
+fleet_state fleet;
 std::unique_ptr<ros::Publisher> waypoints_path_pub;
 using waypoint_cb = std::function<void(const vec3&, const vec3&)>;
 using new_node_cb = std::function<void(const vec3&, const vec3&)>;
@@ -77,16 +320,31 @@ waypoint_cb after_waypoint_optimization;
 new_node_cb new_node_created;
 raycast_cb raycast;
 
-visualization_msgs::MarkerArray exclusion_marker_array;
-visualization_msgs::MarkerArray unknown_voxel_hit_during_waypoint_optimization_marker_array;
-visualization_msgs::MarkerArray rrt_marker_array;
+// the octomap server publishes the binary map on a topic with the same name as its service.
+// Holding on to the latest message means a request only pays for deserialization when the
+// map has actually changed since the previous request.
+uoe::OctomapCache octomap_cache;
+// if no map has been published for this long, fall back to requesting it from the service
+const auto OCTOMAP_MAX_AGE = ros::Duration(5.0);
+
+// replaces the octomap server, see uoe::rrt_service::set_octomap_source
+std::function<std::shared_ptr<const uoe::Octomap>()> octomap_source;
+
+auto call_get_object_octomap() -> std::shared_ptr<const uoe::Octomap> {
+    if (octomap_source) {
+        return octomap_source();
+    }
+    if (octomap_cache.is_fresh(OCTOMAP_MAX_AGE)) {
+        return octomap_cache.get();
+    }
 
-auto call_get_object_octomap() -> uoe::Octomap* {
     auto request = octomap_msgs::GetOctomap::Request{};  // empty request
     auto response = octomap_msgs::GetOctomap::Response{};
 
-    get_octomap_client->call(request, response);
-    return response.map.data.size() == 0 ? nullptr : new uoe::Octomap{response.map};
+    if (get_octomap_client->call(request, response)) {
+        octomap_cache.update(std::move(response.map));
+    }
+    return octomap_cache.get();
 }
 
 /**
@@ -134,6 +392,254 @@ auto waypoints_to_geometry_msgs_points(const uoe::rrt::RRT::Waypoints& wps)
     return points;
 }
 
+/**
+ * @brief the distance field of octomap. It is only rebuilt from scratch, when the map has grown
+ * past the bounds of the field. Otherwise only the region of the map that has changed is
+ * integrated. A field still used by another request is copied before it is integrated into.
+ * Must be called with map_views_mutex held.
+ */
+auto esdf_of(const std::shared_ptr<const uoe::Octomap>& octomap)
+    -> std::shared_ptr<const uoe::Esdf> {
+    if (esdf_cache.octomap == octomap) {
+        return esdf_cache.esdf;
+    }
+    const auto bounds = octomap->metric_bounds();
+    // the field covers whole voxels, so it can extend a little past the bounds of the map
+    const auto fits = [&] {
+        const auto& esdf = esdf_cache.esdf;
+        return esdf && std::abs(esdf->voxel_size() - octomap->resolution()) < 1e-6 &&
+               esdf->bounds().min().isApprox(bounds.min()) &&
+               (bounds.max().array() <= esdf->bounds().max().array()).all();
+    };
+    if (esdf_cache.octomap != nullptr && fits()) {
+        if (const auto changed = octomap->changed_region(*esdf_cache.octomap)) {
+            if (esdf_cache.esdf.use_count() > 1) {
+                esdf_cache.esdf = std::make_shared<uoe::Esdf>(*esdf_cache.esdf);
+            }
+            esdf_cache.esdf->integrate(*octomap, *changed);
+        }
+    } else {
+        esdf_cache.esdf =
+            std::make_shared<uoe::Esdf>(bounds, octomap->resolution(), esdf_max_distance);
+        esdf_cache.esdf->integrate(*octomap);
+    }
+    esdf_cache.octomap = octomap;
+    return esdf_cache.esdf;
+}
+
+/**
+ * @brief the inflated occupancy of octomap. Like the distance field, it is only rebuilt from
+ * scratch when the map has grown past its bounds, or the clearance has changed, and otherwise
+ * only updated around the region of the map that has changed. Must be called with
+ * map_views_mutex held.
+ */
+auto inflated_occupancy_of(const std::shared_ptr<const uoe::Octomap>& octomap)
+    -> std::shared_ptr<const uoe::InflatedOccupancy> {
+    auto& cache = inflated_occupancy_cache;
+    const auto clearance = static_cast<float>(inflated_occupancy_clearance);
+    if (cache.octomap == octomap && cache.inflated->clearance() == clearance) {
+        return cache.inflated;
+    }
+    const auto bounds = octomap->metric_bounds();
+    const auto fits = [&] {
+        const auto& inflated = cache.inflated;
+        return inflated && inflated->clearance() == clearance &&
+               std::abs(inflated->voxel_size() - octomap->resolution()) < 1e-6 &&
+               inflated->bounds().min().isApprox(bounds.min()) &&
+               (bounds.max().array() <= inflated->bounds().max().array()).all();
+    };
+    if (cache.octomap != nullptr && fits()) {
+        if (const auto changed = octomap->changed_region(*cache.octomap)) {
+            if (cache.inflated.use_count() > 1) {
+                cache.inflated = std::make_shared<uoe::InflatedOccupancy>(*cache.inflated);
+            }
+            cache.inflated->integrate(*octomap, *changed);
+        }
+    } else {
+        cache.inflated = std::make_shared<uoe::InflatedOccupancy>(bounds, octomap->resolution(),
+                                                                  inflated_occupancy_clearance);
+        cache.inflated->integrate(*octomap);
+    }
+    cache.octomap = octomap;
+    return cache.inflated;
+}
+
+/**
+ * @brief the snapshot of octomap. It is only taken again when a new map has been received, and
+ * shared by every request until then. Must be called with map_views_mutex held.
+ */
+auto snapshot_of(const std::shared_ptr<const uoe::Octomap>& octomap)
+    -> std::shared_ptr<const uoe::OctomapSnapshot> {
+    if (snapshot_cache.octomap != octomap) {
+        snapshot_cache.snapshot = std::make_shared<const uoe::OctomapSnapshot>(octomap->snapshot());
+        snapshot_cache.octomap = octomap;
+        ROS_INFO_STREAM("took a snapshot of the octomap, " << snapshot_cache.snapshot->n_blocks()
+                                                           << " blocks");
+    }
+    return snapshot_cache.snapshot;
+}
+
+/**
+ * @brief the coarse free space of octomap. Like the snapshot, it is only built again when a new
+ * map has been received. Must be called with map_views_mutex held.
+ */
+auto coarse_free_space_of(const std::shared_ptr<const uoe::Octomap>& octomap)
+    -> std::shared_ptr<const uoe::CoarseFreeSpace> {
+    auto& cache = coarse_free_space_cache;
+    if (cache.octomap != octomap || cache.coarse->levels() != coarse_collision_levels) {
+        cache.coarse = std::make_shared<const uoe::CoarseFreeSpace>(*octomap,
+                                                                    coarse_collision_levels);
+        cache.octomap = octomap;
+        ROS_INFO_STREAM("built the coarse free space of the octomap, with cells of "
+                        << cache.coarse->cell_size() << " m");
+    }
+    return cache.coarse;
+}
+
+/**
+ * @brief the frontiers of octomap. Like the distance field, only the region of the map that has
+ * changed since the previous map is updated. Must be called with map_views_mutex held.
+ */
+auto frontiers_of(const std::shared_ptr<const uoe::Octomap>& octomap)
+    -> std::shared_ptr<const uoe::Frontiers> {
+    if (frontiers_cache.octomap == octomap) {
+        return frontiers_cache.frontiers;
+    }
+    const auto& frontiers = frontiers_cache.frontiers;
+    if (frontiers_cache.octomap != nullptr && frontiers != nullptr &&
+        std::abs(frontiers->resolution() - octomap->resolution()) < 1e-6) {
+        if (const auto changed = octomap->changed_region(*frontiers_cache.octomap)) {
+            if (frontiers_cache.frontiers.use_count() > 1) {
+                frontiers_cache.frontiers = std::make_shared<uoe::Frontiers>(*frontiers);
+            }
+            frontiers_cache.frontiers->update(*octomap, *changed);
+        }
+    } else {
+        frontiers_cache.frontiers = std::make_shared<uoe::Frontiers>(octomap->resolution());
+        frontiers_cache.frontiers->update(*octomap);
+    }
+    frontiers_cache.octomap = octomap;
+    return frontiers_cache.frontiers;
+}
+
+/**
+ * @brief what an rrt checks its edges against. The rrt only holds raw pointers, so whoever uses
+ * the rrt has to keep this alive meanwhile.
+ */
+struct map_views {
+    std::shared_ptr<const uoe::Octomap> octomap;
+    std::shared_ptr<const uoe::Esdf> esdf;
+    std::shared_ptr<const uoe::InflatedOccupancy> inflated;
+    std::shared_ptr<const uoe::OctomapSnapshot> snapshot;
+    std::shared_ptr<const uoe::CoarseFreeSpace> coarse;
+};
+
+/**
+ * @brief the octomap, and if enabled its distance field, inflated occupancy, snapshot or coarse
+ * free space, is what rrt checks edges against.
+ */
+auto assign_map(uoe::rrt::RRT& rrt, const std::shared_ptr<const uoe::Octomap>& octomap)
+    -> map_views {
+    auto views = map_views{octomap, nullptr, nullptr, nullptr, nullptr};
+    const auto coarse = coarse_collision_levels > 0;
+    if (octomap != nullptr &&
+        (use_esdf || use_inflated_occupancy || use_octomap_snapshot || coarse)) {
+        auto lock = std::scoped_lock{map_views_mutex};
+        if (use_esdf) {
+            views.esdf = esdf_of(octomap);
+        }
+        if (use_inflated_occupancy) {
+            views.inflated = inflated_occupancy_of(octomap);
+        }
+        if (use_octomap_snapshot) {
+            views.snapshot = snapshot_of(octomap);
+        }
+        if (coarse) {
+            views.coarse = coarse_free_space_of(octomap);
+        }
+    }
+    rrt.assign_octomap(octomap.get());
+    rrt.assign_esdf(views.esdf.get());
+    rrt.assign_inflated_occupancy(views.inflated.get());
+    rrt.assign_snapshot(views.snapshot.get());
+    rrt.assign_coarse_free_space(views.coarse.get());
+    return views;
+}
+
+/**
+ * @brief the path from start to goal through the roadmap of octomap, with its edges checked by
+ * rrt. The edges of the roadmap near where octomap differs from the map they were checked
+ * against are checked again, and all of them if the drone has changed.
+ * @return std::nullopt if there is no roadmap yet, or it does not connect start and goal.
+ */
+auto find_path_in_roadmap(const uoe::rrt::RRT& rrt,
+                          const std::shared_ptr<const uoe::Octomap>& octomap, const vec3& start,
+                          const vec3& goal, const uoe_msgs::DroneConfig& drone)
+    -> std::optional<uoe::rrt::RRT::Waypoints> {
+    auto lock = std::scoped_lock{roadmap_mutex};
+    auto& cache = roadmap_cache;
+    if (cache.building.valid() &&
+        cache.building.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        cache.roadmap = cache.building.get();
+        cache.octomap = std::move(cache.building_from);
+        cache.drone_size = {};
+        ROS_INFO_STREAM("built a roadmap of " << cache.roadmap->n_vertices() << " vertices and "
+                                              << cache.roadmap->n_edges() << " edges");
+    }
+    const auto bounds = octomap->metric_bounds();
+    const auto covered = cache.roadmap != nullptr &&
+                         (cache.roadmap->bounds().min().array() <= bounds.min().array()).all() &&
+                         (bounds.max().array() <= cache.roadmap->bounds().max().array()).all();
+    if (! covered && ! cache.building.valid()) {
+        // the previous roadmap, if any, answers the requests until it is done
+        auto options = uoe::rrt::Roadmap::Options{};
+        options.n_vertices = roadmap_vertices;
+        options.connection_radius = static_cast<float>(roadmap_connection_radius);
+        options.seed = seed >= 0 ? static_cast<std::uint64_t>(seed) : 0;
+        cache.building_from = octomap;
+        cache.building = std::async(std::launch::async, [octomap, options] {
+            return std::make_shared<uoe::rrt::Roadmap>(*octomap, options);
+        });
+    }
+    if (cache.roadmap == nullptr) {
+        return std::nullopt;
+    }
+
+    const auto drone_size = std::array<double, 3>{drone.width, drone.height, drone.depth};
+    if (cache.drone_size != drone_size) {
+        cache.roadmap->invalidate();
+        cache.drone_size = drone_size;
+    } else if (cache.octomap != octomap) {
+        if (const auto changed = octomap->changed_region(*cache.octomap)) {
+            // an edge is checked for the cross section of the drone, and its depth past the end
+            const auto margin = std::hypot(drone.width, drone.height) / 2 + drone.depth;
+            cache.roadmap->invalidate(*changed, static_cast<float>(margin));
+        }
+    }
+    cache.octomap = octomap;
+
+    auto stats = uoe::rrt::Roadmap::Stats{};
+    auto path = cache.roadmap->find_path(
+        start, goal, [&](const vec3& a, const vec3& b) { return rrt.edge_is_collision_free(a, b); },
+        &stats);
+    ROS_INFO_STREAM("roadmap: " << (path ? "found" : "did not find") << " a path, checked "
+                                << stats.edges_checked << " edges, expanded "
+                                << stats.vertices_expanded << " vertices");
+    return path;
+}
+
+auto planner_stats_msg(const uoe::rrt::RRT::Stats& stats) -> uoe_msgs::PlannerStats {
+    auto msg = uoe_msgs::PlannerStats{};
+    msg.raycasts = stats.raycasts;
+    msg.nn_queries = stats.nn_queries;
+    msg.nn_nodes_visited = stats.nn_nodes_visited;
+    msg.kdtree_rebuilds = stats.kdtree_rebuilds;
+    msg.collision_checks = stats.collision_checks;
+    msg.collisions_rejected = stats.collisions_rejected;
+    msg.coarse_accepted = stats.coarse_accepted;
+    return msg;
+}
+
 auto rrt_find_path_handler(uoe_msgs::RrtFindPath::Request& request,
                            uoe_msgs::RrtFindPath::Response& response) -> bool {
     ROS_INFO("rrt service called.");
@@ -157,6 +663,15 @@ auto rrt_find_path_handler(uoe_msgs::RrtFindPath::Request& request,
                    .drone_width(request.drone_config.width)
                    .drone_height(request.drone_config.height)
                    .drone_depth(request.drone_config.depth)
+                   .rrt_star(use_rrt_star)
+                   .optimize_waypoints(! use_rrt_star)
+                   // a portfolio already keeps the cores busy
+                   .shortcut_workers(portfolio_trees > 1
+                                         ? 1
+                                         : uoe::utils::concurrency::default_number_of_workers())
+                   .lazy_collision_checking(use_lazy_collision_checking)
+                   .rrt_connect(use_rrt_connect)
+                   .informed_sampling(use_informed_sampling && find_path_time_budget > 0)
                    .build();
 
     // rrt.register_cb_for_event_on_new_node_created(
@@ -165,13 +680,67 @@ auto rrt_find_path_handler(uoe_msgs::RrtFindPath::Request& request,
     rrt.register_cb_for_event_on_new_node_created(new_node_created);
 
     auto octomap_ptr = call_get_object_octomap();
+    if (recorder != nullptr) {
+        recorder->record("find_path", request, octomap_ptr);
+    }
+    const auto request_seed = next_seed();
+    if (request_seed) {
+        rrt.seed(*request_seed);
+    }
 
+    auto views = map_views{};
     if (octomap_ptr != nullptr) {
         ROS_INFO("there is a octomap available");
-        rrt.assign_octomap(octomap_ptr);
+        views = assign_map(rrt, octomap_ptr);
     }
     auto found_a_path = false;
 
+    if (use_roadmap && octomap_ptr != nullptr) {
+        if (const auto path =
+                find_path_in_roadmap(rrt, octomap_ptr, start, goal, request.drone_config)) {
+            response.waypoints = waypoints_to_geometry_msgs_points(*path);
+            response.found_path = true;
+            response.stats = planner_stats_msg(rrt.stats());
+            return true;
+        }
+    }
+
+    if (portfolio_trees > 1) {
+        ROS_INFO_STREAM("running a portfolio of " << portfolio_trees << " rrt");
+        auto options = uoe::rrt::PortfolioOptions{};
+        options.n_trees = static_cast<std::size_t>(portfolio_trees);
+        if (request_seed) {
+            options.seed = *request_seed;
+        }
+        if (portfolio_deadline > 0) {
+            options.deadline = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(portfolio_deadline));
+        }
+        auto stats = uoe::rrt::RRT::Stats{};
+        if (const auto result = uoe::rrt::run_portfolio(rrt, options, &stats)) {
+            ROS_INFO_STREAM("rrt: tree " << result->tree << " found the shortest of "
+                                         << result->n_solutions << " paths");
+            response.waypoints = waypoints_to_geometry_msgs_points(result->waypoints);
+            response.found_path = true;
+            found_a_path = true;
+        }
+        response.stats = planner_stats_msg(stats);
+        return found_a_path;
+    }
+
+    if (find_path_time_budget > 0) {
+        const auto result = rrt.run_for(std::chrono::duration_cast<uoe::rrt::RRT::clock::duration>(
+            std::chrono::duration<double>(find_path_time_budget)));
+        ROS_INFO_STREAM("rrt: " << result.iterations << " iterations at "
+                                << result.iterations_per_second << " per second, "
+                                << (result.reached_goal ? "reached" : "did not reach")
+                                << " the goal");
+        response.waypoints = waypoints_to_geometry_msgs_points(result.waypoints);
+        response.found_path = result.reached_goal;
+        response.stats = planner_stats_msg(rrt.stats());
+        return ! result.waypoints.empty();
+    }
+
     ROS_INFO("running rrt");
     if (const auto opt = rrt.run()) {
         ROS_INFO("rrt: found a path");
@@ -179,16 +748,53 @@ auto rrt_find_path_handler(uoe_msgs::RrtFindPath::Request& request,
         const auto path = opt.value();
         std::cout << "path.size() = " << path.size() << std::endl;
         response.waypoints = waypoints_to_geometry_msgs_points(path);
+        response.found_path = true;
 
         found_a_path = true;
     }
+    response.stats = planner_stats_msg(rrt.stats());
 
-    if (octomap_ptr != nullptr) {
-        ROS_INFO("deallocating octomap copy");
-        delete octomap_ptr;
+    return found_a_path;
+}
+
+auto bbx_overlap(const uoe::types::BBX& a, const uoe::types::BBX& b) -> bool {
+    return (a.min().array() <= b.max().array()).all() && (b.min().array() <= a.max().array()).all();
+}
+
+/**
+ * @brief prepare the tree of the previous nbv request for a search from start, against octomap.
+ * Edges and cached gains affected by changes to the octomap since the previous request are
+ * removed.
+ * @return false if the tree can not be reused.
+ */
+auto warm_start_nbv_tree(nbv_warm_start_state& nbv_state, map_views& views, const vec3& start,
+                         const std::shared_ptr<const uoe::Octomap>& octomap) -> bool {
+    auto& rrt = *nbv_state.rrt;
+    views = assign_map(rrt, octomap);
+
+    if (nbv_state.octomap != octomap) {
+        if (const auto changed = octomap->changed_region(*nbv_state.octomap)) {
+            const auto old_to_new = rrt.prune_edges_in_collision(changed);
+            auto gains = std::vector<std::optional<nbv_cached_gain>>(rrt.size());
+            for (std::size_t i = 0; i < old_to_new.size() && i < nbv_state.gains.size(); ++i) {
+                const auto& cached = nbv_state.gains[i];
+                if (old_to_new[i] != uoe::rrt::RRT::no_node && cached &&
+                    ! bbx_overlap(cached->fov_bbx, *changed)) {
+                    gains[old_to_new[i]] = cached;
+                }
+            }
+            nbv_state.gains = std::move(gains);
+            ROS_INFO_STREAM("warm start: " << rrt.size() << " of " << old_to_new.size()
+                                           << " nodes are still valid");
+        }
     }
+    nbv_state.octomap = octomap;
 
-    return found_a_path;
+    if (! rrt.reroot(start)) {
+        return false;
+    }
+    nbv_state.gains.resize(rrt.size());
+    return true;
 }
 
 auto nbv_handler(uoe_msgs::NBV::Request& request, uoe_msgs::NBV::Response& response) -> bool {
@@ -202,34 +808,65 @@ auto nbv_handler(uoe_msgs::NBV::Request& request, uoe_msgs::NBV::Response& respo
     const auto horizontal = FoVAngle::from_degrees(request.fov.horizontal.angle);
     const auto vertical = FoVAngle::from_degrees(request.fov.vertical.angle);
     const auto depth_range = DepthRange{request.fov.depth_range.min, request.fov.depth_range.max};
-    auto excluded_points = std::vector<vec3>();
-    std::transform(std::begin(request.nbv_config.excluded_points),
-                   std::end(request.nbv_config.excluded_points),
-                   std::back_inserter(excluded_points), geometry_msgs_point_to_vec3);
-
-    auto rrt = uoe::rrt::RRT::from_builder()
-                   .start_and_goal_position(
-                       geometry_msgs_point_to_vec3(request.rrt_config.start),
-                       geometry_msgs_point_to_vec3(
-                           request.rrt_config.goal))  // goal is irrelevant - not really though
-                   .max_iterations(request.rrt_config.max_iterations)
-                   .goal_bias(0)
-                   .probability_of_testing_full_path_from_new_node_to_goal(0)
-                   .max_dist_goal_tolerance(0)
-                   .step_size(request.rrt_config.step_size)
-                   .drone_width(request.drone_config.width)
-                   .drone_height(request.drone_config.height)
-                   .drone_depth(request.drone_config.depth)
-                   .sampling_radius(10000)
-                   .build();
-
-    // ROS_INFO_STREAM("" << rrt);
+    auto fleet_viewpoints = std::vector<vec3>();
 
     auto octomap_environment_ptr = call_get_object_octomap();
+    if (recorder != nullptr) {
+        recorder->record("nbv", request, octomap_environment_ptr);
+    }
+    const auto request_seed = next_seed();
+
+    const auto& drone_id = request.drone_config.id;
+    auto& nbv_state = [&]() -> nbv_warm_start_state& {
+        auto lock = std::scoped_lock{fleet.mutex};
+        if (fleet_exclusion) {
+            for (const auto& [id, viewpoint] : fleet.claimed_viewpoints) {
+                if (id != drone_id) {
+                    fleet_viewpoints.push_back(viewpoint);
+                }
+            }
+        }
+        return fleet.nbv_states[drone_id];
+    }();
+    // requests of the same drone are served one at a time, as they share its tree
+    auto nbv_state_lock = std::scoped_lock{nbv_state.mutex};
+
+    // the request holds the excluded points from the offset onwards. Points before it were sent by
+    // earlier requests, unless the service has lost them, in which case the client has to send
+    // all of them again.
+    const auto excluded_points_offset = request.nbv_config.excluded_points_offset;
+    if (excluded_points_offset > nbv_state.excluded_points.size()) {
+        ROS_WARN_STREAM("nbv request continues from excluded point "
+                        << excluded_points_offset << ", but only "
+                        << nbv_state.excluded_points.size() << " are known");
+        nbv_state.excluded_points.clear();
+        nbv_state.excluded_point_grid.clear();
+        response.excluded_points_count = 0;
+        response.found_nbv_with_sufficent_gain = false;
+        return true;
+    }
+    const auto excluded_points_distance_tolerance =
+        static_cast<float>(request.nbv_config.excluded_points_distance_tolerance);
+    const auto excluded_point_cell_size =
+        excluded_points_distance_tolerance > 0 ? excluded_points_distance_tolerance : 1.0f;
+    auto& excluded_point_grid = nbv_state.excluded_point_grid;
+    auto n_hashed = excluded_point_grid.size();
+    if (excluded_points_offset < n_hashed ||
+        excluded_point_grid.cell_size() != excluded_point_cell_size) {
+        excluded_point_grid = uoe::PointGrid(excluded_point_cell_size);
+        n_hashed = 0;
+    }
+    nbv_state.excluded_points.resize(excluded_points_offset);
+    std::transform(std::begin(request.nbv_config.excluded_points),
+                   std::end(request.nbv_config.excluded_points),
+                   std::back_inserter(nbv_state.excluded_points), geometry_msgs_point_to_vec3);
+    for (auto i = n_hashed; i < nbv_state.excluded_points.size(); ++i) {
+        excluded_point_grid.insert(nbv_state.excluded_points[i]);
+    }
+    response.excluded_points_count = nbv_state.excluded_points.size();
 
     if (octomap_environment_ptr != nullptr) {
         ROS_INFO("there is a octomap available");
-        rrt.assign_octomap(octomap_environment_ptr);
         voxel_resolution = octomap_environment_ptr->resolution();
         ROS_INFO_STREAM("size of octomap (in kb) is: "
                         << octomap_environment_ptr->octree().memoryUsage() / 1024);
@@ -238,14 +875,109 @@ auto nbv_handler(uoe_msgs::NBV::Request& request, uoe_msgs::NBV::Response& respo
         return false;
     }
 
+    const vec3 start = geometry_msgs_point_to_vec3(request.rrt_config.start);
+    // request parameters the tree, or the gains, depend on
+    const auto tree_params = std::vector<double>{
+        request.rrt_config.step_size,
+        request.drone_config.width,
+        request.drone_config.height,
+        request.drone_config.depth,
+        request.rrt_config.goal.x,
+        request.rrt_config.goal.y,
+        request.rrt_config.goal.z,
+        static_cast<double>(request.rrt_config.max_iterations),
+    };
+    const auto gain_params = std::vector<double>{
+        request.fov.horizontal.angle,
+        request.fov.vertical.angle,
+        request.fov.depth_range.min,
+        request.fov.depth_range.max,
+        request.fov.pitch.angle,
+        request.nbv_config.weight_free,
+        request.nbv_config.weight_occupied,
+        request.nbv_config.weight_unknown,
+        request.nbv_config.weight_distance_to_object,
+        request.nbv_config.weight_not_visible,
+    };
+
+    auto views = map_views{};
+    const auto reuse_tree = [&] {
+        if (! nbv_warm_start || ! nbv_state.rrt || nbv_state.tree_params != tree_params) {
+            return false;
+        }
+        const auto max_size = NBV_WARM_START_MAX_TREE_GROWTH *
+                              static_cast<std::size_t>(request.rrt_config.max_iterations);
+        // the stats of the response only cover the work of this request
+        nbv_state.rrt->reset_stats();
+        return nbv_state.rrt->size() < max_size &&
+               warm_start_nbv_tree(nbv_state, views, start, octomap_environment_ptr);
+    }();
+
+    if (! reuse_tree) {
+        nbv_state.rrt.emplace(
+            uoe::rrt::RRT::from_builder()
+                .start_and_goal_position(
+                    start, geometry_msgs_point_to_vec3(
+                               request.rrt_config.goal))  // goal is irrelevant - not really though
+                .max_iterations(request.rrt_config.max_iterations)
+                .goal_bias(0)
+                .probability_of_testing_full_path_from_new_node_to_goal(0)
+                .max_dist_goal_tolerance(0)
+                .step_size(request.rrt_config.step_size)
+                .drone_width(request.drone_config.width)
+                .drone_height(request.drone_config.height)
+                .drone_depth(request.drone_config.depth)
+                .sampling_radius(10000)
+                .build());
+        views = assign_map(*nbv_state.rrt, octomap_environment_ptr);
+        nbv_state.octomap = octomap_environment_ptr;
+        nbv_state.gains.assign(nbv_state.rrt->size(), std::nullopt);
+    }
+    if (nbv_state.gain_params != gain_params) {
+        nbv_state.gains.assign(nbv_state.rrt->size(), std::nullopt);
+    }
+    nbv_state.tree_params = tree_params;
+    nbv_state.gain_params = gain_params;
+
+    auto& rrt = *nbv_state.rrt;
+    if (request_seed) {
+        rrt.seed(*request_seed);
+    }
+    // callbacks of the previous request refer to its stack frame
+    rrt.unregister_cbs_for_all_events();
+    const auto n_retained_nodes = reuse_tree ? rrt.size() : std::size_t{0};
+    ROS_INFO_STREAM((reuse_tree ? "reusing" : "building") << " rrt with " << rrt.size()
+                                                          << " nodes");
+
+    // ROS_INFO_STREAM("" << rrt);
+
     // TODO: how to initialize this maybe std::optional ?
     auto best_fov_gain_metric = uoe::FoVGainMetric{};
-    double best_gain = std::numeric_limits<double>::lowest();
+    // candidates are scored concurrently, so the best candidate is guarded by best_mutex.
+    // best_gain is also kept in an atomic, so most candidates can be rejected without locking.
+    auto best_mutex = std::mutex{};
+    auto best_gain = std::atomic<double>{std::numeric_limits<double>::lowest()};
     vec3 best_point = geometry_msgs_point_to_vec3(request.rrt_config.start);
     const vec3 target = geometry_msgs_point_to_vec3(request.rrt_config.goal);
     // vec3{request.rrt_config.start.x, request.rrt_config.start.y, request.rrt_config.start.z};
 
-    bool found_suitable_nbv = false;
+    auto found_suitable_nbv = std::atomic<bool>{false};
+    vec3 suitable_point = best_point;
+
+    if (nbv_frontier_bias > 0) {
+        const auto frontiers = [&] {
+            auto lock = std::scoped_lock{map_views_mutex};
+            return frontiers_of(octomap_environment_ptr);
+        }();
+        // candidates near these see unknown space when looking at the target
+        auto facing = frontiers->facing(target, request.fov.depth_range.max);
+        ROS_INFO_STREAM(facing.size() << " of " << frontiers->size()
+                                      << " frontier voxels face the target");
+        rrt.bias_sampling_towards(std::move(facing), static_cast<float>(nbv_frontier_bias),
+                                  request.rrt_config.step_size);
+    } else {
+        rrt.bias_sampling_towards({}, 0.0f, 0.0f);
+    }
 
 #ifdef VISUALIZE_MARKERS_IN_RVIZ
     // visualization_msgs::MarkerArray rrt_marker_array;
@@ -256,9 +988,8 @@ auto nbv_handler(uoe_msgs::NBV::Request& request, uoe_msgs::NBV::Response& respo
                                       .color({1, 0.8, 0, 1})
                                       .build();
     rrt.register_cb_for_event_on_new_node_created([&](const auto& from, const auto& to) {
-        auto msg =
-            new_node_arrow_msg_gen({from, to}, ros::Time::now(), ros::Duration(MARKER_TIMEOUT));
-        rrt_marker_array.markers.push_back(msg);
+        rrt_markers->add(
+            new_node_arrow_msg_gen({from, to}, ros::Time::now(), ros::Duration(MARKER_TIMEOUT)));
     });
 
     // // TODO: comment
@@ -270,15 +1001,68 @@ auto nbv_handler(uoe_msgs::NBV::Request& request, uoe_msgs::NBV::Response& respo
 
     auto text_msg_gen = uoe::utils::rviz::text_msg_gen();
 
+    // the viewpoints of the other drones are few, one per drone, so they are checked one by one
     const auto too_close_to_excluded_points = [&](const vec3& v) {
         const auto too_close = [&](const vec3& p) {
-            return (p - v).norm() <= request.nbv_config.excluded_points_distance_tolerance;
+            return (p - v).norm() <= excluded_points_distance_tolerance;
         };
 
-        return std::any_of(std::begin(excluded_points), std::end(excluded_points), too_close);
+        return excluded_point_grid.any_within(v, excluded_points_distance_tolerance) ||
+               std::any_of(std::begin(fleet_viewpoints), std::end(fleet_viewpoints), too_close);
+    };
+
+    struct nbv_candidate {
+        vec3 position;
+        std::size_t iteration;
+        uoe::rrt::RRT::node_index node;
+    };
+
+    // gains computed during this request, merged into nbv_state.gains when the search is over
+    auto scored_mutex = std::mutex{};
+    auto scored = std::vector<std::pair<uoe::rrt::RRT::node_index, nbv_cached_gain>>{};
+
+    const auto consider_candidate = [&](const nbv_candidate& candidate,
+                                        const uoe::FoVGainMetric& fov_gain_metric) {
+        const vec3& new_point = candidate.position;
+        const double gain = fov_gain_metric.gain_total;
+        ROS_INFO_STREAM(candidate.iteration << "/" << rrt.max_iterations()
+                                            << " - gain: " << std::to_string(gain));
+
+        if (gain > best_gain.load() && fov_gain_metric.gain_unknown != 0 &&
+            ! too_close_to_excluded_points(new_point)) {
+            auto lock = std::scoped_lock{best_mutex};
+            // another worker may have found a better candidate while we waited for the lock
+            if (gain > best_gain.load()) {
+                ROS_INFO_STREAM("gain (" << std::to_string(gain)
+                                         << ") is better that the current best gain ("
+                                         << std::to_string(best_gain.load()) << ")");
+                best_fov_gain_metric = fov_gain_metric;
+                best_gain.store(gain);
+                best_point = new_point;
+            }
+        }
+
+        if (gain >= request.nbv_config.gain_of_interest_threshold) {
+            auto lock = std::scoped_lock{best_mutex};
+            if (! found_suitable_nbv.exchange(true)) {
+                ROS_INFO_STREAM("found a suitable gain " << std::to_string(gain));
+                suitable_point = new_point;
+            }
+        }
     };
 
-    rrt.register_cb_for_event_on_new_node_created([&](const auto&, const vec3& new_point) {
+    // work of the octree traversals of score_batch, which runs on the workers
+    auto octree_nodes_visited = std::atomic<std::size_t>{0};
+    auto voxels_visited = std::atomic<std::size_t>{0};
+    auto fovs_skipped = std::atomic<std::size_t>{0};
+
+    auto gain_cache = std::optional<uoe::GainCache<uoe::FoVGainMetric>>{};
+    if (nbv_gain_cache_quantum > 0) {
+        gain_cache.emplace(static_cast<float>(nbv_gain_cache_quantum));
+    }
+
+    const auto fov_of_candidate = [&](const nbv_candidate& candidate) {
+        const vec3& new_point = candidate.position;
         vec3 dir = target - new_point;
 
         const auto yaw = std::atan2(dir.y(), dir.x());
@@ -288,7 +1072,36 @@ auto nbv_handler(uoe_msgs::NBV::Request& request, uoe_msgs::NBV::Response& respo
             Eigen::AngleAxisf(deg2rad(-request.fov.pitch.angle), Eigen::Vector3f::UnitY());
 
         const auto pose = Pose{new_point, orientation};
-        const auto fov = FoV{pose, horizontal, vertical, depth_range, target};
+        return FoV{pose, horizontal, vertical, depth_range, target};
+    };
+
+    const auto record_candidate = [&](const nbv_candidate& candidate, const FoV& fov,
+                                      const uoe::FoVGainMetric& fov_gain_metric) {
+        {
+            auto lock = std::scoped_lock{scored_mutex};
+            scored.emplace_back(candidate.node,
+                                nbv_cached_gain{fov_gain_metric, uoe::compute_bbx(fov)});
+        }
+        consider_candidate(candidate, fov_gain_metric);
+    };
+
+    const vec3 root = uoe::utils::transform::geometry_mgs_point_to_vec(request.rrt_config.start);
+    const auto distance_tf = [](double x) { return x /* x * x */; };
+
+    // best_gain only grows, so a candidate that can not beat it now never will
+    const auto cannot_win = [&](const FoV& fov) {
+        const auto bound = uoe::gain_upper_bound(fov, *octomap_environment_ptr,
+                                                 request.nbv_config.weight_unknown,
+                                                 request.nbv_config.weight_distance_to_object,
+                                                 root, distance_tf);
+        return bound <= best_gain.load() && bound < request.nbv_config.gain_of_interest_threshold;
+    };
+
+    const auto score_batch = [&](const std::vector<nbv_candidate>& batch) {
+        if (found_suitable_nbv.load()) {
+            // the search is over, so there is no need to score the remaining candidates
+            return;
+        }
 
 #ifdef VISUALIZE_MARKERS_IN_RVIZ
 
@@ -300,64 +1113,137 @@ auto nbv_handler(uoe_msgs::NBV::Request& request, uoe_msgs::NBV::Response& respo
 #endif  // VISUALIZE_MARKERS_IN_RVIZ
 
         // ROS_INFO("calculating gain of fov");
-        const auto fov_gain_metric = uoe::gain_of_fov(
-            fov, *octomap_environment_ptr, request.nbv_config.weight_free,
-            request.nbv_config.weight_occupied, request.nbv_config.weight_unknown,
-            request.nbv_config.weight_distance_to_object, request.nbv_config.weight_not_visible,
-            uoe::utils::transform::geometry_mgs_point_to_vec(request.rrt_config.start),
-            [](double x) { return x /* x * x */; },
-            [&](const uoe::types::vec3&, const uoe::types::vec3&, float, const bool,
-                uoe::VoxelStatus) {});
+        auto uncached = std::vector<nbv_candidate>{};
+        auto fovs = std::vector<FoV>{};
+        for (const auto& candidate : batch) {
+            const auto fov = fov_of_candidate(candidate);
+            if (const auto cached = gain_cache ? gain_cache->find(candidate.position)
+                                               : std::nullopt) {
+                record_candidate(candidate, fov, *cached);
+            } else if (nbv_gain_bound && cannot_win(fov)) {
+                fovs_skipped.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                uncached.push_back(candidate);
+                fovs.push_back(fov);
+            }
+        }
+        if (fovs.empty()) {
+            return;
+        }
 
-        const double gain = fov_gain_metric.gain_total;
-        ROS_INFO_STREAM(rrt.max_iterations() - rrt.remaining_iterations()
-                        << "/" << rrt.max_iterations() << " - gain: " << std::to_string(gain));
-
-        // {
-        //     std::string text = std::to_string(gain) + " | (" +
-        //                        std::to_string(fov_gain_metric.gain_unknown) + " | " +
-        //                        std::to_string(fov_gain_metric.v_unknown_voxels) + ") | " +
-        //                        std::to_string(fov_gain_metric.gain_distance);
-        //     auto msg = text_msg_gen(text, fov.pose().position);
-        //     msg.color.r = 1;
-        //     msg.color.g = 1;
-        //     msg.color.b = 1;
-        //     marker_array.markers.push_back(msg);
-        // }
+        const auto fov_gain_metrics =
+            fovs.size() == 1
+                ? std::vector{uoe::gain_of_fov(
+                      fovs.front(), *octomap_environment_ptr, request.nbv_config.weight_free,
+                      request.nbv_config.weight_occupied, request.nbv_config.weight_unknown,
+                      request.nbv_config.weight_distance_to_object,
+                      request.nbv_config.weight_not_visible, root, distance_tf,
+                      [&](const uoe::types::vec3&, const uoe::types::vec3&, float, const bool,
+                          uoe::VoxelStatus) {})}
+                : uoe::gain_of_fovs(
+                      fovs, *octomap_environment_ptr, request.nbv_config.weight_free,
+                      request.nbv_config.weight_occupied, request.nbv_config.weight_unknown,
+                      request.nbv_config.weight_distance_to_object,
+                      request.nbv_config.weight_not_visible, root, distance_tf);
+        // the batch shares one traversal of the octree
+        octree_nodes_visited.fetch_add(fov_gain_metrics.front().n_octree_nodes_visited,
+                                       std::memory_order_relaxed);
+        for (std::size_t i = 0; i < uncached.size(); ++i) {
+            voxels_visited.fetch_add(fov_gain_metrics[i].n_voxels_visited,
+                                     std::memory_order_relaxed);
+            if (gain_cache) {
+                gain_cache->insert(uncached[i].position, fov_gain_metrics[i]);
+            }
+            record_candidate(uncached[i], fovs[i], fov_gain_metrics[i]);
+        }
+    };
 
-        if (gain > best_gain && fov_gain_metric.gain_unknown != 0 &&
-            ! too_close_to_excluded_points(new_point)) {
-            ROS_INFO_STREAM("gain (" << std::to_string(gain)
-                                     << ") is better that the current best gain ("
-                                     << std::to_string(best_gain) << ")");
-            best_fov_gain_metric = fov_gain_metric;
-            best_gain = gain;
-            best_point = new_point;
+    // the tree is grown on this thread, while the candidates are scored by the worker pool
+    // against the read-only octomap. The queue is bounded so the tree can not outgrow the
+    // workers by more than a few batches. With no workers every batch is scored inline.
+    auto scoring_pool =
+        std::optional<uoe::utils::concurrency::WorkerPool<std::vector<nbv_candidate>>>{};
+    if (nbv_worker_threads > 0) {
+        const auto queue_capacity = NBV_CANDIDATES_QUEUED_PER_WORKER * nbv_worker_threads;
+        scoring_pool.emplace(nbv_worker_threads, queue_capacity, score_batch);
+    }
+
+    auto pending = std::vector<nbv_candidate>{};
+    const auto dispatch = [&] {
+        if (pending.empty()) {
+            return;
         }
+        if (scoring_pool) {
+            scoring_pool->submit(std::move(pending));
+        } else {
+            score_batch(pending);
+        }
+        pending = {};
+    };
+    const auto submit = [&](const nbv_candidate& candidate) {
+        pending.push_back(candidate);
+        if (pending.size() >= nbv_gain_batch_size) {
+            dispatch();
+        }
+    };
 
-        if (gain >= request.nbv_config.gain_of_interest_threshold) {
-            ROS_INFO_STREAM("found a suitable gain " << std::to_string(gain));
-            found_suitable_nbv = true;
+    // nodes kept from the previous request are candidates too. Their cached gain is reused
+    // unless the octomap changed inside their FoV, it only has to be adjusted for the new root.
+    const double distance_total = (target - start).norm();
+    for (uoe::rrt::RRT::node_index i = 0; i < n_retained_nodes && ! found_suitable_nbv.load();
+         ++i) {
+        const auto candidate = nbv_candidate{rrt.node_position(i), 0, i};
+        if (const auto& cached = nbv_state.gains[i]) {
+            consider_candidate(candidate,
+                               uoe::with_distance_total(
+                                   cached->metric, request.nbv_config.weight_distance_to_object,
+                                   distance_total));
+        } else {
+            submit(candidate);
         }
-    });
+    }
 
-    // grow rrt incrementally
+    // grow rrt incrementally. The new nodes are found by their index rather than through
+    // on_new_node_created events, which are not dispatched in builds without RRT events.
     response.found_nbv_with_sufficent_gain = false;
-    while (rrt.can_grow()) {
+    auto n_submitted = rrt.size();
+    while (rrt.can_grow() && ! found_suitable_nbv.load()) {
         rrt.grow1();
+        const auto iteration = rrt.max_iterations() - rrt.remaining_iterations();
+        for (; n_submitted < rrt.size(); ++n_submitted) {
+            const auto node = static_cast<uoe::rrt::RRT::node_index>(n_submitted);
+            submit(nbv_candidate{rrt.node_position(node), iteration, node});
+        }
+    }
 
-        if (found_suitable_nbv) {
-            ROS_INFO("found suitable nbv");
-            // backtrack and set waypoints
-            std::cout << uoe::utils::MAGENTA << "finding waypoints from suitable gain node"
-                      << uoe::utils::RESET << std::endl;
-            if (const auto opt = rrt.waypoints_from_newest_node()) {
-                const auto path = opt.value();
-                response.waypoints = waypoints_to_geometry_msgs_points(path);
-                response.found_nbv_with_sufficent_gain = true;
-            }
+    // candidates still in the queue are only worth scoring if no suitable nbv has been found
+    if (! found_suitable_nbv.load()) {
+        dispatch();
+    }
+    if (scoring_pool) {
+        scoring_pool->join(found_suitable_nbv.load());
+    }
+    rrt.unregister_cbs_for_all_events();
+    if (gain_cache) {
+        ROS_INFO_STREAM("gain cache: " << gain_cache->hits() << " hits, " << gain_cache->misses()
+                                       << " misses");
+    }
+
+    nbv_state.gains.resize(rrt.size());
+    for (auto& [node, gain] : scored) {
+        nbv_state.gains[node] = std::move(gain);
+    }
 
-            break;
+    if (found_suitable_nbv.load()) {
+        ROS_INFO("found suitable nbv");
+        // backtrack and set waypoints
+        std::cout << uoe::utils::MAGENTA << "finding waypoints from suitable gain node"
+                  << uoe::utils::RESET << std::endl;
+        // candidates are scored out of order, so the suitable node is not necessarily the newest
+        if (const auto opt = rrt.get_waypoints_from_nearsest_node_to(suitable_point)) {
+            const auto path = opt.value();
+            response.waypoints = waypoints_to_geometry_msgs_points(path);
+            response.found_nbv_with_sufficent_gain = true;
         }
     }
 
@@ -375,14 +1261,23 @@ auto nbv_handler(uoe_msgs::NBV::Request& request, uoe_msgs::NBV::Response& respo
         }
     }
 
+    response.stats = planner_stats_msg(rrt.stats());
+    response.stats.octree_nodes_visited = octree_nodes_visited.load();
+    response.stats.voxels_visited = voxels_visited.load();
+    response.stats.fovs_skipped = fovs_skipped.load();
+
+    if (fleet_exclusion && ! drone_id.empty() && ! response.waypoints.empty()) {
+        auto lock = std::scoped_lock{fleet.mutex};
+        fleet.claimed_viewpoints[drone_id] = geometry_msgs_point_to_vec3(response.waypoints.back());
+    }
+
 #ifdef VISUALIZE_MARKERS_IN_RVIZ
     nbv_metric_pub->publish(uoe::to_ros_msg(best_fov_gain_metric));
-    marker_array_pub->publish(unknown_voxel_hit_during_waypoint_optimization_marker_array);
-    unknown_voxel_hit_during_waypoint_optimization_marker_array.markers.clear();
-    rrt_marker_array_pub->publish(rrt_marker_array);
-    rrt_marker_array.markers.clear();
     {
         auto sphere_msg_gen = uoe::utils::rviz::sphere_msg_gen();
+        auto excluded_points = nbv_state.excluded_points;
+        excluded_points.insert(excluded_points.end(), fleet_viewpoints.begin(),
+                               fleet_viewpoints.end());
         for (const auto& ep : excluded_points) {
             auto msg = sphere_msg_gen(ep, ros::Time::now(), ros::Duration(MARKER_TIMEOUT));
             msg.scale.x = request.nbv_config.excluded_points_distance_tolerance * 2;
@@ -392,13 +1287,9 @@ auto nbv_handler(uoe_msgs::NBV::Request& request, uoe_msgs::NBV::Response& respo
             msg.color.g = 0;
             msg.color.b = 0;
             msg.color.a = 0.2;
-            exclusion_marker_array.markers.push_back(msg);
+            exclusion_markers->add(std::move(msg));
         }
     }
-    exclusion_marker_array_pub->publish(exclusion_marker_array);
-    exclusion_marker_array.markers.clear();
-    ros::spinOnce();
-    ros::Rate(uoe::utils::DEFAULT_LOOP_RATE).sleep();
 
     // {
     // auto cube_msg_gen =
@@ -501,18 +1392,170 @@ auto nbv_handler(uoe_msgs::NBV::Request& request, uoe_msgs::NBV::Response& respo
 
     std::cout << yaml(best_fov_gain_metric) << std::endl;
 
-    if (octomap_environment_ptr != nullptr) {
-        ROS_INFO("deallocating octomap copy");
-        delete octomap_environment_ptr;
+    ROS_INFO_STREAM("information gain: " << best_gain.load());
+
+    return true;
+}
+
+using param_ref = std::variant<bool*, int*, unsigned int*, double*, std::string*>;
+
+// the parameters of the service, by their name under /uoe/rrt_service/
+auto params() -> const std::vector<std::pair<std::string, param_ref>>& {
+    static const auto table = std::vector<std::pair<std::string, param_ref>>{
+        {"nbv_worker_threads", &nbv_worker_threads},
+        {"rrt_star", &use_rrt_star},
+        {"nbv_warm_start", &nbv_warm_start},
+        {"nbv_gain_cache_quantum", &nbv_gain_cache_quantum},
+        {"nbv_gain_batch_size", &nbv_gain_batch_size},
+        {"nbv_gain_bound", &nbv_gain_bound},
+        {"lazy_collision_checking", &use_lazy_collision_checking},
+        {"rrt_connect", &use_rrt_connect},
+        {"portfolio_trees", &portfolio_trees},
+        {"portfolio_deadline", &portfolio_deadline},
+        {"find_path_time_budget", &find_path_time_budget},
+        {"informed_sampling", &use_informed_sampling},
+        {"esdf", &use_esdf},
+        {"esdf_max_distance", &esdf_max_distance},
+        {"inflated_occupancy", &use_inflated_occupancy},
+        {"inflated_occupancy_clearance", &inflated_occupancy_clearance},
+        {"octomap_snapshot", &use_octomap_snapshot},
+        {"coarse_collision_levels", &coarse_collision_levels},
+        {"roadmap", &use_roadmap},
+        {"roadmap_vertices", &roadmap_vertices},
+        {"roadmap_connection_radius", &roadmap_connection_radius},
+        {"spinner_threads", &spinner_threads},
+        {"fleet_exclusion", &fleet_exclusion},
+        {"nbv_frontier_bias", &nbv_frontier_bias},
+        {"trace", &trace},
+        {"trace_file", &trace_file},
+        {"record_dir", &record_dir},
+        {"seed", &seed},
+    };
+    return table;
+}
+
+/**
+ * @brief applies the parameters that need more than being assigned, after any of them changed
+ */
+auto apply_params() -> void {
+    nbv_gain_batch_size = std::max(nbv_gain_batch_size, 1u);
+    // the octree of an octomap is 16 levels deep, and the cells have to be below its root
+    coarse_collision_levels = std::min(coarse_collision_levels, 15u);
+    if (! (inflated_occupancy_clearance >= 0)) {
+        inflated_occupancy_clearance = 1.5;
     }
+    if (! (roadmap_connection_radius > 0)) {
+        roadmap_connection_radius = 4.0;
+    }
+#ifdef VISUALIZE_MARKERS_IN_RVIZ
+    // the markers are collected in globals shared by all requests
+    if (spinner_threads > 1) {
+        ROS_WARN("serving one request at a time, as markers are visualized");
+        spinner_threads = 1;
+    }
+#endif  // VISUALIZE_MARKERS_IN_RVIZ
+    uoe::utils::trace::enable(trace);
+    if (record_dir.empty()) {
+        recorder.reset();
+    } else if (recorder == nullptr || recorder->dir() != record_dir) {
+        ROS_INFO_STREAM("recording requests to " << record_dir);
+        recorder = std::make_unique<uoe::recording::recorder>(record_dir);
+    }
+}
 
-    ROS_INFO_STREAM("information gain: " << best_gain);
+namespace uoe::rrt_service {
+
+auto load_params(ros::NodeHandle& nh) -> void {
+    for (const auto& [name, ref] : params()) {
+        const auto key = "/uoe/rrt_service/" + name;
+        std::visit(
+            [&](auto* value) {
+                if constexpr (std::is_same_v<decltype(value), unsigned int*>) {
+                    auto n = static_cast<int>(*value);
+                    nh.param(key, n, n);
+                    *value = static_cast<unsigned int>(std::max(n, 0));
+                } else {
+                    nh.param(key, *value, *value);
+                }
+            },
+            ref);
+    }
+    apply_params();
+}
 
+auto set_param(const std::string& name, const std::string& value) -> bool {
+    const auto it = std::find_if(params().begin(), params().end(),
+                                 [&](const auto& param) { return param.first == name; });
+    if (it == params().end()) {
+        return false;
+    }
+    std::visit(
+        [&](auto* v) {
+            using T = std::remove_pointer_t<decltype(v)>;
+            if constexpr (std::is_same_v<T, bool>) {
+                if (value != "true" && value != "false" && value != "1" && value != "0") {
+                    throw std::invalid_argument(name + " must be true or false");
+                }
+                *v = value == "true" || value == "1";
+            } else if constexpr (std::is_same_v<T, int>) {
+                *v = std::stoi(value);
+            } else if constexpr (std::is_same_v<T, unsigned int>) {
+                *v = static_cast<unsigned int>(std::max(std::stoi(value), 0));
+            } else if constexpr (std::is_same_v<T, double>) {
+                *v = std::stod(value);
+            } else {
+                *v = value;
+            }
+        },
+        it->second);
+    if (name == "seed") {
+        // the seeds of the requests that follow start over, as if the service had just started
+        n_seeded_requests = 0;
+    }
+    apply_params();
     return true;
 }
 
+auto set_octomap_source(std::function<std::shared_ptr<const Octomap>()> source) -> void {
+    octomap_source = std::move(source);
+}
+
+auto reset_state() -> void {
+    {
+        auto lock = std::scoped_lock{fleet.mutex};
+        fleet.nbv_states.clear();
+        fleet.claimed_viewpoints.clear();
+    }
+    {
+        // waits for a roadmap being built, rather than leave it to finish into the next requests
+        auto lock = std::scoped_lock{roadmap_mutex};
+        roadmap_cache = roadmap_state{};
+    }
+    {
+        auto lock = std::scoped_lock{map_views_mutex};
+        esdf_cache = esdf_state{};
+        inflated_occupancy_cache = inflated_occupancy_state{};
+        snapshot_cache = snapshot_state{};
+        coarse_free_space_cache = coarse_free_space_state{};
+        frontiers_cache = frontiers_state{};
+    }
+    n_seeded_requests = 0;
+}
+
+auto find_path(uoe_msgs::RrtFindPath::Request& request, uoe_msgs::RrtFindPath::Response& response)
+    -> bool {
+    return rrt_find_path_handler(request, response);
+}
+
+auto nbv(uoe_msgs::NBV::Request& request, uoe_msgs::NBV::Response& response) -> bool {
+    return nbv_handler(request, response);
+}
+
+}  // namespace uoe::rrt_service
+
 // -------------------------------------------------------------------------------------------------
 
+#ifndef RRT_SERVICE_NO_MAIN
 auto main(int argc, char* argv[]) -> int {
     const auto name_of_node = "rrt_service"s;
 
@@ -521,7 +1564,6 @@ auto main(int argc, char* argv[]) -> int {
 
 #ifdef VISUALIZE_MARKERS_IN_RVIZ
     // marker_array.markers = std::vector<visualization_msgs::Marker>{};
-    auto rate = ros::Rate(uoe::utils::DEFAULT_LOOP_RATE);
 
     waypoints_path_pub = std::make_unique<ros::Publisher>([&] {
         const auto service_name = "/visualization_marker"s;
@@ -539,7 +1581,7 @@ auto main(int argc, char* argv[]) -> int {
         auto msg = before_waypoint_optimization_arrow_msg_gen({from, to}, ros::Time::now(),
                                                               ros::Duration(MARKER_TIMEOUT));
         // waypoints_path_pub->publish(msg);
-        rrt_marker_array.markers.push_back(msg);
+        rrt_markers->add(std::move(msg));
 
         // rate.sleep();
         // ros::spinOnce();
@@ -555,10 +1597,7 @@ auto main(int argc, char* argv[]) -> int {
                                                          .build();
 
     after_waypoint_optimization = [&](const vec3& from, const vec3& to) {
-        auto msg = after_waypoint_optimization_arrow_msg_gen({from, to});
-        waypoints_path_pub->publish(msg);
-        rate.sleep();
-        ros::spinOnce();
+        rrt_markers->add(after_waypoint_optimization_arrow_msg_gen({from, to}));
     };
 
     ros::Duration(1).sleep();
@@ -570,13 +1609,11 @@ auto main(int argc, char* argv[]) -> int {
                                      .build();
 
     auto unknown_voxel_cube_msg_gen =
-        uoe::utils::rviz::cube_msg_gen{static_cast<float>(voxel_resolution)};
+        uoe::utils::rviz::cube_msg_gen{static_cast<float>(voxel_resolution.load())};
 
     raycast = [&](const vec3& origin, const vec3& direction, const float length, bool did_hit,
                   const vec3& center_of_hit_voxel) {
-        std::cerr << "raycast cb" << std::endl;
         if (did_hit) {
-            std::cerr << "it did hit so drawing voxel" << std::endl;
             // auto msg = raycast_arrow_msg_gen({origin, origin + direction.normalized() * length});
             // auto msg = unknown_voxel_cube_msg_gen(origin + direction.normalized() * length,
             //                                       ros::Time::now(), ros::Duration(0));
@@ -590,13 +1627,13 @@ auto main(int argc, char* argv[]) -> int {
                 msg.color.b = 0.0f;
                 msg.color.a = 0.8f;
 
-                unknown_voxel_hit_during_waypoint_optimization_marker_array.markers.push_back(msg);
+                unknown_voxel_markers->add(std::move(msg));
             }
 
             {
                 auto msg = raycast_arrow_msg_gen({origin, center_of_hit_voxel}, ros::Time::now(),
                                                  ros::Duration(MARKER_TIMEOUT));
-                unknown_voxel_hit_during_waypoint_optimization_marker_array.markers.push_back(msg);
+                unknown_voxel_markers->add(std::move(msg));
             }
         }
 
@@ -618,11 +1655,8 @@ auto main(int argc, char* argv[]) -> int {
                                       .build();
 
     new_node_created = [&](const vec3& from, const vec3& to) {
-        auto msg = new_node_arrow_msg_gen({from, to});
         // marker_array.markers.push_back(msg);
-        waypoints_path_pub->publish(msg);
-        rate.sleep();
-        ros::spinOnce();
+        rrt_markers->add(new_node_arrow_msg_gen({from, to}));
     };
 
     marker_pub = std::make_unique<ros::Publisher>([&] {
@@ -649,6 +1683,12 @@ auto main(int argc, char* argv[]) -> int {
         return nh.advertise<visualization_msgs::MarkerArray>(topic_name, queue_size);
     }());
 
+    using uoe::utils::rviz::marker_aggregator;
+    rrt_markers = std::make_unique<marker_aggregator>(*rrt_marker_array_pub, MARKER_RATE);
+    unknown_voxel_markers = std::make_unique<marker_aggregator>(*marker_array_pub, MARKER_RATE);
+    exclusion_markers =
+        std::make_unique<marker_aggregator>(*exclusion_marker_array_pub, MARKER_RATE);
+
 #endif  // VISUALIZE_MARKERS_IN_RVIZ
 
     get_octomap_client = std::make_unique<ros::ServiceClient>([&] {
@@ -656,6 +1696,14 @@ auto main(int argc, char* argv[]) -> int {
         return nh.serviceClient<octomap_msgs::GetOctomap>(service_name);
     }());
 
+    octomap_sub = std::make_unique<ros::Subscriber>([&] {
+        const auto topic_name = "/environment_voxel_map/octomap_binary"s;
+        const auto queue_size = 1;
+        return nh.subscribe<octomap_msgs::Octomap>(
+            topic_name, queue_size,
+            [](const octomap_msgs::Octomap::ConstPtr& msg) { octomap_cache.update(msg); });
+    }());
+
     clear_octomap_client = std::make_unique<ros::ServiceClient>([&] {
         const auto service_name = "/environment_voxel_map/environment_voxel_map/reset"s;
         return nh.serviceClient<std_srvs::Empty>(service_name);
@@ -666,6 +1714,9 @@ auto main(int argc, char* argv[]) -> int {
         return nh.serviceClient<octomap_msgs::BoundingBoxQuery>(service_name);
     }());
 
+    uoe::rrt_service::load_params(nh);
+    ROS_INFO_STREAM("scoring nbv candidates with " << nbv_worker_threads << " worker threads");
+
     ROS_INFO("creating rrt service");
 
     auto service = [&] {
@@ -686,7 +1737,28 @@ auto main(int argc, char* argv[]) -> int {
         return nh.advertise<uoe_msgs::FoVGainMetric>(topic_name, queue_size);
     }());
 
-    ros::spin();
+    auto diagnostics_pub = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+    auto diagnostics_timer = ros::Timer();
+    if (trace) {
+        diagnostics_timer = nh.createTimer(
+            ros::Duration(TRACE_DIAGNOSTICS_PERIOD),
+            [&](const ros::TimerEvent&) { diagnostics_pub.publish(trace_diagnostics()); });
+    }
+
+    if (spinner_threads > 1) {
+        ROS_INFO_STREAM("serving requests with " << spinner_threads << " threads");
+        auto spinner = ros::AsyncSpinner(static_cast<std::uint32_t>(spinner_threads));
+        spinner.start();
+        ros::waitForShutdown();
+    } else {
+        ros::spin();
+    }
+
+    if (trace && ! trace_file.empty()) {
+        ROS_INFO_STREAM("writing trace to " << trace_file);
+        uoe::utils::trace::write_chrome_trace(std::ofstream(trace_file));
+    }
 
     return 0;
 }
+#endif  // RRT_SERVICE_NO_MAIN
@@ -0,0 +1,75 @@
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "uoe/octomap_snapshot_file.hpp"
+
+using namespace std::string_literals;
+
+// prints the known volume of every snapshot file given, and with --at the status of a point in
+// each of them. Only the header, and the pages a lookup touches, are read from each file.
+auto main(int argc, char* argv[]) -> int {
+    const auto usage = [&] {
+        std::cerr << "usage: " << argv[0] << " [--at x y z] <map.snap>..." << '\n';
+        std::cerr << "EXAMPLE\n"
+                  << argv[0] << " --at 0 0 2 data/object_map_*.snap" << '\n';
+    };
+
+    auto at = std::optional<uoe::MappedOctomapSnapshot::point_type>{};
+    auto paths = std::vector<std::string>();
+    for (int i = 1; i < argc; ++i) {
+        const auto arg = std::string(argv[i]);
+        if (arg == "--help" || arg == "-h") {
+            usage();
+            std::exit(EXIT_SUCCESS);
+        } else if (arg == "--at" && i + 3 < argc) {
+            at = uoe::MappedOctomapSnapshot::point_type{std::stof(argv[i + 1]),
+                                                        std::stof(argv[i + 2]),
+                                                        std::stof(argv[i + 3])};
+            i += 3;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.empty()) {
+        usage();
+        std::exit(EXIT_FAILURE);
+    }
+
+    const auto status_to_string = [](uoe::VoxelStatus vs) {
+        switch (vs) {
+            case uoe::VoxelStatus::Free:
+                return "free"s;
+            case uoe::VoxelStatus::Occupied:
+                return "occupied"s;
+            default:
+                return "unknown"s;
+        }
+    };
+
+    std::cout << std::fixed << std::setprecision(3);
+    auto failed = false;
+    for (const auto& path : paths) {
+        try {
+            const auto snapshot = uoe::MappedOctomapSnapshot(path);
+            const auto& header = snapshot.header();
+            const auto voxel_volume = std::pow(header.resolution, 3);
+            std::cout << path << '\t' << "resolution: " << header.resolution << '\t'
+                      << "free: " << header.n_free_voxels * voxel_volume << " m3\t"
+                      << "occupied: " << header.n_occupied_voxels * voxel_volume << " m3";
+            if (at) {
+                const auto status = snapshot.get_voxel_status_at_point(*at);
+                std::cout << '\t' << "at: " << status_to_string(status);
+            }
+            std::cout << '\n';
+        } catch (const std::runtime_error& e) {
+            std::cerr << e.what() << '\n';
+            failed = true;
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
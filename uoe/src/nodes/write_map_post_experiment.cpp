@@ -7,6 +7,7 @@
 #include <string>
 
 #include "uoe/octomap.hpp"
+#include "uoe/octomap_snapshot_file.hpp"
 #include "uoe/utils/utils.hpp"
 #include "uoe_msgs/MissionStateStamped.h"
 #include "ros/service.h"
@@ -15,12 +16,13 @@ using namespace std::string_literals;
 
 std::unique_ptr<ros::ServiceClient> get_octomap_client;
 
-auto call_get_octomap() -> uoe::Octomap* {
+auto call_get_octomap() -> std::unique_ptr<uoe::Octomap> {
     auto request = octomap_msgs::GetOctomap::Request{};  // empty request
     auto response = octomap_msgs::GetOctomap::Response{};
 
     get_octomap_client->call(request, response);
-    return response.map.data.size() == 0 ? nullptr : new uoe::Octomap{response.map};
+    return response.map.data.size() == 0 ? nullptr
+                                         : std::make_unique<uoe::Octomap>(response.map);
 }
 
 uoe_msgs::MissionStateStamped mission_state;
@@ -61,9 +63,12 @@ auto main(int argc, char* argv[]) -> int {
         const auto path = std::filesystem::path(output_bt_filepath);
 
         std::cerr << "writing octomap to file: " << path << '\n';
-        octomap_ptr->write(path);
-
-        delete octomap_ptr;
+        // a .snap file can be mapped into memory by analysis tools, instead of deserialized
+        if (path.extension() == uoe::SnapshotFileHeader::FILE_EXTENSION) {
+            octomap_ptr->snapshot().write(path);
+        } else {
+            octomap_ptr->write(path);
+        }
     } else {
         std::cerr << "octomap received from " << object_map_client_topic_name
                   << " was EMPTY not writing to " << output_bt_filepath << '\n';
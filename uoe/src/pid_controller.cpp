@@ -2,23 +2,26 @@
 
 namespace uoe::control {
 
+namespace {
+template <typename T>
+auto to_vec3(const std::array<T, 3>& v) -> Eigen::Vector3f {
+    return Eigen::Vector3f(static_cast<float>(v[0]), static_cast<float>(v[1]),
+                           static_cast<float>(v[2]));
+}
+}  // namespace
+
 PIDController::PIDController(ros::NodeHandle& nh, ros::Rate& rate, PID gains_xy, PID gains_z,
                              PID gains_yaw, bool visualise)
     : rate(rate),
-      gains_xy(gains_xy),
-      gains_z(gains_z),
-      gains_yaw(gains_yaw),
-      error_position({0, 0, 0}),
-      error_position_integral({0, 0, 0}),
-      error_position_previous({0, 0, 0}),
-      error_yaw(0),
-      error_yaw_integral(0),
-      error_yaw_previous(0),
+      period(std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::duration<double>(rate.expectedCycleTime().toSec()))),
+      pid(gains_xy, gains_z, gains_yaw, std::chrono::duration<float>(period).count()),
       command_linear({0, 0, 0}),
       command_yaw(0),
       seq_command(0),
       seq_state(0),
       seq_visualise(0),
+      running(false),
       should_visualise(visualise) {
     // state subscriber
     sub_mission_state = nh.subscribe<uoe_msgs::MissionStateStamped>(
@@ -41,6 +44,18 @@ PIDController::PIDController(ros::NodeHandle& nh, ros::Rate& rate, PID gains_xy,
     // visualisation publisher
     pub_visualisation = nh.advertise<visualization_msgs::Marker>("/uoe/visualisation/controller",
                                                                  uoe::utils::DEFAULT_QUEUE_SIZE);
+
+    command_msg.header.frame_id = uoe::utils::FRAME_WORLD;
+}
+
+PIDController::~PIDController() {
+    running = false;
+    if (control_thread.joinable()) {
+        control_thread.join();
+    }
+    if (report_thread.joinable()) {
+        report_thread.join();
+    }
 }
 
 /**
@@ -50,40 +65,11 @@ PIDController::PIDController(ros::NodeHandle& nh, ros::Rate& rate, PID gains_xy,
  * @param pos_error is the 3D euclidean error
  * @return geometry_msgs::TwistStamped PID control output in a geometry_msgs::TwistStamped message
  */
-auto PIDController::compute_linear_velocities() -> void {
-    // std::cout << "Inside compute_linear_velocities" << std::endl;
-    // std::cout << "gains_xy: \n" << gains_xy.p << " " << gains_xy.i << " " << gains_xy.d <<
-    // std::endl; std::cout << "gains_z: \n" << gains_z.p << " " << gains_z.i << " " << gains_z.d <<
-    // std::endl; std::cout << "gains_yaw: \n" << gains_yaw.p << " " << gains_yaw.i << " " <<
-    // gains_yaw.d << std::endl;
-    error_position =
-        uoe::utils::transform::geometry_mgs_point_to_vec(mission_state.target.position) -
-        uoe::utils::transform::geometry_mgs_point_to_vec(odom.pose.pose.position);
-    // update integral error if the drone is in the air
-    if (odom.pose.pose.position.z > uoe::utils::SMALL_DISTANCE_TOLERANCE) {
-        error_position_integral += error_position;
-    }
-    // change in error since previous time step
-    auto error_derivative =
-        (error_position - error_position_previous) / rate.expectedCycleTime().toSec();
-
-    // linear velocity controller output
-    // apply seperate gains for xy and z
-    auto x_vel = gains_xy.p * error_position.x() + gains_xy.i * error_position_integral.x() +
-                 gains_xy.d * error_derivative.x();
-    auto y_vel = gains_xy.p * error_position.y() + gains_xy.i * error_position_integral.y() +
-                 gains_xy.d * error_derivative.y();
-    auto z_vel = gains_z.p * error_position.z() + gains_z.i * error_position_integral.z() +
-                 gains_z.d * error_derivative.z();
-    auto tmp_command_linear = Eigen::Vector3f{x_vel, y_vel, z_vel};
-    // auto ep = gains_xy.p * error_position;
-    // auto ei = gains_xy.i * error_position_integral;
-    // auto ed = gains_xy.d * error_derivative;
-    // auto tmp_command_linear = ep + ei + ed;
+auto PIDController::compute_linear_velocities(const odometry_state& odom,
+                                              const setpoint_state& setpoint) -> void {
     // set class field used to publish
-    command_linear = uoe::utils::eigen::clamp_vec3(tmp_command_linear, VELOCITY_MIN, VELOCITY_MAX);
-
-    error_position_previous = error_position;
+    command_linear =
+        pid.compute_linear_velocities(to_vec3(odom.position), to_vec3(setpoint.position));
 }
 
 /**
@@ -93,69 +79,58 @@ auto PIDController::compute_linear_velocities() -> void {
  * @param quat is the target attitude for the drone
  * @return float yaw velocity
  */
-auto PIDController::compute_yaw_velocity() -> void {
+auto PIDController::compute_yaw_velocity(const odometry_state& odom,
+                                         const setpoint_state& setpoint) -> void {
     // target attitude
-    auto target_yaw = tf2::getYaw(mission_state.target.orientation);
+    const auto target_attitude = tf2::Quaternion(setpoint.orientation[0], setpoint.orientation[1],
+                                                 setpoint.orientation[2], setpoint.orientation[3]);
+    auto target_yaw = tf2::getYaw(target_attitude);
 
-    // attitude error
     auto yaw = utils::state::yaw_representation(tf2::getYaw(drone_attitude) + M_PI / 2);
-    error_yaw = utils::state::yaw_representation(target_yaw - yaw);
-
-    // update integral error if the drone is in the air
-    if (odom.pose.pose.position.z > utils::SMALL_DISTANCE_TOLERANCE) {
-        error_yaw_integral += error_yaw;
-    }
-    // change in error since previous time step
-    std::cout << uoe::utils::GREEN << static_cast<float>(rate.expectedCycleTime().toSec())
-              << uoe::utils::RESET << std::endl;
-    auto error_yaw_derivative =
-        (error_yaw - error_yaw_previous) / static_cast<float>(rate.expectedCycleTime().toSec());
-    // pid output
-    auto tmp_command_yaw = gains_yaw.p * error_yaw + gains_yaw.i * error_yaw_integral +
-                           gains_yaw.d * error_yaw_derivative;
     // set class field used to publish
-    command_yaw = std::clamp(tmp_command_yaw, VELOCITY_MIN_YAW, VELOCITY_MAX_YAW);
-
-    error_yaw_previous = error_yaw;
+    command_yaw = pid.compute_yaw_velocity(to_vec3(odom.position), yaw, target_yaw);
 }
 /**
- * @brief publishes all necessary controller information, such as position error, to the topic
- * /uoe/controller/error
+ * @brief publishes the velocity setpoint to MAVROS
  *
  */
-auto PIDController::publish() -> void {
-    // velocity control message
-    geometry_msgs::TwistStamped twist_msg{};
-
-    twist_msg.header.seq = seq_command++;
-    twist_msg.header.stamp = ros::Time::now();
-    twist_msg.header.frame_id = uoe::utils::FRAME_WORLD;
+auto PIDController::publish_command() -> void {
+    command_msg.header.seq = seq_command++;
+    command_msg.header.stamp = ros::Time::now();
 
-    twist_msg.twist.linear.x = command_linear.x();
-    twist_msg.twist.linear.y = command_linear.y();
-    twist_msg.twist.linear.z = command_linear.z();
-    twist_msg.twist.angular.z = command_yaw;
+    command_msg.twist.linear.x = command_linear.x();
+    command_msg.twist.linear.y = command_linear.y();
+    command_msg.twist.linear.z = command_linear.z();
+    command_msg.twist.angular.z = command_yaw;
 
-    pub_velocity.publish(twist_msg);
+    pub_velocity.publish(command_msg);
+}
 
-    // state message
+/**
+ * @brief publishes all necessary controller information, such as position error, to the topic
+ * /uoe/controller/state
+ *
+ */
+auto PIDController::publish_state(const controller_report& report) -> void {
     uoe_msgs::ControllerStateStamped state_msg;
     state_msg.header.seq = seq_state++;
     state_msg.header.stamp = ros::Time::now();
     state_msg.header.frame_id = uoe::utils::FRAME_WORLD;
 
-    state_msg.command = twist_msg.twist;
+    state_msg.command.linear.x = report.command_linear[0];
+    state_msg.command.linear.y = report.command_linear[1];
+    state_msg.command.linear.z = report.command_linear[2];
+    state_msg.command.angular.z = report.command_yaw;
 
+    const auto error_position = to_vec3(report.error_position);
     state_msg.error.position.x = error_position.x();
     state_msg.error.position.y = error_position.y();
     state_msg.error.position.z = error_position.z();
     state_msg.error.position.norm = error_position.norm();
-    state_msg.error.yaw = error_yaw;
+    state_msg.error.yaw = report.error_yaw;
 
     state_msg.error.perpendicular =
-        (uoe::utils::transform::geometry_mgs_point_to_vec(mission_state.closest_point) -
-         uoe::utils::transform::geometry_mgs_point_to_vec(odom.pose.pose.position))
-            .norm();
+        (to_vec3(report.closest_point) - to_vec3(report.position)).norm();
 
     pub_state.publish(state_msg);
 }
@@ -164,9 +139,9 @@ auto PIDController::publish() -> void {
  * for visualisation in RViz
  *
  */
-auto PIDController::visualise() -> void {
-    auto m = utils::rviz::sphere_msg_gen()(
-        utils::transform::geometry_mgs_point_to_vec(odom.pose.pose.position) + error_position);
+auto PIDController::visualise(const controller_report& report) -> void {
+    const auto pos = to_vec3(report.position);
+    auto m = utils::rviz::sphere_msg_gen()(pos + to_vec3(report.error_position));
     m.header.frame_id = utils::FRAME_WORLD;
 
     m.color.a = 1;
@@ -178,12 +153,6 @@ auto PIDController::visualise() -> void {
     m.scale.y = 0.05;
     m.scale.z = 0.05;
 
-    // std::cout << uoe::utils::MAGENTA << "PUBLISHING" << RESET << std::endl;
-    // std::cout << uoe::utils::ITALIC << uoe::utils::BOLD << "x: " << m.pose.position.x << "\ty: "
-    // << m.pose.position.y
-    //           << "\tz: " << m.pose.position.z << std::endl;
-
-    auto pos = utils::transform::geometry_mgs_point_to_vec(odom.pose.pose.position);
     pub_visualisation.publish(m);
 
     auto m2 = utils::rviz::arrow_msg_gen::Builder()
@@ -191,7 +160,7 @@ auto PIDController::visualise() -> void {
                   .arrow_width(0.025)
                   .arrow_length(0.05)
                   .color(0, 1, 0, 1)
-                  .build()({pos, pos + command_linear});
+                  .build()({pos, pos + to_vec3(report.command_linear)});
     m2.header.frame_id = utils::FRAME_WORLD;
     m2.id = -1;
     pub_visualisation.publish(m2);
@@ -202,43 +171,118 @@ auto PIDController::visualise() -> void {
  * sets class field `odom` to the contents of the published message.
  *
  */
-auto PIDController::odom_cb(const nav_msgs::Odometry::ConstPtr& msg) -> void { odom = *msg; }
+auto PIDController::odom_cb(const nav_msgs::Odometry::ConstPtr& msg) -> void {
+    const auto& pose = msg->pose.pose;
+    odom.store({{pose.position.x, pose.position.y, pose.position.z},
+                {pose.orientation.x, pose.orientation.y, pose.orientation.z, pose.orientation.w}});
+}
 /**
  * @brief called when new message is published on the uoe state topic /uoe/mission/state. sets class
  * field `state` to the contents of the published message.
  *
  */
 auto PIDController::mission_state_cb(const uoe_msgs::MissionStateStamped::ConstPtr& msg) -> void {
-    mission_state = *msg;
+    const auto& target = msg->target;
+    mission_state.store(
+        {{target.position.x, target.position.y, target.position.z},
+         {target.orientation.x, target.orientation.y, target.orientation.z, target.orientation.w},
+         {msg->closest_point.x, msg->closest_point.y, msg->closest_point.z},
+         static_cast<std::uint8_t>(msg->state)});
 }
 
 /**
- * @brief runs the PID controller, looping with the given ros::Rate
+ * @brief one control step every period, until the controller stops. Sleeps until an absolute
+ * deadline, so the time spent computing and publishing does not add up to drift.
  *
  */
-auto PIDController::run() -> void {
-    while (ros::ok()) {
-        auto expected_position =
-            Eigen::Vector3f(mission_state.target.position.x, mission_state.target.position.y,
-                            mission_state.target.position.z);
+auto PIDController::control_loop() -> void {
+    using clock = std::chrono::steady_clock;
+    auto max_wakeup_latency = clock::duration::zero();
+    auto deadline = clock::now();
+    while (running) {
+        const auto odom_state = odom.load();
+        const auto setpoint = mission_state.load();
 
-        tf2::Quaternion drone_attitude_ned;
-        tf2::fromMsg(odom.pose.pose.orientation, drone_attitude_ned);
+        tf2::Quaternion drone_attitude_ned(odom_state.orientation[0], odom_state.orientation[1],
+                                           odom_state.orientation[2], odom_state.orientation[3]);
         drone_attitude =
             drone_attitude_ned * tf2::Quaternion(std::sqrt(2) / 2, -std::sqrt(2) / 2, 0, 0);
 
-        compute_linear_velocities();
-        compute_yaw_velocity();
+        compute_linear_velocities(odom_state, setpoint);
+        compute_yaw_velocity(odom_state, setpoint);
+
+        if (setpoint.mission_state != 4) {
+            publish_command();
+        }
+
+        report.store({{static_cast<float>(odom_state.position[0]),
+                       static_cast<float>(odom_state.position[1]),
+                       static_cast<float>(odom_state.position[2])},
+                      {pid.error_position().x(), pid.error_position().y(),
+                       pid.error_position().z()},
+                      {command_linear.x(), command_linear.y(), command_linear.z()},
+                      setpoint.closest_point,
+                      pid.error_yaw(),
+                      command_yaw,
+                      std::chrono::duration<float>(max_wakeup_latency).count()});
 
-        if (mission_state.state != 4) {
-            publish();
-            if (should_visualise) {
-                visualise();
-            }
+        deadline += period;
+        std::this_thread::sleep_until(deadline);
+        const auto now = clock::now();
+        max_wakeup_latency = std::max(max_wakeup_latency, now - deadline);
+        // skip the periods that were missed entirely, instead of running them back to back
+        if (now - deadline > period) {
+            deadline = now;
         }
+    }
+}
 
-        ros::spinOnce();
+/**
+ * @brief publishes the controller state, and visualises it if enabled, at the loop rate.
+ * Nothing here is timing critical, so a slow publisher only delays the next report.
+ *
+ */
+auto PIDController::report_loop() -> void {
+    auto last_version = report.version();
+    while (running) {
         rate.sleep();
+        if (report.version() == last_version || mission_state.load().mission_state == 4) {
+            continue;
+        }
+        last_version = report.version();
+        const auto current = report.load();
+        ROS_DEBUG_STREAM_THROTTLE(
+            5, "control loop woke up at most " << current.max_wakeup_latency << " s late");
+        publish_state(current);
+        if (should_visualise) {
+            visualise(current);
+        }
     }
 }
-}  // namespace uoe::control
\ No newline at end of file
+
+/**
+ * @brief starts the PID controller on its own thread, with the period of the given ros::Rate, and
+ * returns. The callbacks are left to whoever spins the queue of the node handle.
+ *
+ */
+auto PIDController::start() -> void {
+    running = true;
+    control_thread = std::thread(&PIDController::control_loop, this);
+    report_thread = std::thread(&PIDController::report_loop, this);
+}
+
+/**
+ * @brief runs the PID controller on its own thread, with the period of the given ros::Rate, and
+ * handles the callbacks on the calling thread until ROS shuts down
+ *
+ */
+auto PIDController::run() -> void {
+    start();
+
+    ros::spin();
+
+    running = false;
+    control_thread.join();
+    report_thread.join();
+}
+}  // namespace uoe::control
@@ -4,6 +4,8 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <cmath>
@@ -24,16 +26,24 @@
 #include <variant>
 #include <vector>
 
+#include "uoe/graph.hpp"
 #include "uoe/rrt/rrt_builder.hpp"
+#include "uoe/utils/concurrency.hpp"
 #include "uoe/utils/eigen.hpp"
 #include "uoe/utils/random.hpp"
 #include "uoe/utils/rosparam.hpp"
+#include "uoe/utils/trace.hpp"
 #include "ros/duration.h"
 #include "ros/message.h"
 
 namespace uoe::rrt {
 
 auto RRT::run() -> std::optional<Waypoints> {
+    const auto never = std::atomic<bool>{false};
+    return run(never);
+}
+
+auto RRT::run(const std::atomic<bool>& cancelled) -> std::optional<Waypoints> {
     if (collision_free_(start_position_, goal_position_)) {
         // we might get lucky here, and a direct path between start and goal exists :-)
         waypoints_.push_back(start_position_);
@@ -41,7 +51,7 @@ auto RRT::run() -> std::optional<Waypoints> {
         return {waypoints_};
     }
 
-    while (remaining_iterations_ > 0) {
+    while (remaining_iterations_ > 0 && ! cancelled.load(std::memory_order_relaxed)) {
         if (grow_()) {
             return {waypoints_};
         }
@@ -50,6 +60,42 @@ auto RRT::run() -> std::optional<Waypoints> {
     return {};
 }
 
+auto RRT::run_until(clock::time_point deadline) -> AnytimeResult {
+    auto result = AnytimeResult{};
+    if (collision_free_(start_position_, goal_position_)) {
+        waypoints_ = {start_position_, goal_position_};
+        result.waypoints = waypoints_;
+        result.reached_goal = true;
+        return result;
+    }
+
+    const auto t_start = clock::now();
+    auto now = t_start;
+    while (remaining_iterations_ > 0 && now < deadline) {
+        ++result.iterations;
+        if (grow_()) {
+            result.reached_goal = true;
+            if (! informed_sampling_enabled_) {
+                break;
+            }
+        }
+        now = clock::now();
+    }
+    const auto elapsed = std::chrono::duration<double>(clock::now() - t_start).count();
+    iterations_per_second_ = elapsed > 0 ? static_cast<double>(result.iterations) / elapsed : 0.0;
+    result.iterations_per_second = iterations_per_second_;
+
+    if (informed_sampling_enabled_ && result.reached_goal) {
+        // rewiring may have shortened the path to a goal node since it was backtracked
+        backtrack_and_set_waypoints_starting_at_(cheapest_goal_node_());
+        waypoints_ = best_waypoints_;
+    } else if (! result.reached_goal) {
+        get_waypoints_from_nearsest_node_to(goal_position_);
+    }
+    result.waypoints = waypoints_;
+    return result;
+}
+
 auto RRT::growN(int n) -> bool {
     if (n < 0) {
         throw std::invalid_argument("n must be positive");
@@ -66,14 +112,64 @@ auto RRT::growN(int n) -> bool {
 
 auto RRT::get_frontier_nodes() const -> std::vector<vec3> {
     auto frontier_nodes = std::vector<vec3>{};
-    for (const auto& n : nodes_) {
-        if (n.is_leaf()) {
-            frontier_nodes.push_back(n.position_);
+    for (node_index i = 0; i < tree_.size(); ++i) {
+        if (tree_.is_leaf(i)) {
+            frontier_nodes.push_back(tree_.position(i));
         }
     }
     return frontier_nodes;
 }
 
+auto RRT::reroot(const vec3& start) -> bool {
+    const auto nearest = find_nearest_neighbor_(start);
+    if (nearest == no_node) {
+        return false;
+    }
+
+    auto new_root = nearest;
+    if (! tree_.position(nearest).isApprox(start)) {
+        if (! collision_free_(start, tree_.position(nearest))) {
+            return false;
+        }
+        new_root = tree_.add(start, nearest);
+    }
+    tree_.make_root(new_root);
+
+    start_position_ = start;
+    direction_from_start_to_goal_ = goal_position_ - start;
+    remaining_iterations_ = max_iterations_;
+    waypoints_.clear();
+    // the bound is on paths from the old start
+    best_path_length_ = std::numeric_limits<float>::infinity();
+    best_waypoints_.clear();
+    return true;
+}
+
+auto RRT::prune_edges_in_collision(const std::optional<types::BBX>& region)
+    -> std::vector<node_index> {
+    // an edge is affected by the region, if the volume swept by the drone along it overlaps
+    const auto padding = static_cast<float>(std::max({drone_width_, drone_height_, drone_depth_}));
+    const auto near_region = [&](const vec3& a, const vec3& b) {
+        if (! region) {
+            return true;
+        }
+        const vec3 lo = a.cwiseMin(b) - vec3::Constant(padding);
+        const vec3 hi = a.cwiseMax(b) + vec3::Constant(padding);
+        return (lo.array() <= region->max().array()).all() &&
+               (region->min().array() <= hi.array()).all();
+    };
+
+    return remove_subtrees_if_([&](node_index i) {
+        const auto parent = tree_.parent(i);
+        if (parent == no_node) {
+            return false;
+        }
+        const auto& from = tree_.position(parent);
+        const auto& to = tree_.position(i);
+        return near_region(from, to) && ! collision_free_(from, to);
+    });
+}
+
 RRT::RRT(const vec3& start_position, const vec3& goal_position, float step_size, float goal_bias,
          std::size_t max_iterations, float max_dist_goal_tolerance,
          float probability_of_testing_full_path_from_new_node_to_goal) {
@@ -85,7 +181,7 @@ RRT::RRT(const vec3& start_position, const vec3& goal_position, float step_size,
         direction_from_start_to_goal_ = direction;
         // TODO: figure out the best radius
         sampling_radius_ = direction.norm() * 1.5;
-        nodes_.emplace_back(start_position);
+        tree_.add_root(start_position);
     }
 
     if (step_size < 0.f) {
@@ -96,8 +192,7 @@ RRT::RRT(const vec3& start_position, const vec3& goal_position, float step_size,
 
     max_iterations_ = max_iterations;
     remaining_iterations_ = max_iterations;
-    // // DO NOT CHANGE THIS, IF A CONSTANT IS NOT ADDED THEN A DOUBLE FREE HAPPENS
-    // nodes_.reserve(max_iterations + 10);
+    tree_.reserve(max_iterations * 2);
 
     if (max_dist_goal_tolerance < 0.f) {
         auto err_msg = "max_dist_goal_tolerance must be greater than 0.f";
@@ -126,93 +221,74 @@ RRT::RRT(const vec3& start_position, const vec3& goal_position, float step_size,
 }
 
 auto RRT::sample_random_point_() -> vec3 {
+    if (informed_sampling_enabled_ && best_path_length_ < std::numeric_limits<float>::infinity()) {
+        return rng_.sample_random_point_inside_prolate_spheroid(start_position_, goal_position_,
+                                                                best_path_length_);
+    }
+    if (! sampling_targets_.empty() && rng_.random01() < sampling_target_probability_) {
+        const auto n = sampling_targets_.size();
+        const auto i = std::min(static_cast<std::size_t>(rng_.random01() * n), n - 1);
+        return sampling_targets_[i] +
+               sampling_target_radius_ * rng_.sample_random_point_inside_unit_sphere();
+    }
     auto random_pt =
         rng_.sample_random_point_inside_unit_sphere(direction_from_start_to_goal_, goal_bias_);
     return sampling_radius_ * random_pt + goal_position_;
 }
 
-auto RRT::find_nearest_neighbor_(const vec3& pt) -> RRT::node_t* {
-    struct nearest_neighbor_candidate_t {
-        double distance = std::numeric_limits<double>::max();
-        std::size_t index{};
-    };
-    using nearest_neighbor_candidates_t = std::vector<nearest_neighbor_candidate_t>;
-    auto nearest_neighbor_candidates = nearest_neighbor_candidates_t();
-
+auto RRT::find_nearest_neighbor_(const vec3& pt, bool in_goal_tree) -> node_index {
+    const auto timer = utils::trace::scoped_timer(utils::trace::stage::nearest_neighbor);
+    const auto& tree = in_goal_tree ? goal_tree_ : tree_;
 #ifdef USE_KDTREE
-    // 1. find nearest neighbor in each kdtree, and store them in a list of candidates.
-    for (const auto& bucket : kdtree3s_) {
-        // TODO: would be better not to expose the underlying array here.
-        for (const auto& kdtree : bucket.forest) {
-            if (kdtree != nullptr) {
-                if (const auto opt = kdtree->nearest(pt)) {
-                    const auto [_, shortest_distance, index] = opt.value();
-                    // const auto distance = kdtree->distance();
-                    nearest_neighbor_candidates.push_back(
-                        nearest_neighbor_candidate_t{shortest_distance, index});
-                }
-            }
+    auto& index = in_goal_tree ? goal_index_ : index_;
+    sync_index_(tree, index);
+    ++stats_.nn_queries;
+    if (const auto opt = index.nearest(pt)) {
+        stats_.nn_nodes_visited += opt->n_visited;
+        return static_cast<node_index>(opt->value);
+    }
+    return no_node;
+#else
+    // linear search, comparing squared distances as only the relative ordering is of interest.
+    const auto& positions = tree.positions();
+    ++stats_.nn_queries;
+    stats_.nn_nodes_visited += positions.size();
+    if (positions.empty()) {
+        return no_node;
+    }
+    std::size_t index{0};
+    auto shortest_distance = std::numeric_limits<float>::max();
+    for (std::size_t i = 0; i < positions.size(); ++i) {
+        const auto distance = (positions[i] - pt).squaredNorm();
+        if (distance < shortest_distance) {
+            shortest_distance = distance;
+            index = i;
         }
     }
+    return static_cast<node_index>(index);
 #endif  // USE_KDTREE
-
-    // 2. find nearest neighbor in the linear search segment.
-    nearest_neighbor_candidates.push_back([&] {
-        std::size_t index{0};
-        auto shortest_distance = std::numeric_limits<double>::max();
-        for (std::size_t i = linear_search_start_index_; i < nodes_.size(); ++i) {
-            // TODO: use squared distance instead of sqrt distance. as the size is not of interest,
-            // but only relative ordering of distances between points.
-            const auto distance = (nodes_[i].position_ - pt).norm();
-            if (distance < shortest_distance) {
-                shortest_distance = distance;
-                index = i;
-            }
-        }
-        return nearest_neighbor_candidate_t{shortest_distance, index};
-    }());
-
-    // 3. compare all candidates and select the nearest one.
-    const auto index = [&] {
-        const auto smaller_distance = [](const auto& c1, const auto& c2) {
-            return c1.distance < c2.distance;
-        };
-        std::sort(nearest_neighbor_candidates.begin(), nearest_neighbor_candidates.end(),
-                  smaller_distance);
-
-        return nearest_neighbor_candidates.front().index;
-    }();
-
-    return &nodes_[index];
 }
 
 auto RRT::bft_(const std::function<void(const vec3& parent_pt, const vec3& child_pt)>& f,
                bool skip_root) const -> void {
-    const auto root = &nodes_[0];
-    assert(root != nullptr);
+    if (tree_.empty()) {
+        return;
+    }
+    const node_index root = tree_.root();
     // handle special case when node is the root.
     if (not skip_root) {
-        f(root->position_, root->position_);
+        f(tree_.position(root), tree_.position(root));
     }
 
-    auto queue = std::queue<const node_t*>{};
-    for (const auto child : root->children) {
-        queue.push(child);
-    }
-
-    while (! queue.empty()) {
-        const auto node = queue.front();
-        queue.pop();
-
-        f(node->parent->position_, node->position_);
+    // the queue is a vector with a read cursor, as every node is pushed exactly once.
+    auto queue = std::vector<node_index>{};
+    queue.reserve(tree_.size());
+    tree_.for_each_child(root, [&](node_index child) { queue.push_back(child); });
 
-        if (node->is_leaf()) {
-            continue;
-        }
-
-        for (const auto child : node->children) {
-            queue.push(child);
-        }
+    for (std::size_t head = 0; head < queue.size(); ++head) {
+        const auto node = queue[head];
+        f(tree_.position(tree_.parent(node)), tree_.position(node));
+        tree_.for_each_child(node, [&](node_index child) { queue.push_back(child); });
     }
 }
 
@@ -223,239 +299,99 @@ auto RRT::bft_(const std::function<void(const vec3& parent_pt, const vec3& child
  * @param parent
  * @return node& a reference to the new node.
  */
-auto RRT::insert_node_(const vec3& pos, node_t* parent) -> node_t& {
-    assert(parent != nullptr);
-    // TODO: this is different when rrt*
-    auto& node = nodes_.emplace_back(pos, parent);  // add vertex
-    parent->children.push_back(&node);              // add edge
+auto RRT::insert_node_(const vec3& pos, node_index parent) -> node_index {
+    assert(parent != no_node);
+    // add vertex and edge. In lazy mode the edge is checked when a path through it is backtracked
+    const auto node = tree_.add(pos, parent, ! lazy_collision_checking_enabled_);
     --remaining_iterations_;
 
-    // TODO: add star
-    // #ifdef USE_RRT_STAR
-
-    //     const auto near = [this](const auto& index) {
-    //         const auto dist = [](const vec3& a, const vec3& b) { return (b - a).norm(); };
-    //         const auto near_radius = 3.0f;
-    //         return dist(pos, nodes_[index].position_) <= near_radius;
-    //     };
-
-    //     auto near_nodes = std::vector<std::size_t>();
-
-    //     // find near neighbors in linear search region
-
-    //     for (std::size_t i = linear_search_start_index_; i < nodes_.size(); ++i) {
-    //         if (near(i)) {
-    //             near_nodes.push_back(i);
-    //         }
-    //     }
-
-    // #ifdef USE_KDTREE
-    //     // find near neighbors in kdtree search region
-
-    // #endif  // USE_KDTREE
-
-    //     auto x_min = parent;
-
-    //     auto c_min = cost(x_min) + (parent->position_ - pos).norm();
-    //     auto c_new = 2.0f;
-    //     // for all in near
-
-    //     for (auto idx : near_nodes) {
-    //         auto c_new = cost(nodes_[idx]) + (parent->position_ - pos).norm();
-    //         if (c_new < c_min && collision_free_(x_near, x_new)) {
-    //             x_min = x_near;
-    //             c_min = c_new;
-    //         }
-    //     }
-
-    //     // add edge (x_min, x_new)
-
-    //     // update edges
-    //     // n->parent_ = x_new
-
-    //     for (auto idx : near_nodes) {
-    //         const auto c_near = cost(nodes_[idx]);
-    //         auto c_new = cost(nodes_[x_new]) + (x_new - x_near).norm();
-    //         if (c_new < c_min && collision_free_(x_near, x_new)) {
-    //             auto x_parent = parent(x_near);
-    //             // remove edge (x_parent, x_near)
-    //             // add edge (x_new, x_near)
-    //         }
-    //     }
+    return node;
+}
 
-    // #endif  // USE_RRT_STAR
+auto RRT::find_near_nodes_(const vec3& pt) -> void {
+    near_nodes_.clear();
+    const auto radius = rewire_radius_ > 0.0f ? rewire_radius_ : 2 * step_size_;
 
 #ifdef USE_KDTREE
-    {
-        // determine if kdtrees should be updated. --------------------------------
-        const auto n = static_cast<int>(nodes_.size());  // number of nodes
-
-        const auto number_of_nodes_not_in_kdtrees = n - n_kdtree_nodes_;
-        assert(number_of_nodes_not_in_kdtrees >= 0);
-        const auto update_kdtrees =
-            number_of_nodes_not_in_kdtrees == max_number_of_nodes_to_do_linear_search_on_;
-
-        if (update_kdtrees) {
-            ROS_INFO_STREAM("update kdtrees");
-
-            auto bucket_sizes = std::vector<int>();
-            std::transform(kdtree3s_.begin(), kdtree3s_.end(), std::back_inserter(bucket_sizes),
-                           [](const auto& bucket) { return bucket.number_of_trees(); });
-            // make a copy of the buckets to compare with later to compute diff.
-            auto bucket_sizes_before = bucket_sizes;
-
-            const auto bucket_is_full = [](int bucket_size) {
-                return bucket_size == max_number_of_kdtrees_per_bucket_;
-            };
-            const auto any_bucket_is_full = [&]() {
-                return std::any_of(bucket_sizes.begin(), bucket_sizes.end(), bucket_is_full);
-            };
-
-            // always add 1 to the smallest bucket
-            bucket_sizes.front() += 1;
-
-            // compute the bucket sizes after updating the kdtrees
-            // example: (5 is max bucket size)
-            // [3, 0, 0, 0] -> [4, 0, 0, 0]
-            // [4, 0, 0, 0] -> [0, 1, 0, 0]
-            // [4, 4, 0, 0] -> [0, 0, 1, 0]
-            while (any_bucket_is_full()) {
-                // iterate through each bucket except the last one, and propagate the
-                // change in sizes.
-                for (auto i = 0; i < bucket_sizes.size() - 1; ++i) {
-                    if (bucket_is_full(bucket_sizes[i])) {
-                        bucket_sizes[i] = 0;
-                        bucket_sizes[i + 1] += 1;
-                    }
-                }
-
-                // edge case when the last i.e. largest bucket overflows, then
-                // a new bucket has to be created.
-                auto& last_bucket_size = bucket_sizes.back();
-                if (bucket_is_full(last_bucket_size)) {
-                    last_bucket_size = 0;
-                    bucket_sizes.emplace_back(1);
-                }
-            }
-
-            // compute diff
-            const auto bucket_sizes_diff = [&]() {
-                auto& bucket_sizes_updated = bucket_sizes;
-                const auto a_new_bucket_has_been_added =
-                    bucket_sizes_before.size() < bucket_sizes_updated.size();
-                // append 0, to make difference easier to calculate.
-                if (a_new_bucket_has_been_added) {
-                    ROS_INFO_STREAM("a new bucket has been added");
-                    bucket_sizes_before.push_back(0);
-                }
-#ifndef NDEBUG  // this object macro is defined by cpp spec when debug build is selected
-                std::cout << "before\tafter\tdiff" << '\n';
-#endif  // NDEBUG
-                auto result = std::vector<int>(bucket_sizes_updated.size());
-                // subtract each bucket element wise
-                for (auto i = 0; i < result.size(); ++i) {
-                    const auto before = bucket_sizes_before[i];
-                    const auto after = bucket_sizes_updated[i];
-                    const auto diff = after - before;
-                    result[i] = diff;
-#ifndef NDEBUG  // this object macro is defined by cpp spec when debug build is selected
-                    std::cout << before << '\t' << after << '\t' << diff << '\n';
-#endif  // NDEBUG
-                }
-
-                return result;
-            }();
-
-            // TEST:
-            const auto create_larger_bucket = bucket_sizes_diff.size() > kdtree3s_.size();
-            if (create_larger_bucket) {
-                add_bucket();
-            }
-            // apply the diff
-            for (auto i = 0; i < bucket_sizes_diff.size(); ++i) {
-                const auto diff = bucket_sizes_diff[i];
-                auto& bucket = kdtree3s_[i];
-                if (diff < 0) {
-                    // deallocate trees
-                    bucket.delete_trees();
-                    ROS_INFO(
-                        "delete kdtrees in bucket %d and merge them into a kdtree in bucket %d", i,
-                        i + 1);
-                } else if (diff > 0) {
-                    // create tree
-                    ROS_INFO("create kdtree in bucket %d", i);
-
-                    // compute interval [start, end)
-                    const auto [start, end] = [&] {
-                        auto total = 0;
-                        for (int i = 0; i < bucket_sizes.size(); ++i) {
-                            const auto trees_in_bucket = bucket_sizes[i];
-                            const auto& b = kdtree3s_[i];
-                            total += trees_in_bucket * b.size_of_a_tree;
-                        }
-                        const auto offset = bucket.size_of_a_tree;
-                        // e.g. total = 1000, and the size of the bucket is 1000, so
-                        // start = 0, and end = 1000 to get the interval.
-                        return std::make_pair(total - offset, total);
-                    }();
-                    // create generator object, that transform existing nodes in
-                    // the interval, into the format used by a kdtree.
-                    auto generator = [this, start = start, end = end] {
-                        assert(start < end);
-                        assert(0 <= start && start < nodes_.size());
-                        // assert(0 <= end && end < nodes_.size());
-                        auto it = std::next(nodes_.begin(), start);
-                        // the lambda needs to bo mutable because we want a different output for
-                        // each invocation. Otherwise the same output will be generated.
-                        return [it,
-                                index = start]() mutable -> std::pair<kdtree3::Point, std::size_t> {
-                            // get point and advance iterator
-                            const auto pos = (*it++).position_;
-                            return {pos, index++};
-                        };
-                    }();
-
-                    bucket.add_kdtree(generator, end - start);
-
-                    // recompute number of kdtree nodes.
-                    // its correct to only recompute it here because the number of kdtree nodes
-                    // only changes when a new kdtree is created,
-                    // and only one kdtree at max can be created when this method is called.
-                    n_kdtree_nodes_ = std::transform_reduce(
-                        kdtree3s_.begin(), kdtree3s_.end(), 0, std::plus<>(),
-                        [](const auto& bucket) { return bucket.number_of_nodes_in_bucket(); });
-                    // update the index from where the linear search should start. we
-                    // do not do linear search among the nodes with a kdtree index, so it
-                    // should start at the end of the kdtree indexes.
-                    linear_search_start_index_ = end;
-                }
-            }
+    sync_index_();
+    ++stats_.nn_queries;
+    index_.k_nearest(pt, rewire_neighbors_, neighbors_);
+    for (const auto& n : neighbors_) {
+        if (n.distance > radius) {
+            break;  // sorted by distance
+        }
+        near_nodes_.push_back(n.value);
+    }
+#else
+    const auto& positions = tree_.positions();
+    const auto squared_distance = [&](std::size_t i) { return (positions[i] - pt).squaredNorm(); };
+    for (std::size_t i = 0; i < positions.size(); ++i) {
+        if (squared_distance(i) <= radius * radius) {
+            near_nodes_.push_back(i);
         }
     }
-
+    if (near_nodes_.size() > rewire_neighbors_) {
+        const auto kth = near_nodes_.begin() + rewire_neighbors_;
+        std::nth_element(near_nodes_.begin(), kth, near_nodes_.end(),
+                         [&](auto a, auto b) { return squared_distance(a) < squared_distance(b); });
+        near_nodes_.erase(kth, near_nodes_.end());
+    }
 #endif  // USE_KDTREE
+}
 
-    return node;
+auto RRT::choose_parent_(const vec3& pt, node_index nearest) -> node_index {
+    auto best = nearest;
+    auto best_cost = tree_.cost(nearest) + (pt - tree_.position(nearest)).norm();
+    for (const auto i : near_nodes_) {
+        const auto candidate = static_cast<node_index>(i);
+        if (candidate == nearest) {
+            continue;
+        }
+        const auto& position = tree_.position(candidate);
+        const auto cost = tree_.cost(candidate) + (pt - position).norm();
+        // the collision check is by far the most expensive part, so it is done last
+        if (cost < best_cost &&
+            (lazy_collision_checking_enabled_ || collision_free_(position, pt))) {
+            best = candidate;
+            best_cost = cost;
+        }
+    }
+    return best;
+}
+
+auto RRT::rewire_(node_index node) -> void {
+    const auto& position = tree_.position(node);
+    for (const auto i : near_nodes_) {
+        const auto near = static_cast<node_index>(i);
+        if (near == tree_.parent(node)) {
+            continue;
+        }
+        const auto& near_position = tree_.position(near);
+        const auto cost = tree_.cost(node) + (near_position - position).norm();
+        if (cost < tree_.cost(near) &&
+            (lazy_collision_checking_enabled_ || collision_free_(position, near_position))) {
+            tree_.reparent(near, node, ! lazy_collision_checking_enabled_);
+        }
+    }
 }
 
 auto RRT::grow_() -> bool {
     if (remaining_iterations_ <= 0) {
         return false;
     }
-
-#ifdef MEASURE_PERF
-    const auto t_start = std::chrono::high_resolution_clock::now();
-#endif  // MEASURE_PERF
+    const auto timer = utils::trace::scoped_timer(utils::trace::stage::grow);
+    if (rrt_connect_enabled_) {
+        return grow_connect_();
+    }
 
     // TODO: decrease radius
     const auto random_pt = sample_random_point_();
     auto v_near = find_nearest_neighbor_(random_pt);
-    auto x_min = (*v_near).position_;
 
     // this horror is needed to avoid a race condition with Eigen that
     // causes the vector to be overwritten with garbage values.
-    const auto [x, y, z] = [=, &v_near]() {
-        const auto& pt = v_near->position_;
+    const auto [x, y, z] = [=]() {
+        const auto& pt = tree_.position(v_near);
         const auto direction = (random_pt - pt).normalized();
         const auto new_pt = pt + direction * step_size_;
         return std::make_tuple(new_pt.x(), new_pt.y(), new_pt.z());
@@ -472,36 +408,41 @@ auto RRT::grow_() -> bool {
     //     return ! collision_free_(u, v);
     // };
 
-    if (! collision_free_((*v_near).position_, x_new)) {
+    if (! lazy_collision_checking_enabled_ && ! collision_free_(tree_.position(v_near), x_new)) {
         return false;
     }
 
-    auto& inserted_node = insert_node_(x_new, v_near);
+    if (rrt_star_enabled_) {
+        find_near_nodes_(x_new);
+        v_near = choose_parent_(x_new, v_near);
+    }
 
-#ifdef MEASURE_PERF
-    const auto t_end = std::chrono::high_resolution_clock::now();
-    const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(t_end - t_start);
-    timimg_measurements_.push_back(duration);
-#endif
+    const auto inserted_node = insert_node_(x_new, v_near);
+    // copied, as references into the tree are invalidated by insertions
+    const vec3 inserted_pt = tree_.position(inserted_node);
 
-    call_cbs_for_event_on_new_node_created_(v_near->position_, inserted_node.position_);
+    if (rrt_star_enabled_) {
+        rewire_(inserted_node);
+    }
+
+    call_cbs_for_event_on_new_node_created_(tree_.position(v_near), inserted_pt);
 
-    const auto reached_goal =
-        (inserted_node.position_ - goal_position_).norm() <= max_dist_goal_tolerance_;
+    const auto reached_goal = (inserted_pt - goal_position_).norm() <= max_dist_goal_tolerance_;
 
     if (reached_goal) {
         // try direct edge when within tolerance to goal_position_
-        if (collision_free_(inserted_node.position_, goal_position_)) {
-            auto& new_node = insert_node_(goal_position_, &inserted_node);
-            call_cbs_for_event_on_new_node_created_(inserted_node.position_, goal_position_);
+        if (lazy_collision_checking_enabled_ || collision_free_(inserted_pt, goal_position_)) {
+            const auto new_node = insert_node_(goal_position_, inserted_node);
+            call_cbs_for_event_on_new_node_created_(inserted_pt, goal_position_);
             // a path has been found from the start coordinate to the goal coordinate,
             // so we need to backtrack to the start coordinate, to get the path as
-            // a list of coordinates.
-            // auto& last_node = nodes_.back();
-            call_cbs_for_event_on_goal_reached_(new_node.position_);
-            backtrack_and_set_waypoints_starting_at_(&new_node);
-
-            return true;
+            // a list of coordinates. In lazy mode the path may turn out to be in collision, in
+            // which case the tree has been pruned, and keeps growing.
+            if (backtrack_and_set_waypoints_starting_at_(new_node)) {
+                call_cbs_for_event_on_goal_reached_(goal_position_);
+                return true;
+            }
+            return false;
         }
     }
 
@@ -509,18 +450,83 @@ auto RRT::grow_() -> bool {
     const auto test_full_edge_from_new_point_to_goal =
         probability_of_testing_full_path_from_new_node_to_goal_ > rng_.random01();
     if (test_full_edge_from_new_point_to_goal) {
-        call_cbs_for_event_on_trying_full_path_(inserted_node.position_, goal_position_);
-        if (collision_free_(inserted_node.position_, goal_position_)) {
-            auto& new_node = insert_node_(goal_position_, &inserted_node);
-            backtrack_and_set_waypoints_starting_at_(&new_node);
-
-            return true;
+        call_cbs_for_event_on_trying_full_path_(inserted_pt, goal_position_);
+        if (lazy_collision_checking_enabled_ || collision_free_(inserted_pt, goal_position_)) {
+            const auto new_node = insert_node_(goal_position_, inserted_node);
+            return backtrack_and_set_waypoints_starting_at_(new_node);
         }
     }
 
     return false;
 }
 
+auto RRT::grow_connect_() -> bool {
+    if (goal_tree_.empty()) {
+        goal_tree_.add_root(goal_position_);
+    }
+    const auto from_goal = extend_goal_tree_next_;
+    extend_goal_tree_next_ = ! extend_goal_tree_next_;
+    auto& tree = from_goal ? goal_tree_ : tree_;
+    auto& other = from_goal ? tree_ : goal_tree_;
+
+    // a step from pt towards target, or target itself if it is within a step
+    const auto steer = [this](const vec3& pt, const vec3& target) -> vec3 {
+        const vec3 direction = target - pt;
+        const auto distance = direction.norm();
+        return distance <= step_size_ ? target : vec3(pt + direction / distance * step_size_);
+    };
+
+    // extend
+    const auto random_pt = sample_random_point_();
+    const auto nearest = find_nearest_neighbor_(random_pt, from_goal);
+    const vec3 nearest_pt = tree.position(nearest);
+    const vec3 new_pt = steer(nearest_pt, random_pt);
+    if (! collision_free_(nearest_pt, new_pt)) {
+        return false;
+    }
+    const auto new_node = tree.add(new_pt, nearest);
+    --remaining_iterations_;
+    call_cbs_for_event_on_new_node_created_(nearest_pt, new_pt);
+
+    // connect
+    auto node = find_nearest_neighbor_(new_pt, ! from_goal);
+    while (remaining_iterations_ > 0) {
+        const vec3 pt = other.position(node);
+        if ((new_pt - pt).norm() <= step_size_) {
+            if (! collision_free_(pt, new_pt)) {
+                return false;
+            }
+            return from_goal ? connect_trees_(node, new_node) : connect_trees_(new_node, node);
+        }
+        const vec3 next_pt = steer(pt, new_pt);
+        if (! collision_free_(pt, next_pt)) {
+            return false;
+        }
+        node = other.add(next_pt, node);
+        --remaining_iterations_;
+        call_cbs_for_event_on_new_node_created_(pt, next_pt);
+    }
+    return false;
+}
+
+auto RRT::connect_trees_(node_index start_node, node_index goal_node) -> bool {
+    // the goal tree may have stepped exactly onto the node it connects to
+    if (goal_tree_.position(goal_node).isApprox(tree_.position(start_node)) &&
+        ! goal_tree_.is_root(goal_node)) {
+        goal_node = goal_tree_.parent(goal_node);
+    }
+    // with the goal in tree_, the result is the same as that of a unidirectional search
+    auto node = start_node;
+    for (auto i = goal_node; i != no_node; i = goal_tree_.parent(i)) {
+        node = tree_.add(goal_tree_.position(i), node);
+    }
+    if (! backtrack_and_set_waypoints_starting_at_(node)) {
+        return false;
+    }
+    call_cbs_for_event_on_goal_reached_(goal_position_);
+    return true;
+}
+
 auto RRT::optimize_waypoints_() -> void {
     // cannot optimize
     if (waypoints_.size() <= 2) {
@@ -540,123 +546,57 @@ auto RRT::optimize_waypoints_() -> void {
 
     // use euclidean distance for cost
     const auto cost = [this](const std::size_t w1_index, const std::size_t w2_index) -> double {
-        assert(0 <= w1_index && w1_index < waypoints_.size());
-        assert(0 <= w2_index && w2_index < waypoints_.size());
-        auto d = (waypoints_[w1_index] - waypoints_[w2_index]).norm();
-        return d;
+        assert(w1_index < waypoints_.size());
+        assert(w2_index < waypoints_.size());
+        return (waypoints_[w1_index] - waypoints_[w2_index]).norm();
     };
 
-    struct edge {
-        edge(std::size_t f, std::size_t t) : from(f), to(t) {}
-        std::size_t from, to;
-    };
-
-    const auto edge_is_collision_free = [this](const edge& e) -> bool {
-        const auto [from, to] = e;
-        assert(0 <= from && from < waypoints_.size());
-        assert(0 <= to && to < waypoints_.size());
-
-        return collision_free_(waypoints_[from], waypoints_[to]);
-    };
-
-    const auto fmt_vec3 = [](const vec3& v) {
-        return "[" + std::to_string(v.x()) + ", " + std::to_string(v.y()) + ", " +
-               std::to_string(v.z()) + "]";
-    };
-    // distances does not change so we compute them once
-
-    // struct waypoint_cost {
-    //     waypoint_cost(std::size_t i, double c) : index{i}, cost{c} {}
-    //     std::size_t index;
-    //     double cost;
-    // };
-
-    // first index is vertex id (a), second is vertex id (b) of a vertex that it forms
-    // an edge with (a,b)
-    using graph = std::vector<std::vector<std::size_t>>;
-    const auto visited = [](const graph& g, const edge& e) -> bool {
-        const auto [u, v] = e;
-
-        assert(u != v);
-        assert(0 <= u && u < g.size());
-
-        const auto& edges = g[u];
-
-        for (const auto connected_vertex : edges) {
-            if (v == connected_vertex) {
-                return true;
-            }
-        }
-        return false;
-    };
-
-    // returns true if the edge does not exist, it then marks the edge as visited.
-    const auto mark_as_visited = [](graph& g, const edge& e) -> bool {
-        const auto [u, v] = e;
-
-        assert(u != v);
-        assert(0 <= u && u < g.size());
-
-        auto& edges = g[u];
-
-        for (const auto connected_vertex : edges) {
-            if (v == connected_vertex) {
-                return false;
-            }
+    // visibility graph over the waypoints. Consecutive waypoints are connected by an edge of the
+    // tree, which is collision free already, so only the shortcuts need to be checked. They are
+    // all checked in one pass, before the graph is searched.
+    const auto n = waypoints_.size();
+    auto shortcut_is_free = std::vector<std::uint8_t>(n * n, 0);
+    // the work of each row is counted separately, and added to stats_ once all rows are done
+    auto shortcut_stats = std::vector<Stats>(n);
+    const auto check_shortcuts_from = [&](std::size_t from, bool cached) {
+        for (auto to = from + 2; to < n; ++to) {
+            // the cache is not shared between threads
+            shortcut_is_free[from * n + to] =
+                cached ? collision_free_(waypoints_[from], waypoints_[to])
+                       : collision_free_(waypoints_[from], waypoints_[to], drone_depth_,
+                                         drone_width_, drone_height_, shortcut_stats[from]);
         }
-        edges.push_back(v);
-        return true;
     };
-
-    // create a range [0, |W| - 1]
-    auto wps = std::vector<std::size_t>(waypoints_.size());
-    std::iota(wps.begin(), wps.end(), 0);
-
-    const auto w_goal = waypoints_.size() - 1;
-    const auto w_start = 0;
-
-    auto solution_indices = std::vector<std::size_t>();
-
-    auto s = std::stack<edge>();
-    s.emplace(w_start, w_start);
-
-    graph g(waypoints_.size());
-
-    // not guaranteed optimal. use a greedy algorithm approach to be efficient.
-    while (! s.empty()) {
-        const auto [w_parent, w] = s.top();
-        s.pop();
-        // will be false on iteration 1
-        if (w_parent != w && ! edge_is_collision_free({w_parent, w})) {
-            // this condition is hard to explain...
-            if (! s.empty()) {
-                const auto [next_w_parent, _] = s.top();
-                // if we have exhausted the candidates where w_parent is the parent,
-                // then we need to drop it from the solution
-                if (next_w_parent != w_parent) {
-                    solution_indices.pop_back();
-                }
-            }
-            // acts as backtracking
-            continue;
-        } else {
-            solution_indices.emplace_back(w);
+    // raycast listeners are not thread safe, and expect every check to raycast
+    if (shortcut_workers_ > 1 && ! raycast_listeners_()) {
+        auto pool = uoe::utils::concurrency::WorkerPool<std::size_t>(
+            shortcut_workers_, n, [&](std::size_t from) { check_shortcuts_from(from, false); });
+        for (std::size_t from = 0; from + 2 < n; ++from) {
+            pool.submit(from);
         }
-
-        // base case
-        if (w == w_goal) {
-            break;
+        pool.join();
+    } else {
+        for (std::size_t from = 0; from + 2 < n; ++from) {
+            check_shortcuts_from(from, true);
         }
+    }
+    for (const auto& st : shortcut_stats) {
+        stats_ += st;
+    }
 
-        for (auto it = wps.cbegin(); it != wps.cend(); ++it) {
-            const auto w_neighbor = *it;
-            if (w != w_neighbor && mark_as_visited(g, edge{w, w_neighbor})) {
-                s.emplace(w, w_neighbor);
+    auto edges = std::vector<types::graph::Edge>{};
+    for (std::size_t from = 0; from + 1 < n; ++from) {
+        edges.push_back({from, from + 1, cost(from, from + 1)});
+        for (auto to = from + 2; to < n; ++to) {
+            if (shortcut_is_free[from * n + to] != 0) {
+                edges.push_back({from, to, cost(from, to)});
             }
         }
     }
+    const auto g = types::graph::CsrGraph(n, std::move(edges));
+    const auto solution_indices = types::graph::shortest_path(g, 0, n - 1);
 
-    if (s.empty()) {
+    if (solution_indices.empty()) {
         std::cerr << "nothing to do  ¯\\_(ツ)_/¯" << '\n';
         std::cerr << "disabling cbs for event on raycast " << __LINE__ << std::endl;
 
@@ -730,37 +670,102 @@ auto RRT::optimize_waypoints_() -> void {
     disable_cbs_for_event_on_raycast();
 }
 
-auto RRT::backtrack_and_set_waypoints_starting_at_(node_t* start_node) -> bool {
-    if (start_node == nullptr) {
+auto RRT::backtrack_and_set_waypoints_starting_at_(node_index start_node) -> bool {
+    if (start_node == no_node) {
         return false;
     }
     // clear any previous waypoints found.
     if (! waypoints_.empty()) {
         waypoints_.clear();
     }
+    if (lazy_collision_checking_enabled_ && ! validate_path_to_(start_node)) {
+        return false;
+    }
     // backtrack to get waypoints
-    node_t* ptr = start_node;
-    do {
-        waypoints_.push_back(ptr->position_);
-        ptr = ptr->parent;
-    } while (ptr != nullptr);
+    for (auto node = start_node; node != no_node; node = tree_.parent(node)) {
+        waypoints_.push_back(tree_.position(node));
+    }
 
     std::reverse(waypoints_.begin(), waypoints_.end());
 
-    const auto should_optimize_waypoints = true;
-    if (should_optimize_waypoints) {
+    if (optimize_waypoints_enabled_) {
         optimize_waypoints_();
     }
+
+    if (tree_.position(start_node) == goal_position_) {
+        const auto length = path_length(waypoints_);
+        if (length < best_path_length_) {
+            best_path_length_ = length;
+            best_waypoints_ = waypoints_;
+        }
+    }
+    return true;
+}
+
+auto RRT::cheapest_goal_node_() const -> node_index {
+    auto cheapest = no_node;
+    for (node_index i = 0; i < tree_.size(); ++i) {
+        if (tree_.position(i) == goal_position_ &&
+            (cheapest == no_node || tree_.cost(i) < tree_.cost(cheapest))) {
+            cheapest = i;
+        }
+    }
+    return cheapest;
+}
+
+auto RRT::validate_path_to_(node_index node) -> bool {
+    path_.clear();
+    for (auto n = node; n != no_node; n = tree_.parent(n)) {
+        path_.push_back(n);
+    }
+
+    for (auto it = path_.rbegin(); it != path_.rend(); ++it) {
+        const auto n = *it;
+        if (tree_.edge_checked(n)) {
+            continue;
+        }
+        if (! collision_free_(tree_.position(tree_.parent(n)), tree_.position(n))) {
+            remove_subtrees_if_([n](node_index i) { return i == n; });
+            return false;
+        }
+        tree_.set_edge_checked(n);
+    }
     return true;
 }
 
 // TODO: change parameters
 auto RRT::collision_free_(const vec3& from, const vec3& to, double depth, double width,
-                          double height) const -> bool {
+                          double height, Stats& stats) const -> bool {
+    const auto timer = utils::trace::scoped_timer(utils::trace::stage::collision_check);
+    ++stats.collision_checks;
+    // the raycasts cover the cross section of the drone, and extend depth past to, so they are
+    // inside the segment from `from` to `end`, grown by the radius of the cross section.
+    const auto swept_end = [&] {
+        const vec3 direction = to - from;
+        return direction.isZero()
+                   ? to
+                   : vec3{to + direction.normalized() * static_cast<float>(depth)};
+    };
+    const auto clearance = static_cast<float>(std::hypot(width, height) / 2);
+    if (inflated_occupancy_ != nullptr && inflated_occupancy_->clearance() >= clearance) {
+        const auto free = inflated_occupancy_->segment_is_free(from, swept_end());
+        stats.collisions_rejected += free ? 0 : 1;
+        return free;
+    }
+    if (esdf_ != nullptr) {
+        const auto free = esdf_->segment_is_free(from, swept_end(), clearance);
+        stats.collisions_rejected += free ? 0 : 1;
+        return free;
+    }
     if (octomap_ == nullptr) {
         std::cerr << "[INFO] no octomap available, assuming path is collision free" << '\n';
         return true;
     }
+    if (coarse_free_space_ != nullptr && ! raycast_listeners_() &&
+        coarse_free_space_->segment_is_free(from, swept_end(), clearance)) {
+        ++stats.coarse_accepted;
+        return true;
+    }
 
     using std::cos, std::sin;
     using mat3x3 = Eigen::Matrix3f;
@@ -813,36 +818,11 @@ auto RRT::collision_free_(const vec3& from, const vec3& to, double depth, double
 
     const float raycast_length = direction.norm() + depth;
 
-    const auto occupied_or_unknown = [&](const vec3& v) {
-        static constexpr auto convert_to_pt = [](const auto& v) -> uoe::Octomap::point_type {
-            return {v.x(), v.y(), v.z()};
-        };
-
-        const vec3 origin = T * v + from;
-        const auto voxel = octomap_->raycast_in_direction(
-            convert_to_pt(origin), convert_to_pt(direction), raycast_length, false);
-        vec3 voxel_center = vec3{0, 0, 0};
-
-        const bool did_hit =
-            std::visit(Overload{
-                           [](Free) { return false; },
-                           [&](Unknown c) {
-                               voxel_center = vec3{c.center.x(), c.center.y(), c.center.z()};
-                               return true;
-                           },
-                           [&](Occupied c) {
-                               voxel_center = vec3{c.center.x(), c.center.y(), c.center.z()};
-                               return true;
-                           },
-                       },
-                       voxel);
-
-        call_cbs_for_event_on_raycast_(origin, direction, raycast_length, did_hit, voxel_center);
-        return did_hit;
+    static constexpr auto convert_to_pt = [](const auto& v) -> uoe::Octomap::point_type {
+        return {v.x(), v.y(), v.z()};
     };
 
-    // use short circuit evaluation && to lazy evaluate raycasts, so no unnecessary raycasts
-    // are performed when it is not needed.
+    // offsets of the rays in the drone's local frame, spanning its cross section
     //     /        /        /
     //    /        /        /
     //   /        /        /
@@ -858,38 +838,50 @@ auto RRT::collision_free_(const vec3& from, const vec3& to, double depth, double
     // | /      | /      | /
     // |/       |/       |/
     // 7--------2--------8
-    return ! (occupied_or_unknown(vec3{0, 0, 0})                          // 0, center
-              || occupied_or_unknown(vec3{0, width / 2, 0})               // 3, left
-              || occupied_or_unknown(vec3{0, -width / 2, 0})              // 4, right
-              || occupied_or_unknown(vec3{0, 0, height / 2})              // 1, up
-              || occupied_or_unknown(vec3{0, 0, -height / 2})             // 2, down
-              || occupied_or_unknown(vec3{0, -width / 2, height / 2})     // 5, up left
-              || occupied_or_unknown(vec3{0, width / 2, height / 2})      // 6, up right
-              || occupied_or_unknown(vec3{0, width / 2, -height / 2})     // 7, down left
-              || occupied_or_unknown(vec3{0, -width / 2, -height / 2}));  // 8, down right
-}
+    const auto w = static_cast<float>(width / 2);
+    const auto h = static_cast<float>(height / 2);
+    constexpr std::size_t n_rays = 9;
+    const auto offsets = std::array<vec3, n_rays>{
+        vec3{0, 0, 0},    // 0, center
+        vec3{0, w, 0},    // 3, left
+        vec3{0, -w, 0},   // 4, right
+        vec3{0, 0, h},    // 1, up
+        vec3{0, 0, -h},   // 2, down
+        vec3{0, -w, h},   // 5, up left
+        vec3{0, w, h},    // 6, up right
+        vec3{0, w, -h},   // 7, down left
+        vec3{0, -w, -h},  // 8, down right
+    };
 
-auto RRT::call_cbs_for_event_on_new_node_created_(const vec3& parent_pt, const vec3& new_pt) const
-    -> void {
-    if (on_new_node_created_status_) {
-        std::for_each(on_new_node_created_cb_list.begin(), on_new_node_created_cb_list.end(),
-                      [&](const auto& cb) { cb(parent_pt, new_pt); });
+    auto origins = std::array<uoe::Octomap::point_type, n_rays>{};
+    std::transform(offsets.begin(), offsets.end(), origins.begin(),
+                   [&](const vec3& v) { return convert_to_pt(vec3{T * v + from}); });
+
+    // all rays share direction and length, so they are traversed together. When nobody is
+    // listening for raycast events there is no need to know which rays hit, so the traversal can
+    // stop at the first hit.
+    const auto stop_at_first_hit = ! raycast_listeners_();
+    const auto bundle =
+        snapshot_ != nullptr
+            ? snapshot_->raycast_bundle(origins, convert_to_pt(direction), raycast_length, false,
+                                        stop_at_first_hit)
+            : octomap_->raycast_bundle(origins, convert_to_pt(direction), raycast_length, false,
+                                       stop_at_first_hit);
+    stats.raycasts += n_rays;
+    stats.collisions_rejected += bundle.any() ? 1 : 0;
+
+    if (! stop_at_first_hit) {
+        for (std::size_t i = 0; i < origins.size(); ++i) {
+            const auto& o = origins[i];
+            const auto& c = bundle.hit_centers[i];
+            const bool did_hit = bundle.hit(i);
+            const vec3 voxel_center = did_hit ? vec3{c.x(), c.y(), c.z()} : vec3{0, 0, 0};
+            call_cbs_for_event_on_raycast_(vec3{o.x(), o.y(), o.z()}, direction, raycast_length,
+                                           did_hit, voxel_center);
+        }
     }
-}
 
-auto RRT::call_cbs_for_event_on_goal_reached_(const vec3& pt) const -> void {
-    if (on_goal_reached_status_) {
-        std::for_each(on_goal_reached_cb_list.begin(), on_goal_reached_cb_list.end(),
-                      [&](const auto& cb) { cb(pt, nodes_.size()); });
-    }
-}
-
-auto RRT::call_cbs_for_event_on_trying_full_path_(const vec3& new_node, const vec3& goal) const
-    -> void {
-    if (on_trying_full_path_status_) {
-        std::for_each(on_trying_full_path_cb_list.begin(), on_trying_full_path_cb_list.end(),
-                      [&](const auto& cb) { cb(new_node, goal); });
-    }
+    return ! bundle.any();
 }
 
 auto RRT::call_cbs_for_event_after_optimizing_waypoints_(const vec3& from, const vec3& to) const
@@ -917,16 +909,6 @@ auto RRT::call_cbs_for_event_on_clearing_nodes_in_tree_() const -> void {
     }
 }
 
-auto RRT::call_cbs_for_event_on_raycast_(const vec3& origin, const vec3& direction,
-                                         const float length, bool did_hit,
-                                         const vec3& center_of_hit_voxel) const -> void {
-    if (on_raycast_status_) {
-        std::for_each(on_raycast_cb_list.begin(), on_raycast_cb_list.end(), [&](const auto& cb) {
-            cb(origin, direction, length, did_hit, center_of_hit_voxel);
-        });
-    }
-}
-
 auto RRT::from_builder() -> RRTBuilder { return {}; }
 
 auto RRT::from_rosparam(std::string_view prefix) -> RRT {
@@ -982,53 +964,6 @@ auto RRT::from_rosparam(std::string_view prefix) -> RRT {
             get_float("probability_of_testing_full_path_from_new_node_to_goal")};
 }
 
-#ifdef MEASURE_PERF
-
-RRT::~RRT() {
-    if (log_perf_measurements_enabled_) {
-        const auto output_file = [&] {
-            const auto file_exists = std::filesystem::is_regular_file(file_path_csv_);
-            if (file_exists) {
-                std::cerr << "[INFO] "
-                          << "the perf output file " << file_path_csv_ << " already exists"
-                          << std::endl;
-
-                const auto unix_timestamp = [] {
-                    using namespace std::chrono;
-                    const auto now = high_resolution_clock::now();
-                    return static_cast<std::uint32_t>(
-                        duration_cast<seconds>(now.time_since_epoch()).count());
-                }();
-                const auto fmt_str =
-                    file_path_csv_.stem().string() + "-" + std::to_string(unix_timestamp) + ".csv";
-                return std::filesystem::path(fmt_str);
-            }
-
-            return file_path_csv_;
-        }();
-
-        std::cerr << "[INFO] "
-                  << "writing perf measurements to " << output_file << '\n';
-
-        auto file = std::ofstream(output_file);
-        if (file.is_open()) {
-            file << "t,nodes\n";  // write csv header
-            const auto nanoseconds_to_seconds = [](double nanoseconds) {
-                return nanoseconds / 1e9;
-            };
-            // write rows
-            for (std::size_t i = 0; i < timimg_measurements_.size(); ++i) {
-                const auto& measurement = timimg_measurements_[i];
-                file << i << "," << nanoseconds_to_seconds(static_cast<double>(measurement.count()))
-                     << '\n';
-            }
-            file.close();
-        }
-    }
-}
-
-#endif  // MEASURE_PERF
-
 std::ostream& operator<<(std::ostream& os, const RRT& rrt) {
     os << "RRT:\n";
     os << "  step_size: " << rrt.step_size_ << '\n';
@@ -12,22 +12,58 @@ auto TransformListener::lookup_tf(const std::string& to_frame, const std::string
     }
 }
 
+auto TransformListener::lookup_isometry(const std::string& to_frame, const std::string& from_frame,
+                                        ros::Time time) -> std::optional<Eigen::Isometry3f> {
+    // ros::Time(0) is the latest transform, which changes as new transforms arrive
+    const auto cacheable = ! time.isZero();
+    if (cacheable) {
+        auto lock = std::scoped_lock{cache_mutex_};
+        for (const auto& entry : cache_) {
+            if (entry.time == time && entry.from_frame == from_frame &&
+                entry.to_frame == to_frame) {
+                return entry.tf;
+            }
+        }
+    }
+
+    const auto tf = lookup_tf(to_frame, from_frame, time);
+    if (! tf) {
+        return std::nullopt;
+    }
+    const Eigen::Isometry3f isometry = tf2::transformToEigen(*tf).cast<float>();
+    if (cacheable) {
+        auto lock = std::scoped_lock{cache_mutex_};
+        cache_[cache_next_] = cached_tf_{to_frame, from_frame, time, isometry};
+        cache_next_ = (cache_next_ + 1) % CACHE_SIZE;
+    }
+    return isometry;
+}
+
 auto TransformListener::transform_vec3(const std::string& to_frame, const std::string& from_frame,
                                        const Eigen::Vector3f& vec3, ros::Time time)
     -> std::optional<Eigen::Vector3f> {
-    if (const auto opt = lookup_tf(to_frame, from_frame, time)) {
-        const auto tf = *opt;
-        auto point_to_frame = geometry_msgs::PointStamped();
-        auto point_from_frame = geometry_msgs::PointStamped();
-        point_from_frame.point.x = vec3.x();
-        point_from_frame.point.y = vec3.y();
-        point_from_frame.point.z = vec3.z();
-        tf2::doTransform(point_from_frame, point_to_frame, tf);
-        const auto& point = point_to_frame.point;
-        return Eigen::Vector3f{static_cast<float>(point.x), static_cast<float>(point.y),
-                               static_cast<float>(point.z)};
+    if (const auto tf = lookup_isometry(to_frame, from_frame, time)) {
+        return *tf * vec3;
     }
     return std::nullopt;
 }
 
+auto TransformListener::transform_points(const std::string& to_frame,
+                                         const std::string& from_frame,
+                                         std::vector<Eigen::Vector3f>& points, ros::Time time)
+    -> bool {
+    const auto tf = lookup_isometry(to_frame, from_frame, time);
+    if (! tf) {
+        return false;
+    }
+    if (points.empty()) {
+        return true;
+    }
+    // the points are contiguous, so they can be viewed as the columns of a 3 x n matrix
+    auto matrix = Eigen::Map<Eigen::Matrix3Xf>(points.data()->data(), 3,
+                                               static_cast<Eigen::Index>(points.size()));
+    matrix = (tf->linear() * matrix).colwise() + tf->translation();
+    return true;
+}
+
 }  // namespace uoe::utils::transform
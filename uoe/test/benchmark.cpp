@@ -0,0 +1,277 @@
+// headless benchmarks of the planner over octomaps saved to .bt files, e.g. the maps in data/.
+// Nothing is published and no ros master is needed, so the numbers only measure the planner.
+// All inputs are drawn from a seeded generator, so two runs with the same arguments do the same
+// work, and their latencies can be compared to catch regressions.
+//
+// usage: benchmark [--runs N] [--seed S] [--rrt-iterations N] <map.bt>...
+// EXAMPLE
+// rosrun uoe benchmark --runs 50 data/environment_map_75-*.bt data/bridge_scenario_*.bt
+//
+// The output is a tab separated table, with a row per map and benchmark:
+//   raycast      1000 raycasts in random directions from a free point, work is raycasts
+//   gain_of_fov  gain_of_fov() of a single FoV at a free point, work is fovs
+//   nbv_sweep    gain_of_fovs() of a batch of FoV::BATCH_SIZE fovs, as in a NBV request, work is
+//                fovs
+//   rrt          RRT::run() between two free points, work is iterations
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <eigen3/Eigen/Dense>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "uoe/common_types.hpp"
+#include "uoe/fov.hpp"
+#include "uoe/gain.hpp"
+#include "uoe/octomap.hpp"
+#include "uoe/rrt/rrt.hpp"
+#include "uoe/rrt/rrt_builder.hpp"
+#include "uoe/utils/random.hpp"
+
+using namespace uoe::types;
+using clock_type = std::chrono::steady_clock;
+
+// the parameters the planner runs with, as in rosparam/
+constexpr auto DRONE_SIZE = 2.0;
+constexpr auto STEP_SIZE = 2.0f;
+constexpr auto GOAL_BIAS = 0.7f;
+constexpr auto GOAL_TOLERANCE = 2.0f;
+constexpr auto HORIZONTAL_FOV = 90.0f;
+constexpr auto VERTICAL_FOV = 60.0f;
+constexpr auto DEPTH_MIN = 0.1f;
+constexpr auto DEPTH_MAX = 15.0f;
+constexpr auto RAYCASTS_PER_RUN = 1000;
+
+struct measurement {
+    std::vector<double> seconds{};  // latency of every run
+    std::size_t work = 0;           // over all runs, in the unit of the benchmark
+    std::size_t failed = 0;         // runs that did not produce a result, e.g. no path was found
+};
+
+struct run_result {
+    std::size_t work = 0;
+    bool ok = true;
+};
+
+auto percentile(std::vector<double> values, double p) -> double {
+    if (values.empty()) {
+        return 0.0;
+    }
+    const auto idx = static_cast<std::size_t>(std::ceil(p * values.size())) - 1;
+    const auto nth = values.begin() + std::min(idx, values.size() - 1);
+    std::nth_element(values.begin(), nth, values.end());
+    return *nth;
+}
+
+auto report(const std::string& map, const std::string& benchmark, const measurement& m,
+            const std::string& unit) -> void {
+    const auto total = std::accumulate(m.seconds.begin(), m.seconds.end(), 0.0);
+    std::cout << map << '\t' << benchmark << '\t' << m.seconds.size() << '\t' << m.failed << '\t'
+              << percentile(m.seconds, 0.5) * 1e3 << '\t' << percentile(m.seconds, 0.99) * 1e3
+              << '\t' << (total > 0 ? m.work / total : 0.0) << '\t' << unit << "/s" << '\n';
+}
+
+auto time_run(measurement& m, const std::function<run_result()>& f) -> void {
+    const auto start = clock_type::now();
+    const auto result = f();
+    m.seconds.push_back(std::chrono::duration<double>(clock_type::now() - start).count());
+    m.work += result.work;
+    m.failed += result.ok ? 0 : 1;
+}
+
+class free_point_sampler {
+   public:
+    free_point_sampler(const uoe::Octomap& map, std::uint64_t seed)
+        : map_{map}, bounds_{map.metric_bounds()}, rng_{0.0f, 1.0f, seed} {}
+
+    auto operator()() -> std::optional<vec3> {
+        constexpr auto MAX_ATTEMPTS = 10000;
+        for (int i = 0; i < MAX_ATTEMPTS; ++i) {
+            const auto p = point_in_bounds();
+            if (map_.get_voxel_status_at_point({p.x(), p.y(), p.z()}) == uoe::VoxelStatus::Free) {
+                return p;
+            }
+        }
+        return std::nullopt;
+    }
+
+    auto point_in_bounds() -> vec3 {
+        // most candidates are rejected, so they are drawn a batch at a time
+        if (next_ == candidates_.cols()) {
+            rng_.fill_uniform_inside_box(bounds_.min(), bounds_.max(), candidates_);
+            next_ = 0;
+        }
+        return candidates_.col(next_++);
+    }
+
+    auto direction() -> vec3 { return rng_.sample_random_point_on_unit_sphere_surface(); }
+
+   private:
+    static constexpr Eigen::Index BATCH_SIZE = 256;
+
+    const uoe::Octomap& map_;
+    BBX bounds_;
+    uoe::utils::random::random_point_generator rng_;
+    Eigen::Matrix3Xf candidates_ = Eigen::Matrix3Xf(3, BATCH_SIZE);
+    Eigen::Index next_ = BATCH_SIZE;
+};
+
+auto fov_at(const vec3& position, const vec3& target) -> FoV {
+    const vec3 dir = target - position;
+    const auto yaw = std::atan2(dir.y(), dir.x());
+    const auto orientation = Eigen::Quaternionf(Eigen::AngleAxisf(yaw, vec3::UnitZ()));
+    return FoV{Pose{position, orientation}, FoVAngle::from_degrees(HORIZONTAL_FOV),
+               FoVAngle::from_degrees(VERTICAL_FOV), DepthRange{DEPTH_MIN, DEPTH_MAX}, target};
+}
+
+auto gain_at(const FoV& fov, const uoe::Octomap& map, const vec3& root) -> uoe::FoVGainMetric {
+    const auto distance_tf = [](double x) { return x; };
+    return uoe::gain_of_fov(fov, map, 0, 0, 1, 1, 0, root, distance_tf,
+                            [](const vec3&, const vec3&, float, const bool, uoe::VoxelStatus) {});
+}
+
+auto main(int argc, char* argv[]) -> int {
+    const auto usage = [&] {
+        std::cerr << "usage: " << argv[0]
+                  << " [--runs N] [--seed S] [--rrt-iterations N] <map.bt>..." << '\n';
+    };
+
+    auto runs = std::size_t{20};
+    auto seed = std::uint64_t{0};
+    auto rrt_iterations = std::size_t{10000};
+    auto paths = std::vector<std::filesystem::path>();
+    for (int i = 1; i < argc; ++i) {
+        const auto arg = std::string(argv[i]);
+        const auto has_value = i + 1 < argc;
+        if (arg == "--help" || arg == "-h") {
+            usage();
+            std::exit(EXIT_SUCCESS);
+        } else if (arg == "--runs" && has_value) {
+            runs = std::stoul(argv[++i]);
+        } else if (arg == "--seed" && has_value) {
+            seed = std::stoull(argv[++i]);
+        } else if (arg == "--rrt-iterations" && has_value) {
+            rrt_iterations = std::stoul(argv[++i]);
+        } else {
+            paths.emplace_back(arg);
+        }
+    }
+    if (paths.empty()) {
+        usage();
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "map\tbenchmark\truns\tfailed\tp50_ms\tp99_ms\tthroughput\tunit\n";
+    for (const auto& path : paths) {
+        auto map = uoe::Octomap(0.1);
+        if (! map.octree().readBinary(path.string())) {
+            std::cerr << "could not read " << path << '\n';
+            continue;
+        }
+        const auto name = path.filename().string();
+        // every map is sampled the same way, whichever maps come before it
+        auto sampler = free_point_sampler(map, seed);
+        const auto center = map.metric_bounds().center;
+
+        {
+            auto m = measurement{};
+            for (std::size_t r = 0; r < runs; ++r) {
+                const auto origin = sampler();
+                auto directions = std::vector<vec3>(RAYCASTS_PER_RUN);
+                std::generate(directions.begin(), directions.end(),
+                              [&] { return sampler.direction(); });
+                time_run(m, [&]() -> run_result {
+                    if (! origin) {
+                        return {0, false};
+                    }
+                    const auto o = uoe::Octomap::point_type{origin->x(), origin->y(), origin->z()};
+                    for (const auto& d : directions) {
+                        map.raycast_in_direction(o, {d.x(), d.y(), d.z()}, DEPTH_MAX);
+                    }
+                    return {directions.size()};
+                });
+            }
+            report(name, "raycast", m, "raycasts");
+        }
+
+        {
+            auto m = measurement{};
+            for (std::size_t r = 0; r < runs; ++r) {
+                const auto position = sampler();
+                time_run(m, [&]() -> run_result {
+                    if (! position) {
+                        return {0, false};
+                    }
+                    gain_at(fov_at(*position, center), map, *position);
+                    return {1};
+                });
+            }
+            report(name, "gain_of_fov", m, "fovs");
+        }
+
+        {
+            auto m = measurement{};
+            const auto distance_tf = [](double x) { return x; };
+            for (std::size_t r = 0; r < runs; ++r) {
+                const auto root = sampler();
+                auto fovs = std::vector<FoV>();
+                for (std::size_t i = 0; root && i < FoV::BATCH_SIZE; ++i) {
+                    // candidates within a step of the root, like the nodes of a NBV tree
+                    const vec3 candidate = *root + sampler.direction() * STEP_SIZE;
+                    fovs.push_back(fov_at(candidate, center));
+                }
+                time_run(m, [&]() -> run_result {
+                    if (fovs.empty()) {
+                        return {0, false};
+                    }
+                    uoe::gain_of_fovs(fovs, map, 0, 0, 1, 1, 0, *root, distance_tf);
+                    return {fovs.size()};
+                });
+            }
+            report(name, "nbv_sweep", m, "fovs");
+        }
+
+        {
+            auto m = measurement{};
+            for (std::size_t r = 0; r < runs; ++r) {
+                const auto start = sampler();
+                const auto goal = sampler();
+                if (! start || ! goal) {
+                    ++m.failed;
+                    continue;
+                }
+                auto rrt = uoe::rrt::RRT::from_builder()
+                               .start_and_goal_position(*start, *goal)
+                               .sampling_radius((*start - *goal).norm() * 2)
+                               .max_iterations(rrt_iterations)
+                               .goal_bias(GOAL_BIAS)
+                               .probability_of_testing_full_path_from_new_node_to_goal(0)
+                               .max_dist_goal_tolerance(GOAL_TOLERANCE)
+                               .step_size(STEP_SIZE)
+                               .drone_width(DRONE_SIZE)
+                               .drone_height(DRONE_SIZE)
+                               .drone_depth(DRONE_SIZE)
+                               .build();
+                rrt.seed(seed + r);
+                rrt.assign_octomap(&map);
+                time_run(m, [&]() -> run_result {
+                    const auto found = rrt.run().has_value();
+                    const auto remaining = std::max(0, rrt.remaining_iterations());
+                    return {rrt.max_iterations() - static_cast<std::size_t>(remaining), found};
+                });
+            }
+            report(name, "rrt", m, "iterations");
+        }
+    }
+    return 0;
+}
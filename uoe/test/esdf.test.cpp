@@ -0,0 +1,55 @@
+// checks that uoe::Esdf treats the space past its bounds as unknown, so a segment running along
+// the inside of the bounds is rejected at a clearance wider than its distance to them, even when
+// everything inside the bounds is free.
+// usage: test_esdf
+#include <cstdlib>
+#include <iostream>
+
+#include "uoe/esdf.hpp"
+#include "uoe/octomap.hpp"
+
+using vec3 = uoe::types::vec3;
+
+auto check(bool ok, const char* what) -> void {
+    if (! ok) {
+        std::cerr << "FAILED: " << what << '\n';
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+auto main() -> int {
+    constexpr auto RESOLUTION = 0.5;
+    constexpr auto EXTENT = 10.0f;
+    constexpr auto MAX_DISTANCE = 3.0;
+
+    // a map that is free everywhere inside of the bounds
+    auto map = uoe::Octomap(RESOLUTION);
+    const auto half = static_cast<float>(RESOLUTION / 2);
+    for (auto x = half; x < EXTENT; x += static_cast<float>(RESOLUTION)) {
+        for (auto y = half; y < EXTENT; y += static_cast<float>(RESOLUTION)) {
+            for (auto z = half; z < EXTENT; z += static_cast<float>(RESOLUTION)) {
+                map.octree().updateNode(uoe::Octomap::point_type{x, y, z}, false);
+            }
+        }
+    }
+
+    auto esdf = uoe::Esdf(uoe::types::BBX{vec3::Zero(), vec3::Constant(EXTENT)}, RESOLUTION,
+                          MAX_DISTANCE);
+    esdf.integrate(map);
+
+    const auto voxel = static_cast<float>(RESOLUTION);
+    const auto clearance = 1.5f * voxel;
+    const auto center = EXTENT / 2;
+    check(esdf.segment_is_free({2, center, center}, {8, center, center}, clearance),
+          "a segment through the middle of free space is free");
+    check(! esdf.segment_is_free({2, voxel, center}, {8, voxel, center}, clearance),
+          "a segment one voxel inside the bounds is not free at a clearance above a voxel");
+    check(! esdf.segment_is_free({center, center, EXTENT - voxel}, {center, 2, EXTENT - voxel},
+                                 clearance),
+          "the upper bounds are unknown space as well");
+    check(esdf.distance(vec3{center, voxel, center}) <= 2 * voxel,
+          "the distance along the bounds is at most the distance past them");
+
+    std::cout << "segments along the bounds of the field are rejected\n";
+    return EXIT_SUCCESS;
+}
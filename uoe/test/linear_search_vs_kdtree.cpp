@@ -9,6 +9,8 @@
 #include <thread>
 #include <vector>
 
+#include "kdtree/kdtree3.hpp"
+#include "kdtree/kdtree3_flat.hpp"
 #include "uoe/utils/math.hpp"
 #include "uoe/utils/random.hpp"
 auto n_runs = 1e2;
@@ -120,6 +122,45 @@ int main(int argc, char const* argv[]) {
         },
         n_runs);
 
+    // the same queries answered by the pointer based kdtree and the bucketed flat kdtree
+    const auto n_queries = std::size_t{10000};
+    auto query_points = std::vector<Eigen::Vector3f>(n_queries);
+    for (auto& q : query_points) {
+        q = uoe::utils::random::sample_random_point_inside_unit_sphere(direction, 0) * r +
+            bounding_sphere_center;
+    }
+    std::size_t i = 0;
+    const auto next_point = [&] {
+        const auto idx = i++;
+        return std::make_pair(points[idx], idx);
+    };
+
+    const auto kdtree = kdtree::kdtree3<std::size_t>(next_point, points.size());
+    i = 0;
+    const auto flat_kdtree = kdtree::kdtree3_flat<std::size_t, 16>(next_point, points.size());
+
+    std::cout << "kdtree3, " << n_queries << " queries" << std::endl;
+    measure_average(
+        [&]() {
+            auto sum = 0.0;
+            for (const auto& q : query_points) {
+                sum += kdtree.nearest(q)->distance;
+            }
+            std::cout << "sum of distances: " << sum << std::endl;
+        },
+        n_runs);
+
+    std::cout << "kdtree3_flat<16>, " << n_queries << " queries" << std::endl;
+    measure_average(
+        [&]() {
+            auto sum = 0.0;
+            for (const auto& q : query_points) {
+                sum += flat_kdtree.nearest(q)->distance;
+            }
+            std::cout << "sum of distances: " << sum << std::endl;
+        },
+        n_runs);
+
     // for (int i = 0; i < n_runs; ++i) {
     //     measure([&]() {
     //         auto query_point =
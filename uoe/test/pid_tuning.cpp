@@ -0,0 +1,407 @@
+// tunes the gains of uoe::control::PIDController offline. Flies paths with its control law, see
+// uoe::control::PositionYawPID, against a simple model of a multirotor tracking velocity
+// setpoints, as fast as the cpu allows instead of in real time, for every combination of a grid
+// of gains, with a combination per core at a time. Nothing is published and no ros master is
+// needed, so a sweep that takes a mission in the simulator per combination only takes seconds.
+//
+// usage: pid_tuning [--xy p,i,d]... [--z p,i,d]... [--yaw p,i,d]... [--velocity m/s]
+//                   [--control-rate hz] [--setpoint-rate hz] [--threads N] [--output file]
+//                   [path_file]...
+// EXAMPLE
+// rosrun uoe pid_tuning --xy 0.5:2:0.25,0:0.01:0.005,0.5:3:0.5 --yaw 1,0,0.5:2:0.5 path.txt
+//
+// --xy, --z and --yaw each add gains to the grid, with p, i and d either a value, or a range
+// lo:hi:step, which adds every gain in the range. Without --z, the z gains are the xy gains, as
+// with control_manager. A path file has a waypoint "x y z" per line, e.g. of a path planned by
+// rrt_service, and is flown like a mission flies it, with the setpoint moving along the
+// CompoundTrajectory through it at --velocity. Without path files a built-in path is flown.
+//
+// The output is a tab separated table with a row per combination of gains, ordered from the
+// smallest tracking error, with the errors of ControllerStateStamped, to the expected position,
+// perpendicular to the trajectory and in yaw, over every path, as RMS and max, and how long it
+// took to settle at the end of the paths, on average.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <eigen3/Eigen/Dense>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "uoe/compound_trajectory.hpp"
+#include "uoe/pid.hpp"
+#include "uoe/sampled_trajectory.hpp"
+#include "uoe/utils/concurrency.hpp"
+#include "uoe/utils/state.hpp"
+#include "uoe/utils/utils.hpp"
+
+using uoe::control::PID;
+using clock_type = std::chrono::steady_clock;
+
+/**
+ * @brief a multirotor whose flight controller tracks velocity setpoints, as PX4 does for the
+ * setpoints of mavros, modelled as a first order lag of the velocity, with limited acceleration,
+ * and of the yaw rate. The yaw is the heading the controller computes from the attitude.
+ */
+struct multirotor_model {
+    float velocity_time_constant = 0.3f;
+    float max_acceleration = 4.f;
+    float yaw_rate_time_constant = 0.15f;
+
+    Eigen::Vector3f position = Eigen::Vector3f::Zero();
+    Eigen::Vector3f velocity = Eigen::Vector3f::Zero();
+    float yaw = 0;
+    float yaw_rate = 0;
+
+    auto step(const Eigen::Vector3f& command_linear, float command_yaw, float dt) -> void {
+        Eigen::Vector3f acceleration = (command_linear - velocity) / velocity_time_constant;
+        if (acceleration.norm() > max_acceleration) {
+            acceleration *= max_acceleration / acceleration.norm();
+        }
+        velocity += acceleration * dt;
+        position += velocity * dt;
+        yaw_rate += (command_yaw - yaw_rate) / yaw_rate_time_constant * dt;
+        yaw = uoe::utils::state::yaw_representation(yaw + yaw_rate * dt);
+    }
+};
+
+struct gains {
+    PID xy, z, yaw;
+};
+
+/**
+ * @brief the tracking errors of one flight
+ */
+struct flight_stats {
+    double sum_squared_error = 0, max_error = 0;
+    double sum_squared_perpendicular = 0, max_perpendicular = 0;
+    double sum_squared_yaw = 0, max_yaw = 0;
+    std::size_t steps = 0;
+    // seconds from the end of the trajectory until the drone stayed within tolerance of it, or
+    // the whole time flown after its end if it never settled
+    double settling_time = 0;
+    bool diverged = false;
+
+    auto add(const flight_stats& other) -> void {
+        sum_squared_error += other.sum_squared_error;
+        max_error = std::max(max_error, other.max_error);
+        sum_squared_perpendicular += other.sum_squared_perpendicular;
+        max_perpendicular = std::max(max_perpendicular, other.max_perpendicular);
+        sum_squared_yaw += other.sum_squared_yaw;
+        max_yaw = std::max(max_yaw, other.max_yaw);
+        steps += other.steps;
+        settling_time += other.settling_time;
+        diverged = diverged || other.diverged;
+    }
+    [[nodiscard]] auto rms_error() const -> double {
+        return diverged ? std::numeric_limits<double>::infinity()
+                        : std::sqrt(sum_squared_error / std::max<std::size_t>(steps, 1));
+    }
+};
+
+struct flight_config {
+    float velocity = 1;
+    float control_period = 1.f / (uoe::utils::DEFAULT_LOOP_RATE * 6);
+    float setpoint_period = 1.f / uoe::utils::DEFAULT_LOOP_RATE;
+    // time flown after the end of the trajectory, for the drone to settle
+    float settle_time = 5;
+};
+
+// errors this large only come from gains that make the drone oscillate out of control
+constexpr auto DIVERGED_ERROR = 100.0;
+
+/**
+ * @brief flies trajectory once with g, the way control_manager and mission_manager fly it: the
+ * mission moves the setpoint along the trajectory at the setpoint rate, heading towards it from
+ * where the drone is, and the controller steps at the control rate.
+ */
+auto fly(uoe::trajectory::CompoundTrajectory trajectory,
+         const uoe::trajectory::SampledTrajectory& samples, const gains& g,
+         const flight_config& config) -> flight_stats {
+    auto pid = uoe::control::PositionYawPID(g.xy, g.z, g.yaw, config.control_period);
+    auto drone = multirotor_model{};
+    drone.position = samples.sample_at(0).position;
+
+    auto stats = flight_stats{};
+    auto expected_position = drone.position;
+    auto target_yaw = 0.0;
+    auto settled_since = std::optional<double>{};
+    const auto steps_per_setpoint =
+        std::max(1, static_cast<int>(std::lround(config.setpoint_period / config.control_period)));
+    const auto duration = samples.duration() + config.settle_time;
+    const auto n_steps = static_cast<std::size_t>(std::ceil(duration / config.control_period));
+    for (std::size_t step = 0; step < n_steps; ++step) {
+        const auto t = static_cast<double>(step) * config.control_period;
+        if (step % steps_per_setpoint == 0) {
+            expected_position = samples.sample_at(static_cast<float>(t)).position;
+            const Eigen::Vector3f diff = expected_position - drone.position;
+            if (diff.head<2>().norm() > uoe::utils::SMALL_DISTANCE_TOLERANCE) {
+                target_yaw = std::atan2(diff.y(), diff.x());
+            }
+        }
+
+        const auto command_linear =
+            pid.compute_linear_velocities(drone.position, expected_position);
+        const auto command_yaw = pid.compute_yaw_velocity(drone.position, drone.yaw, target_yaw);
+        drone.step(command_linear, command_yaw, config.control_period);
+
+        const auto error = static_cast<double>(pid.error_position().norm());
+        const auto perpendicular = static_cast<double>(
+            (trajectory.get_closest_point(drone.position) - drone.position).norm());
+        const auto yaw_error = static_cast<double>(std::abs(pid.error_yaw()));
+        stats.sum_squared_error += error * error;
+        stats.max_error = std::max(stats.max_error, error);
+        stats.sum_squared_perpendicular += perpendicular * perpendicular;
+        stats.max_perpendicular = std::max(stats.max_perpendicular, perpendicular);
+        stats.sum_squared_yaw += yaw_error * yaw_error;
+        stats.max_yaw = std::max(stats.max_yaw, yaw_error);
+        ++stats.steps;
+        if (! std::isfinite(error) || error > DIVERGED_ERROR) {
+            stats.diverged = true;
+            break;
+        }
+
+        if (t >= samples.duration()) {
+            if (error > uoe::utils::DEFAULT_DISTANCE_TOLERANCE) {
+                settled_since.reset();
+            } else if (! settled_since) {
+                settled_since = t;
+            }
+        }
+    }
+    stats.settling_time = settled_since ? *settled_since - samples.duration() : config.settle_time;
+    return stats;
+}
+
+/**
+ * @brief the gains of a --xy, --z or --yaw argument
+ * @throw std::invalid_argument if it is not p,i,d with each a value or a range lo:hi:step
+ */
+auto parse_gains(const std::string& arg) -> std::vector<PID> {
+    const auto split = [](const std::string& s, char delimiter) {
+        auto parts = std::vector<std::string>{};
+        auto ss = std::stringstream{s};
+        for (auto part = std::string{}; std::getline(ss, part, delimiter);) {
+            parts.push_back(part);
+        }
+        return parts;
+    };
+    const auto values = [&](const std::string& s) {
+        const auto range = split(s, ':');
+        if (range.size() == 1) {
+            return std::vector<float>{std::stof(range[0])};
+        }
+        if (range.size() != 3) {
+            throw std::invalid_argument("a range of gains is lo:hi:step, not " + s);
+        }
+        const auto lo = std::stof(range[0]);
+        const auto hi = std::stof(range[1]);
+        const auto step = std::stof(range[2]);
+        if (! (step > 0) || hi < lo) {
+            throw std::invalid_argument("a range of gains is lo:hi:step, with lo <= hi");
+        }
+        auto v = std::vector<float>{};
+        // the end is included, even if rounding puts it slightly past the last step
+        for (auto i = 0; lo + static_cast<float>(i) * step <= hi + step * 1e-3f; ++i) {
+            v.push_back(lo + static_cast<float>(i) * step);
+        }
+        return v;
+    };
+    const auto pid = split(arg, ',');
+    if (pid.size() != 3) {
+        throw std::invalid_argument("gains are p,i,d, not " + arg);
+    }
+    auto grid = std::vector<PID>{};
+    for (const auto p : values(pid[0])) {
+        for (const auto i : values(pid[1])) {
+            for (const auto d : values(pid[2])) {
+                grid.push_back({p, i, d});
+            }
+        }
+    }
+    return grid;
+}
+
+/**
+ * @throw std::runtime_error if the file can not be read, or has less than two waypoints
+ */
+auto read_path(const std::string& file) -> std::vector<Eigen::Vector3f> {
+    auto f = std::ifstream(file);
+    if (! f) {
+        throw std::runtime_error("could not read " + file);
+    }
+    auto path = std::vector<Eigen::Vector3f>{};
+    for (auto line = std::string{}; std::getline(f, line);) {
+        auto ss = std::stringstream{line};
+        auto p = Eigen::Vector3f{};
+        if (ss >> p.x() >> p.y() >> p.z()) {
+            path.push_back(p);
+        }
+    }
+    if (path.size() < 2) {
+        throw std::runtime_error(file + " has less than two waypoints");
+    }
+    return path;
+}
+
+auto main(int argc, char* argv[]) -> int {
+    const auto usage = [&] {
+        std::cerr << "usage: " << argv[0]
+                  << " [--xy p,i,d]... [--z p,i,d]... [--yaw p,i,d]... [--velocity m/s]"
+                     " [--control-rate hz] [--setpoint-rate hz] [--threads N] [--output file]"
+                     " [path_file]..."
+                  << '\n';
+    };
+
+    auto grid_xy = std::vector<PID>{};
+    auto grid_z = std::vector<PID>{};
+    auto grid_yaw = std::vector<PID>{};
+    auto config = flight_config{};
+    auto n_threads = uoe::utils::concurrency::default_number_of_workers();
+    auto output = std::string{};
+    auto path_files = std::vector<std::string>{};
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const auto arg = std::string(argv[i]);
+            const auto has_value = i + 1 < argc;
+            const auto append = [](std::vector<PID>& grid, const std::vector<PID>& gains) {
+                grid.insert(grid.end(), gains.begin(), gains.end());
+            };
+            if (arg == "--help" || arg == "-h") {
+                usage();
+                std::exit(EXIT_SUCCESS);
+            } else if (arg == "--xy" && has_value) {
+                append(grid_xy, parse_gains(argv[++i]));
+            } else if (arg == "--z" && has_value) {
+                append(grid_z, parse_gains(argv[++i]));
+            } else if (arg == "--yaw" && has_value) {
+                append(grid_yaw, parse_gains(argv[++i]));
+            } else if (arg == "--velocity" && has_value) {
+                config.velocity = std::stof(argv[++i]);
+            } else if (arg == "--control-rate" && has_value) {
+                config.control_period = 1 / std::stof(argv[++i]);
+            } else if (arg == "--setpoint-rate" && has_value) {
+                config.setpoint_period = 1 / std::stof(argv[++i]);
+            } else if (arg == "--threads" && has_value) {
+                n_threads = static_cast<unsigned int>(std::stoul(argv[++i]));
+            } else if (arg == "--output" && has_value) {
+                output = argv[++i];
+            } else if (arg.rfind("--", 0) == 0) {
+                usage();
+                std::exit(EXIT_FAILURE);
+            } else {
+                path_files.push_back(arg);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        usage();
+        std::exit(EXIT_FAILURE);
+    }
+    // the gains of the runs in data/results, if none are given
+    if (grid_xy.empty()) {
+        grid_xy = {{1, 0, 1}};
+    }
+    if (grid_yaw.empty()) {
+        grid_yaw = {{1, 0, 1}};
+    }
+
+    // a path with straight sections, corners and a climb, if none is given
+    auto paths = std::vector<std::vector<Eigen::Vector3f>>{};
+    try {
+        for (const auto& file : path_files) {
+            paths.push_back(read_path(file));
+        }
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << '\n';
+        std::exit(EXIT_FAILURE);
+    }
+    if (paths.empty()) {
+        paths.push_back({{0, 0, 2}, {5, 0, 2}, {10, 0, 2}, {10, 5, 3}, {5, 8, 4}, {0, 8, 4},
+                         {0, 4, 6}, {-3, 0, 5}, {0, 0, 2}});
+    }
+
+    // every path is fitted and sampled once, and copied for each flight, as closest point
+    // queries keep a cursor into the trajectory
+    auto trajectories = std::vector<uoe::trajectory::CompoundTrajectory>{};
+    auto samples = std::vector<uoe::trajectory::SampledTrajectory>{};
+    for (auto& path : paths) {
+        auto& trajectory = trajectories.emplace_back(path);
+        samples.emplace_back(trajectory, config.velocity, config.control_period);
+    }
+
+    auto grid = std::vector<gains>{};
+    for (const auto& xy : grid_xy) {
+        for (const auto& z : grid_z.empty() ? std::vector<PID>{xy} : grid_z) {
+            for (const auto& yaw : grid_yaw) {
+                grid.push_back({xy, z, yaw});
+            }
+        }
+    }
+
+    // a flight per combination of gains and path, spread over the threads
+    auto results = std::vector<flight_stats>(grid.size() * paths.size());
+    const auto start = clock_type::now();
+    {
+        auto pool = uoe::utils::concurrency::WorkerPool<std::size_t>(
+            n_threads, results.size(), [&](std::size_t i) {
+                const auto p = i % paths.size();
+                results[i] = fly(trajectories[p], samples[p], grid[i / paths.size()], config);
+            });
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            pool.submit(i);
+        }
+    }
+    const auto wall_time = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    auto totals = std::vector<flight_stats>(grid.size());
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        totals[i / paths.size()].add(results[i]);
+    }
+    auto order = std::vector<std::size_t>(grid.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        return totals[a].rms_error() < totals[b].rms_error();
+    });
+
+    auto simulated_time = 0.0;
+    for (const auto& s : samples) {
+        simulated_time += (s.duration() + config.settle_time) * static_cast<double>(grid.size());
+    }
+    std::cerr << "flew " << results.size() << " flights, " << simulated_time << " s, in "
+              << wall_time << " s on " << n_threads << " threads, "
+              << simulated_time / std::max(wall_time, 1e-9) << " times faster than real time"
+              << '\n';
+
+    auto file = std::ofstream();
+    if (! output.empty()) {
+        file.open(output);
+    }
+    auto& os = output.empty() ? std::cout : file;
+    os << std::fixed << std::setprecision(4);
+    os << "xy_p\txy_i\txy_d\tz_p\tz_i\tz_d\tyaw_p\tyaw_i\tyaw_d\trms_error\tmax_error\t"
+          "rms_perpendicular\tmax_perpendicular\trms_yaw\tmax_yaw\tsettling_time\n";
+    for (const auto i : order) {
+        const auto& g = grid[i];
+        const auto& s = totals[i];
+        const auto rms = [&](double sum_squared) {
+            return s.diverged ? std::numeric_limits<double>::infinity()
+                              : std::sqrt(sum_squared / std::max<std::size_t>(s.steps, 1));
+        };
+        os << g.xy.p << '\t' << g.xy.i << '\t' << g.xy.d << '\t' << g.z.p << '\t' << g.z.i << '\t'
+           << g.z.d << '\t' << g.yaw.p << '\t' << g.yaw.i << '\t' << g.yaw.d << '\t'
+           << s.rms_error() << '\t' << s.max_error << '\t' << rms(s.sum_squared_perpendicular)
+           << '\t' << s.max_perpendicular << '\t' << rms(s.sum_squared_yaw) << '\t' << s.max_yaw
+           << '\t' << s.settling_time / static_cast<double>(paths.size()) << '\n';
+    }
+
+    return 0;
+}
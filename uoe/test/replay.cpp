@@ -0,0 +1,174 @@
+// replays a recording of the requests served by rrt_service, made by setting its record_dir
+// parameter, through the same handlers the node serves them with. Nothing is published and no
+// ros master is needed, and every request is planned with a seed derived from its position in the
+// recording, so a replay does the same work every time, e.g. to profile it:
+//
+// usage: replay [--param name=value]... [--repeat N] [--output file] <recording_dir>
+// EXAMPLE
+// perf record -g rosrun uoe replay --param nbv_worker_threads=4 /tmp/recording
+//
+// --param sets a parameter of the service, as in rosparam/, by its name under /uoe/rrt_service/,
+// e.g. to compare configurations over the same requests. The output is a tab separated table with
+// a row per replayed request, its latency, if a path or viewpoint was found, and the work it took.
+#include <ros/ros.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "uoe/octomap.hpp"
+#include "uoe/planner_recording.hpp"
+#include "uoe/rrt_service.hpp"
+#include "uoe_msgs/PlannerStats.h"
+
+using clock_type = std::chrono::steady_clock;
+
+auto write_row(std::ostream& os, const uoe::recording::entry& e, double ms, bool found,
+               const uoe_msgs::PlannerStats& stats) -> void {
+    os << e.seq << '\t' << e.kind << '\t' << ms << '\t' << found << '\t' << stats.raycasts << '\t'
+       << stats.octree_nodes_visited << '\t' << stats.voxels_visited << '\t' << stats.nn_queries
+       << '\t' << stats.nn_nodes_visited << '\t' << stats.kdtree_rebuilds << '\t'
+       << stats.collision_checks << '\t' << stats.collisions_rejected << '\t' << stats.fovs_skipped
+       << '\t' << stats.coarse_accepted << '\n';
+}
+
+template <typename F>
+auto time_ms(F f) -> double {
+    const auto start = clock_type::now();
+    f();
+    return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+auto main(int argc, char* argv[]) -> int {
+    const auto usage = [&] {
+        std::cerr << "usage: " << argv[0]
+                  << " [--param name=value]... [--repeat N] [--output file] <recording_dir>"
+                  << '\n';
+    };
+
+    auto overrides = std::vector<std::pair<std::string, std::string>>();
+    auto repeat = std::size_t{1};
+    auto output = std::string();
+    auto dir = std::filesystem::path();
+    for (int i = 1; i < argc; ++i) {
+        const auto arg = std::string(argv[i]);
+        const auto has_value = i + 1 < argc;
+        if (arg == "--help" || arg == "-h") {
+            usage();
+            std::exit(EXIT_SUCCESS);
+        } else if (arg == "--param" && has_value) {
+            const auto param = std::string(argv[++i]);
+            const auto eq = param.find('=');
+            if (eq == std::string::npos) {
+                usage();
+                std::exit(EXIT_FAILURE);
+            }
+            overrides.emplace_back(param.substr(0, eq), param.substr(eq + 1));
+        } else if (arg == "--repeat" && has_value) {
+            repeat = std::stoul(argv[++i]);
+        } else if (arg == "--output" && has_value) {
+            output = argv[++i];
+        } else {
+            dir = arg;
+        }
+    }
+    if (dir.empty()) {
+        usage();
+        std::exit(EXIT_FAILURE);
+    }
+
+    // the handlers stamp their responses, which needs a clock, but not a node
+    ros::Time::init();
+
+    try {
+        // deterministic unless overridden: seeded requests, and no worker threads to interleave
+        uoe::rrt_service::set_param("seed", "0");
+        uoe::rrt_service::set_param("nbv_worker_threads", "0");
+        for (const auto& [name, value] : overrides) {
+            if (! uoe::rrt_service::set_param(name, value)) {
+                std::cerr << "rrt_service has no parameter called " << name << '\n';
+                std::exit(EXIT_FAILURE);
+            }
+        }
+    } catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << '\n';
+        std::exit(EXIT_FAILURE);
+    }
+
+    auto entries = std::vector<uoe::recording::entry>();
+    try {
+        entries = uoe::recording::read_index(dir);
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << '\n';
+        std::exit(EXIT_FAILURE);
+    }
+
+    // every map is read once, however many requests were planned against it
+    auto maps = std::map<std::filesystem::path, std::shared_ptr<const uoe::Octomap>>();
+    auto current_map = std::shared_ptr<const uoe::Octomap>();
+    uoe::rrt_service::set_octomap_source([&] { return current_map; });
+    const auto map_at = [&](const std::filesystem::path& path) {
+        if (path.empty()) {
+            return std::shared_ptr<const uoe::Octomap>();
+        }
+        auto& map = maps[path];
+        if (map == nullptr) {
+            auto m = std::make_shared<uoe::Octomap>(0.1);
+            if (! m->octree().readBinary(path.string())) {
+                throw std::runtime_error("could not read " + path.string());
+            }
+            map = std::move(m);
+        }
+        return map;
+    };
+
+    auto file = std::ofstream();
+    if (! output.empty()) {
+        file.open(output);
+    }
+    auto& os = output.empty() ? std::cout : file;
+    os << std::fixed << std::setprecision(3);
+    os << "seq\tkind\tms\tfound\traycasts\toctree_nodes_visited\tvoxels_visited\tnn_queries\t"
+          "nn_nodes_visited\tkdtree_rebuilds\tcollision_checks\tcollisions_rejected\t"
+          "fovs_skipped\tcoarse_accepted\n";
+
+    auto failed = false;
+    for (std::size_t r = 0; r < repeat; ++r) {
+        // every repetition starts from the state of the first, and is seeded as it, so they do
+        // the same work, rather than reuse the trees and claimed viewpoints of the previous one
+        uoe::rrt_service::reset_state();
+        for (const auto& e : entries) {
+            try {
+                current_map = map_at(e.map);
+                if (e.kind == "find_path") {
+                    auto request = uoe::recording::read_message<uoe_msgs::RrtFindPath::Request>(
+                        e.request);
+                    auto response = uoe_msgs::RrtFindPath::Response{};
+                    const auto ms =
+                        time_ms([&] { uoe::rrt_service::find_path(request, response); });
+                    write_row(os, e, ms, response.found_path, response.stats);
+                } else if (e.kind == "nbv") {
+                    auto request = uoe::recording::read_message<uoe_msgs::NBV::Request>(e.request);
+                    auto response = uoe_msgs::NBV::Response{};
+                    const auto ms = time_ms([&] { uoe::rrt_service::nbv(request, response); });
+                    write_row(os, e, ms, response.found_nbv_with_sufficent_gain, response.stats);
+                } else {
+                    std::cerr << "skipping request " << e.seq << " of unknown kind " << e.kind
+                              << '\n';
+                }
+            } catch (const std::runtime_error& err) {
+                std::cerr << err.what() << '\n';
+                failed = true;
+            }
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
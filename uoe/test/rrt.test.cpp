@@ -7,6 +7,8 @@
 #include <cstddef>
 #include <cstdlib>
 #include <eigen3/Eigen/Dense>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <optional>
 #include <thread>
@@ -15,6 +17,7 @@
 #include "uoe/rrt/rrt.hpp"
 #include "uoe/rrt/rrt_builder.hpp"
 #include "uoe/utils/rviz.hpp"
+#include "uoe/utils/trace.hpp"
 #include "ros/assert.h"
 #include "ros/init.h"
 #include "ros/rate.h"
@@ -60,27 +63,19 @@ auto main(int argc, char* argv[]) -> int {
     ROS_INFO("creating rrt");
     auto rrt = uoe::rrt::RRT::from_rosparam("/uoe/rrt");
 
-#ifdef MEASURE_PERF
-
-    if (const auto opt = [=]() -> std::optional<std::filesystem::path> {
-            if (argc >= 2) {
-                return std::make_optional(std::filesystem::path(argv[1]));
-            }
-            return std::nullopt;
-        }()) {
-        const auto measurement_dir = opt.value();
-        const auto measurement_file = measurement_dir / "perf.csv";
-        rrt.enable_perf_logging(measurement_file);
+    // with a directory as argument, the stages of the run are traced, and the duration of every
+    // iteration still in the trace is written to perf.csv, which
+    // generate_medians_of_time_measurements.py reads
+    const auto measurement_dir = [=]() -> std::optional<std::filesystem::path> {
+        if (argc >= 2) {
+            return std::make_optional(std::filesystem::path(argv[1]));
+        }
+        return std::nullopt;
+    }();
+    if (measurement_dir) {
+        uoe::utils::trace::enable();
     }
 
-    // std::size_t i = 0;
-    // rrt.register_cb_for_event_on_new_node_created([&](const auto& p1, const auto& p2) {
-    //     // std::cout << "iteration: " << i << '\n';
-    //     ++i;
-    // });
-
-#endif  // MEASURE_PERF
-
     // rrt.register_cb_for_event_on_trying_full_path(
     //     [](const auto& p1, const auto& p2) { std::cout << "trying full path" << '\n'; });
     // rrt.register_cb_for_event_on_new_node_created([&](const vec3& parent, const vec3& new_node) {
@@ -215,5 +210,17 @@ auto main(int argc, char* argv[]) -> int {
     }
     std::cout << rrt << std::endl;
 
+    if (measurement_dir) {
+        auto csv = std::ofstream(*measurement_dir / "perf.csv");
+        csv << "t,nodes\n";
+        auto i = std::size_t{0};
+        uoe::utils::trace::for_each_event([&](auto, const uoe::utils::trace::event& e) {
+            if (e.s == uoe::utils::trace::stage::grow) {
+                csv << i++ << ',' << static_cast<double>(e.duration_ns) / 1e9 << '\n';
+            }
+        });
+        uoe::utils::trace::write_chrome_trace(std::ofstream(*measurement_dir / "trace.json"));
+    }
+
     return 0;
 }
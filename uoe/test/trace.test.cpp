@@ -0,0 +1,67 @@
+// checks that tracing from short lived threads, like the WorkerPools rrt_service starts per
+// request, reuses the buffers of the threads that have exited, instead of growing the registry
+// by a buffer per thread, and that their events can still be exported.
+// usage: test_trace
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "uoe/utils/trace.hpp"
+
+namespace trace = uoe::utils::trace;
+
+auto check(bool ok, const char* what) -> void {
+    if (! ok) {
+        std::cerr << "FAILED: " << what << '\n';
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+auto trace_in_threads(std::size_t n_threads) -> void {
+    auto threads = std::vector<std::thread>{};
+    for (std::size_t i = 0; i < n_threads; ++i) {
+        threads.emplace_back([] {
+            const auto timer = trace::scoped_timer(trace::stage::grow);
+            trace::count(trace::stage::grow);
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+auto main() -> int {
+    trace::enable();
+
+    constexpr auto N_CONCURRENT = 4;
+    constexpr auto N_ROUNDS = 256;
+    for (auto round = 0; round < N_ROUNDS + 1; ++round) {
+        trace_in_threads(N_CONCURRENT);
+    }
+    // at most a buffer per thread that traced at once, however many have traced in total
+    const auto n_buffers = trace::detail::n_buffers();
+    check(n_buffers <= N_CONCURRENT,
+          "the buffers of exited threads are reused by the next threads");
+
+    // one at a time, every thread gets the buffer the previous one handed back
+    for (auto round = 0; round < N_ROUNDS; ++round) {
+        std::thread([] { const auto timer = trace::scoped_timer(trace::stage::raycast); }).join();
+    }
+    check(trace::detail::n_buffers() == n_buffers, "a thread at a time needs no new buffer");
+
+    const auto total_threads = N_CONCURRENT * (N_ROUNDS + 1) + N_ROUNDS;
+    const auto summary = trace::summary();
+    check(summary[static_cast<std::size_t>(trace::stage::grow)].calls ==
+              N_CONCURRENT * (N_ROUNDS + 1),
+          "the aggregates of exited threads are kept");
+    check(summary[static_cast<std::size_t>(trace::stage::raycast)].calls == N_ROUNDS,
+          "the aggregates of reused buffers accumulate");
+
+    auto n_events = std::size_t{0};
+    trace::for_each_event([&](std::uint32_t, const trace::event&) { ++n_events; });
+    check(n_events == total_threads, "the events of exited threads can still be exported");
+
+    std::cout << total_threads << " threads traced into " << n_buffers << " buffers\n";
+    return EXIT_SUCCESS;
+}